@@ -37,8 +37,8 @@ Csprintf(Cstring *iot, char *fmt, ...)
 
 /* write() into a cstring
  */
-int
-Cswrite(Cstring *iot, char *bfr, int size)
+ptrdiff_t
+Cswrite(Cstring *iot, char *bfr, ptrdiff_t size)
 {
     RESERVE(*iot, size);
     memcpy(T(*iot)+S(*iot), bfr, size);
@@ -47,6 +47,21 @@ Cswrite(Cstring *iot, char *bfr, int size)
 }
 
 
+/* FNV-1a, cut to 32 bits so the same bytes hash the same everywhere
+ * (block ids and saved documents depend on it.)  Start with FNV_BASIS,
+ * or with what it returned last time to keep going.
+ */
+unsigned long
+___mkd_hash(unsigned long h, const void *data, ptrdiff_t size)
+{
+    const unsigned char *p = data;
+
+    while ( size-- > 0 )
+	h = ((h ^ *p++) * 16777619UL) & 0xffffffffUL;
+    return h;
+}
+
+
 /* reparse() into a cstring
  */
 void
@@ -94,13 +94,14 @@
 #define BYTE  unsigned char
 #endif
 
+/*
+ * Thread-local storage for the per-thread document pool.
+ */
+#define THREAD_LOCAL __declspec(thread)
+
 #define HAVE_PWD_H 0
 #define HAVE_GETPWUID 0
-#define HAVE_SRANDOM 0
-#define INITRNG(x) srand((unsigned int)x)
 #define HAVE_BZERO 0
-#define HAVE_RANDOM 0
-#define COINTOSS() (rand()&1)
 #define HAVE_STRCASECMP  1  /* Faked in posc/strings.h */
 #define HAVE_STRNCASECMP 1  /* Faked in posc/strings.h */
 #define HAVE_FCHDIR 0
@@ -87,10 +87,34 @@ LIB32=link.exe -lib
 # PROP Default_Filter "cpp;c;cxx;rc;def;r;odl;idl;hpj;bat"
 # Begin Source File
 
+SOURCE=..\anchor.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\ast.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\async.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\basename.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\batch.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\cache.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\compiled.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\Csio.c
 # End Source File
 # Begin Source File
@@ -107,6 +131,10 @@ SOURCE=..\dumptree.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\edit.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\emmatch.c
 # End Source File
 # Begin Source File
@@ -127,6 +155,10 @@ SOURCE=..\html5.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\index.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\markdown.c
 # End Source File
 # Begin Source File
@@ -135,10 +167,18 @@ SOURCE=..\mkdio.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\outline.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\pgm_options.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\plaintext.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\resource.c
 # End Source File
 # Begin Source File
@@ -1,129 +1,341 @@
-#ifndef _MKDIO_D
-#define _MKDIO_D
-
-#include <stdio.h>
-
-typedef void MMIOT;
-
-typedef unsigned long mkd_flag_t;
-
-/* line builder for markdown()
- */
-MMIOT *mkd_in(FILE*,mkd_flag_t);		/* assemble input from a file */
-MMIOT *mkd_string(const char*,int,mkd_flag_t);	/* assemble input from a buffer */
-
-/* line builder for github flavoured markdown
- */
-MMIOT *gfm_in(FILE*,mkd_flag_t);		/* assemble input from a file */
-MMIOT *gfm_string(const char*,int,mkd_flag_t);	/* assemble input from a buffer */
-
-void mkd_basename(MMIOT*,char*);
-
-void mkd_initialize();
-void mkd_with_html5_tags();
-void mkd_shlib_destructor();
-
-/* compilation, debugging, cleanup
- */
-int mkd_compile(MMIOT*, mkd_flag_t);
-int mkd_cleanup(MMIOT*);
-
-/* markup functions
- */
-int mkd_dump(MMIOT*, FILE*, int, char*);
-int markdown(MMIOT*, FILE*, mkd_flag_t);
-int mkd_line(char *, int, char **, mkd_flag_t);
-typedef int (*mkd_sta_function_t)(const int,const void*);
-void mkd_string_to_anchor(char *, int, mkd_sta_function_t, void*, int);
-int mkd_xhtmlpage(MMIOT*,int,FILE*);
-
-/* header block access
- */
-char* mkd_doc_title(MMIOT*);
-char* mkd_doc_author(MMIOT*);
-char* mkd_doc_date(MMIOT*);
-
-/* compiled data access
- */
-int mkd_document(MMIOT*, char**);
-int mkd_toc(MMIOT*, char**);
-int mkd_css(MMIOT*, char **);
-int mkd_xml(char *, int, char **);
-
-/* write-to-file functions
- */
-int mkd_generatehtml(MMIOT*,FILE*);
-int mkd_generatetoc(MMIOT*,FILE*);
-int mkd_generatexml(char *, int,FILE*);
-int mkd_generatecss(MMIOT*,FILE*);
-#define mkd_style mkd_generatecss
-int mkd_generateline(char *, int, FILE*, mkd_flag_t);
-#define mkd_text mkd_generateline
-
-/* url generator callbacks
- */
-typedef char * (*mkd_callback_t)(const char*, const int, void*);
-typedef void   (*mkd_free_t)(char*, void*);
-
-void mkd_e_url(void *, mkd_callback_t);
-void mkd_e_flags(void *, mkd_callback_t);
-void mkd_e_free(void *, mkd_free_t );
-void mkd_e_data(void *, void *);
-
-/* version#.
- */
-extern char markdown_version[];
-void mkd_mmiot_flags(FILE *, MMIOT *, int);
-void mkd_flags_are(FILE*, mkd_flag_t, int);
-
-void mkd_ref_prefix(MMIOT*, char*);
-
-
-/* special flags for markdown() and mkd_text()
- */
-#define MKD_NOLINKS		0x00000001	/* don't do link processing, block <a> tags  */
-#define MKD_NOIMAGE		0x00000002	/* don't do image processing, block <img> */
-#define MKD_NOPANTS		0x00000004	/* don't run smartypants() */
-#define MKD_NOHTML		0x00000008	/* don't allow raw html through AT ALL */
-#define MKD_STRICT		0x00000010	/* disable SUPERSCRIPT, RELAXED_EMPHASIS */
-#define MKD_TAGTEXT		0x00000020	/* process text inside an html tag; no
-						 * <em>, no <bold>, no html or [] expansion */
-#define MKD_NO_EXT		0x00000040	/* don't allow pseudo-protocols */
-#define MKD_NOEXT		MKD_NO_EXT	/* ^^^ (aliased for user convenience) */
-#define MKD_CDATA		0x00000080	/* generate code for xml ![CDATA[...]] */
-#define MKD_NOSUPERSCRIPT	0x00000100	/* no A^B */
-#define MKD_NORELAXED		0x00000200	/* emphasis happens /everywhere/ */
-#define MKD_NOTABLES		0x00000400	/* disallow tables */
-#define MKD_NOSTRIKETHROUGH	0x00000800	/* forbid ~~strikethrough~~ */
-#define MKD_TOC			0x00001000	/* do table-of-contents processing */
-#define MKD_1_COMPAT		0x00002000	/* compatibility with MarkdownTest_1.0 */
-#define MKD_AUTOLINK		0x00004000	/* make http://foo.com link even without <>s */
-#define MKD_SAFELINK		0x00008000	/* paranoid check for link protocol */
-#define MKD_NOHEADER		0x00010000	/* don't process header blocks */
-#define MKD_TABSTOP		0x00020000	/* expand tabs to 4 spaces */
-#define MKD_NODIVQUOTE		0x00040000	/* forbid >%class% blocks */
-#define MKD_NOALPHALIST		0x00080000	/* forbid alphabetic lists */
-#define MKD_NODLIST		0x00100000	/* forbid definition lists */
-#define MKD_EXTRA_FOOTNOTE	0x00200000	/* enable markdown extra-style footnotes */
-#define MKD_NOSTYLE		0x00400000
-
-#if WITH_TINPOT_
-#define MKD_XML			MKD_CDATA	/* XML output: use `<... />`. */
-#define MKD_ISO			0x00800000	/* ISO HTML output: omit `type="a"` in <OL> etc. */
-#define MKD_OUT_UTF8		0x00000000	/* Output UTF-8 (default, hence zero bitmask). */
-#define MKD_OUT_ASCII		0x01000000	/* Output ASCII. */
-#define MKD_OUT_LATIN1		0x02000000	/* Output ISO 8859-1 */
-#define MKD_IN_LATIN1		0x04000000	/* Input is in ISO 8859-1 */
-#define MKD_IN_UTF8		0x00000000	/* Input is in UTF-8 (default, hence zero bitmask). */
-#if WITH_TCL_WIKI
-#define MKD_WIKI		0x08000000	/* Perform tricks for Tcl Wiki. */
-#endif
-#endif /* WITH_TINPOT_ */
-
-#define MKD_EMBED		MKD_NOLINKS|MKD_NOIMAGE|MKD_TAGTEXT
-
-/* special flags for mkd_in() and mkd_string()
- */
-
-
-#endif/*_MKDIO_D*/
+#ifndef _MKDIO_D
+#define _MKDIO_D
+
+#include <stdio.h>
+#include <stddef.h>
+
+typedef void MMIOT;
+typedef void mkd_engine;
+
+typedef unsigned long mkd_flag_t;
+
+/* line builder for markdown()
+ */
+MMIOT *mkd_in(FILE*,mkd_flag_t);		/* assemble input from a file */
+MMIOT *mkd_string(const char*,int,mkd_flag_t);	/* assemble input from a buffer */
+MMIOT *mkd_string64(const char*,size_t,mkd_flag_t);	/* ... a really big buffer */
+
+/* line builder for github flavoured markdown
+ */
+MMIOT *gfm_in(FILE*,mkd_flag_t);		/* assemble input from a file */
+MMIOT *gfm_string(const char*,int,mkd_flag_t);	/* assemble input from a buffer */
+
+/* reusing documents
+ */
+void mkd_reset(MMIOT*);				/* empty a document for reuse */
+MMIOT *mkd_reuse_in(MMIOT*,FILE*,mkd_flag_t);	/* mkd_in() into a used document */
+MMIOT *mkd_reuse_string(MMIOT*,const char*,int,mkd_flag_t);
+MMIOT *mkd_pool_in(FILE*,mkd_flag_t);		/* mkd_in() from the thread's pool */
+MMIOT *mkd_pool_string(const char*,int,mkd_flag_t);
+void mkd_pool_release(MMIOT*);			/* give a document back to the pool */
+void mkd_pool_drain();				/* free the thread's pool */
+
+/* documents that can be edited and compiled again
+ */
+MMIOT *mkd_edit_string(const char*,int,mkd_flag_t);
+int mkd_update(MMIOT*,int,int,const char*,int);	/* replace part of the source */
+
+/* line builder for mkd_stream()
+ */
+MMIOT *mkd_stream_in(FILE*,mkd_flag_t);	/* read input a piece at a time */
+
+void mkd_basename(MMIOT*,char*);
+
+void mkd_initialize();
+void mkd_with_html5_tags();
+void mkd_shlib_destructor();
+
+/* engines: tags, raw delimiters, and default flags for documents
+ * that might be rendered on different threads
+ */
+mkd_engine *mkd_engine_new(mkd_flag_t);		/* default flags */
+int mkd_engine_define_tag(mkd_engine*,char*,int);	/* extra html block tag */
+int mkd_engine_html5_tags(mkd_engine*);
+int mkd_engine_raw(mkd_engine*,char*);		/* raw delimiters */
+int mkd_engine_seed(mkd_engine*,unsigned long);	/* email mangling seed */
+int mkd_engine_cache(mkd_engine*,size_t);	/* share rendered blocks */
+void mkd_engine_freeze(mkd_engine*);		/* no more changes */
+void mkd_engine_free(mkd_engine*);
+MMIOT *mkd_engine_in(mkd_engine*,FILE*,mkd_flag_t);
+MMIOT *mkd_engine_string(mkd_engine*,const char*,int,mkd_flag_t);
+
+/* compilation, debugging, cleanup
+ */
+int mkd_compile(MMIOT*, mkd_flag_t);
+int mkd_cleanup(MMIOT*);
+
+/* compiled documents that can be loaded without compiling them again
+ */
+int mkd_save_compiled(MMIOT*,FILE*);
+MMIOT *mkd_load_compiled(const void*,size_t);	/* (which has to stay around) */
+
+/* markup functions
+ */
+int mkd_dump(MMIOT*, FILE*, int, char*);
+int markdown(MMIOT*, FILE*, mkd_flag_t);
+int mkd_line(char *, int, char **, mkd_flag_t);
+typedef int (*mkd_sta_function_t)(const int,const void*);
+void mkd_string_to_anchor(char *, int, mkd_sta_function_t, void*, int);
+int mkd_xhtmlpage(MMIOT*,int,FILE*);
+
+/* rendering a lot of documents at once
+ */
+typedef struct mkd_batch {
+    const char *text;		/* markdown source */
+    int size;
+    char *html;			/* malloc()ed html */
+    int htmlsize;		/* (EOF if it couldn't be rendered) */
+} mkd_batch_t;
+
+int mkd_threads(int);				/* 0 = one per processor */
+int mkd_render_batch(mkd_batch_t*,int,mkd_flag_t,int);
+void mkd_free_batch(mkd_batch_t*,int);
+
+/* converting documents in the background
+ */
+typedef struct mkd_result {
+    int id;			/* what mkd_submit() returned */
+    void *cookie;		/* and what was passed to it */
+    char *html;			/* malloc()ed html */
+    int htmlsize;		/* (EOF if it couldn't be rendered) */
+} mkd_result_t;
+
+int mkd_async_start(int);			/* start nthreads workers */
+int mkd_async_fd();				/* readable when there are results */
+int mkd_submit(mkd_engine*,const char*,int,mkd_flag_t,void*);
+int mkd_cancel(int);				/* drop a queued document */
+int mkd_poll(mkd_result_t*,int);		/* pick up finished documents */
+void mkd_free_result(mkd_result_t*);
+void mkd_async_shutdown();
+
+/* changes since the last time a document was rendered
+ */
+typedef struct mkd_patch {
+    int op;
+#define MKD_PATCH_INSERT	1
+#define MKD_PATCH_REMOVE	2
+#define MKD_PATCH_REPLACE	3
+    int where;			/* which block it is (or was) */
+    unsigned long id;		/* the block */
+    unsigned long old;		/* and the one it replaces */
+    char *html;			/* malloc()ed html */
+    int htmlsize;
+} mkd_patch_t;
+
+int mkd_patch(MMIOT*,MMIOT*,mkd_patch_t**);	/* blocks changed since the last render */
+void mkd_free_patch(mkd_patch_t*,int);
+
+/* the document as a tree
+ */
+typedef struct mkd_node {
+    int type;
+#define MKD_NODE_CODE		1	/* blocks */
+#define MKD_NODE_QUOTE		2
+#define MKD_NODE_PARAGRAPH	3
+#define MKD_NODE_HTML		4
+#define MKD_NODE_STYLE		5
+#define MKD_NODE_DL		6
+#define MKD_NODE_UL		7
+#define MKD_NODE_OL		8
+#define MKD_NODE_AL		9
+#define MKD_NODE_ITEM		10
+#define MKD_NODE_HEADER		11
+#define MKD_NODE_HR		12
+#define MKD_NODE_TABLE		13
+#define MKD_NODE_ROW		14
+#define MKD_NODE_HEADCELL	15
+#define MKD_NODE_CELL		16
+#define MKD_NODE_TERM		17
+#define MKD_NODE_NOTES		18	/* the footnotes, after everything else */
+#define MKD_NODE_NOTE		19
+#define MKD_NODE_TEXT		20	/* and what's inside them */
+#define MKD_NODE_EM		21
+#define MKD_NODE_STRONG		22
+#define MKD_NODE_CODESPAN	23
+#define MKD_NODE_LINK		24
+#define MKD_NODE_IMAGE		25
+#define MKD_NODE_SUPERSCRIPT	26
+#define MKD_NODE_DEL		27
+#define MKD_NODE_BREAK		28
+#define MKD_NODE_TAG		29
+#define MKD_NODE_NOTEREF	30
+    struct mkd_node *next;
+    struct mkd_node *child;
+    const char *text;		/* text, code, html, the url, or a footnote label */
+    int size;			/* (which isn't null-terminated) */
+    const char *title;		/* the title of a link or image, or what a footnote says */
+    int titlesize;
+    const char *ident;		/* %id% of a quote or list item */
+    const char *lang;		/* the language of a code block */
+    int hnumber;		/* header level */
+    int align;			/* paragraph or table cell alignment */
+#define MKD_ALIGN_NONE		0
+#define MKD_ALIGN_CENTER	1
+#define MKD_ALIGN_LEFT		2
+#define MKD_ALIGN_RIGHT		3
+    int height, width;		/* of an image */
+    int number;			/* of a footnote */
+    int line;			/* the line of the source it starts on */
+} mkd_node_t;
+
+int mkd_ast(MMIOT*,mkd_node_t**);		/* which belongs to the document */
+typedef int (*mkd_event_t)(const mkd_node_t*,int,void*);
+int mkd_walk(MMIOT*,mkd_event_t,void*);		/* node by node, without the tree */
+
+/* the headers and link targets, and the lines they're on
+ */
+typedef struct mkd_outline {
+    int type;
+#define MKD_OUTLINE_HEADER	1
+#define MKD_OUTLINE_LINK	2
+#define MKD_OUTLINE_IMAGE	3
+#define MKD_OUTLINE_REF		4	/* a [label]: url definition */
+    int line;
+    int hnumber;		/* header level */
+    char *text;			/* what a header says, or the url */
+    int size;
+    char *anchor;		/* what a header is called in the html */
+    char *label;		/* the label a url is defined for */
+    int labelsize;
+} mkd_outline_t;
+
+int mkd_outline(MMIOT*,mkd_outline_t**);	/* free() it when you're done */
+
+/* everything that's written out about a document, from one pass
+ */
+typedef struct mkd_header {
+    int hnumber;
+    int top;			/* it's in the table of contents */
+    char *text;			/* what it says */
+    int textsize;
+    char *anchor;		/* what it's called in the html */
+    int anchorsize;
+} mkd_header_t;
+
+typedef struct mkd_outputs {
+    char *html;			/* (which belongs to the document) */
+    int htmlsize;
+    char *toc;
+    int tocsize;
+    char *css;
+    int csssize;
+    mkd_header_t *headers;
+    int nheaders;
+    char *title, *author, *date;/* (which belong to the document) */
+} mkd_outputs_t;
+
+int mkd_outputs(MMIOT*,mkd_outputs_t*);
+void mkd_free_outputs(mkd_outputs_t*);
+
+/* a document rendered as one piece of html for each section
+ */
+typedef struct mkd_split {
+    mkd_header_t header;	/* the header it starts with */
+    int first, last;		/* the top-level blocks it's made of */
+    char *html;			/* malloc()ed html */
+    int htmlsize;
+} mkd_split_t;
+
+int mkd_split(MMIOT*,int,mkd_flag_t,mkd_split_t**);	/* all in one pass */
+void mkd_free_split(mkd_split_t*,int);
+
+/* header block access
+ */
+char* mkd_doc_title(MMIOT*);
+char* mkd_doc_author(MMIOT*);
+char* mkd_doc_date(MMIOT*);
+MMIOT *mkd_peek_header(FILE*,mkd_flag_t);	/* read just the header */
+
+/* compiled data access
+ */
+int mkd_document(MMIOT*, char**);
+ptrdiff_t mkd_document64(MMIOT*, char**);
+int mkd_render_next(MMIOT*, char*, int);
+int mkd_render(MMIOT*, mkd_flag_t, char**);	/* without changing the document */
+int mkd_render_range(MMIOT*, int, int, mkd_flag_t, char**);	/* just blocks [first,last) */
+int mkd_section(MMIOT*, char*, int*, int*);	/* the blocks a header starts */
+int mkd_toc(MMIOT*, char**);
+int mkd_css(MMIOT*, char **);
+int mkd_plaintext(MMIOT*, char **);		/* just the text, for indexing */
+int mkd_xml(char *, int, char **);
+
+/* write-to-file functions
+ */
+int mkd_generatehtml(MMIOT*,FILE*);
+int mkd_generatetoc(MMIOT*,FILE*);
+int mkd_generatexml(char *, int,FILE*);
+int mkd_generatexml64(char *, ptrdiff_t,FILE*);	/* for more than an int can hold */
+int mkd_generatecss(MMIOT*,FILE*);
+int mkd_generateplaintext(MMIOT*,FILE*);
+int mkd_stream(MMIOT*,FILE*,mkd_flag_t);
+#define mkd_style mkd_generatecss
+int mkd_generateline(char *, int, FILE*, mkd_flag_t);
+#define mkd_text mkd_generateline
+
+/* url generator callbacks
+ */
+typedef char * (*mkd_callback_t)(const char*, const int, void*);
+typedef void   (*mkd_free_t)(char*, void*);
+
+void mkd_e_url(void *, mkd_callback_t);
+void mkd_e_flags(void *, mkd_callback_t);
+void mkd_e_free(void *, mkd_free_t );
+void mkd_e_data(void *, void *);
+
+/* version#.
+ */
+extern char markdown_version[];
+void mkd_mmiot_flags(FILE *, MMIOT *, int);
+void mkd_flags_are(FILE*, mkd_flag_t, int);
+
+void mkd_ref_prefix(MMIOT*, char*);
+
+
+/* special flags for markdown() and mkd_text()
+ */
+#define MKD_NOLINKS		0x00000001	/* don't do link processing, block <a> tags  */
+#define MKD_NOIMAGE		0x00000002	/* don't do image processing, block <img> */
+#define MKD_NOPANTS		0x00000004	/* don't run smartypants() */
+#define MKD_NOHTML		0x00000008	/* don't allow raw html through AT ALL */
+#define MKD_STRICT		0x00000010	/* disable SUPERSCRIPT, RELAXED_EMPHASIS */
+#define MKD_TAGTEXT		0x00000020	/* process text inside an html tag; no
+						 * <em>, no <bold>, no html or [] expansion */
+#define MKD_NO_EXT		0x00000040	/* don't allow pseudo-protocols */
+#define MKD_NOEXT		MKD_NO_EXT	/* ^^^ (aliased for user convenience) */
+#define MKD_CDATA		0x00000080	/* generate code for xml ![CDATA[...]] */
+#define MKD_NOSUPERSCRIPT	0x00000100	/* no A^B */
+#define MKD_NORELAXED		0x00000200	/* emphasis happens /everywhere/ */
+#define MKD_NOTABLES		0x00000400	/* disallow tables */
+#define MKD_NOSTRIKETHROUGH	0x00000800	/* forbid ~~strikethrough~~ */
+#define MKD_TOC			0x00001000	/* do table-of-contents processing */
+#define MKD_1_COMPAT		0x00002000	/* compatibility with MarkdownTest_1.0 */
+#define MKD_AUTOLINK		0x00004000	/* make http://foo.com link even without <>s */
+#define MKD_SAFELINK		0x00008000	/* paranoid check for link protocol */
+#define MKD_NOHEADER		0x00010000	/* don't process header blocks */
+#define MKD_TABSTOP		0x00020000	/* expand tabs to 4 spaces */
+#define MKD_NODIVQUOTE		0x00040000	/* forbid >%class% blocks */
+#define MKD_NOALPHALIST		0x00080000	/* forbid alphabetic lists */
+#define MKD_NODLIST		0x00100000	/* forbid definition lists */
+#define MKD_EXTRA_FOOTNOTE	0x00200000	/* enable markdown extra-style footnotes */
+#define MKD_NOSTYLE		0x00400000
+
+#if WITH_TINPOT_
+#define MKD_XML			MKD_CDATA	/* XML output: use `<... />`. */
+#define MKD_ISO			0x00800000	/* ISO HTML output: omit `type="a"` in <OL> etc. */
+#define MKD_OUT_UTF8		0x00000000	/* Output UTF-8 (default, hence zero bitmask). */
+#define MKD_OUT_ASCII		0x01000000	/* Output ASCII. */
+#define MKD_OUT_LATIN1		0x02000000	/* Output ISO 8859-1 */
+#define MKD_IN_LATIN1		0x04000000	/* Input is in ISO 8859-1 */
+#define MKD_IN_UTF8		0x00000000	/* Input is in UTF-8 (default, hence zero bitmask). */
+#if WITH_TCL_WIKI
+#define MKD_WIKI		0x08000000	/* Perform tricks for Tcl Wiki. */
+#endif
+#endif /* WITH_TINPOT_ */
+
+#define MKD_EMBED		MKD_NOLINKS|MKD_NOIMAGE|MKD_TAGTEXT
+
+/* special flags for mkd_in() and mkd_string()
+ */
+
+
+#endif/*_MKDIO_D*/
@@ -0,0 +1,326 @@
+/* markdown: a C implementation of John Gruber's Markdown markup language.
+ *
+ * Copyright (C) 2007 David L Parsons.
+ * The redistribution terms are provided in the COPYRIGHT file that must
+ * be distributed with this source code.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "cstring.h"
+#include "markdown.h"
+#include "amalloc.h"
+
+/* the anchors headers are given in the html (and linked to from the
+ * table of contents.)   They're worked out once, when the document is
+ * compiled, straight from the markdown -- the header isn't rendered
+ * to get them -- and if two headers would get the same anchor the
+ * second one gets a -1 on the end (and the third a -2, and so on.)
+ */
+
+static void label(char *, int, Cstring *);
+
+
+/* find the ] that closes the [ at s[0], or -1
+ */
+static int
+closebracket(char *s, int size)
+{
+    int i, depth = 0;
+
+    for ( i=0; i < size; i++ )
+	switch ( s[i] ) {
+	case '\\':  i++;
+		    break;
+	case '[':   depth++;
+		    break;
+	case ']':   if ( --depth == 0 )
+			return i;
+		    break;
+	}
+    return -1;
+}
+
+
+/* find the end of the (url) or [label] that s[0] starts, or -1
+ */
+static int
+closelink(char *s, int size)
+{
+    int i, depth = 0;
+    char open = s[0], close = (open == '(') ? ')' : ']';
+
+    for ( i=0; i < size; i++ )
+	if ( s[i] == '\\' )
+	    i++;
+	else if ( s[i] == open )
+	    depth++;
+	else if ( (s[i] == close) && (--depth == 0) )
+	    return i;
+    return -1;
+}
+
+
+/* a link (or image) is just its text; a footnote isn't anything
+ */
+static int
+linktext(char *s, int size, Cstring *out)
+{
+    int close, end;
+
+    if ( (close = closebracket(s, size)) < 0 )
+	return 0;
+
+    if ( (size > 1) && (s[1] == '^') )
+	return close+1;
+
+    end = close+1;
+    if ( (end < size) && ((s[end] == '(') || (s[end] == '[')) ) {
+	if ( (end = closelink(s+end, size-end)) < 0 )
+	    return 0;
+	end += close+2;
+    }
+    else {
+	/* it's only a link if there's a reference for it, so leave
+	 * the brackets alone
+	 */
+	Csputc('[', out);
+	label(s+1, close-1, out);
+	Csputc(']', out);
+	return close+1;
+    }
+    label(s+1, close-1, out);
+    return end;
+}
+
+
+/* a code span is its code, without the backticks
+ */
+static int
+codespan(char *s, int size, Cstring *out)
+{
+    int ticks, i, j;
+
+    for ( ticks=0; (ticks < size) && (s[ticks] == '`'); ticks++ )
+	;
+    for ( i=ticks; i < size; i++ )
+	if ( s[i] == '`' ) {
+	    for ( j=i; (j < size) && (s[j] == '`'); j++ )
+		;
+	    if ( j-i == ticks ) {
+		Cswrite(out, s+ticks, i-ticks);
+		return j;
+	    }
+	    i = j-1;
+	}
+    return 0;
+}
+
+
+/* an autolink is its address; a html tag isn't anything
+ */
+static int
+tag(char *s, int size, Cstring *out)
+{
+    int i;
+
+    for ( i=1; (i < size) && (s[i] != '>'); i++ )
+	if ( isspace(s[i]) && !((s[1] == '/') || isalpha(s[1])) )
+	    return 0;
+    if ( i >= size )
+	return 0;
+
+    if ( memchr(s+1, ':', i-1) || memchr(s+1, '@', i-1) ) {
+	if ( (i > 8) && (strncasecmp(s+1, "mailto:", 7) == 0) )
+	    Cswrite(out, s+8, i-8);
+	else
+	    Cswrite(out, s+1, i-1);
+    }
+    return i+1;
+}
+
+
+/* write out the text of a header without its markup
+ */
+static void
+label(char *s, int size, Cstring *out)
+{
+    int i, n, c;
+
+    for ( i=0; i < size; i++ ) {
+	c = s[i];
+	n = 0;
+
+	switch ( c ) {
+	case '\\':  if ( (i+1 < size) && ispunct(s[i+1]) )
+			c = s[++i];
+		    break;
+	case '!':   if ( (i+1 < size) && (s[i+1] == '[') )
+			n = linktext(s+i+1, size-i-1, out) + 1;
+		    break;
+	case '[':   n = linktext(s+i, size-i, out);
+		    break;
+	case '`':   n = codespan(s+i, size-i, out);
+		    break;
+	case '<':   n = tag(s+i, size-i, out);
+		    break;
+	case '*':
+	case '~':   continue;
+	case '_':   /* underscores inside words aren't emphasis */
+		    if ( !( (i > 0) && isalnum(s[i-1])
+			   && (i+1 < size) && isalnum(s[i+1]) ) )
+			continue;
+		    break;
+	}
+
+	if ( n > 1 )
+	    i += n-1;
+	else
+	    Csputc(c, out);
+    }
+}
+
+
+/* write out the anchor a header with this text gets, before it's been
+ * made unique
+ */
+void
+___mkd_string_slug(char *s, int size, Cstring *out)
+{
+    Cstring text;
+
+    while ( size && isspace(s[0]) )
+	++s, --size;
+    while ( size && isspace(s[size-1]) )
+	--size;
+
+    CREATE(text);
+    RESERVE(text, size+1);
+    label(s, size, &text);
+    ___mkd_label_anchor(T(text), S(text), (mkd_sta_function_t)Csputc, out);
+    DELETE(text);
+}
+
+
+/* write out the anchor a header gets, before it's been made unique
+ */
+void
+___mkd_slug(Paragraph *p, Cstring *out)
+{
+    if ( p->text )
+	___mkd_string_slug(T(p->text->text), S(p->text->text), out);
+}
+
+
+/* find where an anchor is (or would go) in the set
+ */
+static struct anchor *
+slot(Anchors *a, char *s)
+{
+    unsigned long i = ___mkd_hash(FNV_BASIS, s, strlen(s)) % a->nslots;
+
+    while ( a->slot[i].name && strcmp(a->slot[i].name, s) )
+	i = (i+1) % a->nslots;
+    return &a->slot[i];
+}
+
+
+static void
+grow(Anchors *a)
+{
+    Anchors bigger;
+    int i;
+
+    bigger.nslots = a->nslots ? 2 * a->nslots : 64;
+    bigger.count = a->count;
+    bigger.slot = calloc(bigger.nslots, sizeof bigger.slot[0]);
+
+    for ( i=0; i < a->nslots; i++ )
+	if ( a->slot[i].name )
+	    *slot(&bigger, a->slot[i].name) = a->slot[i];
+    if ( a->slot )
+	free(a->slot);
+    *a = bigger;
+}
+
+
+/* give a header its anchor, unless another header already has it.
+ * The anchor it would have gotten remembers the last -N that was put
+ * on it, so a document full of headers with the same name doesn't
+ * have to try -1, -2, ... all over again for each one.   `bfr` is
+ * somewhere to build the anchor in.
+ */
+void
+___mkd_anchor(Paragraph *p, Anchors *a, Cstring *bfr)
+{
+    int size;
+    struct anchor *base, *s;
+
+    if ( 2 * (a->count+2) > a->nslots )
+	grow(a);
+
+    S(*bfr) = 0;
+    ___mkd_slug(p, bfr);
+    size = S(*bfr);
+    EXPAND(*bfr) = 0;
+
+    if ( (base = s = slot(a, T(*bfr)))->name ) {
+	do {
+	    S(*bfr) = size;
+	    Csprintf(bfr, "-%d", ++base->last);
+	    EXPAND(*bfr) = 0;
+	} while ( (s = slot(a, T(*bfr)))->name );
+    }
+
+    if ( p->anchor )
+	free(p->anchor);
+    p->anchor = strdup(T(*bfr));
+    s->name = strdup(T(*bfr));
+    s->last = 0;
+    a->count++;
+}
+
+
+static void
+anchors(Paragraph *p, Anchors *a, Cstring *bfr)
+{
+    for ( ; p; p = p->next ) {
+	if ( p->typ == HDR )
+	    ___mkd_anchor(p, a, bfr);
+	if ( p->down )
+	    anchors(p->down, a, bfr);
+    }
+}
+
+
+/* give all the headers in a list of paragraphs their anchors; `a` is
+ * the anchors that have been given out already
+ */
+void
+___mkd_anchors(Paragraph *p, Anchors *a)
+{
+    Cstring bfr;
+
+    CREATE(bfr);
+    RESERVE(bfr, 80);
+    anchors(p, a, &bfr);
+    DELETE(bfr);
+}
+
+
+void
+___mkd_free_anchors(Anchors *a)
+{
+    int i;
+
+    for ( i=0; i < a->nslots; i++ )
+	if ( a->slot[i].name )
+	    free(a->slot[i].name);
+    if ( a->slot )
+	free(a->slot);
+    memset(a, 0, sizeof *a);
+}
@@ -0,0 +1,1737 @@
+/* markdown: a C implementation of John Gruber's Markdown markup language.
+ *
+ * Copyright (C) 2007 David L Parsons.
+ * The redistribution terms are provided in the COPYRIGHT file that must
+ * be distributed with this source code.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "cstring.h"
+#include "markdown.h"
+#include "amalloc.h"
+
+/* mkd_walk() sends a compiled document, block by block and then piece
+ * by piece inside each block, to a function for programs that want to
+ * know what's in it (the links, the headers, the code) instead of what
+ * it looks like, and mkd_ast() uses it to make a tree out of the
+ * document.   The blocks come straight from the Paragraph tree, and the
+ * text inside them is picked apart with the same rules text() uses, but
+ * nothing is written out as html.   The text is left where it is unless
+ * it has to be put back together (paragraphs, code blocks, and urls with
+ * \escapes in them); that goes in an arena, which mkd_walk() empties
+ * after every block and mkd_ast() keeps with the tree.
+ */
+#define ARENA_SIZE	8192
+#define ALIGN(x)	(((x) + 7) & ~(size_t)7)
+
+struct arena {
+    struct arena *next;
+    size_t used, size;
+} ;
+
+struct ast {
+    Node *root;
+    struct arena *arena;
+} ;
+
+/* a piece of text that's been picked apart, or a run of *s or _s that
+ * might turn out to be emphasis.   The text inside a link or a span is
+ * picked apart when it's sent, after the emphasis around it has been
+ * matched up.
+ */
+typedef struct token {
+    Node node;
+    char *at;			/* where it starts */
+    char *sub;			/* the text inside it */
+    int subsize;
+    char *subesc;		/* (and what can be \escaped there) */
+    int literal;		/* which isn't picked apart (alt text) */
+    char *run;			/* where the run is */
+    int count;			/* how many are left to match */
+    int fill;			/* how many turned out to be text */
+    Cstring open, close;	/* what it starts and ends (1 = em, 2 = strong) */
+    Footnote *note;		/* the footnote a [^reference] is to */
+} Token;
+
+typedef STRING(Token) Tokens;
+typedef STRING(int) Istring;
+
+/* which line of the source each line of a block's text came from
+ */
+typedef struct { int offset, line; } Linestart;
+typedef STRING(Linestart) Linemap;
+
+struct walk {
+    MMIOT *f;
+    mkd_event_t event;		/* where the nodes go */
+    void *ctx;
+    int stop;			/* what it returned when it wanted to stop */
+    struct arena **arena;
+    int keep;			/* don't empty the arena after each block */
+    Tokens tokens;		/* the text that's being picked apart */
+    Istring emphasis;		/* and the emphasis that's been sent */
+    char *text;			/* the block's text */
+    int size;
+    Linemap lines;		/* and where its lines start */
+    STRING(Footnote*) notes;	/* the footnotes referenced, in order */
+} ;
+
+typedef int (*stfu)(const void*,const void*);
+int __mkd_footsort(Footnote *, Footnote *);
+
+
+static void *
+alloc(struct arena **a, size_t size)
+{
+    struct arena *p = *a;
+    char *ret;
+
+    size = ALIGN(size);
+    if ( !p || (p->used + size > p->size) ) {
+	size_t room = (size > ARENA_SIZE) ? size : ARENA_SIZE;
+
+	p = malloc(ALIGN(sizeof *p) + room);
+	p->next = *a;
+	p->used = 0;
+	p->size = room;
+	*a = p;
+    }
+    ret = (char*)p + ALIGN(sizeof *p) + p->used;
+    p->used += size;
+    return ret;
+}
+
+
+/* empty out an arena, keeping the first piece of it around
+ */
+static void
+empty(struct arena **a)
+{
+    struct arena *p, *next;
+
+    if ( !*a )
+	return;
+    for ( p = *a; p->next; p = next ) {
+	next = p->next;
+	free(p);
+    }
+    p->used = 0;
+    *a = p;
+}
+
+
+static void
+freearena(struct arena **a)
+{
+    struct arena *p, *next;
+
+    for ( p = *a; p; p = next ) {
+	next = p->next;
+	free(p);
+    }
+    *a = 0;
+}
+
+
+/* send a node to the walker, unless it's already been told to stop
+ */
+static int
+send(struct walk *w, Node *n, int leaving)
+{
+    if ( !w->stop )
+	w->stop = (*w->event)(n, leaving, w->ctx);
+    return w->stop;
+}
+
+
+static void
+leaf(struct walk *w, Node *n)
+{
+    send(w, n, 0);
+    send(w, n, 1);
+}
+
+
+/* the text of a block is `size` bytes at `text`, which start on
+ * line `line` of the source
+ */
+static void
+source(struct walk *w, char *text, int size, int line)
+{
+    w->text = text;
+    w->size = size;
+    S(w->lines) = 0;
+    EXPAND(w->lines).offset = 0;
+    T(w->lines)[0].line = line;
+}
+
+
+/* and the line at `offset` of it is line `line`
+ */
+static void
+newline(struct walk *w, int offset, int line)
+{
+    Linestart *l = &T(w->lines)[S(w->lines)-1];
+
+    if ( l->offset < offset )
+	l = &EXPAND(w->lines);
+
+    l->offset = offset;
+    l->line = line;
+}
+
+
+/* which line of the source something in the block's text is on
+ */
+static int
+lineof(struct walk *w, char *at)
+{
+    int lo = 0, hi = S(w->lines)-1, mid, offset;
+
+    if ( !S(w->lines) )
+	return 0;
+    if ( !at || (at < w->text) || (at > w->text + w->size) )
+	return T(w->lines)[0].line;
+
+    offset = at - w->text;
+    while ( lo < hi ) {
+	mid = (lo + hi + 1) / 2;
+	if ( T(w->lines)[mid].offset <= offset )
+	    lo = mid;
+	else
+	    hi = mid-1;
+    }
+    return T(w->lines)[lo].line;
+}
+
+
+/* the first line of the source a block came from
+ */
+static int
+firstline(Paragraph *p)
+{
+    Paragraph *q;
+    int line;
+
+    if ( p->text )
+	return p->text->lineno;
+    for ( q = p->down; q; q = q->next )
+	if ( (line = firstline(q)) )
+	    return line;
+    return 0;
+}
+
+
+/*
+ * picking apart the text in a block
+ */
+
+struct scan {
+    struct walk *w;
+    MMIOT *f;
+    char *s;			/* the text */
+    int size;
+    int pos;			/* where the next character is */
+    char *esc;			/* extra characters that can be \escaped */
+    int base;			/* where its tokens start in w->tokens */
+} ;
+
+#define NTOKENS(sc)	(S((sc)->w->tokens) - (sc)->base)
+#define TOKEN(sc,i)	(T((sc)->w->tokens)[(sc)->base + (i)])
+
+#define MARKUP	"\003![^_*~`\\<"	/* what text() looks for */
+
+static void inlines(struct walk *, char *, int, char *);
+
+
+/* look <i> characters ahead of the cursor, like peek() in generate.c
+ */
+static int
+peek(struct scan *sc, int i)
+{
+    int at = sc->pos - 1 + i;
+
+    return (at >= 0) && (at < sc->size) ? (unsigned char)sc->s[at] : EOF;
+}
+
+
+static int
+pull(struct scan *sc)
+{
+    return (sc->pos < sc->size) ? (unsigned char)sc->s[sc->pos++] : EOF;
+}
+
+
+static void
+shift(struct scan *sc, int i)
+{
+    if ( sc->pos + i >= 0 )
+	sc->pos += i;
+}
+
+
+static int
+isthisspace(struct scan *sc, int i)
+{
+    int c = peek(sc, i);
+
+    if ( c == EOF )
+	return 1;
+    if ( c & 0x80 )
+	return 0;
+    return isspace(c) || (c < ' ');
+}
+
+
+static int
+isthisalnum(struct scan *sc, int i)
+{
+    int c = peek(sc, i);
+
+    return (c != EOF) && isalnum(c);
+}
+
+
+static int
+isthisnonword(struct scan *sc, int i)
+{
+    return isthisspace(sc, i) || ispunct(peek(sc,i));
+}
+
+
+static Token *
+token(struct scan *sc)
+{
+    Token *t = &EXPAND(sc->w->tokens);
+
+    memset(t, 0, sizeof *t);
+    t->at = sc->s + sc->pos - 1;
+    return t;
+}
+
+
+static Node *
+add(struct scan *sc, int type)
+{
+    Token *t = token(sc);
+
+    t->node.type = type;
+    return &t->node;
+}
+
+
+/* the character <i> characters back from the cursor is plain text
+ */
+static void
+plain(struct scan *sc, int i)
+{
+    char *c = sc->s + sc->pos - i;
+    Node *last;
+
+    if ( NTOKENS(sc) ) {
+	last = &TOKEN(sc, NTOKENS(sc)-1).node;
+	if ( (last->type == MKD_NODE_TEXT) && (last->text + last->size == c) ) {
+	    last->size++;
+	    return;
+	}
+    }
+    last = add(sc, MKD_NODE_TEXT);
+    last->text = c;
+    last->size = 1;
+    TOKEN(sc, NTOKENS(sc)-1).at = c;
+}
+
+
+/* the text inside the last node, which is sent after it is
+ */
+static void
+inside(struct scan *sc, char *text, int size, char *esc, int literal)
+{
+    Token *t = &TOKEN(sc, NTOKENS(sc)-1);
+
+    t->sub = text;
+    t->subsize = size;
+    t->subesc = esc;
+    t->literal = literal;
+}
+
+
+/* a run of *s or _s
+ */
+static void
+run(struct scan *sc, int count)
+{
+    Token *t = token(sc);
+
+    t->at = t->run = sc->s + sc->pos - count;
+    t->count = count;
+    CREATE(t->open);
+    CREATE(t->close);
+}
+
+
+/* copy a url, taking out the \s that puturl() would leave out
+ */
+static void
+url(struct scan *sc, Node *n, char *s, int size)
+{
+    char *p;
+    int i;
+
+    n->text = s;
+    n->size = size;
+    if ( !memchr(s, '\\', size) )
+	return;
+
+    n->text = p = alloc(sc->w->arena, size);
+    for ( n->size = i = 0; i < size; i++ ) {
+	if ( (s[i] == '\\') && (i < size-1)
+			    && (ispunct((unsigned char)s[i+1])
+				|| isspace((unsigned char)s[i+1])) )
+	    ++i;
+	p[n->size++] = s[i];
+    }
+}
+
+
+/*
+ * links, which follow linkylinky() and friends in generate.c
+ */
+
+static int
+eatspace(struct scan *sc)
+{
+    int c;
+
+    for ( ; ((c=peek(sc, 1)) != EOF) && isspace(c); pull(sc) )
+	;
+    return c;
+}
+
+
+static int
+parenthetical(struct scan *sc, int in, int out)
+{
+    int size, indent, c;
+
+    for ( indent=1,size=0; indent; size++ ) {
+	if ( (c = pull(sc)) == EOF )
+	    return EOF;
+	else if ( (c == '\\') && (peek(sc,1) == out || peek(sc,1) == in) ) {
+	    ++size;
+	    pull(sc);
+	}
+	else if ( c == in )
+	    ++indent;
+	else if ( c == out )
+	    --indent;
+    }
+    return size ? (size-1) : 0;
+}
+
+
+static int
+linkylabel(struct scan *sc, Cstring *res)
+{
+    char *ptr = sc->s + sc->pos;
+    int size;
+
+    if ( (size = parenthetical(sc, '[', ']')) != EOF ) {
+	T(*res) = ptr;
+	S(*res) = size;
+	return 1;
+    }
+    return 0;
+}
+
+
+static int
+linkytitle(struct scan *sc, char quote, Footnote *ref)
+{
+    int whence = sc->pos;
+    char *title = sc->s + sc->pos;
+    char *e;
+    int c;
+
+    while ( (c = pull(sc)) != EOF ) {
+	e = sc->s + sc->pos;
+	if ( c == quote ) {
+	    if ( (c = eatspace(sc)) == ')' ) {
+		T(ref->title) = 1+title;
+		S(ref->title) = (e-title)-2;
+		return 1;
+	    }
+	}
+    }
+    sc->pos = whence;
+    return 0;
+}
+
+
+static int
+linkysize(struct scan *sc, Footnote *ref)
+{
+    int height=0, width=0;
+    int whence = sc->pos;
+    int c;
+
+    if ( isspace(peek(sc,0)) ) {
+	pull(sc);	/* eat '=' */
+
+	for ( c = pull(sc); isdigit(c); c = pull(sc))
+	    width = (width * 10) + (c - '0');
+
+	if ( c == 'x' ) {
+	    for ( c = pull(sc); isdigit(c); c = pull(sc))
+		height = (height*10) + (c - '0');
+
+	    if ( isspace(c) )
+		c = eatspace(sc);
+
+	    if ( (c == ')') || ((c == '\'' || c == '"') && linkytitle(sc, c, ref)) ) {
+		ref->height = height;
+		ref->width  = width;
+		return 1;
+	    }
+	}
+    }
+    sc->pos = whence;
+    return 0;
+}
+
+
+static int
+linkybroket(struct scan *sc, int image, Footnote *p)
+{
+    int c;
+    int good = 0;
+
+    T(p->link) = sc->s + sc->pos;
+    for ( S(p->link)=0; (c = pull(sc)) != '>'; ++S(p->link) ) {
+	if ( c == EOF )
+	    return 0;
+	else if ( (c == '\\') && ispunct(peek(sc,2)) ) {
+	    ++S(p->link);
+	    pull(sc);
+	}
+    }
+
+    c = eatspace(sc);
+
+    if ( ( c == '\'' || c == '"' ) && linkytitle(sc,c,p) )
+	good=1;
+    else if ( image && (c == '=') && linkysize(sc,p) )
+	good=1;
+    else
+	good=( c == ')' );
+
+    if ( good ) {
+	if ( peek(sc, 1) == ')' )
+	    pull(sc);
+	___mkd_tidy(&p->link);
+    }
+    return good;
+}
+
+
+static int
+linkyurl(struct scan *sc, int image, Footnote *p)
+{
+    int c;
+    int mayneedtotrim=0;
+
+    if ( (c = eatspace(sc)) == EOF )
+	return 0;
+
+    if ( c == '<' ) {
+	pull(sc);
+	if ( !(sc->f->flags & MKD_1_COMPAT) )
+	    return linkybroket(sc,image,p);
+	mayneedtotrim=1;
+    }
+
+    T(p->link) = sc->s + sc->pos;
+    for ( S(p->link)=0; (c = peek(sc,1)) != ')'; ++S(p->link) ) {
+	if ( c == EOF )
+	    return 0;
+	else if ( (c == '"' || c == '\'') && linkytitle(sc, c, p) )
+	    break;
+	else if ( image && (c == '=') && linkysize(sc, p) )
+	    break;
+	else if ( (c == '\\') && ispunct(peek(sc,2)) ) {
+	    ++S(p->link);
+	    pull(sc);
+	}
+	pull(sc);
+    }
+    if ( peek(sc, 1) == ')' )
+	pull(sc);
+
+    ___mkd_tidy(&p->link);
+
+    if ( mayneedtotrim && S(p->link) && (T(p->link)[S(p->link)-1] == '>') )
+	--S(p->link);
+
+    return 1;
+}
+
+
+/* make a link or image node, unless the flags say it can't be one
+ */
+static int
+linkynode(struct scan *sc, Cstring text, int image, Footnote *ref)
+{
+    Node *n;
+
+    if ( sc->f->flags & (image ? MKD_NOIMAGE : MKD_NOLINKS) )
+	return 0;
+    if ( !image && (sc->f->flags & MKD_NO_EXT) && S(ref->link)
+		&& memchr(T(ref->link), ':', S(ref->link))
+		&& !strncasecmp(T(ref->link), "raw:", 4) )
+	return 0;
+
+    n = add(sc, image ? MKD_NODE_IMAGE : MKD_NODE_LINK);
+    url(sc, n, T(ref->link), S(ref->link));
+    n->title = T(ref->title);
+    n->titlesize = S(ref->title);
+    n->height = ref->height;
+    n->width = ref->width;
+
+    /* the alt text of an image isn't marked up */
+    inside(sc, T(text), S(text), 0, image);
+    return 1;
+}
+
+
+/* make a [^reference] to a footnote; it isn't numbered until it's
+ * sent, because the text inside a link is picked apart after the rest
+ * of the block is.
+ */
+static int
+notenode(struct scan *sc, Cstring name, Footnote *ref)
+{
+    Node *n = add(sc, MKD_NODE_NOTEREF);
+
+    n->text = T(name)+1;
+    n->size = S(name)-1;
+    n->title = T(ref->title);
+    n->titlesize = S(ref->title);
+    TOKEN(sc, NTOKENS(sc)-1).note = ref;
+    return 1;
+}
+
+
+static int
+linkylinky(struct scan *sc, int image)
+{
+    int start = sc->pos;
+    Cstring name;
+    Footnote key, *ref;
+    int status = 0;
+    int extra_footnote = 0;
+
+    CREATE(name);
+    memset(&key, 0, sizeof key);
+
+    if ( linkylabel(sc, &name) ) {
+	if ( peek(sc,1) == '(' ) {
+	    pull(sc);
+	    if ( linkyurl(sc, image, &key) )
+		status = linkynode(sc, name, image, &key);
+	}
+	else {
+	    int goodlink, implicit_mark = sc->pos;
+
+	    if ( isspace(peek(sc,1)) )
+		pull(sc);
+
+	    if ( peek(sc,1) == '[' ) {
+		pull(sc);	/* consume leading '[' */
+		goodlink = linkylabel(sc, &key.tag);
+	    }
+	    else {
+		sc->pos = implicit_mark;
+		goodlink = !(sc->f->flags & MKD_1_COMPAT);
+
+		if ( (sc->f->flags & MKD_EXTRA_FOOTNOTE) && !image
+					&& S(name) && (T(name)[0] == '^') )
+		    extra_footnote = 1;
+	    }
+
+	    if ( goodlink ) {
+		if ( !S(key.tag) ) {
+		    T(key.tag) = T(name);
+		    S(key.tag) = S(name);
+		}
+		ref = bsearch(&key, T(*sc->f->footnotes), S(*sc->f->footnotes),
+				    sizeof key, (stfu)__mkd_footsort);
+		if ( ref && extra_footnote )
+		    status = notenode(sc, name, ref);
+		else if ( ref )
+		    status = linkynode(sc, name, image, ref);
+	    }
+	}
+    }
+
+    if ( status == 0 )
+	sc->pos = start;
+    else	/* (it starts at the [, not where it ends) */
+	TOKEN(sc, NTOKENS(sc)-1).at = sc->s + start - (image ? 2 : 1);
+    return status;
+}
+
+
+/*
+ * <tags> and <automatic links>, which follow maybe_tag_or_link() and
+ * friends in generate.c
+ */
+
+static int
+isautoprefix(char *text, int size)
+{
+    static char *protocol[] = { "https:", "http:", "news:", "ftp:" };
+    int i, len;
+
+    for ( i=0; i < sizeof protocol / sizeof protocol[0]; i++ ) {
+	len = strlen(protocol[i]);
+	if ( (size >= len) && strncasecmp(text, protocol[i], len) == 0 )
+	    return 1;
+    }
+    return 0;
+}
+
+
+static int
+maybe_address(char *p, int size)
+{
+    int ok = 0;
+
+    for ( ;size && (isalnum((unsigned char)*p) || strchr("._-+*", *p)); ++p, --size)
+	;
+
+    if ( ! (size && *p == '@') )
+	return 0;
+
+    --size, ++p;
+
+    if ( size && *p == '.' ) return 0;
+
+    for ( ;size && (isalnum((unsigned char)*p) || strchr("._-+", *p)); ++p, --size )
+	if ( *p == '.' && size > 1 ) ok = 1;
+
+    return size ? 0 : ok;
+}
+
+
+static int
+possible_link(struct scan *sc, int size)
+{
+    char *text = sc->s + sc->pos;
+    Node *n;
+    int mailto = 0;
+
+    if ( sc->f->flags & MKD_NOLINKS )
+	return 0;
+
+    if ( (size > 7) && strncasecmp(text, "mailto:", 7) == 0 )
+	mailto = 7;
+    else if ( !maybe_address(text, size) && !isautoprefix(text, size) )
+	return 0;
+
+    n = add(sc, MKD_NODE_LINK);
+    if ( mailto || isautoprefix(text, size) ) {
+	n->text = text;
+	n->size = size;
+    }
+    else {
+	char *p = alloc(sc->w->arena, size + 7);
+
+	memcpy(p, "mailto:", 7);
+	memcpy(p+7, text, size);
+	n->text = p;
+	n->size = size + 7;
+    }
+    inside(sc, text + mailto, size - mailto, 0, 1);
+    return 1;
+}
+
+
+static int
+forbidden_tag(struct scan *sc)
+{
+    int c = toupper(peek(sc, 1));
+
+    if ( sc->f->flags & MKD_NOHTML )
+	return 1;
+
+    if ( c == 'A' && (sc->f->flags & MKD_NOLINKS) && !isthisalnum(sc,2) )
+	return 1;
+    if ( c == 'I' && (sc->f->flags & MKD_NOIMAGE)
+		  && strncasecmp(sc->s + sc->pos + 1, "MG", 2) == 0
+		  && !isthisalnum(sc,4) )
+	return 1;
+    return 0;
+}
+
+
+static int
+maybe_tag_or_link(struct scan *sc)
+{
+    int c, size;
+    int maybetag = 1;
+    Node *n;
+
+    for ( size=0; (c = peek(sc, size+1)) != '>'; size++) {
+	if ( c == EOF )
+	    return 0;
+	else if ( c == '\\' ) {
+	    maybetag=0;
+	    if ( peek(sc, size+2) != EOF )
+		size++;
+	}
+	else if ( isspace(c) )
+	    break;
+#if WITH_GITHUB_TAGS
+	else if ( ! (c == '/' || c == '-' || c == '_' || isalnum(c) ) )
+#else
+	else if ( ! (c == '/' || isalnum(c) ) )
+#endif
+	    maybetag=0;
+    }
+
+    if ( size ) {
+	if ( maybetag || (size >= 3 && strncmp(sc->s + sc->pos, "!--", 3) == 0) ) {
+	    while ( (c = peek(sc, size+1)) != '>' )
+		if ( c == EOF )
+		    return 0;
+		else
+		    size++;
+
+	    if ( forbidden_tag(sc) )
+		return 0;
+
+	    n = add(sc, MKD_NODE_TAG);
+	    n->text = sc->s + sc->pos - 1;
+	    n->size = size + 2;
+	    shift(sc, size+1);
+	    return 1;
+	}
+	else if ( !isspace(c) && possible_link(sc, size) ) {
+	    shift(sc, size+1);
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+
+static int
+maybe_autolink(struct scan *sc)
+{
+    int c;
+    int size;
+
+    for ( size=0; (c=peek(sc, size+1)) != EOF; size++ )
+	if ( c == '\\' ) {
+	     if ( peek(sc, size+2) != EOF )
+		++size;
+	}
+	else if ( isspace(c) || strchr("'\"()[]{}<>`", c) )
+	    break;
+
+    if ( (size > 1) && possible_link(sc, size) ) {
+	shift(sc, size);
+	return 1;
+    }
+    return 0;
+}
+
+
+/*
+ * `code` and ~~deleted~~ spans
+ */
+
+static int
+nrticks(struct scan *sc, int offset, int tickchar)
+{
+    int tick = 0;
+
+    while ( peek(sc, offset+tick) == tickchar ) tick++;
+    return tick;
+}
+
+
+static int
+matchticks(struct scan *sc, int tickchar, int ticks, int *endticks)
+{
+    int size, count, c;
+    int subsize=0, subtick=0;
+
+    *endticks = ticks;
+    for (size = 0; (c=peek(sc,size+ticks)) != EOF; size ++) {
+	if ( (c == tickchar) && ( count = nrticks(sc,size+ticks,tickchar)) ) {
+	    if ( count == ticks )
+		return size;
+	    else if ( count ) {
+		if ( (count > subtick) && (count < ticks) ) {
+		    subsize = size;
+		    subtick = count;
+		}
+		size += count;
+	    }
+	}
+    }
+    if ( subsize ) {
+	*endticks = subtick;
+	return subsize;
+    }
+    return 0;
+}
+
+
+static void
+span(struct scan *sc, int size, int type)
+{
+    char *at = sc->s + sc->pos - 1;
+    Node *n = add(sc, type);
+    int i = 0;
+
+    if ( type == MKD_NODE_DEL )
+	inside(sc, at, size, 0, 0);
+    else {
+	if ( size > 1 && peek(sc, size-1) == ' ' ) --size;
+	if ( peek(sc,i) == ' ' ) ++i, --size;
+	n->text = at + i;
+	n->size = size;
+    }
+}
+
+
+static int
+tickhandler(struct scan *sc, int tickchar, int minticks, int allow_space, int type)
+{
+    int endticks, size;
+    int tick = nrticks(sc, 0, tickchar);
+
+    if ( !allow_space && isspace(peek(sc,tick)) )
+	return 0;
+
+    if ( (tick >= minticks) && (size = matchticks(sc,tickchar,tick,&endticks)) ) {
+	if ( endticks < tick ) {
+	    size += (tick - endticks);
+	    tick = endticks;
+	}
+	shift(sc, tick);
+	span(sc, size, type);
+	shift(sc, size+tick-1);
+	return 1;
+    }
+    return 0;
+}
+
+
+/*
+ * emphasis, which is matched up the way emmatch.c does it
+ */
+
+static int
+empair(struct scan *sc, int first, int last, int match)
+{
+    Token *begin = &TOKEN(sc, first), *p;
+    int i;
+
+    for (i=first+1; i <= last; i++) {
+	p = &TOKEN(sc, i);
+
+	if ( p->run && (p->count <= 0) )
+	    continue;
+	if ( p->run && (*p->run == *begin->run) ) {
+	    if ( p->count == match )
+		return i;
+	    if ( p->count > 2 )
+		return i;
+	}
+    }
+    return 0;
+}
+
+
+static void
+emfill(Token *p)
+{
+    if ( p->run ) {
+	p->fill += p->count;
+	p->count = 0;
+    }
+}
+
+
+static void emblock(struct scan *, int, int);
+
+static void
+emmatch(struct scan *sc, int first, int last)
+{
+    Token *start = &TOKEN(sc, first), *end;
+    int e, e2, match;
+    char tag;
+
+    switch (start->count) {
+    case 2: if ( (e = empair(sc,first,last,match=2)) )
+		break;
+    case 1: e = empair(sc,first,last,match=1);
+	    break;
+    case 0: return;
+    default:
+	    e = empair(sc,first,last,1);
+	    e2= empair(sc,first,last,2);
+
+	    if ( e2 >= e ) {
+		e = e2;
+		match = 2;
+	    }
+	    else
+		match = 1;
+	    break;
+    }
+
+    if ( e ) {
+	end = &TOKEN(sc, e);
+	end->count -= match;
+	start->count -= match;
+
+	emblock(sc, first, e);
+
+	tag = match;
+	PREFIX(start->open, &tag, 1);
+	SUFFIX(end->close, &tag, 1);
+
+	emmatch(sc, first, last);
+    }
+}
+
+
+static void
+emblock(struct scan *sc, int first, int last)
+{
+    int i;
+
+    for ( i = first; i <= last; i++ )
+	if ( TOKEN(sc, i).run )
+	    emmatch(sc, i, last);
+    for ( i = first+1; i < last-1; i++ )
+	emfill(&TOKEN(sc, i));
+}
+
+
+/* match up the emphasis, then send the tokens with the emphasis around
+ * them
+ */
+static void
+emit(struct scan *sc)
+{
+    struct walk *w = sc->w;
+    int outside = S(w->emphasis);
+    Node n;
+    Token *p;
+    int i, j;
+
+    emblock(sc, 0, NTOKENS(sc)-1);
+
+    for ( i=0; i < NTOKENS(sc); i++ ) {
+	p = &TOKEN(sc, i);
+
+	if ( p->run ) {
+	    emfill(p);
+	    memset(&n, 0, sizeof n);
+	    n.line = lineof(w, p->run);
+	    for ( j=0; (j < S(p->close)) && (S(w->emphasis) > outside); j++ ) {
+		n.type = T(w->emphasis)[--S(w->emphasis)];
+		send(w, &n, 1);
+	    }
+	    for ( j=0; j < S(p->open); j++ ) {
+		n.type = (T(p->open)[j] == 2) ? MKD_NODE_STRONG : MKD_NODE_EM;
+		EXPAND(w->emphasis) = n.type;
+		send(w, &n, 0);
+	    }
+	    if ( p->fill ) {
+		n.type = MKD_NODE_TEXT;
+		n.text = p->run;
+		n.size = p->fill;
+		leaf(w, &n);
+	    }
+	    DELETE(p->open);
+	    DELETE(p->close);
+	}
+	else {
+	    p->node.line = lineof(w, p->at);
+	    if ( p->note ) {
+		/* footnotes are numbered in the order they're referenced,
+		 * and only the first reference to one is a reference; the
+		 * rest are left as text, the way extra_linky() does it
+		 */
+		for ( j=0; (j < S(w->notes)) && (T(w->notes)[j] != p->note); j++ )
+		    ;
+		if ( j < S(w->notes) ) {
+		    p->node.type = MKD_NODE_TEXT;
+		    p->node.size = (p->node.text + p->node.size + 1) - p->at;
+		    p->node.text = p->at;
+		    p->node.title = 0;
+		    p->node.titlesize = 0;
+		}
+		else {
+		    EXPAND(w->notes) = p->note;
+		    p->node.number = S(w->notes);
+		}
+	    }
+	    send(w, &p->node, 0);
+	    if ( p->literal ) {
+		if ( p->subsize ) {
+		    memset(&n, 0, sizeof n);
+		    n.line = lineof(w, p->sub);
+		    n.type = MKD_NODE_TEXT;
+		    n.text = p->sub;
+		    n.size = p->subsize;
+		    leaf(w, &n);
+		}
+	    }
+	    else if ( p->sub ) {
+		inlines(w, p->sub, p->subsize, p->subesc);
+		p = &TOKEN(sc, i);	/* (which may have moved) */
+	    }
+	    send(w, &p->node, 1);
+	}
+    }
+    S(w->emphasis) = outside;
+}
+
+
+/* pick apart a piece of text the way text() does
+ */
+static void
+inlines(struct walk *w, char *s, int size, char *esc)
+{
+    struct scan sc;
+    MMIOT *f = w->f;
+    int c, rep;
+
+    if ( w->stop )
+	return;
+
+    memset(&sc, 0, sizeof sc);
+    sc.w = w;
+    sc.f = f;
+    sc.s = s;
+    sc.size = size;
+    sc.esc = esc;
+    sc.base = S(w->tokens);
+
+    while (1) {
+	if ( (f->flags & MKD_AUTOLINK) && isalpha(peek(&sc,1)) )
+	    maybe_autolink(&sc);
+
+	if ( (c = pull(&sc)) == EOF )
+	    break;
+
+	switch (c) {
+	case 3:     add(&sc, MKD_NODE_BREAK);
+		    break;
+
+	case '!':   if ( peek(&sc,1) == '[' ) {
+			pull(&sc);
+			if ( !linkylinky(&sc, 1) ) {
+			    plain(&sc, 2);
+			    plain(&sc, 1);
+			}
+		    }
+		    else
+			plain(&sc, 1);
+		    break;
+
+	case '[':   if ( !linkylinky(&sc, 0) )
+			plain(&sc, 1);
+		    break;
+
+	case '^':   if ( (f->flags & (MKD_NOSUPERSCRIPT|MKD_STRICT))
+				|| (isthisnonword(&sc,-1) && peek(&sc,-1) != ')')
+				|| isthisspace(&sc,1) )
+			plain(&sc, 1);
+		    else {
+			char *sup = s + sc.pos;
+			int here = sc.pos, len = 0;
+
+			if ( peek(&sc,1) == '(' ) {
+			    pull(&sc);
+			    if ( (len = parenthetical(&sc,'(',')')) <= 0 ) {
+				sc.pos = here;
+				plain(&sc, 1);
+				break;
+			    }
+			    sup++;
+			}
+			else {
+			    while ( isthisalnum(&sc,1+len) )
+				++len;
+			    if ( !len ) {
+				plain(&sc, 1);
+				break;
+			    }
+			    shift(&sc,len);
+			}
+			add(&sc, MKD_NODE_SUPERSCRIPT);
+			inside(&sc, sup, len, "()", 0);
+		    }
+		    break;
+
+	case '_':   if ( !(f->flags & (MKD_NORELAXED|MKD_STRICT))
+					&& isthisalnum(&sc,-1)
+					 && isthisalnum(&sc,1) ) {
+			plain(&sc, 1);
+			break;
+		    }
+	case '*':   if ( isthisspace(&sc,-1) && isthisspace(&sc,1) ) {
+			plain(&sc, 1);
+			break;
+		    }
+		    for (rep = 1; peek(&sc,1) == c; pull(&sc) )
+			++rep;
+		    run(&sc, rep);
+		    break;
+
+	case '~':   if ( (f->flags & (MKD_NOSTRIKETHROUGH|MKD_STRICT))
+			    || !tickhandler(&sc,c,2,0,MKD_NODE_DEL) )
+			plain(&sc, 1);
+		    break;
+
+	case '`':   if ( !tickhandler(&sc,c,1,1,MKD_NODE_CODESPAN) )
+			plain(&sc, 1);
+		    break;
+
+	case '\\':  switch ( c = pull(&sc) ) {
+		    case '&':   plain(&sc, 1);
+				break;
+		    case '<':   c = peek(&sc,1);
+				if ( (c == EOF) || isspace(c) )
+				    plain(&sc, 1);
+				else {
+				    plain(&sc, 2);
+				    shift(&sc, -1);
+				}
+				break;
+		    case '^':   if ( f->flags & (MKD_STRICT|MKD_NOSUPERSCRIPT) ) {
+				    plain(&sc, 2);
+				    shift(&sc, -1);
+				    break;
+				}
+				plain(&sc, 1);
+				break;
+		    case ':': case '|':
+				if ( f->flags & MKD_NOTABLES ) {
+				    plain(&sc, 2);
+				    shift(&sc, -1);
+				    break;
+				}
+				plain(&sc, 1);
+				break;
+		    case EOF:	plain(&sc, 1);
+				break;
+		    default:	if ( (esc && strchr(esc, c))
+				     || strchr(">#.-+{}]![*_\\()`", c) )
+				    plain(&sc, 1);
+				else {
+				    plain(&sc, 2);
+				    shift(&sc, -1);
+				}
+				break;
+		    }
+		    break;
+
+	case '<':   if ( !maybe_tag_or_link(&sc) )
+			plain(&sc, 1);
+		    break;
+
+	default:    plain(&sc, 1);
+
+		    /* and so is everything up to the next thing that might
+		     * be markup (unless it might be the start of a link)
+		     */
+		    if ( !(f->flags & MKD_AUTOLINK) ) {
+			for ( rep = sc.pos; (rep < size) && !strchr(MARKUP, s[rep]); rep++ )
+			    ;
+			TOKEN(&sc, NTOKENS(&sc)-1).node.size += rep - sc.pos;
+			sc.pos = rep;
+		    }
+		    break;
+	}
+    }
+
+    emit(&sc);
+    S(w->tokens) = sc.base;
+}
+
+
+/*
+ * blocks
+ */
+
+/* put a paragraph's lines back together the way printblock() does
+ */
+static void
+paragraph(struct walk *w, Paragraph *p)
+{
+    Node n;
+    Line *t;
+    char *text;
+    int size, len = 0;
+
+    for ( t = p->text; t; t = t->next )
+	len += S(t->text) + 2;
+    text = alloc(w->arena, len+1);
+    source(w, text, 0, firstline(p));
+
+    for ( len = 0, t = p->text; t; t = t->next ) {
+	if ( !S(t->text) )
+	    continue;
+	newline(w, len, t->lineno);
+	if ( t->next && S(t->text) > 2
+		     && T(t->text)[S(t->text)-2] == ' '
+		     && T(t->text)[S(t->text)-1] == ' ' ) {
+	    memcpy(text+len, T(t->text), S(t->text)-2);
+	    len += S(t->text)-2;
+	    text[len++] = 3;
+	    text[len++] = '\n';
+	}
+	else {
+	    for ( size = S(t->text); size && isspace((unsigned char)T(t->text)[size-1]); --size )
+		;
+	    memcpy(text+len, T(t->text), size);
+	    len += size;
+	    if ( t->next )
+		text[len++] = '\n';
+	}
+    }
+    w->size = len;
+    memset(&n, 0, sizeof n);
+    n.type = MKD_NODE_PARAGRAPH;
+    n.line = firstline(p);
+    n.align = p->align;
+    send(w, &n, 0);
+    inlines(w, text, len, 0);
+    send(w, &n, 1);
+}
+
+
+/* the text of a code, html, or style block, with the blank lines on
+ * the end taken off (like printcode() and printhtml() do)
+ */
+static void
+verbatim(struct walk *w, Node *n, Line *t, int code)
+{
+    Line *p;
+    char *text;
+    int len = 0, blanks = 0;
+
+    for ( p = t; p; p = p->next )
+	len += S(p->text) + 1;
+    n->text = text = alloc(w->arena, len+1);
+
+    for ( len = 0; t; t = t->next )
+	if ( S(t->text) > (code ? t->dle : 0) ) {
+	    for ( ; blanks; --blanks )
+		text[len++] = '\n';
+	    memcpy(text+len, T(t->text), S(t->text));
+	    len += S(t->text);
+	    text[len++] = '\n';
+	}
+	else
+	    blanks++;
+    n->size = len;
+}
+
+
+/* split the rows of a table into cells the way splat() does
+ */
+static int
+row(struct walk *w, Line *p, int lead, int type, Istring align, int force)
+{
+    Node n, cell;
+    int first,
+	idx = p->dle + lead,
+	size = S(p->text),
+	colno = 0;
+
+    while ( size && isspace((unsigned char)T(p->text)[size-1]) )
+	--size;
+    if ( size && (T(p->text)[size-1] == '|') )
+	--size;
+
+    source(w, T(p->text), S(p->text), p->lineno);
+    memset(&n, 0, sizeof n);
+    n.type = MKD_NODE_ROW;
+    n.line = p->lineno;
+    send(w, &n, 0);
+
+    while ( idx < size || (force && colno < S(align)) ) {
+	memset(&cell, 0, sizeof cell);
+	cell.type = type;
+	cell.line = p->lineno;
+	cell.align = (colno < S(align)) ? T(align)[colno] : 0;
+	send(w, &cell, 0);
+	if ( idx < size ) {
+	    first = idx;
+	    if ( force && (colno >= S(align)-1) )
+		idx = size;
+	    else
+		while ( (idx < size) && (T(p->text)[idx] != '|') ) {
+		    if ( T(p->text)[idx] == '\\' )
+			++idx;
+		    ++idx;
+		}
+	    if ( idx > size )
+		idx = size;
+	    inlines(w, T(p->text)+first, idx-first, "|");
+	    idx++;
+	}
+	send(w, &cell, 1);
+	colno++;
+    }
+    send(w, &n, 1);
+    return colno;
+}
+
+
+static void
+table(struct walk *w, Paragraph *pp)
+{
+    Node n;
+    Line *hdr, *dash, *body;
+    Istring align;
+    int hcols, start, lead, it;
+    char *p;
+
+    hdr = pp->text;
+    dash= hdr->next;
+    body= dash->next;
+
+    lead = (T(hdr->text)[hdr->dle] == '|');
+
+    CREATE(align);
+    for (p=T(dash->text), start=dash->dle+lead; start < S(dash->text); ) {
+	char first, last;
+	int end;
+
+	last=first=0;
+	for (end=start ; (end < S(dash->text)) && p[end] != '|'; ++ end ) {
+	    if ( p[end] == '\\' )
+		++ end;
+	    else if ( !isspace((unsigned char)p[end]) ) {
+		if ( !first) first = p[end];
+		last = p[end];
+	    }
+	}
+	it = ( first == ':' ) ? (( last == ':') ? MKD_ALIGN_CENTER : MKD_ALIGN_LEFT)
+			      : (( last == ':') ? MKD_ALIGN_RIGHT : MKD_ALIGN_NONE );
+
+	EXPAND(align) = it;
+	start = 1+end;
+    }
+
+    memset(&n, 0, sizeof n);
+    n.type = MKD_NODE_TABLE;
+    n.line = hdr->lineno;
+    send(w, &n, 0);
+
+    hcols = row(w, hdr, lead, MKD_NODE_HEADCELL, align, 0);
+
+    if ( hcols < S(align) )
+	S(align) = hcols;
+    else
+	while ( hcols > S(align) )
+	    EXPAND(align) = MKD_ALIGN_NONE;
+
+    for ( ; body && !w->stop; body = body->next )
+	row(w, body, lead, MKD_NODE_CELL, align, 1);
+
+    send(w, &n, 1);
+    DELETE(align);
+}
+
+
+static void blocklist(struct walk *, Paragraph *);
+
+static void
+items(struct walk *w, Paragraph *p, int dl)
+{
+    Node n, term;
+    Line *tag;
+
+    for ( ; p && !w->stop; p = p->next ) {
+	memset(&n, 0, sizeof n);
+	n.type = MKD_NODE_ITEM;
+	n.line = firstline(p);
+	n.ident = p->ident;
+	send(w, &n, 0);
+	if ( dl )
+	    for ( tag = p->text; tag; tag = tag->next ) {
+		memset(&term, 0, sizeof term);
+		term.type = MKD_NODE_TERM;
+		term.line = tag->lineno;
+		send(w, &term, 0);
+		source(w, T(tag->text), S(tag->text), tag->lineno);
+		inlines(w, T(tag->text), S(tag->text), 0);
+		send(w, &term, 1);
+	    }
+	blocklist(w, p->down);
+	send(w, &n, 1);
+    }
+}
+
+
+static void
+blocknode(struct walk *w, Paragraph *p)
+{
+    Node n;
+
+    memset(&n, 0, sizeof n);
+    n.line = firstline(p);
+    switch ( p->typ ) {
+    case WHITESPACE:
+	break;
+
+    case SOURCE:
+	blocklist(w, p->down);
+	break;
+
+    case CODE:
+	n.type = MKD_NODE_CODE;
+	n.lang = p->lang;
+	verbatim(w, &n, p->text, 1);
+	leaf(w, &n);
+	break;
+
+    case HTML:
+    case STYLE:
+	n.type = (p->typ == HTML) ? MKD_NODE_HTML : MKD_NODE_STYLE;
+	verbatim(w, &n, p->text, 0);
+	leaf(w, &n);
+	break;
+
+    case QUOTE:
+	n.type = MKD_NODE_QUOTE;
+	n.ident = p->ident;
+	send(w, &n, 0);
+	blocklist(w, p->down);
+	send(w, &n, 1);
+	break;
+
+    case UL:
+    case OL:
+    case AL:
+    case DL:
+	n.type = (p->typ == UL) ? MKD_NODE_UL :
+		 (p->typ == OL) ? MKD_NODE_OL :
+		 (p->typ == AL) ? MKD_NODE_AL : MKD_NODE_DL;
+	send(w, &n, 0);
+	items(w, p->down, p->typ == DL);
+	send(w, &n, 1);
+	break;
+
+    case HR:
+	n.type = MKD_NODE_HR;
+	leaf(w, &n);
+	break;
+
+    case HDR:
+	n.type = MKD_NODE_HEADER;
+	n.hnumber = p->hnumber;
+	send(w, &n, 0);
+	source(w, T(p->text->text), S(p->text->text), p->text->lineno);
+	inlines(w, T(p->text->text), S(p->text->text), 0);
+	send(w, &n, 1);
+	break;
+
+    case TABLE:
+	table(w, p);
+	break;
+
+    default:
+	paragraph(w, p);
+	break;
+    }
+}
+
+
+static void
+blocklist(struct walk *w, Paragraph *p)
+{
+    for ( ; p && !w->stop; p = p->next ) {
+	blocknode(w, p);
+	if ( !w->keep )
+	    empty(w->arena);
+    }
+}
+
+
+/* the footnotes that were referenced, after the rest of the document,
+ * the way ___mkd_extra_footnotes() writes them out.  Their text is
+ * picked apart without any flags or references, like Csreparse() does.
+ */
+static void
+footnotes(struct walk *w)
+{
+    MMIOT *f = w->f, bare;
+    Footnote *ref;
+    Node n, note;
+    int i;
+
+    if ( w->stop || !S(w->notes) )
+	return;
+
+    ___mkd_initmmiot(&bare, 0);
+    memset(&n, 0, sizeof n);
+    n.type = MKD_NODE_NOTES;
+    n.line = T(w->notes)[0]->lineno;
+    send(w, &n, 0);
+
+    w->f = &bare;
+    for ( i=0; (i < S(w->notes)) && !w->stop; i++ ) {
+	ref = T(w->notes)[i];
+	memset(&note, 0, sizeof note);
+	note.type = MKD_NODE_NOTE;
+	note.line = ref->lineno;
+	note.text = T(ref->tag)+1;
+	note.size = S(ref->tag)-1;
+	note.number = i+1;
+	send(w, &note, 0);
+	source(w, T(ref->title), S(ref->title), ref->lineno);
+	inlines(w, T(ref->title), S(ref->title), 0);
+	send(w, &note, 1);
+	if ( !w->keep )
+	    empty(w->arena);
+    }
+    w->f = f;
+
+    send(w, &n, 1);
+    ___mkd_freemmiot(&bare, 0);
+}
+
+
+/* send every node in a compiled document to a function, which is told
+ * when each one starts (leaving=0) and ends (leaving=1).   Text that
+ * had to be put back together only lasts until the function returns.
+ * Returns EOF if the document isn't compiled, otherwise 0 or whatever
+ * the function returned when it wanted to stop.
+ */
+int
+mkd_walk(Document *doc, mkd_event_t event, void *ctx)
+{
+    struct walk w;
+    struct arena *arena = 0;
+
+    if ( !(doc && doc->compiled && event) )
+	return EOF;
+
+    ___mkd_renumber(doc);
+    memset(&w, 0, sizeof w);
+    w.f = doc->ctx;
+    w.event = event;
+    w.ctx = ctx;
+    w.arena = &arena;
+    blocklist(&w, doc->code);
+    footnotes(&w);
+    freearena(&arena);
+    DELETE(w.tokens);
+    DELETE(w.emphasis);
+    DELETE(w.lines);
+    DELETE(w.notes);
+    return w.stop;
+}
+
+
+/* mkd_ast() makes the tree by hanging each node it's sent off the one
+ * it's inside of
+ */
+struct grow {
+    struct arena **arena;
+    STRING(Node**) tails;	/* where the next node at each level goes */
+} ;
+
+static int
+grow(const Node *n, int leaving, void *ctx)
+{
+    struct grow *g = ctx;
+    Node *copy;
+
+    if ( leaving ) {
+	--S(g->tails);
+	return 0;
+    }
+    copy = alloc(g->arena, sizeof *copy);
+    *copy = *n;
+    copy->next = copy->child = 0;
+
+    *T(g->tails)[S(g->tails)-1] = copy;
+    T(g->tails)[S(g->tails)-1] = &copy->next;
+    EXPAND(g->tails) = &copy->child;
+    return 0;
+}
+
+
+/* the compiled document as a tree, which is made the first time it's
+ * asked for and kept with the document.   Returns 0 (and the first
+ * block in *res,) or EOF if the document isn't compiled.
+ */
+int
+mkd_ast(Document *doc, Node **res)
+{
+    struct ast *a;
+    struct walk w;
+    struct grow g;
+
+    *res = 0;
+    if ( !(doc && doc->compiled) )
+	return EOF;
+
+    if ( !doc->ast ) {
+	if ( !(a = calloc(1, sizeof *a)) )
+	    return EOF;
+
+	___mkd_renumber(doc);
+	g.arena = &a->arena;
+	CREATE(g.tails);
+	EXPAND(g.tails) = &a->root;
+
+	memset(&w, 0, sizeof w);
+	w.f = doc->ctx;
+	w.event = grow;
+	w.ctx = &g;
+	w.arena = &a->arena;
+	w.keep = 1;
+	blocklist(&w, doc->code);
+	footnotes(&w);
+	DELETE(w.tokens);
+	DELETE(w.emphasis);
+	DELETE(w.lines);
+	DELETE(w.notes);
+
+	DELETE(g.tails);
+	doc->ast = a;
+    }
+    *res = doc->ast->root;
+    return 0;
+}
+
+
+void
+___mkd_free_ast(Document *doc)
+{
+    if ( doc->ast ) {
+	freearena(&doc->ast->arena);
+	free(doc->ast);
+	doc->ast = 0;
+    }
+}
@@ -0,0 +1,440 @@
+/* markdown: a C implementation of John Gruber's Markdown markup language.
+ *
+ * Copyright (C) 2007 David L Parsons.
+ * The redistribution terms are provided in the COPYRIGHT file that must
+ * be distributed with this source code.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#if WITH_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#if HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+#endif
+
+#include "cstring.h"
+#include "markdown.h"
+#include "amalloc.h"
+
+/* documents handed to mkd_submit() are converted on a set of worker
+ * threads, and the results are put on a queue for mkd_poll().  A file
+ * descriptor (an eventfd, or a pipe if there's no eventfd) is readable
+ * whenever there's something on that queue, so an event loop can
+ * wait for it along with everything else.
+ */
+struct job {
+    struct job *next;
+    int id;
+    Engine *engine;
+    char *text;
+    int size;
+    DWORD flags;
+    void *cookie;
+    char *html;
+    int htmlsize;
+} ;
+
+struct queue {
+    struct job *head, *tail;
+} ;
+
+static struct queue todo, done;
+static int nextid = 0;
+
+#if WITH_THREADS
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work = PTHREAD_COND_INITIALIZER;
+static pthread_t *workers = 0;
+static int nrworkers = 0;
+static int stopping = 0;
+static int evfd[2] = { -1, -1 };	/* [0] to read, [1] to write */
+#define LOCK()		pthread_mutex_lock(&lock)
+#define UNLOCK()	pthread_mutex_unlock(&lock)
+#else
+#define LOCK()		(void)0
+#define UNLOCK()	(void)0
+#endif
+
+
+static void
+enqueue(struct queue *q, struct job *j)
+{
+    j->next = 0;
+    if ( q->tail )
+	q->tail->next = j;
+    else
+	q->head = j;
+    q->tail = j;
+}
+
+
+static struct job *
+dequeue(struct queue *q)
+{
+    struct job *j;
+
+    if ( (j = q->head) ) {
+	if ( !(q->head = j->next) )
+	    q->tail = 0;
+    }
+    return j;
+}
+
+
+static void
+freejob(struct job *j)
+{
+    if ( j->text ) free(j->text);
+    if ( j->html ) free(j->html);
+    free(j);
+}
+
+
+/* convert a job's text, reusing the worker's Document if it has one
+ */
+static void
+convert(Document **doc, struct job *j)
+{
+    char *html;
+    int size;
+
+    if ( *doc )
+	*doc = mkd_reuse_string(*doc, j->text, j->size, j->flags);
+    else
+	*doc = mkd_string(j->text, j->size, j->flags);
+
+    if ( !*doc )
+	return;
+    (*doc)->engine = j->engine;
+
+    if ( mkd_compile(*doc, j->flags)
+		&& ((size = mkd_document(*doc, &html)) != EOF)
+		&& (j->html = malloc(size+1)) ) {
+	memcpy(j->html, html, size);
+	j->html[size] = 0;
+	j->htmlsize = size;
+    }
+    free(j->text);
+    j->text = 0;
+}
+
+
+#if WITH_THREADS
+/* tell the event loop there's something to pick up (with the lock held)
+ */
+static void
+ring()
+{
+#if HAVE_SYS_EVENTFD_H
+    unsigned long long one = 1;
+
+    write(evfd[1], &one, sizeof one);
+#else
+    write(evfd[1], "", 1);
+#endif
+}
+
+
+/* and clear the signal once the queue is empty (ditto)
+ */
+static void
+unring()
+{
+    char bfr[64];
+
+    while ( read(evfd[0], bfr, sizeof bfr) > 0 )
+	;
+}
+
+
+static void *
+worker(void *unused)
+{
+    Document *doc = 0;
+    struct job *j;
+
+    LOCK();
+    while ( 1 ) {
+	while ( !stopping && !todo.head )
+	    pthread_cond_wait(&work, &lock);
+	if ( stopping )
+	    break;
+	j = dequeue(&todo);
+	UNLOCK();
+
+	convert(&doc, j);
+
+	LOCK();
+	if ( !done.head )
+	    ring();
+	enqueue(&done, j);
+    }
+    UNLOCK();
+
+    if ( doc )
+	mkd_cleanup(doc);
+    return 0;
+}
+#endif
+
+
+#if WITH_THREADS
+/* close the eventfd (or pipe) that mkd_poll() is woken up with
+ */
+static void
+closefds()
+{
+    close(evfd[0]);
+    if ( evfd[1] != evfd[0] )
+	close(evfd[1]);
+    evfd[0] = evfd[1] = -1;
+}
+#endif
+
+
+/* start the worker threads (or as many as there are processors, if
+ * nthreads is 0.)   mkd_submit() does this itself if it has to.
+ * Returns how many there are, or EOF if none of them could be
+ * started.
+ */
+int
+mkd_async_start(int nthreads)
+{
+#if WITH_THREADS
+    int i;
+
+    LOCK();
+    if ( workers ) {
+	UNLOCK();
+	return nrworkers;
+    }
+
+    /* set up the default engine before any threads can race for it
+     */
+    mkd_initialize();
+
+    if ( nthreads <= 0 )
+	nthreads = ___mkd_nthreads();
+
+#if HAVE_SYS_EVENTFD_H
+    if ( (evfd[0] = evfd[1] = eventfd(0, EFD_NONBLOCK)) == -1 ) {
+	UNLOCK();
+	return EOF;
+    }
+#else
+    if ( pipe(evfd) == -1 ) {
+	UNLOCK();
+	return EOF;
+    }
+    fcntl(evfd[0], F_SETFL, fcntl(evfd[0], F_GETFL) | O_NONBLOCK);
+    fcntl(evfd[1], F_SETFL, fcntl(evfd[1], F_GETFL) | O_NONBLOCK);
+#endif
+
+    if ( !(workers = malloc(nthreads * sizeof workers[0])) ) {
+	closefds();
+	UNLOCK();
+	return EOF;
+    }
+    stopping = 0;
+    for ( i=0; i < nthreads; i++ )
+	if ( pthread_create(&workers[nrworkers], 0, worker, 0) == 0 )
+	    nrworkers++;
+
+    if ( nrworkers == 0 ) {
+	/* so the next mkd_async_start() tries again */
+	free(workers);
+	workers = 0;
+	closefds();
+	UNLOCK();
+	return EOF;
+    }
+    UNLOCK();
+    return nrworkers;
+#else
+    mkd_initialize();
+    return 0;
+#endif
+}
+
+
+/* the file descriptor that's readable when mkd_poll() has something
+ * to return, or EOF if documents are converted in mkd_submit()
+ */
+int
+mkd_async_fd()
+{
+#if WITH_THREADS
+    mkd_async_start(0);
+    return evfd[0];
+#else
+    return EOF;
+#endif
+}
+
+
+/* queue a document to be converted, returning an id that can be
+ * passed to mkd_cancel() and that comes back from mkd_poll(), or EOF.
+ * The text is copied, so it doesn't need to stay around.
+ */
+int
+mkd_submit(Engine *e, const char *text, int size, DWORD flags, void *cookie)
+{
+    struct job *j;
+    int id;
+
+    if ( !e )
+	e = &___mkd_default_engine;
+    else if ( e->magic != VALID_ENGINE )
+	return EOF;
+
+    if ( !text || (size < 0) )
+	return EOF;
+
+#if WITH_THREADS
+    if ( mkd_async_start(0) <= 0 )
+	return EOF;
+#endif
+
+    if ( !(j = calloc(sizeof *j, 1)) )
+	return EOF;
+    if ( !(j->text = malloc(size ? size : 1)) ) {
+	free(j);
+	return EOF;
+    }
+    memcpy(j->text, text, size);
+    j->size = size;
+    mkd_engine_freeze(e);
+    j->engine = e;
+    j->flags = flags | e->flags;
+    j->cookie = cookie;
+    j->htmlsize = EOF;
+
+    LOCK();
+    if ( ++nextid <= 0 )
+	nextid = 1;
+    id = j->id = nextid;
+#if WITH_THREADS
+    enqueue(&todo, j);
+    pthread_cond_signal(&work);
+    UNLOCK();
+#else
+    {   Document *doc = 0;
+
+	convert(&doc, j);
+	if ( doc )
+	    mkd_cleanup(doc);
+	enqueue(&done, j);
+    }
+#endif
+    return id;
+}
+
+
+/* take a document off the queue before it's been converted.   Returns
+ * 0 if it was cancelled, EOF if it's already been started (or there's
+ * no such document.)
+ */
+int
+mkd_cancel(int id)
+{
+    struct job *j, *prev = 0;
+
+    LOCK();
+    for ( j = todo.head; j; prev = j, j = j->next )
+	if ( j->id == id ) {
+	    if ( prev )
+		prev->next = j->next;
+	    else
+		todo.head = j->next;
+	    if ( todo.tail == j )
+		todo.tail = prev;
+	    break;
+	}
+    UNLOCK();
+
+    if ( j ) {
+	freejob(j);
+	return 0;
+    }
+    return EOF;
+}
+
+
+/* pick up to count finished documents, returning how many were found.
+ * The html in each result is malloc()ed and freed by mkd_free_result().
+ */
+int
+mkd_poll(Result *res, int count)
+{
+    struct job *j;
+    int i;
+
+    if ( !res )
+	return EOF;
+
+    LOCK();
+    for ( i=0; (i < count) && (j = dequeue(&done)); i++ ) {
+	res[i].id = j->id;
+	res[i].cookie = j->cookie;
+	res[i].html = j->html;
+	res[i].htmlsize = j->htmlsize;
+	j->html = 0;
+	freejob(j);
+    }
+#if WITH_THREADS
+    if ( !done.head )
+	unring();
+#endif
+    UNLOCK();
+    return i;
+}
+
+
+void
+mkd_free_result(Result *res)
+{
+    if ( res && res->html ) {
+	free(res->html);
+	res->html = 0;
+    }
+}
+
+
+/* stop the worker threads and throw away anything that's still queued
+ */
+void
+mkd_async_shutdown()
+{
+    struct job *j;
+#if WITH_THREADS
+    int i;
+
+    LOCK();
+    if ( workers ) {
+	stopping = 1;
+	pthread_cond_broadcast(&work);
+	UNLOCK();
+	for ( i=0; i < nrworkers; i++ )
+	    pthread_join(workers[i], 0);
+	LOCK();
+	free(workers);
+	workers = 0;
+	nrworkers = 0;
+	closefds();
+    }
+#else
+    LOCK();
+#endif
+    while ( (j = dequeue(&todo)) )
+	freejob(j);
+    while ( (j = dequeue(&done)) )
+	freejob(j);
+    UNLOCK();
+}
@@ -0,0 +1,177 @@
+/* markdown: a C implementation of John Gruber's Markdown markup language.
+ *
+ * Copyright (C) 2007 David L Parsons.
+ * The redistribution terms are provided in the COPYRIGHT file that must
+ * be distributed with this source code.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#if WITH_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "cstring.h"
+#include "markdown.h"
+#include "amalloc.h"
+
+/* a batch of documents being rendered.   Workers take the next
+ * document off the list as soon as they've finished the last one,
+ * so a few big documents don't leave the other threads idle.
+ */
+struct batch {
+    Batch *items;
+    int count;
+    int next;			/* the next document nobody's taken */
+    DWORD flags;
+#if WITH_THREADS
+    pthread_mutex_t lock;
+#endif
+} ;
+
+
+/* take the next document to render
+ */
+static int
+claim(struct batch *b)
+{
+    int i;
+
+#if WITH_THREADS
+    pthread_mutex_lock(&b->lock);
+#endif
+    i = b->next;
+    if ( i < b->count )
+	b->next++;
+#if WITH_THREADS
+    pthread_mutex_unlock(&b->lock);
+#endif
+    return i;
+}
+
+
+/* render one document, reusing the worker's Document (and its buffers)
+ * if it has one, and leaving a copy of the html in the batch.
+ */
+static void
+render(Document **doc, Batch *p, DWORD flags)
+{
+    char *html;
+    int size;
+
+    p->html = 0;
+    p->htmlsize = EOF;
+
+    if ( *doc )
+	*doc = mkd_reuse_string(*doc, p->text, p->size, flags);
+    else
+	*doc = mkd_string(p->text, p->size, flags);
+
+    if ( !(*doc && mkd_compile(*doc, flags)) )
+	return;
+    if ( (size = mkd_document(*doc, &html)) == EOF )
+	return;
+
+    if ( (p->html = malloc(size+1)) ) {
+	memcpy(p->html, html, size);
+	p->html[size] = 0;
+	p->htmlsize = size;
+    }
+}
+
+
+static void *
+worker(void *arg)
+{
+    struct batch *b = arg;
+    Document *doc = 0;
+    int i;
+
+    while ( (i = claim(b)) < b->count )
+	render(&doc, &b->items[i], b->flags);
+
+    if ( doc )
+	mkd_cleanup(doc);
+    return 0;
+}
+
+
+/* render a batch of documents on nthreads threads (or as many threads
+ * as there are processors, if nthreads is 0.)   The html for each
+ * document is left in malloc()ed memory in that document's Batch.
+ */
+int
+mkd_render_batch(Batch *items, int count, DWORD flags, int nthreads)
+{
+    struct batch b;
+    int i, ok;
+#if WITH_THREADS
+    pthread_t *tid;
+    int started;
+#endif
+
+    if ( !items || (count < 0) )
+	return EOF;
+
+    b.items = items;
+    b.count = count;
+    b.next = 0;
+    b.flags = flags;
+
+    /* set up the default engine before any threads can race for it
+     */
+    mkd_initialize();
+
+#if WITH_THREADS
+    if ( nthreads <= 0 )
+	nthreads = ___mkd_nthreads();
+    if ( nthreads > count )
+	nthreads = count;
+
+    pthread_mutex_init(&b.lock, 0);
+    started = 0;
+    if ( (nthreads > 1) && (tid = malloc((nthreads-1) * sizeof tid[0])) ) {
+	while ( started < nthreads-1 ) {
+	    if ( pthread_create(&tid[started], 0, worker, &b) != 0 )
+		break;
+	    started++;
+	}
+	/* the calling thread works too */
+	worker(&b);
+	for ( i=0; i < started; i++ )
+	    pthread_join(tid[i], 0);
+	free(tid);
+    }
+    else
+	worker(&b);
+    pthread_mutex_destroy(&b.lock);
+#else
+    worker(&b);
+#endif
+
+    for ( ok=i=0; i < count; i++ )
+	if ( items[i].htmlsize != EOF )
+	    ok++;
+    return ok;
+}
+
+
+/* free the html left behind by mkd_render_batch()
+ */
+void
+mkd_free_batch(Batch *items, int count)
+{
+    int i;
+
+    if ( items )
+	for ( i=0; i < count; i++ ) {
+	    if ( items[i].html )
+		free(items[i].html);
+	    items[i].html = 0;
+	    items[i].htmlsize = EOF;
+	}
+}
@@ -0,0 +1,400 @@
+/* markdown: a C implementation of John Gruber's Markdown markup language.
+ *
+ * Copyright (C) 2007 David L Parsons.
+ * The redistribution terms are provided in the COPYRIGHT file that must
+ * be distributed with this source code.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#if WITH_THREADS
+#include <pthread.h>
+#endif
+
+#include "cstring.h"
+#include "markdown.h"
+#include "amalloc.h"
+
+/* a cache of rendered top-level blocks, shared by all the documents
+ * made with an engine, so boilerplate that turns up in document after
+ * document is only rendered once.   A block is found by its source
+ * (and the flags it was rendered with,) and is only used if the
+ * references it looked up are the same in the document that wants it.
+ */
+typedef struct cached {
+    unsigned long hash;
+    Cstring key;		/* the block's source and flags */
+    Cstring refs;		/* the references it used, and what they were */
+    Cstring html;
+    struct cached *newer, *older;
+    struct cached *chain;	/* the next one in the same bucket */
+} Cached;
+
+struct cache {
+    size_t max;			/* how big it can get */
+    size_t size;
+    Cached **bucket;
+    int nbuckets;
+    int count;
+    Cached *newest, *oldest;
+#if WITH_THREADS
+    pthread_mutex_t lock;
+#endif
+} ;
+
+#define NBUCKETS	256
+
+typedef int (*stfu)(const void*,const void*);
+int __mkd_footsort(Footnote *, Footnote *);
+
+
+static void
+lock(struct cache *c)
+{
+#if WITH_THREADS
+    pthread_mutex_lock(&c->lock);
+#endif
+}
+
+
+static void
+unlock(struct cache *c)
+{
+#if WITH_THREADS
+    pthread_mutex_unlock(&c->lock);
+#endif
+}
+
+
+/* the key and the references are only compared with other keys and
+ * references in the same program, so they're written out in binary.
+ */
+static void
+sigint(Cstring *key, long n)
+{
+    SUFFIX(*key, (char*)&n, sizeof n);
+}
+
+
+/* write out a string so it can't run into whatever comes after it
+ */
+static void
+sigstring(Cstring *key, char *s, ptrdiff_t size)
+{
+    sigint(key, (long)size);
+    if ( size > 0 )
+	SUFFIX(*key, s, size);
+}
+
+
+/* write out everything display() looks at in a block
+ */
+static void
+signature(Cstring *key, Paragraph *p, int top)
+{
+    Line *t;
+
+    for ( ; p; p = top ? 0 : p->next ) {
+	sigint(key, (p->typ << 16) | (p->align << 8) | p->hnumber);
+	sigstring(key, p->ident, p->ident ? strlen(p->ident) : -1);
+	sigstring(key, p->lang, p->lang ? strlen(p->lang) : -1);
+	sigstring(key, p->anchor, p->anchor ? strlen(p->anchor) : -1);
+	for ( t = p->text; t; t = t->next ) {
+	    sigint(key, t->dle);
+	    sigstring(key, T(t->text), S(t->text));
+	}
+	signature(key, p->down, 0);
+	sigint(key, -2);		/* end of the block */
+    }
+}
+
+
+/* write out a reference that was looked up, and what was found
+ */
+static void
+sigref(Cstring *refs, char *tag, ptrdiff_t size, Footnote *ref)
+{
+    sigstring(refs, tag, size);
+    if ( ref ) {
+	sigint(refs, ref->height);
+	sigint(refs, ref->width);
+	sigint(refs, ref->flags & EXTRA_BOOKMARK);
+	sigstring(refs, T(ref->link), S(ref->link));
+	sigstring(refs, T(ref->title), S(ref->title));
+    }
+    else
+	sigint(refs, -1);
+}
+
+
+static Footnote *
+lookup(MMIOT *f, char *tag, ptrdiff_t size)
+{
+    Footnote key;
+
+    memset(&key, 0, sizeof key);
+    T(key.tag) = tag;
+    S(key.tag) = size;
+    return bsearch(&key, T(*f->footnotes), S(*f->footnotes),
+		   sizeof key, (stfu)__mkd_footsort);
+}
+
+
+/* remember a reference that a block looked up
+ */
+void
+___mkd_cache_looked(Reflog *log, Footnote *key, Footnote *ref)
+{
+    sigref(&log->refs, T(key->tag), S(key->tag), ref);
+}
+
+
+/* would the references this block used come out the same in this
+ * document?
+ */
+static int
+samerefs(Cached *p, MMIOT *f)
+{
+    Cstring now;
+    char *pos = T(p->refs), *end = T(p->refs) + S(p->refs), *tag;
+    long size;
+    int same = 1;
+
+    CREATE(now);
+    while ( same && (pos < end) ) {
+	memcpy(&size, pos, sizeof size);
+	tag = pos + sizeof size;
+	S(now) = 0;
+	sigref(&now, tag, size, lookup(f, tag, size));
+	same = (S(now) <= end-pos) && (memcmp(T(now), pos, S(now)) == 0);
+	pos += S(now);
+    }
+    DELETE(now);
+    return same;
+}
+
+
+/* unhook a block from the lru list
+ */
+static void
+unlink_lru(struct cache *c, Cached *p)
+{
+    if ( p->newer ) p->newer->older = p->older;
+    else c->newest = p->older;
+    if ( p->older ) p->older->newer = p->newer;
+    else c->oldest = p->newer;
+    p->newer = p->older = 0;
+}
+
+
+static void
+push_lru(struct cache *c, Cached *p)
+{
+    p->older = c->newest;
+    p->newer = 0;
+    if ( c->newest ) c->newest->newer = p;
+    else c->oldest = p;
+    c->newest = p;
+}
+
+
+static size_t
+sizeof_cached(Cached *p)
+{
+    return sizeof *p + S(p->key) + S(p->refs) + S(p->html);
+}
+
+
+static void
+freecached(Cached *p)
+{
+    DELETE(p->key);
+    DELETE(p->refs);
+    DELETE(p->html);
+    free(p);
+}
+
+
+/* throw out the block that hasn't been used for the longest time
+ */
+static void
+evict(struct cache *c)
+{
+    Cached *p = c->oldest, **q;
+
+    for ( q = &c->bucket[p->hash % c->nbuckets]; *q != p; q = &(*q)->chain )
+	;
+    *q = p->chain;
+    unlink_lru(c, p);
+    c->size -= sizeof_cached(p);
+    c->count--;
+    freecached(p);
+}
+
+
+/* double the number of buckets once they start getting crowded
+ */
+static void
+rehash(struct cache *c)
+{
+    Cached **new, *p, *next;
+    int i, n = c->nbuckets * 2;
+
+    if ( !(new = calloc(n, sizeof new[0])) )
+	return;
+    for ( i=0; i < c->nbuckets; i++ )
+	for ( p = c->bucket[i]; p; p = next ) {
+	    next = p->chain;
+	    p->chain = new[p->hash % n];
+	    new[p->hash % n] = p;
+	}
+    free(c->bucket);
+    c->bucket = new;
+    c->nbuckets = n;
+}
+
+
+static Cached *
+find(struct cache *c, unsigned long h, Cstring *key, MMIOT *f, Cstring *refs)
+{
+    Cached *p;
+
+    for ( p = c->bucket[h % c->nbuckets]; p; p = p->chain )
+	if ( (p->hash == h) && (S(p->key) == S(*key))
+			    && (memcmp(T(p->key), T(*key), S(*key)) == 0) ) {
+	    if ( refs ) {
+		if ( (S(p->refs) == S(*refs))
+			&& (memcmp(T(p->refs), T(*refs), S(*refs)) == 0) )
+		    return p;
+	    }
+	    else if ( samerefs(p, f) )
+		return p;
+	}
+    return 0;
+}
+
+
+/* look for a block in the cache, and if it's there write its html
+ * out.   Returns 1 if it was found; otherwise `key` is set up for
+ * ___mkd_cache_store().   Returns EOF if the block can't be cached at
+ * all (because callbacks might change what it looks like.)
+ */
+int
+___mkd_cache_fetch(MMIOT *f, Paragraph *p, Cstring *key)
+{
+    struct cache *c = f->engine->cache;
+    Cached *hit;
+
+    if ( f->cb && (f->cb->e_url || f->cb->e_flags || f->cb->e_data) )
+	return EOF;
+
+    CREATE(*key);
+    sigint(key, (long)f->flags);
+    sigstring(key, f->ref_prefix, f->ref_prefix ? strlen(f->ref_prefix) : -1);
+    signature(key, p, 1);
+
+    lock(c);
+    if ( (hit = find(c, ___mkd_hash(FNV_BASIS, T(*key), S(*key)), key, f, 0)) ) {
+	SUFFIX(f->out, T(hit->html), S(hit->html));
+	unlink_lru(c, hit);
+	push_lru(c, hit);
+    }
+    unlock(c);
+
+    if ( hit ) {
+	DELETE(*key);
+	return 1;
+    }
+    return 0;
+}
+
+
+/* put a block that was just rendered (starting at `start` in the
+ * output) into the cache, unless it did something that depends on
+ * where it is in the document.
+ */
+void
+___mkd_cache_store(MMIOT *f, Cstring *key, Reflog *log, ptrdiff_t start)
+{
+    struct cache *c = f->engine->cache;
+    Cached *p;
+    unsigned long h;
+
+    if ( log->uncacheable || !(p = calloc(1, sizeof *p)) ) {
+	DELETE(*key);
+	DELETE(log->refs);
+	return;
+    }
+
+    p->hash = h = ___mkd_hash(FNV_BASIS, T(*key), S(*key));
+    p->key = *key;
+    p->refs = log->refs;
+    CREATE(p->html);
+    SUFFIX(p->html, T(f->out) + start, S(f->out) - start);
+
+    lock(c);
+    if ( (sizeof_cached(p) > c->max) || find(c, h, key, f, &p->refs) ) {
+	unlock(c);
+	freecached(p);
+	return;
+    }
+    p->chain = c->bucket[h % c->nbuckets];
+    c->bucket[h % c->nbuckets] = p;
+    push_lru(c, p);
+    c->size += sizeof_cached(p);
+    c->count++;
+
+    while ( c->size > c->max )
+	evict(c);
+    if ( c->count > 2 * c->nbuckets )
+	rehash(c);
+    unlock(c);
+}
+
+
+/* give an engine a cache of rendered blocks that can grow to `size`
+ * bytes.
+ */
+int
+mkd_engine_cache(Engine *e, size_t size)
+{
+    struct cache *c;
+
+    if ( !(e && (e->magic == VALID_ENGINE)) || e->frozen || e->cache )
+	return -1;
+
+    if ( !(c = calloc(1, sizeof *c)) )
+	return -1;
+    if ( !(c->bucket = calloc(NBUCKETS, sizeof c->bucket[0])) ) {
+	free(c);
+	return -1;
+    }
+    c->nbuckets = NBUCKETS;
+    c->max = size;
+#if WITH_THREADS
+    pthread_mutex_init(&c->lock, 0);
+#endif
+    e->cache = c;
+    return 0;
+}
+
+
+void
+___mkd_free_cache(Engine *e)
+{
+    struct cache *c = e->cache;
+
+    if ( c ) {
+	while ( c->oldest )
+	    evict(c);
+	free(c->bucket);
+#if WITH_THREADS
+	pthread_mutex_destroy(&c->lock);
+#endif
+	free(c);
+	e->cache = 0;
+    }
+}
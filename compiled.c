@@ -0,0 +1,506 @@
+/* markdown: a C implementation of John Gruber's Markdown markup language.
+ *
+ * Copyright (C) 2007 David L Parsons.
+ * The redistribution terms are provided in the COPYRIGHT file that must
+ * be distributed with this source code.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "cstring.h"
+#include "markdown.h"
+#include "amalloc.h"
+
+/* a compiled document, written out so it can be loaded again (by
+ * another process, or after the next deploy) without being parsed.
+ * It's all DWORDs, in the byte order of the machine that wrote it:
+ *
+ *	the header
+ *	the paragraphs, in the order they're walked (PARA_SIZE each)
+ *	the lines (LINE_SIZE each)
+ *	the footnotes, already sorted (FOOT_SIZE each)
+ *	the strings, each one followed by a null
+ *
+ * Everything points at everything else by index, so the whole thing
+ * can be mmap()ed and used where it is; the text of the lines and the
+ * footnotes isn't copied out of it.   The loader checks that all the
+ * indexes are in bounds, but it can't check everything the compiler
+ * would have made sure of, so there's a checksum to catch files that
+ * have been damaged.
+ */
+#define COMPILED_MAGIC		0x4d4b4443	/* "MKDC" */
+#define COMPILED_VERSION	3
+#define BYTE_ORDER_MARK		0x01020304
+#define NIL			0xffffffff
+
+enum { h_MAGIC, h_VERSION, h_ORDER, h_CHECKSUM, h_FLAGS,
+       h_NPARAS, h_NLINES, h_NFOOT, h_STRSIZE,
+       h_TITLE, h_AUTHOR, h_DATE, HDR_SIZE };
+
+enum { p_NEXT, p_DOWN, p_TEXT, p_IDENT, p_LANG,
+       p_TYP, p_ALIGN, p_HNUMBER, p_ANCHOR, PARA_SIZE };
+
+enum { l_NEXT, l_TEXT, l_SIZE, l_DLE, l_FLAGS, l_KIND, l_COUNT, l_LINENO,
+       LINE_SIZE };
+
+enum { f_TAG, f_TAGSIZE, f_LINK, f_LINKSIZE, f_TITLE, f_TITLESIZE,
+       f_HEIGHT, f_WIDTH, f_FLAGS, f_LINENO, FOOT_SIZE };
+
+typedef STRING(DWORD) Words;
+
+struct saver {
+    Words paras, lines, foot;
+    Cstring strings;
+    int toobig;			/* more than a DWORD can point at */
+} ;
+
+
+/* add `size` DWORDs to the end of a table, and return the first of
+ * them (which is only good until the table grows again.)
+ */
+static DWORD *
+record(Words *w, int size)
+{
+    int i;
+
+    for ( i=0; i < size; i++ )
+	EXPAND(*w) = NIL;
+    return T(*w) + S(*w) - size;
+}
+
+
+static DWORD
+putstring(struct saver *s, char *text, ptrdiff_t size)
+{
+    DWORD off = S(s->strings);
+
+    if ( size + S(s->strings) >= NIL ) {
+	s->toobig = 1;
+	return NIL;
+    }
+    if ( size > 0 )
+	SUFFIX(s->strings, text, size);
+    EXPAND(s->strings) = 0;
+    return off;
+}
+
+
+/* write out a paragraph's lines, or (if `chain` isn't set) just one
+ * line of the header, which is still linked to the rest of the input
+ */
+static DWORD
+putlines(struct saver *s, Line *t, int chain)
+{
+    DWORD first = t ? S(s->lines) / LINE_SIZE : NIL;
+    DWORD text, *w;
+
+    for ( ; t; t = chain ? t->next : 0 ) {
+	text = putstring(s, T(t->text), S(t->text));
+	w = record(&s->lines, LINE_SIZE);
+	w[l_NEXT] = (chain && t->next) ? S(s->lines) / LINE_SIZE : NIL;
+	w[l_TEXT] = text;
+	w[l_SIZE] = S(t->text);
+	w[l_DLE] = t->dle;
+	w[l_FLAGS] = t->flags;
+	w[l_KIND] = t->kind;
+	w[l_COUNT] = t->count;
+	w[l_LINENO] = t->lineno;
+    }
+    return first;
+}
+
+
+static void
+putparas(struct saver *s, Paragraph *p)
+{
+    DWORD me, text, ident, lang, anchor, *w;
+
+    for ( ; p; p = p->next ) {
+	text = putlines(s, p->text, 1);
+	ident = p->ident ? putstring(s, p->ident, strlen(p->ident)) : NIL;
+	lang = p->lang ? putstring(s, p->lang, strlen(p->lang)) : NIL;
+	anchor = p->anchor ? putstring(s, p->anchor, strlen(p->anchor)) : NIL;
+
+	me = S(s->paras) / PARA_SIZE;
+	w = record(&s->paras, PARA_SIZE);
+	w[p_TEXT] = text;
+	w[p_IDENT] = ident;
+	w[p_LANG] = lang;
+	w[p_TYP] = p->typ;
+	w[p_ALIGN] = p->align;
+	w[p_HNUMBER] = p->hnumber;
+	w[p_ANCHOR] = anchor;
+
+	if ( p->down ) {
+	    T(s->paras)[me*PARA_SIZE + p_DOWN] = me+1;
+	    putparas(s, p->down);
+	}
+	if ( p->next )
+	    T(s->paras)[me*PARA_SIZE + p_NEXT] = S(s->paras) / PARA_SIZE;
+    }
+}
+
+
+static void
+putfootnotes(struct saver *s, MMIOT *f)
+{
+    Footnote *t;
+    DWORD tag, link, title, *w;
+    int i;
+
+    for ( i=0; i < S(*f->footnotes); i++ ) {
+	t = &T(*f->footnotes)[i];
+	tag = putstring(s, T(t->tag), S(t->tag));
+	link = putstring(s, T(t->link), S(t->link));
+	title = putstring(s, T(t->title), S(t->title));
+
+	w = record(&s->foot, FOOT_SIZE);
+	w[f_TAG] = tag;
+	w[f_TAGSIZE] = S(t->tag);
+	w[f_LINK] = link;
+	w[f_LINKSIZE] = S(t->link);
+	w[f_TITLE] = title;
+	w[f_TITLESIZE] = S(t->title);
+	w[f_HEIGHT] = t->height;
+	w[f_WIDTH] = t->width;
+	w[f_FLAGS] = t->flags & EXTRA_BOOKMARK;
+	w[f_LINENO] = t->lineno;
+    }
+}
+
+
+/* write a compiled document out so mkd_load_compiled() can read it
+ * back without compiling it again.   Returns 0, or EOF if the document
+ * isn't compiled (or is too big, or it couldn't be written.)
+ */
+int
+mkd_save_compiled(Document *doc, FILE *out)
+{
+    struct saver s;
+    DWORD hdr[HDR_SIZE], sum;
+    int ret = EOF;
+
+    if ( !(doc && doc->compiled) )
+	return EOF;
+
+    ___mkd_renumber(doc);
+    memset(&s, 0, sizeof s);
+    CREATE(s.paras);
+    CREATE(s.lines);
+    CREATE(s.foot);
+    CREATE(s.strings);
+
+    hdr[h_MAGIC] = COMPILED_MAGIC;
+    hdr[h_VERSION] = COMPILED_VERSION;
+    hdr[h_ORDER] = BYTE_ORDER_MARK;
+    hdr[h_FLAGS] = doc->ctx->flags;
+    hdr[h_TITLE] = putlines(&s, doc->title, 0);
+    hdr[h_AUTHOR] = putlines(&s, doc->author, 0);
+    hdr[h_DATE] = putlines(&s, doc->date, 0);
+    putparas(&s, doc->code);
+    putfootnotes(&s, doc->ctx);
+    hdr[h_NPARAS] = S(s.paras) / PARA_SIZE;
+    hdr[h_NLINES] = S(s.lines) / LINE_SIZE;
+    hdr[h_NFOOT] = S(s.foot) / FOOT_SIZE;
+    hdr[h_STRSIZE] = S(s.strings);
+    hdr[h_CHECKSUM] = 0;
+    sum = ___mkd_hash(FNV_BASIS, hdr, sizeof hdr);
+    sum = ___mkd_hash(sum, T(s.paras), S(s.paras) * sizeof(DWORD));
+    sum = ___mkd_hash(sum, T(s.lines), S(s.lines) * sizeof(DWORD));
+    sum = ___mkd_hash(sum, T(s.foot), S(s.foot) * sizeof(DWORD));
+    hdr[h_CHECKSUM] = ___mkd_hash(sum, T(s.strings), S(s.strings));
+
+    if ( !s.toobig
+	    && (fwrite(hdr, sizeof hdr, 1, out) == 1)
+	    && (fwrite(T(s.paras), sizeof(DWORD), S(s.paras), out) == S(s.paras))
+	    && (fwrite(T(s.lines), sizeof(DWORD), S(s.lines), out) == S(s.lines))
+	    && (fwrite(T(s.foot), sizeof(DWORD), S(s.foot), out) == S(s.foot))
+	    && (fwrite(T(s.strings), 1, S(s.strings), out) == S(s.strings)) )
+	ret = 0;
+
+    DELETE(s.paras);
+    DELETE(s.lines);
+    DELETE(s.foot);
+    DELETE(s.strings);
+    return ret;
+}
+
+
+struct loader {
+    const char *paras, *lines, *foot;
+    char *strings;
+    DWORD nparas, nlines, nfoot, nstrings;
+    Paragraph *para;		/* what they're loaded into */
+    Line *line;
+    char *used;			/* which ones something already points at */
+} ;
+
+
+/* records don't have to be aligned, so they're copied out a DWORD at a
+ * time
+ */
+static DWORD
+get(const char *rec, int field)
+{
+    DWORD w;
+
+    memcpy(&w, rec + field * sizeof w, sizeof w);
+    return w;
+}
+
+
+/* a string of `size` bytes (and the null after it)
+ */
+static char *
+string(struct loader *ld, DWORD off, DWORD size)
+{
+    if ( (off < ld->nstrings) && (size < ld->nstrings - off)
+			      && (ld->strings[off+size] == 0) )
+	return ld->strings + off;
+    return 0;
+}
+
+
+/* a string that's only ended by its null (the strings all end with
+ * one, so it can't run off the end)
+ */
+static char *
+zstring(struct loader *ld, DWORD off)
+{
+    return (off < ld->nstrings) ? ld->strings + off : 0;
+}
+
+
+/* a line that a paragraph, another line, or the header points at.
+ * Nothing can be pointed at twice, so the lines (and paragraphs) that
+ * are loaded are always a tree, however the file was made.
+ */
+static int
+claimline(struct loader *ld, DWORD i, Line **res)
+{
+    *res = 0;
+    if ( i == NIL )
+	return 1;
+    if ( (i >= ld->nlines) || ld->used[ld->nparas + i] )
+	return 0;
+    ld->used[ld->nparas + i] = 1;
+    *res = &ld->line[i];
+    return 1;
+}
+
+
+static int
+loadlines(struct loader *ld)
+{
+    const char *rec;
+    Line *t;
+    DWORD i, next, size, dle, count;
+
+    for ( i=0; i < ld->nlines; i++ ) {
+	rec = ld->lines + (size_t)i * LINE_SIZE * sizeof(DWORD);
+	t = &ld->line[i];
+
+	size = get(rec, l_SIZE);
+	dle = get(rec, l_DLE);
+	count = get(rec, l_COUNT);
+	if ( !(T(t->text) = string(ld, get(rec, l_TEXT), size)) )
+	    return 0;
+	if ( (dle > size) || (dle > INT_MAX) || (count > INT_MAX)
+			  || (get(rec, l_LINENO) > INT_MAX)
+			  || (get(rec, l_KIND) > chk_equal) )
+	    return 0;
+	S(t->text) = size;	/* (and it isn't ALLOCATED, so it's never freed) */
+	t->dle = dle;
+	t->flags = get(rec, l_FLAGS);
+	t->kind = get(rec, l_KIND);
+	t->count = count;
+	t->lineno = get(rec, l_LINENO);
+
+	next = get(rec, l_NEXT);
+	if ( (next != NIL) && (next <= i) )
+	    return 0;
+	if ( !claimline(ld, next, &t->next) )
+	    return 0;
+    }
+    return 1;
+}
+
+
+static int
+loadparas(struct loader *ld)
+{
+    const char *rec;
+    Paragraph *p;
+    DWORD i, j, off;
+
+    for ( i=0; i < ld->nparas; i++ ) {
+	rec = ld->paras + (size_t)i * PARA_SIZE * sizeof(DWORD);
+	p = &ld->para[i];
+
+	if ( (get(rec, p_TYP) > SOURCE) || (get(rec, p_ALIGN) > CENTER)
+					|| (get(rec, p_HNUMBER) > 6) )
+	    return 0;
+	p->typ = get(rec, p_TYP);
+	p->align = get(rec, p_ALIGN);
+	p->hnumber = get(rec, p_HNUMBER);
+
+	if ( (off = get(rec, p_IDENT)) != NIL )
+	    if ( !(p->ident = zstring(ld, off)) )
+		return 0;
+	if ( (off = get(rec, p_LANG)) != NIL )
+	    if ( !(p->lang = zstring(ld, off)) )
+		return 0;
+	if ( (off = get(rec, p_ANCHOR)) != NIL )
+	    if ( !(p->anchor = zstring(ld, off)) )
+		return 0;
+	if ( !claimline(ld, get(rec, p_TEXT), &p->text) )
+	    return 0;
+
+	if ( (j = get(rec, p_NEXT)) != NIL ) {
+	    if ( (j <= i) || (j >= ld->nparas) || ld->used[j] )
+		return 0;
+	    ld->used[j] = 1;
+	    p->next = &ld->para[j];
+	}
+	if ( (j = get(rec, p_DOWN)) != NIL ) {
+	    if ( (j <= i) || (j >= ld->nparas) || ld->used[j] )
+		return 0;
+	    ld->used[j] = 1;
+	    p->down = &ld->para[j];
+	}
+    }
+    return 1;
+}
+
+
+static int
+loadfootnotes(struct loader *ld, MMIOT *f)
+{
+    const char *rec;
+    Footnote *t;
+    DWORD i;
+
+    for ( i=0; i < ld->nfoot; i++ ) {
+	rec = ld->foot + (size_t)i * FOOT_SIZE * sizeof(DWORD);
+	t = &EXPAND(*f->footnotes);
+	memset(t, 0, sizeof *t);
+
+	S(t->tag) = get(rec, f_TAGSIZE);
+	S(t->link) = get(rec, f_LINKSIZE);
+	S(t->title) = get(rec, f_TITLESIZE);
+	if ( !(T(t->tag) = string(ld, get(rec, f_TAG), S(t->tag)))
+	      || !(T(t->link) = string(ld, get(rec, f_LINK), S(t->link)))
+	      || !(T(t->title) = string(ld, get(rec, f_TITLE), S(t->title))) )
+	    return 0;
+	if ( (get(rec, f_HEIGHT) > INT_MAX) || (get(rec, f_WIDTH) > INT_MAX)
+				|| (get(rec, f_LINENO) > INT_MAX) )
+	    return 0;
+	t->height = get(rec, f_HEIGHT);
+	t->width = get(rec, f_WIDTH);
+	t->flags = get(rec, f_FLAGS) & EXTRA_BOOKMARK;
+	t->lineno = get(rec, f_LINENO);
+    }
+    return 1;
+}
+
+
+/* take `count` records of `size` DWORDs off the front of what's left
+ * of the file
+ */
+static const char *
+table(const char **pos, size_t *left, DWORD count, int size)
+{
+    const char *ret = *pos;
+    size_t bytes = size * sizeof(DWORD);
+
+    if ( count > *left / bytes )
+	return 0;
+    *pos += count * bytes;
+    *left -= count * bytes;
+    return ret;
+}
+
+
+/* load a document that mkd_save_compiled() wrote out.   It's ready to
+ * be rendered, and the text in it is left where it is, so `data` has
+ * to stay around (unchanged) until the document is mkd_cleanup()ed.
+ * Returns 0 if `data` isn't a compiled document.
+ */
+Document *
+mkd_load_compiled(const void *data, size_t size)
+{
+    struct loader ld;
+    DWORD hdr[HDR_SIZE], sum;
+    const char *pos = data;
+    size_t left = size;
+    Document *doc;
+    void *image;
+    int ok;
+
+    if ( !data || (size < sizeof hdr) )
+	return 0;
+    memcpy(hdr, data, sizeof hdr);
+    pos += sizeof hdr;
+    left -= sizeof hdr;
+
+    if ( (hdr[h_MAGIC] != COMPILED_MAGIC)
+	    || (hdr[h_VERSION] != COMPILED_VERSION)
+	    || (hdr[h_ORDER] != BYTE_ORDER_MARK) )
+	return 0;
+
+    memset(&ld, 0, sizeof ld);
+    ld.nparas = hdr[h_NPARAS];
+    ld.nlines = hdr[h_NLINES];
+    ld.nfoot = hdr[h_NFOOT];
+    ld.nstrings = hdr[h_STRSIZE];
+
+    if ( !( (ld.paras = table(&pos, &left, ld.nparas, PARA_SIZE))
+	     && (ld.lines = table(&pos, &left, ld.nlines, LINE_SIZE))
+	     && (ld.foot = table(&pos, &left, ld.nfoot, FOOT_SIZE)) ) )
+	return 0;
+    if ( (left != ld.nstrings) || (left && pos[left-1]) )
+	return 0;
+    sum = hdr[h_CHECKSUM];
+    hdr[h_CHECKSUM] = 0;
+    if ( ___mkd_hash(___mkd_hash(FNV_BASIS, hdr, sizeof hdr),
+		  (const char*)data + sizeof hdr, size - sizeof hdr) != sum )
+	return 0;
+    ld.strings = (char*)pos;
+
+    /* all the paragraphs and lines go into one piece of memory, which
+     * is freed all at once
+     */
+    image = calloc(1, ld.nparas * sizeof(Paragraph)
+		    + ld.nlines * sizeof(Line) + 1);
+    ld.used = calloc(1, (size_t)ld.nparas + ld.nlines + 1);
+    if ( !(image && ld.used && (doc = __mkd_new_Document())) ) {
+	free(image);
+	free(ld.used);
+	return 0;
+    }
+    ld.para = image;
+    ld.line = (Line*)(ld.para + ld.nparas);
+    doc->image = image;
+
+    ___mkd_prepare(doc, hdr[h_FLAGS]);
+
+    ok = loadlines(&ld)
+	&& loadparas(&ld)
+	&& loadfootnotes(&ld, doc->ctx)
+	&& claimline(&ld, hdr[h_TITLE], &doc->title)
+	&& claimline(&ld, hdr[h_AUTHOR], &doc->author)
+	&& claimline(&ld, hdr[h_DATE], &doc->date);
+    free(ld.used);
+
+    if ( !ok ) {
+	mkd_cleanup(doc);
+	return 0;
+    }
+    doc->code = ld.nparas ? ld.para : 0;
+    ___mkd_index(doc, 0);
+    return doc;
+}
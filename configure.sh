@@ -14,6 +14,8 @@ ac_help='--enable-amalloc	Enable memory allocation debugging
 --with-github-tags	Allow `_` and `-` in <> tags
 --with-fenced-code	Allow fenced code blocks
 --with-urlencoded-anchor	Use url-encoded chars to multibyte chars in toc links
+--with-threads		Use threads to compile and render big documents,
+			and for mkd_render_batch() and mkd_submit()
 --enable-all-features	Turn on all stable optional features
 --shared		Build shared libraries (default is static)'
 
@@ -86,19 +88,12 @@ AC_PROG ranlib
 AC_C_VOLATILE
 AC_C_CONST
 AC_C_INLINE
+AC_C_THREAD_LOCAL
 AC_SCALAR_TYPES sub hdr
 AC_CHECK_BASENAME
 
 AC_CHECK_HEADERS sys/types.h pwd.h && AC_CHECK_FUNCS getpwuid
 
-if AC_CHECK_FUNCS srandom; then
-    AC_DEFINE 'INITRNG(x)' 'srandom((unsigned int)x)'
-elif AC_CHECK_FUNCS srand; then
-    AC_DEFINE 'INITRNG(x)' 'srand((unsigned int)x)'
-else
-    AC_DEFINE 'INITRNG(x)' '(void)1'
-fi
-
 if AC_CHECK_FUNCS 'bzero((char*)0,0)'; then
     : # Yay
 elif AC_CHECK_FUNCS 'memset((char*)0,0,0)'; then
@@ -107,14 +102,6 @@ else
     AC_FAIL "$TARGET requires bzero or memset"
 fi
 
-if AC_CHECK_FUNCS random; then
-    AC_DEFINE 'COINTOSS()' '(random()&1)'
-elif AC_CHECK_FUNCS rand; then
-    AC_DEFINE 'COINTOSS()' '(rand()&1)'
-else
-    AC_DEFINE 'COINTOSS()' '1'
-fi
-
 if AC_CHECK_FUNCS strcasecmp; then
     :
 elif AC_CHECK_FUNCS stricmp; then
@@ -159,4 +146,13 @@ fi
 
 [ "$WITH_PANDOC_HEADER" ] && AC_DEFINE 'PANDOC_HEADER' '1'
 
+if [ "$WITH_THREADS" ]; then
+    if AC_CHECK_HEADERS pthread.h && AC_LIBRARY pthread_create -lpthread; then
+	AC_DEFINE 'WITH_THREADS' 1
+	AC_CHECK_HEADERS sys/eventfd.h
+    else
+	AC_FAIL "--with-threads needs pthreads"
+    fi
+fi
+
 AC_OUTPUT Makefile version.c mkdio.h
@@ -19,23 +19,20 @@
 
 
 /*
- * dump out stylesheet sections.
+ * dump out stylesheet sections (the compiler has already picked
+ * them out of the document.)
  */
 static void
-stylesheets(Paragraph *p, Cstring *f)
+stylesheets(Paragraphs *styles, Cstring *f)
 {
     Line* q;
+    int i;
 
-    for ( ; p ; p = p->next ) {
-	if ( p->typ == STYLE ) {
-	    for ( q = p->text; q ; q = q->next ) {
-		Cswrite(f, T(q->text), S(q->text));
-		Csputc('\n', f);
-	    }
+    for ( i=0; i < S(*styles); i++ )
+	for ( q = T(*styles)[i]->text; q ; q = q->next ) {
+	    Cswrite(f, T(q->text), S(q->text));
+	    Csputc('\n', f);
 	}
-	if ( p->down )
-	    stylesheets(p->down, f);
-    }
 }
 
 
@@ -51,7 +48,7 @@ mkd_css(Document *d, char **res)
 	*res = 0;
 	CREATE(f);
 	RESERVE(f, 100);
-	stylesheets(d->code, &f);
+	stylesheets(&d->index.styles, &f);
 			
 	if ( (size = S(f)) > 0 ) {
 	    EXPAND(f) = 0;
@@ -9,20 +9,27 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
 
 #ifndef __WITHOUT_AMALLOC
 # include "amalloc.h"
 #endif
 
-/* expandable Pascal-style string.
+/* expandable Pascal-style string.   Strings grow by half again
+ * each time they fill up, so building one up a piece at a time
+ * doesn't keep copying it.   The sizes are pointer-sized (and signed,
+ * because there's plenty of code that counts them down past zero)
+ * so a string can hold more than 2gb.
  */
-#define STRING(type)	struct { type *text; int size, alloc; }
+#define STRING(type)	struct { type *text; ptrdiff_t size, alloc; }
+
+#define GROW(n)		(100 + (n) + (n)/2)
 
 #define CREATE(x)	( (T(x) = (void*)0), (S(x) = (x).alloc = 0) )
 #define EXPAND(x)	(S(x)++)[(S(x) < (x).alloc) \
 			    ? (T(x)) \
-			    : (T(x) = T(x) ? realloc(T(x), sizeof T(x)[0] * ((x).alloc += 100)) \
-					   : malloc(sizeof T(x)[0] * ((x).alloc += 100)) )]
+			    : (T(x) = T(x) ? realloc(T(x), sizeof T(x)[0] * ((x).alloc = GROW((x).alloc))) \
+					   : malloc(sizeof T(x)[0] * ((x).alloc = GROW(0))) )]
 
 #define DELETE(x)	ALLOCATED(x) ? (free(T(x)), S(x) = (x).alloc = 0) \
 				     : ( S(x) = 0 )
@@ -34,13 +41,12 @@
 #define RESERVE(x, sz)	T(x) = ((x).alloc > S(x) + (sz) \
 			    ? T(x) \
 			    : T(x) \
-				? realloc(T(x), sizeof T(x)[0] * ((x).alloc = 100+(sz)+S(x))) \
-				: malloc(sizeof T(x)[0] * ((x).alloc = 100+(sz)+S(x))))
+				? realloc(T(x), sizeof T(x)[0] * ((x).alloc = GROW(S(x))+(sz))) \
+				: malloc(sizeof T(x)[0] * ((x).alloc = GROW(S(x))+(sz))))
 #define SUFFIX(t,p,sz)	\
-	    memcpy(((S(t) += (sz)) - (sz)) + \
-		    (T(t) = T(t) ? realloc(T(t), sizeof T(t)[0] * ((t).alloc += sz)) \
-				 : malloc(sizeof T(t)[0] * ((t).alloc += sz))), \
-		    (p), sizeof(T(t)[0])*(sz))
+	    ( RESERVE((t), (sz)), \
+	      memcpy(T(t)+S(t), (p), sizeof(T(t)[0])*(sz)), \
+	      S(t) += (sz) )
 
 #define PREFIX(t,p,sz)	\
 	    RESERVE( (t), (sz) ); \
@@ -71,7 +77,7 @@ typedef STRING(char) Cstring;
 
 extern void Csputc(int, Cstring *);
 extern int Csprintf(Cstring *, char *, ...);
-extern int Cswrite(Cstring *, char *, int);
+extern ptrdiff_t Cswrite(Cstring *, char *, ptrdiff_t);
 extern void Csreparse(Cstring *, char *, int, int);
 
 #endif/*_CSTRING_D*/
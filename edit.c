@@ -0,0 +1,606 @@
+/* markdown: a C implementation of John Gruber's Markdown markup language.
+ *
+ * Copyright (C) 2007 David L Parsons.
+ * The redistribution terms are provided in the COPYRIGHT file that must
+ * be distributed with this source code.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "cstring.h"
+#include "markdown.h"
+#include "amalloc.h"
+
+/*
+ * A document made by mkd_edit_string() keeps a copy of its source,
+ * and compiles it in chunks that are cut where ___mkd_breakpoint()
+ * says it's safe to cut.  When mkd_update() changes the source, only
+ * the chunks around the change are compiled again; the new chunks stop
+ * at the first cut that lines up with one of the old chunks after the
+ * change, and everything from there on is kept.
+ */
+typedef STRING(Chunk) Chunks;
+
+typedef int (*stfu)(const void*,const void*);
+int __mkd_footsort(Footnote *, Footnote *);
+
+
+/* read the line of source that starts at *pos (which is line `line` of
+ * the source) into a Line, the same way fill() would.   Returns 0 if
+ * there's nothing left.
+ */
+static Line *
+readline(Document *doc, ptrdiff_t *pos, int line, Cstring *bfr)
+{
+    Document tmp;
+    char *s = T(doc->source);
+    ptrdiff_t i, size = S(doc->source);
+    int c;
+
+    S(*bfr) = 0;
+    for ( i = *pos; (i < size) && (s[i] != '\n'); i++ )
+	if ( isprint(c = (unsigned char)s[i]) || isspace(c) || (c & 0x80) )
+	    EXPAND(*bfr) = c;
+
+    if ( i < size )
+	i++;
+    else if ( S(*bfr) == 0 ) {
+	*pos = size;
+	return 0;
+    }
+    *pos = i;
+
+    memset(&tmp, 0, sizeof tmp);
+    tmp.tabstop = doc->tabstop;
+    tmp.nlines = line-1;
+    __mkd_enqueue(&tmp, bfr);
+    return T(tmp.content);
+}
+
+
+/* does the source start with a pandoc header?  If it does, pull it
+ * out of the document and return where the rest of the document starts.
+ */
+static ptrdiff_t
+header(Document *doc, int keep)
+{
+    Line *h[3];
+    Cstring bfr;
+    ptrdiff_t pos = 0;
+    int i, n, ok = 1;
+
+    if ( doc->inflags & MKD_NOHEADER )
+	return 0;
+
+    /* fill() wants three lines that start with %, each with a newline
+     * at the end
+     */
+    CREATE(bfr);
+    for ( n=0; ok && (n < 3); n++ ) {
+	if ( !(h[n] = readline(doc, &pos, n+1, &bfr)) ) {
+	    ok = 0;
+	    break;
+	}
+	ok = (T(doc->source)[pos-1] == '\n') && S(h[n]->text)
+					      && (T(h[n]->text)[0] == '%');
+    }
+    DELETE(bfr);
+
+    if ( ok && keep ) {
+	for ( i=0; i < 3; i++ )
+	    __mkd_header_dle(h[i]);
+	doc->title = h[0];
+	doc->author = h[1];
+	doc->date = h[2];
+    }
+    else
+	for ( i=0; i < n; i++ )
+	    ___mkd_freeLine(h[i]);
+    return ok ? pos : 0;
+}
+
+
+/* compile the lines of a chunk, keeping its footnotes in the chunk
+ */
+static void
+compile(Document *doc, Chunk *c, Line *text)
+{
+    MMIOT scratch;
+    Paragraph *p;
+
+    CREATE(c->footnotes);
+    ___mkd_initmmiot(&scratch, &c->footnotes);
+    scratch.flags = doc->ctx->flags;
+    scratch.engine = doc->ctx->engine;
+    c->code = ___mkd_compile_piece(text, &scratch);
+    ___mkd_freemmiot(&scratch, &c->footnotes);
+
+    for ( p = c->code; p && p->next; p = p->next )
+	;
+    c->last = p;
+}
+
+
+/* start a new chunk at `start` (which is on line `line`)
+ */
+static Chunk *
+newchunk(Chunks *new, ptrdiff_t start, ptrdiff_t end, int line)
+{
+    Chunk *c = &EXPAND(*new);
+
+    c->start = start;
+    c->size = end - start;
+    c->line = c->numbered = line;
+    return c;
+}
+
+
+/* cut the source into chunks from pos (which is on line `line`) on,
+ * and compile them.  If the source is being cut again after an edit,
+ * stop at the first cut past `after` that lands at the start of one of
+ * the `old` chunks (which have moved `delta` bytes), and return which
+ * one that was.
+ */
+static int
+chop(Document *doc, ptrdiff_t pos, int line, Chunks *new,
+		    Chunk *old, int nold, ptrdiff_t after, ptrdiff_t delta)
+{
+    ANCHOR(Line) text = { 0, 0 };
+    Breakpoint bp;
+    Cstring bfr;
+    Line *t, *prev;
+    ptrdiff_t here, start = pos;
+    int cut, k = 0, first = line;
+
+    memset(&bp, 0, sizeof bp);
+    bp.flags = doc->ctx->flags;
+    bp.engine = doc->ctx->engine;
+    if ( pos > doc->base ) {
+	/* an old chunk starts here, so the tracker is in the state
+	 * it's always in after the blank line in front of a cut.
+	 */
+	bp.blank = bp.block = bp.content = 1;
+    }
+
+    CREATE(bfr);
+    while ( 1 ) {
+	here = pos;
+	if ( !(t = readline(doc, &pos, line++, &bfr)) )
+	    break;
+
+	prev = E(text);
+	ATTACH(text, t);
+	cut = ___mkd_breakpoint(&bp, t);
+
+	if ( cut && prev ) {
+	    prev->next = 0;
+
+	    while ( (k < nold) && (old[k].start + delta < here) )
+		k++;
+	    if ( (here >= after) && (k < nold) && (old[k].start + delta == here) ) {
+		___mkd_freeLine(t);
+		E(text) = prev;
+		pos = here;
+		break;
+	    }
+
+	    compile(doc, newchunk(new, start, here, first), T(text));
+	    T(text) = E(text) = t;
+	    start = here;
+	    first = t->lineno;
+	}
+    }
+    DELETE(bfr);
+
+    if ( T(text) || (pos > start) )
+	compile(doc, newchunk(new, start, pos, first), T(text));
+
+    return t ? k : nold;
+}
+
+
+/* string the paragraphs of chunks [from, to) together, and onto the
+ * chunks on either side of them
+ */
+static void
+relink(Document *doc, int from, int to)
+{
+    Paragraph *last = 0;
+    Chunk *c = T(doc->chunks);
+    int i;
+
+    for ( i = from-1; (i >= 0) && !c[i].code; --i )
+	;
+    if ( i >= 0 )
+	last = c[i].last;
+    else
+	doc->code = 0;
+
+    for ( i = from; i < S(doc->chunks); i++ ) {
+	if ( !c[i].code )
+	    continue;
+	if ( last )
+	    last->next = c[i].code;
+	else
+	    doc->code = c[i].code;
+	last = c[i].last;
+	if ( i >= to )
+	    return;
+    }
+    if ( last )
+	last->next = 0;
+}
+
+
+/* build the table of footnotes that the renderer looks things up in.
+ * The chunks own the footnotes; the table just has copies of them.
+ */
+static void
+refile(Document *doc)
+{
+    MMIOT *f = doc->ctx;
+    Chunk *c;
+    int i, j;
+
+    S(*f->footnotes) = 0;
+    for ( i=0; i < S(doc->chunks); i++ ) {
+	c = &T(doc->chunks)[i];
+	for ( j=0; j < S(c->footnotes); j++ )
+	    EXPAND(*f->footnotes) = T(c->footnotes)[j];
+    }
+    ___mkd_sortfootnotes(f);
+}
+
+
+static void
+renumber(Paragraph *p, Paragraph *last, int shift)
+{
+    Line *t;
+
+    for ( ; p; p = (p == last) ? 0 : p->next ) {
+	for ( t = p->text; t; t = t->next )
+	    t->lineno += shift;
+	if ( p->down )
+	    renumber(p->down, 0, shift);
+    }
+}
+
+
+/* an edit moves everything after it up or down some lines, but
+ * mkd_update() only moves the chunks, not every line in them.  Catch
+ * the lines (and footnotes) up with the chunks they're in before
+ * anything looks at their line numbers.
+ */
+void
+___mkd_renumber(Document *doc)
+{
+    MMIOT *f = doc->ctx;
+    Footnote *def, *copy, *end;
+    Chunk *c;
+    int i, j, shift;
+
+    if ( !(doc->editable && doc->compiled) )
+	return;
+
+    for ( i=0; i < S(doc->chunks); i++ ) {
+	c = &T(doc->chunks)[i];
+	if ( (shift = c->line - c->numbered) == 0 )
+	    continue;
+	if ( c->code )
+	    renumber(c->code, c->last, shift);
+	for ( j=0; j < S(c->footnotes); j++ )
+	    T(c->footnotes)[j].lineno += shift;
+	c->numbered = c->line;
+    }
+
+    /* and the copies of the footnotes in the table (which is sorted
+     * by tag, and might have more than one footnote with the same tag)
+     */
+    end = T(*f->footnotes) + S(*f->footnotes);
+    for ( i=0; i < S(doc->chunks); i++ ) {
+	c = &T(doc->chunks)[i];
+	for ( j=0; j < S(c->footnotes); j++ ) {
+	    def = &T(c->footnotes)[j];
+	    copy = bsearch(def, T(*f->footnotes), S(*f->footnotes),
+				sizeof *def, (stfu)__mkd_footsort);
+	    if ( !copy )
+		continue;
+	    while ( (copy > T(*f->footnotes)) && !__mkd_footsort(copy-1, def) )
+		--copy;
+	    for ( ; (copy < end) && !__mkd_footsort(copy, def); copy++ )
+		if ( T(copy->tag) == T(def->tag) ) {
+		    copy->lineno = def->lineno;
+		    break;
+		}
+	}
+    }
+}
+
+
+/* throw away a chunk; the caller has already cut its paragraphs out
+ * of the document
+ */
+static void
+discard(Chunk *c)
+{
+    int i;
+
+    if ( c->last )
+	c->last->next = 0;
+    if ( c->code )
+	___mkd_freeParagraph(c->code);
+    for ( i=0; i < S(c->footnotes); i++ )
+	___mkd_freefootnote(&T(c->footnotes)[i]);
+    DELETE(c->footnotes);
+}
+
+
+/* free the chunks of a document (but not their paragraphs, which are
+ * freed along with the rest of doc->code)
+ */
+void
+___mkd_freechunks(Document *doc)
+{
+    Chunk *c;
+    int i, j;
+
+    if ( S(doc->chunks) && doc->ctx && doc->ctx->footnotes )
+	S(*doc->ctx->footnotes) = 0;
+
+    for ( i=0; i < S(doc->chunks); i++ ) {
+	c = &T(doc->chunks)[i];
+	for ( j=0; j < S(c->footnotes); j++ )
+	    ___mkd_freefootnote(&T(c->footnotes)[j]);
+	DELETE(c->footnotes);
+    }
+    DELETE(doc->chunks);
+}
+
+
+/* compile a document made by mkd_edit_string() (called from
+ * mkd_compile(), after ___mkd_prepare())
+ */
+int
+___mkd_compile_edit(Document *doc)
+{
+    Chunks new;
+
+    doc->base = header(doc, 1);
+
+    CREATE(new);
+    chop(doc, doc->base, doc->base ? 4 : 1, &new, 0, 0, 0, 0);
+
+    DELETE(doc->chunks);
+    T(doc->chunks) = T(new);
+    S(doc->chunks) = S(new);
+    ALLOCATED(doc->chunks) = ALLOCATED(new);
+
+    relink(doc, 0, S(doc->chunks));
+    refile(doc);
+    S(doc->index.styles) = S(doc->index.headers) = S(doc->index.toc) = 0;
+    ___mkd_reindex(doc, 0, S(doc->chunks), 0);
+    return 1;
+}
+
+
+/* forget the html from the last time the document was rendered
+ */
+static void
+unrender(Document *doc)
+{
+    MMIOT *f = doc->ctx;
+    int i;
+
+    for ( i=0; i < S(doc->segments); i++ )
+	DELETE(T(doc->segments)[i]);
+    S(doc->segments) = 0;
+    S(f->out) = S(f->Q) = 0;
+
+    f->reference = 0;
+    f->block = 0;
+    for ( i=0; i < S(*f->footnotes); i++ ) {
+	T(*f->footnotes)[i].flags &= ~REFERENCED;
+	T(*f->footnotes)[i].refnumber = 0;
+    }
+
+    memset(&doc->cursor, 0, sizeof doc->cursor);
+    doc->html = doc->marked = 0;
+    ___mkd_free_ast(doc);
+}
+
+
+/* compile the whole document again
+ */
+static void
+recompile(Document *doc)
+{
+    ___mkd_freechunks(doc);
+    if ( doc->code ) ___mkd_freeParagraph(doc->code);
+    if ( doc->title ) ___mkd_freeLine(doc->title);
+    if ( doc->author ) ___mkd_freeLine(doc->author);
+    if ( doc->date ) ___mkd_freeLine(doc->date);
+    doc->code = 0;
+    doc->title = doc->author = doc->date = 0;
+
+    ___mkd_compile_edit(doc);
+}
+
+
+static int
+samefootnote(Footnote *a, Footnote *b)
+{
+#define SAME(x,y)	((S(x) == S(y)) && !memcmp(T(x), T(y), S(x)))
+    return SAME(a->tag, b->tag) && SAME(a->link, b->link)
+				&& SAME(a->title, b->title)
+				&& (a->height == b->height)
+				&& (a->width == b->width)
+				&& (a->flags == b->flags);
+#undef SAME
+}
+
+
+/* if the chunks that were compiled again define the same footnotes as
+ * the ones they replace, give them the old footnotes so the table
+ * still points at the right things.  Returns 0 if the footnotes changed.
+ */
+static int
+keepfootnotes(Chunk *old, int nold, Chunk *new, int nnew)
+{
+    Footnote tmp, *a, *b;
+    int i, j, k, l, count = 0;
+
+    for ( i=0; i < nold; i++ )
+	count += S(old[i].footnotes);
+    for ( i=0; i < nnew; i++ )
+	count -= S(new[i].footnotes);
+    if ( count )
+	return 0;
+
+    for ( i=j=0, k=l=0; (i < nold) && (k < nnew); ) {
+	if ( j >= S(old[i].footnotes) ) { i++; j=0; continue; }
+	if ( l >= S(new[k].footnotes) ) { k++; l=0; continue; }
+	if ( !samefootnote(&T(old[i].footnotes)[j++], &T(new[k].footnotes)[l++]) )
+	    return 0;
+    }
+
+    for ( i=j=0, k=l=0; (i < nold) && (k < nnew); ) {
+	if ( j >= S(old[i].footnotes) ) { i++; j=0; continue; }
+	if ( l >= S(new[k].footnotes) ) { k++; l=0; continue; }
+	a = &T(old[i].footnotes)[j++];
+	b = &T(new[k].footnotes)[l++];
+	tmp = *a; *a = *b; *b = tmp;
+	b->lineno = a->lineno;	/* (but it might have moved) */
+    }
+    return 1;
+}
+
+
+static int
+newlines(const char *s, int size)
+{
+    int i, count = 0;
+
+    for ( i=0; i < size; i++ )
+	if ( s[i] == '\n' )
+	    count++;
+    return count;
+}
+
+
+/* replace `removed` bytes of the source of a document at `offset` with
+ * `size` bytes of `text`.  If the document has been compiled, the part
+ * of it that's changed is compiled again.   Returns 0, or EOF if the
+ * document wasn't made by mkd_edit_string() or the edit doesn't fit it.
+ */
+int
+mkd_update(Document *doc, int offset, int removed, const char *text, int size)
+{
+    Chunks new;
+    Chunk *old;
+    Slugs was;
+    ptrdiff_t delta, tail;
+    int a, s, k, i, n, fresh, lines, added;
+
+    if ( !(doc && (doc->magic == VALID_DOCUMENT) && doc->editable) )
+	return EOF;
+    if ( !text || (size < 0) )
+	size = 0;
+    if ( (offset < 0) || (removed < 0) || (offset + (ptrdiff_t)removed > S(doc->source)) )
+	return EOF;
+
+    /* splice the new text into the source
+     */
+    delta = size - removed;
+    lines = newlines(text, size) - newlines(T(doc->source)+offset, removed);
+    tail = S(doc->source) - (offset + removed);
+    if ( delta > 0 )
+	RESERVE(doc->source, delta);
+    memmove(T(doc->source)+offset+size, T(doc->source)+offset+removed, tail);
+    if ( size )
+	memcpy(T(doc->source)+offset, text, size);
+    S(doc->source) += delta;
+
+    if ( !doc->compiled )
+	return 0;
+
+    unrender(doc);
+
+    /* an edit to the pandoc header (or one that makes or breaks one)
+     * changes where the document starts, so start over
+     */
+    n = S(doc->chunks);
+    if ( (n == 0) || (offset < doc->base)
+		  || ((doc->title != 0) != (header(doc, 0) != 0)) ) {
+	recompile(doc);
+	return 0;
+    }
+
+    /* find the chunk the edit starts in, and back up one more chunk
+     * in case the edit changes whether it's safe to cut in front of it
+     */
+    old = T(doc->chunks);
+    for ( a=0; (a < n-1) && (offset >= old[a].start + old[a].size); a++ )
+	;
+    s = a ? a-1 : 0;
+
+    CREATE(new);
+    k = chop(doc, old[s].start, old[s].line, &new, old+s, n-s, offset+size, delta) + s;
+    fresh = !keepfootnotes(old+s, k-s, T(new), S(new));
+
+    CREATE(was);
+    ___mkd_unindex(doc, s, k, &was);
+    for ( i=s; i < k; i++ )
+	discard(&old[i]);
+    for ( i=k; i < n; i++ ) {
+	old[i].start += delta;
+	old[i].line += lines;	/* (see ___mkd_renumber()) */
+    }
+
+    /* and put the new chunks where the old ones were
+     */
+    if ( S(new) > k-s )
+	RESERVE(doc->chunks, S(new) - (k-s));
+    old = T(doc->chunks);
+    memmove(old+s+S(new), old+k, (n-k) * sizeof old[0]);
+    if ( S(new) )
+	memcpy(old+s, T(new), S(new) * sizeof old[0]);
+    S(doc->chunks) += S(new) - (k-s);
+    added = S(new);
+    relink(doc, s, s+added);
+    DELETE(new);
+
+    if ( fresh )
+	refile(doc);
+
+    /* only the new chunks have to be indexed, but if a header in them
+     * has changed its name it might have taken (or given up) an anchor
+     * that a header after it had
+     */
+    ___mkd_reindex(doc, s, s+added, &was);
+    DELETE(was);
+    return 0;
+}
+
+
+/* make a document that can be changed with mkd_update()
+ */
+Document *
+mkd_edit_string(const char *text, int size, DWORD flags)
+{
+    Document *doc;
+
+    if ( !(doc = __mkd_new_Document()) )
+	return 0;
+
+    doc->editable = 1;
+    doc->tabstop = (flags & MKD_TABSTOP) ? 4 : TABSTOP;
+    doc->inflags = flags & INPUT_MASK;
+    CREATE(doc->source);
+    if ( text && (size > 0) )
+	SUFFIX(doc->source, text, size);
+    return doc;
+}
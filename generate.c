@@ -11,9 +11,15 @@
 #include <time.h>
 #include <ctype.h>
 #include <assert.h>
+#include <limits.h>
 
 #include "config.h"
 
+#if WITH_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
 #if HAVE_STRCASECMP 
 #define stricmp strcasecmp
 #endif
@@ -53,10 +59,9 @@ push(char *bfr, int size, MMIOT *f)
 static inline int
 peek(MMIOT *f, int i)
 {
+    ptrdiff_t at = f->isp - 1 + i;
 
-    i += (f->isp-1);
-
-    return (i >= 0) && (i < S(f->in)) ? T(f->in)[i] : EOF;
+    return (at >= 0) && (at < S(f->in)) ? T(f->in)[at] : EOF;
 }
 
 
@@ -207,6 +212,9 @@ ___mkd_reparse(char *bfr, int size, int flags, MMIOT *f, char *esc)
     sub.flags = f->flags | flags;
     sub.cb = f->cb;
     sub.ref_prefix = f->ref_prefix;
+    sub.engine = f->engine;
+    sub.rng = f->rng;
+    sub.log = f->log;
 
     if ( esc ) {
 	sub.esc = &e;
@@ -224,6 +232,7 @@ ___mkd_reparse(char *bfr, int size, int flags, MMIOT *f, char *esc)
     ___mkd_emblock(&sub);
     
     Qwrite(T(sub.out), S(sub.out), f);
+    f->rng = sub.rng;
 
     ___mkd_freemmiot(&sub, f->footnotes);
 }
@@ -754,9 +763,10 @@ printlinkyref(MMIOT *f, linkytype *tag, char *link, int size)
 	___mkd_reparse(link + tag->szpat, size - tag->szpat, MKD_TAGTEXT, f, 0);
 
 #if WITH_TINPOT_ /* A `<img .../>` ? -- Only in XML! */
-    imaget.link_sfx = (f->flags & MKD_XML) ? "\" />" : "\">";
+    if ( tag == &imaget )
+	Qstring((f->flags & MKD_XML) ? "\" />" : "\">", f);
+    else
 #endif
-
     Qstring(tag->link_sfx, f);
 
     if ( f->cb && f->cb->e_flags && (edit = (*f->cb->e_flags)(link, size, f->cb->e_data)) ) {
@@ -783,6 +793,9 @@ MMIOT *p;
 static int
 extra_linky(MMIOT *f, Cstring text, Footnote *ref)
 {
+    if ( f->log )
+	f->log->uncacheable = 1;
+
     if ( ref->flags & REFERENCED )
 	return 0;
 	
@@ -912,8 +925,12 @@ linkylinky(int image, MMIOT *f)
 		    S(key.tag) = S(name);
 		}
 
-		if ( ref = bsearch(&key, T(*f->footnotes), S(*f->footnotes),
-					  sizeof key, (stfu)__mkd_footsort) ) {
+		ref = bsearch(&key, T(*f->footnotes), S(*f->footnotes),
+				   sizeof key, (stfu)__mkd_footsort);
+		if ( f->log )
+		    ___mkd_cache_looked(f->log, &key, ref);
+
+		if ( ref ) {
 		    if ( extra_footnote )
 			status = extra_linky(f,name,ref);
 		    else
@@ -956,15 +973,30 @@ cputc(int c, MMIOT *f)
 }
 
  
+/*
+ * flip a coin, using the document's own random number generator
+ * so it doesn't have to share one with other threads.
+ */
+static int
+cointoss(MMIOT *f)
+{
+    f->rng = f->rng * 1103515245UL + 12345UL;
+    return (f->rng >> 16) & 1;
+}
+
+
 /*
  * convert an email address to a string of nonsense
  */
 static void
 mangle(char *s, int len, MMIOT *f)
 {
+    if ( f->log )
+	f->log->uncacheable = 1;
+
     while ( len-- > 0 ) {
 	Qstring("&#", f);
-	Qprintf(f, COINTOSS() ? "x%02x;" : "%02d;", *((unsigned char*)(s++)) );
+	Qprintf(f, cointoss(f) ? "x%02x;" : "%02d;", *((unsigned char*)(s++)) );
     }
 }
 
@@ -1387,21 +1419,10 @@ smartypants(int c, int *flags, MMIOT *f)
 /* <tin-pot@gmx.net> 2014-04-24:
  * Pass text through without interpreting if it is delimited in a user-defined fashion.
  */
-#define RAW_MAX 128U
-
-struct RawDef {
-    /*const*/ char *begin, *end;	/* Delimiting input mark-up */
-    /*const*/ char *otag, *etag;	/* Delimiting output mark-up */
-} rawdef[RAW_MAX] = {
-    { NULL , NULL, NULL , NULL }
-};
-char rawchr0[RAW_MAX+1];		/* Initial char of rawdef[].begin */
-size_t rawnum = 0U;
-
 int
 rawcmp(const void *lhs, const void *rhs)
 {
-    const struct RawDef *const plhd = lhs,
+    const struct rawdef *const plhd = lhs,
 	                *const prhd = rhs;
     int cmp = strcmp(plhd->begin, prhd->begin);
     /*
@@ -1414,7 +1435,7 @@ rawcmp(const void *lhs, const void *rhs)
 int
 rawbsr(const void *lhs, const void *rhs)
 {
-    const struct RawDef *const prhd = rhs;
+    const struct rawdef *const prhd = rhs;
     const char *begin = (const char *)lhs;
     int cmp = strcmp(begin, prhd->begin);
     /*
@@ -1424,47 +1445,55 @@ rawbsr(const void *lhs, const void *rhs)
     return -cmp;
 }
 
-int
-rawsort(void)
+static int
+rawsort(Engine *e)
 {
     size_t k;
 
-    qsort(rawdef, rawnum, sizeof rawdef[0], rawcmp);
-    for (k = 0; k < rawnum; ++k) 
-	rawchr0[k] = rawdef[k].begin[0];
-    return (int)rawnum;
+    qsort(e->raw, e->rawnum, sizeof e->raw[0], rawcmp);
+    for (k = 0; k < e->rawnum; ++k) 
+	e->rawchr0[k] = e->raw[k].begin[0];
+    return (int)e->rawnum;
 }
 
-struct RawDef *
-rawdefine(char *begin)
+static struct rawdef *
+rawdefine(Engine *e, char *begin)
 {
-    struct RawDef *def;
+    struct rawdef *def;
 
-    def = bsearch(begin, rawdef, rawnum, sizeof rawdef[0], rawbsr);
+    def = bsearch(begin, e->raw, e->rawnum, sizeof e->raw[0], rawbsr);
     if (def == NULL) {
-        if (rawnum >= RAW_MAX)
+        if (e->rawnum >= RAW_MAX)
             return NULL;
         else
-	    def = rawdef + rawnum++;
+	    def = e->raw + e->rawnum++;
     }
 
-    rawchr0[def - rawdef   ] = begin[0];
-    rawchr0[def - rawdef +1] = '\0';
+    e->rawchr0[def - e->raw   ] = begin[0];
+    e->rawchr0[def - e->raw +1] = '\0';
 
     def->begin	= begin;
 
     return def;
 }
 
+/*
+ * Define raw delimiters for an engine that's not been frozen yet.
+ * The argument is modified and must stay around as long as the
+ * engine does.
+ */
 int
-rawarg(char *arg)
+mkd_engine_raw(Engine *e, char *arg)
 {
     int sep;
     char *psep, *pend;
     char *begin, *end;
     char *otag = NULL, *etag = NULL;
-    struct RawDef *def;
+    struct rawdef *def;
     
+    if ( !(e && (e->magic == VALID_ENGINE)) || e->frozen ) {
+	return -5;
+    }
     if (arg == NULL || (sep = arg[0]) == '\0') {
         return -1;
     }
@@ -1511,16 +1540,22 @@ rawarg(char *arg)
     /*
      * Add or overwrite definition for "begin".
      */
-    if ( (def = rawdefine(begin)) != NULL ) {
+    if ( (def = rawdefine(e, begin)) != NULL ) {
         def->end	= end;
         def->otag	= (otag == NULL) ? begin : otag;
         def->etag	= (etag == NULL) ? end   : etag;
-        return rawsort();
+        return rawsort(e);
     } else {
 	return -4; /* Table full. */
     }
 }
 
+int
+rawarg(char *arg)
+{
+    return mkd_engine_raw(&___mkd_default_engine, arg);
+}
+
 static int
 rawhandler(MMIOT *f, int rawchar)
 {
@@ -1529,12 +1564,13 @@ rawhandler(MMIOT *f, int rawchar)
     size_t k;
     char *textbegin, *textend;
     size_t lenbegin, lenend, lenraw;
+    Engine *e = f->engine;
     
     /*
      * Find first defined "raw begin" delimiter where initial 
      * character matches rawchar.
      */
-    if ( (pdelim = strchr(rawchr0, rawchar)) == NULL )
+    if ( (pdelim = strchr(e->rawchr0, rawchar)) == NULL )
 	return 0; /* No initial character => no raw text here. */
     else
         delim = *pdelim;
@@ -1544,10 +1580,10 @@ rawhandler(MMIOT *f, int rawchar)
      */
     textbegin = cursor(f)-1;
 
-    for (k = (size_t)(pdelim - rawchr0); k < rawnum;  ++k) {
-	const char *begin = rawdef[k].begin;
+    for (k = (size_t)(pdelim - e->rawchr0); k < e->rawnum;  ++k) {
+	const char *begin = e->raw[k].begin;
 
-	if (rawchr0[k] != delim) {
+	if (e->rawchr0[k] != delim) {
 	    return 0;  /* No matching "begin" delimiter => no raw text. */
 	}
 	assert(begin != NULL);
@@ -1557,17 +1593,17 @@ rawhandler(MMIOT *f, int rawchar)
 	if (strncmp(textbegin, begin, lenbegin) == 0) 
 	    break;
     }
-    if (k == rawnum)
+    if (k == e->rawnum)
 	return 0; /* No matching "begin" delimiter => no raw text. */
 
     /*
      * Check if there is a matching "raw end" delimiter ahead. 
      */
-    assert(rawdef[k].end != NULL);
-    lenend = strlen(rawdef[k].end);
+    assert(e->raw[k].end != NULL);
+    lenend = strlen(e->raw[k].end);
     assert(lenend > 0U);
 
-    if ( (textend = strstr(textbegin + lenbegin, rawdef[k].end)) == NULL )
+    if ( (textend = strstr(textbegin + lenbegin, e->raw[k].end)) == NULL )
 	return 0; /* No matching end for begin found => no raw text. */
     
     /*
@@ -1587,11 +1623,11 @@ rawhandler(MMIOT *f, int rawchar)
 	 * Two delimiters with text in between => this is the raw text
 	 * we'v been waitin' for!
 	 */
-        assert(rawdef[k].otag != NULL);
-        assert(rawdef[k].etag != NULL);
-        Qstring(rawdef[k].otag, f);
+        assert(e->raw[k].otag != NULL);
+        assert(e->raw[k].etag != NULL);
+        Qstring(e->raw[k].otag, f);
         Qwrite(textbegin + lenbegin, lenraw, f);
-        Qstring(rawdef[k].etag, f);
+        Qstring(e->raw[k].etag, f);
         shift(f, (int)(lenbegin + lenraw + lenend - 1));
         return 1;
     }
@@ -1837,22 +1873,20 @@ Qstring(tag_text(f) ? "  " : "<br/>", f);
 static void
 printheader(Paragraph *pp, MMIOT *f)
 {
+    /* (the anchor was worked out when the document was compiled)
+     */
 #if WITH_ID_ANCHOR
     Qprintf(f, "<h%d", pp->hnumber);
-    if ( f->flags & MKD_TOC ) {
+    if ( (f->flags & MKD_TOC) && pp->anchor ) {
 	Qstring(" id=\"", f);
-	mkd_string_to_anchor(T(pp->text->text),
-			     S(pp->text->text),
-			     (mkd_sta_function_t)Qchar, f, 1);
+	Qstring(pp->anchor, f);
 	Qchar('"', f);
     }
     Qchar('>', f);
 #else
-    if ( f->flags & MKD_TOC ) {
+    if ( (f->flags & MKD_TOC) && pp->anchor ) {
 	Qstring("<a name=\"", f);
-	mkd_string_to_anchor(T(pp->text->text),
-			     S(pp->text->text),
-			     (mkd_sta_function_t)Qchar, f, 1);
+	Qstring(pp->anchor, f);
 	Qstring("\"></a>\n", f);
     }
     Qprintf(f, "<h%d>", pp->hnumber);
@@ -1871,25 +1905,30 @@ static char* alignments[] = { "", " style=\"text-align:center;\"",
 
 typedef STRING(int) Istring;
 
+/* print a row of a table; `lead` is 1 if the rows start with a pipe.
+ * The line is left alone so the document can be rendered again.
+ */
 static int
-splat(Line *p, char *block, Istring align, int force, MMIOT *f)
+splat(Line *p, int lead, char *block, Istring align, int force, MMIOT *f)
 {
     int first,
-	idx = p->dle,
+	idx = p->dle + lead,
+	size = S(p->text),
 	colno = 0;
 
 
-    ___mkd_tidy(&p->text);
-    if ( T(p->text)[S(p->text)-1] == '|' )
-	--S(p->text);
+    while ( size && isspace(T(p->text)[size-1]) )
+	--size;
+    if ( size && (T(p->text)[size-1] == '|') )
+	--size;
     
     Qstring("<tr>\n", f);
-    while ( idx < S(p->text) ) {
+    while ( idx < size ) {
 	first = idx;
 	if ( force && (colno >= S(align)-1) )
-	    idx = S(p->text);
+	    idx = size;
 	else
-	    while ( (idx < S(p->text)) && (T(p->text)[idx] != '|') ) {
+	    while ( (idx < size) && (T(p->text)[idx] != '|') ) {
 		if ( T(p->text)[idx] == '\\' )
 		    ++idx;
 		++idx;
@@ -1920,7 +1959,7 @@ printtable(Paragraph *pp, MMIOT *f)
 
     Line *hdr, *dash, *body;
     Istring align;
-    int hcols,start;
+    int hcols,start,lead;
     char *p;
     enum e_alignments it;
 
@@ -1928,19 +1967,15 @@ printtable(Paragraph *pp, MMIOT *f)
     dash= hdr->next;
     body= dash->next;
 
-    if ( T(hdr->text)[hdr->dle] == '|' ) {
-	/* trim leading pipe off all lines
-	 */
-	Line *r;
-	for ( r = pp->text; r; r = r->next )
-	    r->dle ++;
-    }
+    /* skip the leading pipe on all lines
+     */
+    lead = (T(hdr->text)[hdr->dle] == '|');
 
     /* figure out cell alignments */
 
     CREATE(align);
 
-    for (p=T(dash->text), start=dash->dle; start < S(dash->text); ) {
+    for (p=T(dash->text), start=dash->dle+lead; start < S(dash->text); ) {
 	char first, last;
 	int end;
 	
@@ -2008,7 +2043,7 @@ printtable(Paragraph *pp, MMIOT *f)
 	Qstring("<table>\n", f);
     
     Qstring("<thead>\n", f);
-    hcols = splat(hdr, "th", align, 0, f);
+    hcols = splat(hdr, lead, "th", align, 0, f);
     Qstring("</thead>\n", f);
 
     if ( hcols < S(align) )
@@ -2019,7 +2054,7 @@ printtable(Paragraph *pp, MMIOT *f)
 
     Qstring("<tbody>\n", f);
     for ( ; body; body = body->next)
-	splat(body, "td", align, 1, f);
+	splat(body, lead, "td", align, 1, f);
     Qstring("</tbody>\n", f);
     Qstring("</table>\n", f);
 
@@ -2034,6 +2069,7 @@ printblock(Paragraph *pp, MMIOT *f)
     Line *t = pp->text;
     static char *Begin[] = { "", "<p>", "<p style=\"text-align:center;\">"  };
     static char *End[]   = { "", "</p>","</p>" };
+    int size;
 
     while (t) {
 	if ( S(t->text) ) {
@@ -2044,8 +2080,12 @@ printblock(Paragraph *pp, MMIOT *f)
 		push("\003\n", 2, f);
 	    }
 	    else {
-		___mkd_tidy(&t->text);
-		push(T(t->text), S(t->text), f);
+		/* trim trailing blanks without changing the line, so
+		 * the document can be rendered again
+		 */
+		for ( size = S(t->text); size && isspace(T(t->text)[size-1]); --size )
+		    ;
+		push(T(t->text), size, f);
 		if ( t->next )
 		    push("\n", 1, f);
 	    }
@@ -2232,26 +2272,73 @@ display(Paragraph *p, MMIOT *f)
 }
 
 
-/* dump out a list of footnotes
+/* dump out one top-level paragraph, with the same spacing that htmlify()
+ * would put between it and the paragraph before it.
+ */
+void
+___mkd_display(Paragraph *p, int first, MMIOT *f)
+{
+    Cstring key;
+    Reflog log;
+    ptrdiff_t start;
+
+    /* email addresses in each block are mangled the same way no
+     * matter what order the blocks are rendered in
+     */
+    f->rng = f->engine->seed ^ (f->block++ * 2654435761UL);
+
+    if ( !first )
+	Qstring("\n\n", f);
+
+    if ( f->engine->cache ) {
+	/* the block's html has to start at the end of the output
+	 * for the cache to find it
+	 */
+	___mkd_emblock(f);
+	start = S(f->out);
+
+	switch ( ___mkd_cache_fetch(f, p, &key) ) {
+	case 1:
+	    return;
+	case 0:
+	    memset(&log, 0, sizeof log);
+	    CREATE(log.refs);
+	    f->log = &log;
+	    display(p, f);
+	    ___mkd_emblock(f);
+	    f->log = 0;
+	    ___mkd_cache_store(f, &key, &log, start);
+	    return;
+	}
+    }
+    display(p, f);
+    ___mkd_emblock(f);
+}
+
+
+/* dump out the footnotes numbered `from` on
  */
 static void
-mkd_extra_footnotes(MMIOT *m)
+footnotelist(MMIOT *m, int from)
 {
     int j, i;
     Footnote *t;
 
-    if ( m->reference == 0 )
+    if ( m->reference < from )
 	return;
 
     
 #if WITH_TINPOT_ /* A <hr /> ? -- Only in XML! */
-    Csprintf(&m->out, "\n<div class=\"footnotes\">\n%s\n<ol>\n",
+    Csprintf(&m->out, "\n<div class=\"footnotes\">\n%s\n<ol",
 	    (m->flags & MKD_XML) ? "<hr />" : "<hr>");
 #else
-    Csprintf(&m->out, "\n<div class=\"footnotes\">\n<hr />\n<ol>\n");
+    Csprintf(&m->out, "\n<div class=\"footnotes\">\n<hr />\n<ol");
 #endif
+    if ( from > 1 )
+	Csprintf(&m->out, " start=\"%d\"", from);
+    Csprintf(&m->out, ">\n");
 
-    for ( i=1; i <= m->reference; i++ ) {
+    for ( i=from; i <= m->reference; i++ ) {
 	for ( j=0; j < S(*m->footnotes); j++ ) {
 	    t = &T(*m->footnotes)[j];
 	    if ( (t->refnumber == i) && (t->flags & REFERENCED) ) {
@@ -2268,21 +2355,355 @@ mkd_extra_footnotes(MMIOT *m)
 }
 
 
+/* dump out a list of footnotes
+ */
+void
+___mkd_extra_footnotes(MMIOT *m)
+{
+    footnotelist(m, 1);
+}
+
+
+/* step to the next top-level block of a document; the blocks in a
+ * SOURCE paragraph are handed out one at a time so the pieces stay
+ * small.
+ */
+static Paragraph *
+next_block(Cursor *c)
+{
+    Paragraph *p;
+
+    if ( (p = c->down) )
+	c->down = p->next;
+    else if ( (p = c->top) ) {
+	c->top = p->next;
+	if ( (p->typ == SOURCE) && p->down ) {
+	    /* htmlify() puts the same \n\n between these
+	     * as it does between top-level paragraphs
+	     */
+	    c->down = p->down->next;
+	    p = p->down;
+	}
+    }
+    return p;
+}
+
+
+/* render the next top-level block of a document into an output
+ * buffer.   Returns 0 when there's nothing left to render.
+ */
+static int
+render_piece(MMIOT *f, Cursor *c)
+{
+    Paragraph *p;
+
+    if ( !(p = next_block(c)) ) {
+	if ( c->done )
+	    return 0;
+	c->done = 1;
+	if ( f->flags & MKD_EXTRA_FOOTNOTE )
+	    ___mkd_extra_footnotes(f);
+	return 1;
+    }
+
+    ___mkd_display(p, !c->started, f);
+    c->started = 1;
+    return 1;
+}
+
+
+/* move the output buffer onto the end of the document's list of
+ * segments once it gets big, so the html that's already been written
+ * never has to be copied into a bigger buffer.
+ */
+static void
+segment(Document *p)
+{
+    if ( S(p->ctx->out) >= SEGMENT_SIZE ) {
+	EXPAND(p->segments) = p->ctx->out;
+	CREATE(p->ctx->out);
+    }
+}
+
+
+/* add up the size of a block, and see if it might have a [^footnote]
+ * in it.   Footnotes are numbered in the order they're first used, so
+ * blocks that use them have to be rendered in order.
+ */
+static int
+footnoted(Paragraph *p, int look, long *size)
+{
+    Paragraph *q;
+    Line *t;
+    int i, found = 0;
+
+    for ( t = p->text; t; t = t->next ) {
+	*size += S(t->text) + 1;
+	if ( look && !found )
+	    for ( i=1; i < S(t->text); i++ )
+		if ( (T(t->text)[i] == '^') && (T(t->text)[i-1] == '[') ) {
+		    found = 1;
+		    break;
+		}
+    }
+    for ( q = p->down; q; q = q->next )
+	if ( footnoted(q, look, size) )
+	    found = 1;
+    return found;
+}
+
+
+#if WITH_THREADS
+/*
+ * big documents are rendered on more than one thread by handing out
+ * runs of top-level blocks that add up to about this much markdown.
+ */
+#define RUN_SIZE	65536
+
+struct leaf {
+    Paragraph *p;
+    int serial;			/* rendered in order, after the runs */
+    ptrdiff_t start, size;	/* where its html is in the run's output */
+} ;
+
+struct run {
+    int first, last;		/* the blocks in this run */
+    MMIOT ctx;
+} ;
+
+struct runs {
+    struct leaf *b;
+    struct run *r;
+    int count;
+    int next;
+    pthread_mutex_t lock;
+} ;
+
+
+static void *
+render_runs(void *arg)
+{
+    struct runs *w = arg;
+    struct leaf *b;
+    struct run *r;
+    int i, j;
+
+    while ( 1 ) {
+	pthread_mutex_lock(&w->lock);
+	i = (w->next < w->count) ? w->next++ : EOF;
+	pthread_mutex_unlock(&w->lock);
+
+	if ( i == EOF )
+	    return 0;
+
+	r = &w->r[i];
+	for ( j = r->first; j < r->last; j++ ) {
+	    b = &w->b[j];
+	    if ( b->serial )
+		continue;
+	    b->start = S(r->ctx.out);
+	    r->ctx.block = j;
+	    ___mkd_display(b->p, (j == 0), &r->ctx);
+	    b->size = S(r->ctx.out) - b->start;
+	}
+    }
+}
+
+
+/* render the blocks of a document on as many threads as there are
+ * processors, then copy their html into the document in order.   Blocks
+ * that might number a footnote are left until then, so the footnotes
+ * are numbered just as they would be if the whole document was rendered
+ * in one go.   Returns 0 if the document isn't worth splitting up.
+ */
+static int
+render_parallel(Document *p)
+{
+    MMIOT *f = p->ctx;
+    STRING(struct leaf) blocks;
+    STRING(struct run) runs;
+    struct runs w;
+    struct leaf *b;
+    struct run *r;
+    Paragraph *q;
+    Cursor c;
+    pthread_t *tid = 0;
+    long size = 0;
+    int i, j, look, first = 0, nthreads = 0, started = 0;
+
+    if ( (nthreads = ___mkd_nthreads()) < 2 )
+	return 0;
+
+    /* the url callbacks weren't written to be called from more than
+     * one thread at a time
+     */
+    if ( f->cb && (f->cb->e_url || f->cb->e_flags) )
+	return 0;
+
+    look = (f->flags & MKD_EXTRA_FOOTNOTE) && S(*f->footnotes);
+
+    CREATE(blocks);
+    CREATE(runs);
+    memset(&c, 0, sizeof c);
+    c.top = p->code;
+
+    while ( (q = next_block(&c)) ) {
+	b = &EXPAND(blocks);
+	b->p = q;
+	b->serial = footnoted(q, look, &size);
+	b->start = b->size = 0;
+
+	if ( size >= RUN_SIZE ) {
+	    r = &EXPAND(runs);
+	    r->first = first;
+	    r->last = first = S(blocks);
+	    size = 0;
+	}
+    }
+    if ( first < S(blocks) ) {
+	r = &EXPAND(runs);
+	r->first = first;
+	r->last = S(blocks);
+    }
+
+    if ( S(runs) < 2 ) {
+	DELETE(blocks);
+	DELETE(runs);
+	return 0;
+    }
+
+    for ( i=0; i < S(runs); i++ ) {
+	MMIOT *ctx = &T(runs)[i].ctx;
+
+	___mkd_initmmiot(ctx, f->footnotes);
+	ctx->flags = f->flags;
+	ctx->cb = f->cb;
+	ctx->ref_prefix = f->ref_prefix;
+	ctx->engine = f->engine;
+    }
+
+    w.b = T(blocks);
+    w.r = T(runs);
+    w.count = S(runs);
+    w.next = 0;
+    pthread_mutex_init(&w.lock, 0);
+
+    if ( nthreads > w.count )
+	nthreads = w.count;
+    if ( (tid = malloc((nthreads-1) * sizeof tid[0])) )
+	while ( started < nthreads-1 ) {
+	    if ( pthread_create(&tid[started], 0, render_runs, &w) != 0 )
+		break;
+	    started++;
+	}
+    render_runs(&w);
+    for ( i=0; i < started; i++ )
+	pthread_join(tid[i], 0);
+    if ( tid ) free(tid);
+    pthread_mutex_destroy(&w.lock);
+
+    for ( i=0; i < S(runs); i++ ) {
+	r = &T(runs)[i];
+	for ( j = r->first; j < r->last; j++ ) {
+	    b = &T(blocks)[j];
+	    if ( b->serial ) {
+		f->block = j;
+		___mkd_display(b->p, (j == 0), f);
+	    }
+	    else
+		Cswrite(&f->out, T(r->ctx.out)+b->start, b->size);
+	    segment(p);
+	}
+	___mkd_freemmiot(&r->ctx, f->footnotes);
+    }
+    if ( f->flags & MKD_EXTRA_FOOTNOTE )
+	___mkd_extra_footnotes(f);
+    segment(p);
+
+    DELETE(blocks);
+    DELETE(runs);
+    return 1;
+}
+#endif
+
+
+/* render the whole document.
+ */
+static void
+render(Document *p)
+{
+    Cursor c;
+
+#if WITH_THREADS
+    if ( render_parallel(p) ) {
+	p->html = 1;
+	return;
+    }
+#endif
+    memset(&c, 0, sizeof c);
+    c.top = p->code;
+
+    while ( render_piece(p->ctx, &c) )
+	segment(p);
+    p->html = 1;
+}
+
+
+/* glue the segments of a rendered document back together for the
+ * callers that need it all in one piece.
+ */
+static void
+linearize(Document *p)
+{
+    Cstring all;
+    ptrdiff_t size;
+    int i;
+
+    if ( S(p->segments) == 0 )
+	return;
+
+    size = S(p->ctx->out);
+    for ( i=0; i < S(p->segments); i++ )
+	size += S(T(p->segments)[i]);
+
+    CREATE(all);
+    RESERVE(all, size+1);
+    for ( i=0; i < S(p->segments); i++ ) {
+	Cswrite(&all, T(T(p->segments)[i]), S(T(p->segments)[i]));
+	DELETE(T(p->segments)[i]);
+    }
+    Cswrite(&all, T(p->ctx->out), S(p->ctx->out));
+    DELETE(p->ctx->out);
+    p->ctx->out = all;
+    S(p->segments) = 0;
+}
+
+
+/* render a compiled document, unless it's already been rendered
+ * or is being handed out by mkd_render_next()
+ */
+int
+___mkd_render(Document *p)
+{
+    if ( !(p && p->compiled) || p->cursor.started )
+	return EOF;
+
+    if ( !p->html )
+	render(p);
+    return 0;
+}
+
+
 /* return a pointer to the compiled markdown
  * document.
  */
-int
-mkd_document(Document *p, char **res)
+ptrdiff_t
+mkd_document64(Document *p, char **res)
 {
-    int size;
+    ptrdiff_t size;
     
-    if ( p && p->compiled ) {
-	if ( ! p->html ) {
-	    htmlify(p->code, 0, 0, p->ctx);
-	    if ( p->ctx->flags & MKD_EXTRA_FOOTNOTE )
-		mkd_extra_footnotes(p->ctx);
-	    p->html = 1;
-	}
+    if ( ___mkd_render(p) != EOF ) {
+	linearize(p);
 
 	size = S(p->ctx->out);
 	
@@ -2295,3 +2716,704 @@ mkd_document(Document *p, char **res)
     return EOF;
 }
 
+
+/* mkd_document() for callers that can only take an int; documents
+ * too large for that are an error.
+ */
+int
+mkd_document(Document *p, char **res)
+{
+    ptrdiff_t size = mkd_document64(p, res);
+
+    return (size > INT_MAX) ? EOF : (int)size;
+}
+
+
+typedef STRING(Footnote) Footnotes;
+
+/* set up a MMIOT to render a document into without changing it.
+ * Footnotes are numbered as they're rendered, so each rendering gets
+ * its own copy of them.  The render-time flags are the caller's, or
+ * the engine's defaults if the caller doesn't give any.
+ */
+static void
+borrow(Document *doc, DWORD flags, MMIOT *f, Footnotes *footnotes)
+{
+    MMIOT *ctx = doc->ctx;
+    int i;
+
+    CREATE(*footnotes);
+    if ( S(*ctx->footnotes) ) {
+	RESERVE(*footnotes, S(*ctx->footnotes));
+	memcpy(T(*footnotes), T(*ctx->footnotes), S(*ctx->footnotes) * sizeof T(*footnotes)[0]);
+	S(*footnotes) = S(*ctx->footnotes);
+	for ( i=0; i < S(*footnotes); i++ ) {
+	    T(*footnotes)[i].flags &= ~REFERENCED;
+	    T(*footnotes)[i].refnumber = 0;
+	}
+    }
+
+    ___mkd_initmmiot(f, footnotes);
+    if ( !flags )
+	flags = ctx->engine->flags;
+    f->flags = (ctx->flags & COMPILE_MASK) | (flags & USER_FLAGS & ~COMPILE_MASK);
+    f->ref_prefix = ctx->ref_prefix;
+    f->cb = ctx->cb;
+    f->engine = ctx->engine;
+    f->rng = f->engine->seed;
+}
+
+
+/* hand what was rendered with borrow() to the caller, and clean up
+ */
+static int
+handback(MMIOT *f, Footnotes *footnotes, char **res)
+{
+    ptrdiff_t size = S(f->out);
+
+    if ( size <= INT_MAX ) {
+	EXPAND(f->out) = 0;
+	*res = T(f->out);
+	CREATE(f->out);
+    }
+    ___mkd_freemmiot(f, footnotes);
+    DELETE(*footnotes);
+
+    return *res ? (int)size : EOF;
+}
+
+
+/* render a compiled document without changing it, so the same
+ * document can be rendered by any number of threads at once, each
+ * with its own output flags.   The flags that change how a document
+ * is compiled are the ones it was compiled with.   The html is
+ * malloc()ed, and belongs to the caller.   Returns its size, or EOF
+ * if the document isn't compiled.
+ */
+int
+mkd_render(Document *doc, DWORD flags, char **res)
+{
+    MMIOT f;
+    Footnotes footnotes;
+    Cursor c;
+
+    *res = 0;
+    if ( !(doc && doc->compiled) )
+	return EOF;
+
+    borrow(doc, flags, &f, &footnotes);
+
+    memset(&c, 0, sizeof c);
+    c.top = doc->code;
+    while ( render_piece(&f, &c) )
+	;
+
+    return handback(&f, &footnotes, res);
+}
+
+
+/* render just the top-level blocks [first, last) of a compiled
+ * document (or everything from first on, if last < 0), the way
+ * mkd_render() would, for showing one page of a big document at a
+ * time.   The blocks before the range aren't rendered unless they
+ * might use a [^footnote], so the footnotes in the range get the
+ * numbers they'd have in the whole document; the range ends with a
+ * list of just its own footnotes.   Returns the size of the html, or
+ * EOF if the document isn't compiled.
+ */
+int
+mkd_render_range(Document *doc, int first, int last, DWORD flags, char **res)
+{
+    MMIOT f;
+    Footnotes footnotes;
+    Cursor c;
+    Paragraph *p;
+    long size = 0;
+    int i, look, numbered;
+
+    *res = 0;
+    if ( !(doc && doc->compiled) || (first < 0) )
+	return EOF;
+
+    borrow(doc, flags, &f, &footnotes);
+    look = (f.flags & MKD_EXTRA_FOOTNOTE) && S(footnotes);
+
+    memset(&c, 0, sizeof c);
+    c.top = doc->code;
+    for ( i=0; (i < first) && (p = next_block(&c)); i++ )
+	if ( look && footnoted(p, 1, &size) ) {
+	    f.block = i;
+	    ___mkd_display(p, 1, &f);
+	    S(f.out) = 0;
+	}
+    numbered = f.reference;
+
+    for ( ; ((last < 0) || (i < last)) && (p = next_block(&c)); i++ ) {
+	f.block = i;
+	___mkd_display(p, (i == first), &f);
+    }
+    if ( f.flags & MKD_EXTRA_FOOTNOTE )
+	footnotelist(&f, numbered+1);
+
+    return handback(&f, &footnotes, res);
+}
+
+
+/* find the top-level blocks that make up the section a header starts:
+ * the header, and everything up to the next header that's at the same
+ * level or above it (or the end of the document.)  Returns 0, or EOF
+ * if there's no header with that anchor that's a block of its own.
+ */
+int
+mkd_section(Document *doc, char *anchor, int *first, int *last)
+{
+    Cursor c;
+    Paragraph *p;
+    int i, level = 0;
+
+    *first = *last = EOF;
+    if ( !(doc && doc->compiled && anchor) )
+	return EOF;
+
+    memset(&c, 0, sizeof c);
+    c.top = doc->code;
+    for ( i=0; (p = next_block(&c)); i++ ) {
+	if ( p->typ != HDR )
+	    continue;
+	if ( *first == EOF ) {
+	    if ( p->anchor && (strcmp(p->anchor, anchor) == 0) ) {
+		*first = i;
+		level = p->hnumber;
+	    }
+	}
+	else if ( p->hnumber <= level ) {
+	    *last = i;
+	    return 0;
+	}
+    }
+    if ( *first == EOF )
+	return EOF;
+    *last = i;
+    return 0;
+}
+
+
+/* finish off the section that's being split out of a document: give
+ * it a list of the footnotes that were first used in it, and move the
+ * html into it.   Returns 0 if the html is too big to hand back.
+ */
+static int
+cut(MMIOT *f, int numbered, Split *s, int last)
+{
+    ptrdiff_t size;
+
+    if ( f->flags & MKD_EXTRA_FOOTNOTE )
+	footnotelist(f, numbered+1);
+
+    s->last = last;
+    if ( (size = S(f->out)) > INT_MAX )
+	return 0;
+    EXPAND(f->out) = 0;
+    s->html = T(f->out);
+    s->htmlsize = size;
+    CREATE(f->out);
+    return 1;
+}
+
+
+/* render a compiled document as a piece of html for each section that
+ * starts with a top-level header at `level` or above (and one for
+ * anything in front of the first of them), in one pass and without
+ * changing the document.   The sections all use the same link
+ * definitions, and footnotes are numbered straight through the
+ * document.   Returns how many sections there are, in *res (which is
+ * freed with mkd_free_split()), or EOF.
+ */
+int
+mkd_split(Document *doc, int level, DWORD flags, Split **res)
+{
+    MMIOT f;
+    Footnotes footnotes;
+    STRING(Split) pieces;
+    Split *s = 0;
+    Cursor c;
+    Paragraph *p;
+    int i, numbered = 0, ok = 1;
+
+    *res = 0;
+    if ( !(doc && doc->compiled) || (level < 1) )
+	return EOF;
+
+    borrow(doc, flags, &f, &footnotes);
+    CREATE(pieces);
+
+    memset(&c, 0, sizeof c);
+    c.top = doc->code;
+    for ( i=0; ok && (p = next_block(&c)); i++ ) {
+	if ( !s || ((p->typ == HDR) && (p->hnumber <= level)) ) {
+	    if ( s )
+		ok = cut(&f, numbered, s, i);
+	    numbered = f.reference;
+
+	    s = &EXPAND(pieces);
+	    memset(s, 0, sizeof *s);
+	    s->first = i;
+	    if ( (p->typ == HDR) && (p->hnumber <= level) )
+		___mkd_header(p, 1, &s->header);
+	}
+	___mkd_display(p, (i == s->first), &f);
+    }
+    if ( ok && s )
+	ok = cut(&f, numbered, s, i);
+
+    ___mkd_freemmiot(&f, &footnotes);
+    DELETE(footnotes);
+
+    if ( !ok ) {
+	mkd_free_split(T(pieces), S(pieces));
+	return EOF;
+    }
+    *res = T(pieces);
+    return S(pieces);
+}
+
+
+/* free the sections made by mkd_split()
+ */
+void
+mkd_free_split(Split *split, int count)
+{
+    int i;
+
+    if ( split ) {
+	for ( i=0; i < count; i++ ) {
+	    ___mkd_freeheaders(&split[i].header, 1);
+	    if ( split[i].html )
+		free(split[i].html);
+	}
+	free(split);
+    }
+}
+
+
+/* render a document, and get its table of contents, styles, and
+ * headers along with the html (from the document's index, so the
+ * document isn't gone over again for each of them.)   The html and
+ * the pandoc header belong to the document (as with mkd_document());
+ * everything else is malloc()ed, and is freed by mkd_free_outputs().
+ * Returns the size of the html, or EOF.
+ */
+int
+mkd_outputs(Document *doc, Outputs *out)
+{
+    Cstring toc;
+    int size;
+
+    if ( !(doc && out) )
+	return EOF;
+
+    memset(out, 0, sizeof *out);
+
+    if ( (size = mkd_document(doc, &out->html)) == EOF ) {
+	out->html = 0;
+	return EOF;
+    }
+    /* mkd_document() may have put a null on the end already */
+    if ( size && (out->html[size-1] == 0) )
+	--size;
+    out->htmlsize = size;
+
+    out->nheaders = ___mkd_headers(doc, 0, &out->headers);
+
+    if ( doc->ctx->flags & MKD_TOC ) {
+	CREATE(toc);
+	___mkd_tocwrite(&toc, out->headers, out->nheaders);
+	if ( (out->tocsize = S(toc)) > 0 ) {
+	    EXPAND(toc) = 0;
+	    out->toc = T(toc);	/* (see the HACK ALERT in mkd_toc()) */
+	}
+	else
+	    DELETE(toc);
+    }
+
+    if ( (out->csssize = mkd_css(doc, &out->css)) <= 0 ) {
+	out->csssize = 0;
+	out->css = 0;
+    }
+
+    out->title = mkd_doc_title(doc);
+    out->author = mkd_doc_author(doc);
+    out->date = mkd_doc_date(doc);
+    return size;
+}
+
+
+void
+mkd_free_outputs(Outputs *out)
+{
+    if ( out ) {
+	if ( out->toc )
+	    free(out->toc);
+	if ( out->css )
+	    free(out->css);
+	if ( out->headers ) {
+	    ___mkd_freeheaders(out->headers, out->nheaders);
+	    free(out->headers);
+	}
+	memset(out, 0, sizeof *out);
+    }
+}
+
+
+/* copy up to `cap` bytes of the compiled document into `buf`,
+ * rendering only as much of the document as it takes to fill it.
+ * Returns the number of bytes copied, 0 at the end of the document,
+ * or EOF if the document isn't compiled or has already been written
+ * out by mkd_document().
+ */
+int
+mkd_render_next(Document *doc, char *buf, int cap)
+{
+    Cursor *c;
+    Cstring *out;
+    ptrdiff_t size;
+    int copied = 0;
+
+    if ( !(doc && doc->compiled) || doc->html || (cap < 0) )
+	return EOF;
+
+    c = &doc->cursor;
+    out = &doc->ctx->out;
+
+    if ( !c->started && !c->done && !c->top )
+	c->top = doc->code;
+
+    while ( copied < cap ) {
+	if ( c->pos == S(*out) ) {
+	    S(*out) = c->pos = 0;
+	    if ( !render_piece(doc->ctx, c) )
+		break;
+	    continue;
+	}
+
+	size = S(*out) - c->pos;
+	if ( size > cap - copied )
+	    size = cap - copied;
+	memcpy(buf + copied, T(*out) + c->pos, size);
+	c->pos += size;
+	copied += size;
+    }
+    return copied;
+}
+
+
+struct slot {
+    unsigned long id;
+    int i;
+} ;
+
+static int
+slotcmp(const void *lhs, const void *rhs)
+{
+    const struct slot *a = lhs, *b = rhs;
+
+    if ( a->id != b->id )
+	return (a->id < b->id) ? -1 : 1;
+    return a->i - b->i;
+}
+
+
+/* the first slot that doesn't sort before `key`
+ */
+static struct slot *
+lowerbound(struct slot *s, int count, struct slot *key)
+{
+    int lo = 0, hi = count, mid;
+
+    while ( lo < hi ) {
+	mid = (lo + hi) / 2;
+	if ( slotcmp(&s[mid], key) < 0 )
+	    lo = mid+1;
+	else
+	    hi = mid;
+    }
+    return (lo < count) ? &s[lo] : 0;
+}
+
+
+/* give blocks that have the same id as other blocks a new id made by
+ * `how`; returns the number of blocks that still have the same id.
+ */
+static int
+uniquely(Mark *m, int count, struct slot *sorted, unsigned long *raw,
+	 void (*how)(Mark*,int,unsigned long*,int))
+{
+    int i, j, k, left = 0;
+
+    for ( i=0; i < count; i++ ) {
+	sorted[i].id = m[i].id;
+	sorted[i].i = i;
+    }
+    qsort(sorted, count, sizeof sorted[0], slotcmp);
+
+    for ( i=0; i < count; i = j ) {
+	for ( j=i+1; (j < count) && (sorted[j].id == sorted[i].id); j++ )
+	    ;
+	if ( j-i > 1 ) {
+	    for ( k=i; k < j; k++ )
+		(*how)(m, sorted[k].i, raw, k-i);
+	    left += j-i;
+	}
+    }
+    return left;
+}
+
+
+/* mix in the blocks on either side of it
+ */
+static void
+bycontext(Mark *m, int i, unsigned long *raw, int k)
+{
+    char mix[40];
+
+    sprintf(mix, "<%lx>%lx", i ? raw[i-1] : 0, raw[i+1]);
+    m[i].id = ___mkd_hash(m[i].id, mix, strlen(mix));
+}
+
+
+/* or, failing that, how many copies of it came before it
+ */
+static void
+bycount(Mark *m, int i, unsigned long *raw, int k)
+{
+    char mix[20];
+
+    if ( k ) {
+	sprintf(mix, "#%d", k);
+	m[i].id = ___mkd_hash(m[i].id, mix, strlen(mix));
+    }
+}
+
+
+/* render a document one top-level block at a time, keeping track of
+ * where each block's html is and giving it an id made from a hash of
+ * that html.   Blocks that come out the same are told apart by the
+ * blocks around them, so an edit doesn't change the ids of copies of
+ * a block elsewhere in the document.
+ */
+static void
+render_blocks(Document *p)
+{
+    MMIOT *f = p->ctx;
+    Cursor c;
+    Paragraph *b;
+    Mark *m;
+    struct slot *sorted;
+    unsigned long *raw;
+    ptrdiff_t start;
+    int i, count;
+
+    memset(&c, 0, sizeof c);
+    c.top = p->code;
+    S(p->marks) = 0;
+
+    while ( (b = next_block(&c)) ) {
+	start = S(f->out);
+	___mkd_display(b, !c.started, f);
+	if ( c.started )
+	    start += 2;		/* the \n\n between blocks */
+	c.started = 1;
+
+	m = &EXPAND(p->marks);
+	m->start = start;
+	m->size = S(f->out) - start;
+    }
+
+    if ( f->flags & MKD_EXTRA_FOOTNOTE ) {
+	start = S(f->out);
+	___mkd_extra_footnotes(f);
+	if ( S(f->out) > start ) {
+	    m = &EXPAND(p->marks);
+	    m->start = start+1;	/* (past the \n before the <div>) */
+	    m->size = S(f->out) - m->start;
+	}
+    }
+
+    m = T(p->marks);
+    count = S(p->marks);
+
+    for ( i=0; i < count; i++ )
+	m[i].id = ___mkd_hash(FNV_BASIS, T(f->out) + m[i].start, m[i].size);
+
+    sorted = malloc((count+1) * sizeof sorted[0]);
+    raw = malloc((count+1) * sizeof raw[0]);
+
+    if ( sorted && raw ) {
+	for ( i=0; i < count; i++ )
+	    raw[i] = m[i].id;
+	raw[count] = 0;
+
+	if ( uniquely(m, count, sorted, raw, bycontext) )
+	    uniquely(m, count, sorted, raw, bycount);
+    }
+    if ( sorted ) free(sorted);
+    if ( raw ) free(raw);
+
+    p->html = p->marked = 1;
+}
+
+
+/* add a change to a patch
+ */
+static void
+patchop(Document *p, Patch *res, int *count, int op, int where,
+	unsigned long id, unsigned long old, Mark *m)
+{
+    Patch *ret = &res[(*count)++];
+
+    ret->op = op;
+    ret->where = where;
+    ret->id = id;
+    ret->old = old;
+    ret->html = 0;
+    ret->htmlsize = 0;
+
+    if ( m && (ret->html = malloc(m->size+1)) ) {
+	memcpy(ret->html, T(p->ctx->out) + m->start, m->size);
+	ret->html[m->size] = 0;
+	ret->htmlsize = m->size;
+    }
+}
+
+
+/* render a document (if it hasn't been already) as a list of the
+ * top-level blocks that have changed since `prev` (which can be the
+ * same document, after mkd_update()) was last rendered by mkd_patch():
+ * blocks that were removed, then blocks that were replaced, and blocks
+ * that were inserted, in the order they appear in the new html.
+ * Returns the number of changes, or EOF if the document isn't compiled
+ * or was already rendered some other way.
+ */
+int
+mkd_patch(Document *doc, Document *prev, Patch **res)
+{
+    unsigned long *old = 0;
+    struct slot *sorted = 0, *hit, key;
+    char *keepold = 0, *keepnew = 0;
+    Patch *ret = 0, *out = 0;
+    Mark *new;
+    int nold = 0, nnew, pre, post, last, i, j, r, n, count = 0, done = 0;
+
+    *res = 0;
+
+    if ( !(doc && doc->compiled) || doc->cursor.started || (doc->html && !doc->marked) )
+	return EOF;
+    if ( prev && (prev->magic != VALID_DOCUMENT) )
+	return EOF;
+
+    if ( prev && (nold = S(prev->marks)) ) {
+	if ( !(old = malloc(nold * sizeof old[0])) )
+	    return EOF;
+	for ( i=0; i < nold; i++ )
+	    old[i] = T(prev->marks)[i].id;
+    }
+
+    if ( !doc->html )
+	render_blocks(doc);
+
+    new = T(doc->marks);
+    nnew = S(doc->marks);
+
+    /* the blocks at the start and the end that haven't changed
+     */
+    for ( pre=0; (pre < nold) && (pre < nnew) && (old[pre] == new[pre].id); ++pre )
+	;
+    for ( post=0; (post < nold-pre) && (post < nnew-pre)
+		  && (old[nold-1-post] == new[nnew-1-post].id); ++post )
+	;
+    nold -= post;
+    nnew -= post;
+
+    if ( (pre == nold) && (pre == nnew) ) {
+	if ( old ) free(old);
+	return 0;
+    }
+
+    /* and the ones in between that are still there, in the same order
+     */
+    keepold = calloc(nold+1, 1);
+    keepnew = calloc(nnew+1, 1);
+    sorted = malloc((nold-pre+1) * sizeof sorted[0]);
+    ret = malloc((nold-pre + nnew-pre) * sizeof ret[0]);
+    out = malloc((nold-pre + nnew-pre) * sizeof out[0]);
+
+    if ( keepold && keepnew && sorted && ret && out ) {
+	for ( i=pre; i < nold; i++ ) {
+	    sorted[i-pre].id = old[i];
+	    sorted[i-pre].i = i;
+	}
+	qsort(sorted, nold-pre, sizeof sorted[0], slotcmp);
+
+	for ( last=pre-1, j=pre; j < nnew; j++ ) {
+	    key.id = new[j].id;
+	    key.i = last+1;
+	    hit = lowerbound(sorted, nold-pre, &key);
+	    if ( hit && (hit->id == key.id) ) {
+		keepold[hit->i] = keepnew[j] = 1;
+		last = hit->i;
+	    }
+	}
+
+	/* whatever's between two blocks that stayed put was removed,
+	 * replaced, or inserted.
+	 */
+	for ( i=j=pre; (i < nold) || (j < nnew); i++, j++ ) {
+	    for ( r=i; (r < nold) && !keepold[r]; r++ )
+		;
+	    for ( n=j; (n < nnew) && !keepnew[n]; n++ )
+		;
+	    for ( ; (i < r) && (j < n); i++, j++ )
+		patchop(doc, ret, &count, MKD_PATCH_REPLACE, j, new[j].id, old[i], &new[j]);
+	    for ( ; i < r; i++ )
+		patchop(doc, ret, &count, MKD_PATCH_REMOVE, i, old[i], 0, 0);
+	    for ( ; j < n; j++ )
+		patchop(doc, ret, &count, MKD_PATCH_INSERT, j, new[j].id, 0, &new[j]);
+	}
+
+	/* removals go first */
+	for ( i=0; i < count; i++ )
+	    if ( ret[i].op == MKD_PATCH_REMOVE )
+		out[done++] = ret[i];
+	for ( i=0; i < count; i++ )
+	    if ( ret[i].op != MKD_PATCH_REMOVE )
+		out[done++] = ret[i];
+	*res = out;
+	out = 0;
+    }
+    else
+	count = EOF;
+
+    if ( old ) free(old);
+    if ( keepold ) free(keepold);
+    if ( keepnew ) free(keepnew);
+    if ( sorted ) free(sorted);
+    if ( ret ) free(ret);
+    if ( out ) free(out);
+    return count;
+}
+
+
+/* free a patch made by mkd_patch()
+ */
+void
+mkd_free_patch(Patch *patch, int count)
+{
+    int i;
+
+    if ( patch ) {
+	for ( i=0; i < count; i++ )
+	    if ( patch[i].html )
+		free(patch[i].html);
+	free(patch);
+    }
+}
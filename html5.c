@@ -1,22 +1,33 @@
 /* block-level tags for passing html5 blocks through the blender
  */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cstring.h"
+#include "markdown.h"
 #include "tags.h"
 
-void
-mkd_with_html5_tags()
+/* add the html5 block tags to an engine
+ */
+int
+mkd_engine_html5_tags(Engine *e)
 {
-    static int populated = 0;
+    static char *html5[] = { "ASIDE", "FOOTER", "HEADER", "HGROUP",
+			     "NAV", "SECTION", "ARTICLE" };
+    int i;
 
-    if ( populated ) return;
-    populated = 1;
+    for ( i=0; i < sizeof html5 / sizeof html5[0]; i++ )
+	if ( mkd_engine_define_tag(e, html5[i], 0) < 0 )
+	    return -1;
+    return 0;
+}
 
-    mkd_define_tag("ASIDE", 0);
-    mkd_define_tag("FOOTER", 0);
-    mkd_define_tag("HEADER", 0);
-    mkd_define_tag("HGROUP", 0);
-    mkd_define_tag("NAV", 0);
-    mkd_define_tag("SECTION", 0);
-    mkd_define_tag("ARTICLE", 0);
 
-    mkd_sort_tags();
+void
+mkd_with_html5_tags()
+{
+    mkd_engine_html5_tags(&___mkd_default_engine);
 }
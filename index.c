@@ -0,0 +1,231 @@
+/* markdown: a C implementation of John Gruber's Markdown markup language.
+ *
+ * Copyright (C) 2007 David L Parsons.
+ * The redistribution terms are provided in the COPYRIGHT file that must
+ * be distributed with this source code.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "cstring.h"
+#include "markdown.h"
+#include "amalloc.h"
+
+/* pick out the paragraphs that a document's styles and table of
+ * contents come from when it's compiled, so mkd_css(), mkd_toc(), and
+ * mkd_outputs() only have to look at them and not at the whole
+ * document.   (The link and footnote definitions already have an
+ * index of their own; they're the footnotes table.)
+ */
+
+struct indexer {
+    Index *idx;
+    Anchors anchors;
+    Cstring bfr;
+    int anchor;			/* give the headers their anchors, too */
+} ;
+
+
+/* `top` is set for the paragraphs that are rendered as blocks of
+ * their own (see next_block() in generate.c), because those are the
+ * headers that go in the table of contents
+ */
+static void
+walk(Paragraph *p, Paragraph *last, int top, struct indexer *x)
+{
+    for ( ; p; p = (p == last) ? 0 : p->next ) {
+	if ( p->typ == STYLE )
+	    EXPAND(x->idx->styles) = p;
+	else if ( p->typ == HDR ) {
+	    if ( x->anchor )
+		___mkd_anchor(p, &x->anchors, &x->bfr);
+	    EXPAND(x->idx->headers) = p;
+	    if ( top )
+		EXPAND(x->idx->toc) = p;
+	}
+	if ( p->down )
+	    walk(p->down, 0, top && (p->typ == SOURCE), x);
+    }
+}
+
+
+/* build the index for a compiled document, and give its headers their
+ * anchors unless they already have them (a document that
+ * mkd_load_compiled() made does, and they can't be changed because
+ * they're in its image)
+ */
+void
+___mkd_index(Document *doc, int anchors)
+{
+    struct indexer x;
+
+    memset(&x, 0, sizeof x);
+    x.idx = &doc->index;
+    x.anchor = anchors;
+
+    S(doc->index.styles) = 0;
+    S(doc->index.headers) = 0;
+    S(doc->index.toc) = 0;
+
+    if ( anchors )
+	CREATE(x.bfr);
+    walk(doc->code, 0, 1, &x);
+    if ( anchors ) {
+	DELETE(x.bfr);
+	___mkd_free_anchors(&x.anchors);
+    }
+}
+
+
+/* where the entries for the paragraphs of chunk `from` of an editable
+ * document are in its index
+ */
+static void
+position(Document *doc, int from, int *styles, int *headers, int *toc)
+{
+    Chunk *c = T(doc->chunks);
+    int i;
+
+    *styles = *headers = *toc = 0;
+    for ( i=0; i < from; i++ ) {
+	*styles += c[i].styles;
+	*headers += c[i].headers;
+	*toc += c[i].toc;
+    }
+}
+
+
+static void
+cut(Paragraphs *list, int at, int count)
+{
+    memmove(T(*list)+at, T(*list)+at+count, (S(*list)-at-count) * sizeof T(*list)[0]);
+    S(*list) -= count;
+}
+
+
+static void
+paste(Paragraphs *list, int at, Paragraphs *more)
+{
+    RESERVE(*list, S(*more));
+    memmove(T(*list)+at+S(*more), T(*list)+at, (S(*list)-at) * sizeof T(*list)[0]);
+    memcpy(T(*list)+at, T(*more), S(*more) * sizeof T(*list)[0]);
+    S(*list) += S(*more);
+}
+
+
+/* take chunks [from, to) of an editable document out of its index
+ * before mkd_update() throws them away, and keep what their headers
+ * were called (and the anchors they were given) in `was`
+ */
+void
+___mkd_unindex(Document *doc, int from, int to, Slugs *was)
+{
+    Chunk *c = T(doc->chunks);
+    int styles, headers, toc, i, nstyles = 0, nheaders = 0, ntoc = 0;
+    Paragraph *p;
+    Cstring bfr;
+
+    position(doc, from, &styles, &headers, &toc);
+    for ( i=from; i < to; i++ ) {
+	nstyles += c[i].styles;
+	nheaders += c[i].headers;
+	ntoc += c[i].toc;
+    }
+
+    CREATE(bfr);
+    for ( i=0; i < nheaders; i++ ) {
+	p = T(doc->index.headers)[headers+i];
+	S(bfr) = 0;
+	___mkd_slug(p, &bfr);
+	EXPAND(bfr) = 0;
+	EXPAND(*was).slug = strdup(T(bfr));
+	T(*was)[S(*was)-1].anchor = p->anchor;
+	p->anchor = 0;
+    }
+    DELETE(bfr);
+
+    cut(&doc->index.styles, styles, nstyles);
+    cut(&doc->index.headers, headers, nheaders);
+    cut(&doc->index.toc, toc, ntoc);
+}
+
+
+/* put chunks [from, to) of an editable document into its index.  If
+ * they're replacing chunks that ___mkd_unindex() took out, and their
+ * headers are called what the old ones were, they can have the old
+ * anchors; if not, all the headers in the document have to be given
+ * their anchors again.
+ */
+void
+___mkd_reindex(Document *doc, int from, int to, Slugs *was)
+{
+    Chunk *c = T(doc->chunks);
+    struct indexer x;
+    Index more;
+    int styles, headers, toc, i, same;
+    Cstring bfr;
+
+    memset(&x, 0, sizeof x);
+    memset(&more, 0, sizeof more);
+    x.idx = &more;
+    for ( i=from; i < to; i++ ) {
+	c[i].styles = S(more.styles);
+	c[i].headers = S(more.headers);
+	c[i].toc = S(more.toc);
+	if ( c[i].code )
+	    walk(c[i].code, c[i].last, 1, &x);
+	c[i].styles = S(more.styles) - c[i].styles;
+	c[i].headers = S(more.headers) - c[i].headers;
+	c[i].toc = S(more.toc) - c[i].toc;
+    }
+
+    position(doc, from, &styles, &headers, &toc);
+    paste(&doc->index.styles, styles, &more.styles);
+    paste(&doc->index.headers, headers, &more.headers);
+    paste(&doc->index.toc, toc, &more.toc);
+
+    CREATE(bfr);
+    same = was && (S(*was) == S(more.headers));
+    for ( i=0; same && (i < S(more.headers)); i++ ) {
+	S(bfr) = 0;
+	___mkd_slug(T(more.headers)[i], &bfr);
+	EXPAND(bfr) = 0;
+	same = (strcmp(T(bfr), T(*was)[i].slug) == 0);
+    }
+
+    if ( same )
+	for ( i=0; i < S(more.headers); i++ ) {
+	    T(more.headers)[i]->anchor = T(*was)[i].anchor;
+	    T(*was)[i].anchor = 0;
+	}
+    else {
+	for ( i=0; i < S(doc->index.headers); i++ )
+	    ___mkd_anchor(T(doc->index.headers)[i], &x.anchors, &bfr);
+	___mkd_free_anchors(&x.anchors);
+    }
+    DELETE(bfr);
+
+    if ( was ) {
+	for ( i=0; i < S(*was); i++ ) {
+	    free(T(*was)[i].slug);
+	    if ( T(*was)[i].anchor )
+		free(T(*was)[i].anchor);
+	}
+	S(*was) = 0;
+    }
+    DELETE(more.styles);
+    DELETE(more.headers);
+    DELETE(more.toc);
+}
+
+
+void
+___mkd_freeindex(Document *doc)
+{
+    DELETE(doc->index.styles);
+    DELETE(doc->index.headers);
+    DELETE(doc->index.toc);
+}
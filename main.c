@@ -73,6 +73,7 @@ main(int argc, char **argv)
     int styles = 0;
     int use_mkd_line = 0;
     int github_flavoured = 0;
+    int streaming = 0;
     char *extra_footnote_prefix = 0;
     char *urlflags = 0;
     char *text = 0;
@@ -80,6 +81,7 @@ main(int argc, char **argv)
     char *urlbase = 0;
     char *q;
     MMIOT *doc;
+    mkd_outputs_t outputs;
 
     if ( q = getenv("MARKDOWN_FLAGS") )
 	flags = strtol(q, 0, 0);
@@ -87,10 +89,12 @@ main(int argc, char **argv)
     pgm = basename(argv[0]);
     opterr = 1;
 
-    while ( (opt=getopt(argc, argv, "5b:C:df:E:F:Gno:s:St:TV")) != EOF ) {
+    while ( (opt=getopt(argc, argv, "5Bb:C:df:E:F:Gno:s:St:TV")) != EOF ) {
 	switch (opt) {
 	case '5':   with_html5 = 1;
 		    break;
+	case 'B':   streaming = 1;
+		    break;
 	case 'b':   urlbase = optarg;
 		    break;
 	case 'd':   debug = 1;
@@ -137,7 +141,7 @@ main(int argc, char **argv)
 			exit(1);
 		    }
 		    break;
-	default:    fprintf(stderr, "usage: %s [-dTV] [-b url-base]"
+	default:    fprintf(stderr, "usage: %s [-BdTV] [-b url-base]"
 				    " [-F bitmap] [-f {+-}flags]"
 				    " [-o ofile] [-s text]"
 				    " [-t text] [file]\n", pgm);
@@ -178,7 +182,10 @@ main(int argc, char **argv)
 		exit(1);
 	    }
 
-	    doc = github_flavoured ? gfm_in(stdin,flags) : mkd_in(stdin,flags);
+	    if ( streaming )
+		doc = mkd_stream_in(stdin, flags);
+	    else
+		doc = github_flavoured ? gfm_in(stdin,flags) : mkd_in(stdin,flags);
 	    if ( !doc ) {
 		perror(argc ? argv[0] : "stdin");
 		exit(1);
@@ -193,16 +200,35 @@ main(int argc, char **argv)
 	if ( extra_footnote_prefix )
 	    mkd_ref_prefix(doc, extra_footnote_prefix);
 
-	if ( debug )
+	if ( streaming && !text ) {
+	    if ( (rc = mkd_stream(doc, stdout, flags)) != 0 )
+		complain("%s: input can't be rewound", argc ? argv[0] : "stdin");
+	    mkd_cleanup(doc);
+	}
+	else if ( debug )
 	    rc = mkd_dump(doc, stdout, 0, argc ? basename(argv[0]) : "stdin");
 	else {
 	    rc = 1;
 	    if ( mkd_compile(doc, flags) ) {
 		rc = 0;
-		if ( styles )
-		    mkd_generatecss(doc, stdout);
-		if ( toc )
-		    mkd_generatetoc(doc, stdout);
+		if ( content && (styles || toc) ) {
+		    /* pick up the styles and the toc while the
+		     * document is being rendered
+		     */
+		    if ( mkd_outputs(doc, &outputs) != EOF ) {
+			if ( styles && outputs.css )
+			    fwrite(outputs.css, 1, outputs.csssize, stdout);
+			if ( toc && outputs.toc )
+			    fwrite(outputs.toc, 1, outputs.tocsize, stdout);
+			mkd_free_outputs(&outputs);
+		    }
+		}
+		else {
+		    if ( styles )
+			mkd_generatecss(doc, stdout);
+		    if ( toc )
+			mkd_generatetoc(doc, stdout);
+		}
 		if ( content )
 		    mkd_generatehtml(doc, stdout);
 		mkd_cleanup(doc);
@@ -13,6 +13,11 @@
 #include <time.h>
 #include <ctype.h>
 
+#if WITH_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
 #include "cstring.h"
 #include "markdown.h"
 #include "amalloc.h"
@@ -107,7 +112,7 @@ ___mkd_tidy(Cstring *t)
 static struct kw comment = { "!--", 3, 0 };
 
 static struct kw *
-isopentag(Line *p)
+isopentag(Line *p, Engine *e)
 {
     int i=0, len;
     char *line;
@@ -135,7 +140,7 @@ isopentag(Line *p)
 	;
 
 
-    return mkd_search_tags(T(p->text)+1, i-1);
+    return ___mkd_search_tags(e, T(p->text)+1, i-1);
 }
 
 
@@ -171,6 +176,7 @@ splitline(Line *t, int cutpoint)
 	t->next = tmp;
 
 	tmp->dle = t->dle;
+	tmp->lineno = t->lineno;
 	SUFFIX(tmp->text, T(t->text)+cutpoint, S(t->text)-cutpoint);
 	S(t->text) = cutpoint;
     }
@@ -816,7 +822,7 @@ quoteblock(Paragraph *p, DWORD flags)
 	    prefix="id";
 	    
 	if ( p->ident = malloc(4+strlen(prefix)+S(q->text)) )
-	    sprintf(p->ident, "%s=\"%.*s\"", prefix, S(q->text)-(i+2),
+	    sprintf(p->ident, "%s=\"%.*s\"", prefix, (int)(S(q->text)-(i+2)),
 						     T(q->text)+(i+1) );
 
 	___mkd_freeLine(q);
@@ -1009,6 +1015,7 @@ addfootnote(Line *p, MMIOT* f)
     CREATE(foot->link);
     CREATE(foot->title);
     foot->flags = foot->height = foot->width = 0;
+    foot->lineno = p->lineno;
 
     for (j=i=p->dle+1; T(p->text)[j] != ']'; j++)
 	EXPAND(foot->tag) = T(p->text)[j];
@@ -1116,7 +1123,7 @@ compile_document(Line *ptr, MMIOT *f)
     int eaten, unclosed;
 
     while ( ptr ) {
-	if ( !(f->flags & MKD_NOHTML) && (tag = isopentag(ptr)) ) {
+	if ( !(f->flags & MKD_NOHTML) && (tag = isopentag(ptr, f->engine)) ) {
 	    int blocktype;
 	    /* If we encounter a html/style block, compile and save all
 	     * of the cached source BEFORE processing the html/style.
@@ -1167,6 +1174,456 @@ compile_document(Line *ptr, MMIOT *f)
 }
 
 
+/*
+ * set up the backend context of a document that's about to be compiled
+ */
+void
+___mkd_prepare(Document *doc, DWORD flags)
+{
+    MMIOT *f = doc->ctx;
+    Cstring in = f->in, out = f->out;
+    Qblock Q = f->Q;
+    void *footnotes = f->footnotes;
+
+    doc->compiled = 1;
+    memset(f, 0, sizeof(MMIOT) );
+    f->ref_prefix= doc->ref_prefix;
+    f->cb        = &(doc->cb);
+    f->engine    = doc->engine;
+    f->flags     = (flags | doc->engine->flags) & USER_FLAGS;
+
+    /* a document that's been through mkd_reset() keeps its buffers
+     */
+    f->in = in;   S(f->in) = 0;
+    f->out = out; S(f->out) = 0;
+    f->Q = Q;     S(f->Q) = 0;
+    if ( footnotes )
+	f->footnotes = footnotes;
+    else {
+	f->footnotes = malloc(sizeof f->footnotes[0]);
+	CREATE(*f->footnotes);
+    }
+
+    if ( doc->engine == &___mkd_default_engine )
+	mkd_initialize();
+    f->rng = doc->engine->seed;
+}
+
+
+/*
+ * sort the footnotes so they can be looked up with bsearch()
+ */
+void
+___mkd_sortfootnotes(MMIOT *f)
+{
+    qsort(T(*f->footnotes), S(*f->footnotes),
+		        sizeof T(*f->footnotes)[0],
+			           (stfu)__mkd_footsort);
+}
+
+
+/*
+ * the streaming compiler can't hold the whole document in memory,
+ * so it cuts the input into pieces at places where compile_document()
+ * and compile() would start a new block anyway and compiles each piece
+ * by itself.  ___mkd_breakpoint() is fed the input one line at a time
+ * and says whether it's safe to cut in front of that line, which is
+ * in front of a html block, or after a blank line when we're not in a
+ * html block or a code fence and the line doesn't continue a list,
+ * quote, or definition.
+ */
+
+
+/*
+ * htmlblock(), but one line at a time; look for the end of the open
+ * html block, and if it's not there remember where we were so the
+ * search can pick up there when the next line comes in.
+ */
+static int
+htmlclosed(Breakpoint *b)
+{
+    FLO f = { b->scan, b->scanpos };
+    struct kw *tag = b->tag;
+    int depth = b->depth;
+    int c, i, closing;
+    char *end;
+
+    if ( tag == &comment ) {
+	while ( !(end = strstr(T(b->scan->text)+b->scanpos, "-->")) ) {
+	    if ( !b->scan->next )
+		return 0;
+	    b->scan = b->scan->next;
+	    b->scanpos = 0;
+	}
+	b->scanpos = 3 + (end - T(b->scan->text));
+	return 1;
+    }
+
+    if ( tag->selfclose ) {
+	b->scanpos = S(b->scan->text);
+	return 1;
+    }
+
+    while ( 1 ) {
+	/* resume from here if we run out of input */
+	b->scan = f.t;
+	b->scanpos = f.i;
+	b->depth = depth;
+
+	if ( (c = flogetc(&f)) == EOF )
+	    return 0;
+	if ( c != '<' )
+	    continue;
+
+	if ( (c = flogetc(&f)) == EOF )
+	    return 0;
+	if ( c == '!' ) {
+	    if ( (c = flogetc(&f)) == EOF )
+		return 0;
+	    if ( c != '-' )
+		continue;
+	    if ( (c = flogetc(&f)) == EOF )
+		return 0;
+	    if ( c != '-' )
+		continue;
+	    /* skip over the comment, the same way htmlblock() does */
+	    while ( 1 ) {
+		if ( (c = flogetc(&f)) == EOF )
+		    return 0;
+		if ( c != '-' )
+		    continue;
+		if ( (c = flogetc(&f)) == EOF )
+		    return 0;
+		if ( c != '-' )
+		    continue;
+		if ( (c = flogetc(&f)) == EOF )
+		    return 0;
+		if ( c == '>' )
+		    break;
+	    }
+	    continue;
+	}
+
+	if ( (closing = (c == '/')) && (c = flogetc(&f)) == EOF )
+	    return 0;
+
+	for ( i=0; i < tag->size; ) {
+	    if ( tag->id[i++] != toupper(c) )
+		break;
+	    if ( (c = flogetc(&f)) == EOF )
+		return 0;
+	}
+
+	if ( (i == tag->size) && !isalnum(c) ) {
+	    depth = depth + (closing ? -1 : 1);
+	    if ( depth == 0 ) {
+		while ( c != '>' )
+		    if ( (c = flogetc(&f)) == EOF )
+			return 0;
+		b->scan = f.t;
+		b->scanpos = f.i;
+		return 1;
+	    }
+	}
+    }
+}
+
+
+/*
+ * keep looking for the end of the html block we're in.  Whatever follows
+ * the close tag is split off into a line of its own, which might start
+ * another html block.
+ */
+static void
+trackhtml(Breakpoint *b)
+{
+    struct kw *tag;
+    Line rest;
+
+    while ( htmlclosed(b) ) {
+	b->tag = 0;
+	b->block = 1;
+
+	memset(&rest, 0, sizeof rest);
+	T(rest.text) = T(b->scan->text) + b->scanpos;
+	S(rest.text) = S(b->scan->text) - b->scanpos;
+	rest.dle = b->scan->dle;
+	if ( !(tag = isopentag(&rest, b->engine)) ) {
+	    if ( (S(rest.text) > rest.dle) && !isfootnote(&rest) )
+		b->content = 1;
+#if WITH_FENCED_CODE
+	    if ( iscodefence(&rest, 3, 0) ) {
+		b->fence = rest.count;
+		b->fencekind = rest.kind;
+		b->inside = 0;
+	    }
+#endif
+	    return;
+	}
+	b->tag = tag;
+	b->depth = 0;
+    }
+}
+
+
+/*
+ * does this (unindented) line carry on a list, quote, or definition
+ * list that started earlier on?
+ */
+static int
+continues(Line *t)
+{
+    char *s = T(t->text), *q;
+    int j;
+
+    if ( strchr(">:=", s[0]) )
+	return 1;
+    if ( strchr("*-+", s[0]) && isspace(s[1]) )
+	return 1;
+    if ( ((j = nextblank(t,0)) > 0) && (s[j-1] == '.') ) {
+	if ( j == 2 && isalpha(s[0]) )
+	    return 1;
+	/* islist() reads the number with strtoul(), so -1. is an
+	 * item too
+	 */
+	strtoul(s, &q, 10);
+	if ( isdigit(s[0]) || ((q > s) && (q == s+(j-1))) )
+	    return 1;
+    }
+    return 0;
+}
+
+
+/*
+ * feed the next line of input to the breakpoint tracker, which
+ * returns true if the input can be cut in front of that line.
+ */
+int
+___mkd_breakpoint(Breakpoint *b, Line *t)
+{
+    struct kw *tag;
+    int cut, start, underline, clip, htyp;
+
+    if ( b->tag ) {
+	trackhtml(b);
+	return 0;
+    }
+
+    if ( !(b->flags & MKD_NOHTML) && (tag = isopentag(t, b->engine)) ) {
+	/* compile_document() always compiles what came before a
+	 * html block by itself
+	 */
+	b->tag = tag;
+	b->scan = t;
+	b->scanpos = 0;
+	b->depth = 0;
+	b->fence = b->maybe = b->code = b->list = b->lastlist = b->quote = 0;
+	b->blank = b->dl = b->content = b->footnote = 0;
+	trackhtml(b);
+	return 1;
+    }
+
+    /* footnotes are pulled out of the input before anything else
+     * sees them, along with any blank lines after them and a title
+     * on the next line, so they don't change anything here.
+     */
+    if ( isfootnote(t) ) {
+	b->footnote = 1;
+	return 0;
+    }
+    if ( b->footnote ) {
+	if ( blankline(t) )
+	    return 0;
+	if ( t->dle && tgood(T(t->text)[t->dle]) ) {
+	    /* might be a title, might be text; either way it's not
+	     * safe to cut after it.
+	     */
+	    b->blank = 0;
+	    return 0;
+	}
+	b->footnote = 0;
+    }
+
+#if WITH_FENCED_CODE
+    if ( b->fence ) {
+	b->blank = 0;
+	if ( b->inside++ ) {
+	    if ( iscodefence(t, b->fence, b->fencekind) ) {
+		b->fence = 0;
+		b->block = 1;
+	    }
+	    else
+		b->block = 0;
+	    return 0;
+	}
+	if ( !iscodefence(t, b->fence, 0) )
+	    return 0;
+	/* a fence right after the opening one means it wasn't a
+	 * code block after all (see fencedcodeblock()), so they're
+	 * both just text, and this one might open a block in turn.
+	 */
+	b->fence = b->block = 0;
+	b->maybe = t->count;
+	b->maybekind = t->kind;
+	return 0;
+    }
+#endif
+
+    if ( blankline(t) ) {
+	b->blank = b->block = 1;
+	return 0;
+    }
+
+    /* a setext header underline makes the line before it the start
+     * of a header (and not a list item), and ends it
+     */
+    if ( !(t->flags & CHECKED) )
+	checkline(t);
+    underline = b->content && !b->blank && (t->kind == chk_dash || t->kind == chk_equal);
+
+#if WITH_FENCED_CODE
+    /* (and the line before it might have been a code fence)
+     */
+    if ( b->maybe && underline ) {
+	b->fence = b->maybe;
+	b->fencekind = b->maybekind;
+	b->inside = 1;
+	b->maybe = 0;
+	return 0;
+    }
+#endif
+
+    /* don't leave a piece with nothing but blank lines and footnotes
+     * in it; compile_document() would turn it into an empty block.
+     */
+    cut = b->content && b->blank && (t->dle == 0) && !continues(t);
+
+    /* the first line after an indented code block starts a block
+     * too, but indented lines in a list are part of the list.  So
+     * is anything in a list or a quote that looks like a code fence;
+     * it can't run past the end of the list item or quote, and
+     * listitem() or quoteblock() will find out what it really is.
+     */
+    start = b->block || !b->content || (b->code && (t->dle < 4));
+    if ( underline )
+	b->list = b->lastlist;
+    if ( b->list && b->blank && (t->dle < b->list) )
+	b->list = 0;
+    b->lastlist = b->list;
+    if ( b->list && (t->dle < b->list) && ishr(t) )
+	b->list = 0;
+    if ( (start || b->list) && (islist(t, &clip, b->flags, &htyp) == AL) )
+	b->list = (clip > 4) ? 4 : clip;
+    if ( b->quote && b->blank && !isquote(t) )
+	b->quote = 0;
+    if ( !b->list && isquote(t) )
+	b->quote = 1;
+    b->code = (t->dle >= 4) && (start || b->code) && !b->list;
+
+    if ( b->dl ) {
+	/* a markdown extra definition list goes on for as long as
+	 * there are more definitions, so wait for something that
+	 * can't be part of one.
+	 */
+	if ( cut && (ishdr(t, &htyp) || ishr(t)) )
+	    b->dl = 0;
+	else
+	    cut = 0;
+    }
+#if USE_EXTRA_DL
+    if ( is_extra_dd(t) )
+	b->dl = 1;
+#endif
+
+#if WITH_FENCED_CODE
+    /* a code fence only opens a code block at the start of a block
+     * (and the start of the input is one of those), but if there's
+     * a setext underline on the next line this was the start of one
+     * after all.
+     */
+    b->maybe = 0;
+    if ( !(b->list || b->quote) && iscodefence(t, 3, 0) ) {
+	if ( start ) {
+	    b->fence = t->count;
+	    b->fencekind = t->kind;
+	    b->inside = 0;
+	}
+	else {
+	    b->maybe = t->count;
+	    b->maybekind = t->kind;
+	}
+    }
+#endif
+
+    b->block = ((t->dle == 0) && (S(t->text) > 1) && (T(t->text)[0] == '#'))
+	    || ishr(t) || underline;
+    b->content = 1;
+    b->blank = 0;
+    return cut;
+}
+
+
+/*
+ * the first pass of the streaming compiler; pull the footnotes out
+ * of a piece of the document and throw the rest of it away.
+ */
+void
+___mkd_footnotes(Line *ptr, MMIOT *f)
+{
+    Paragraph p;
+    struct kw *tag;
+    Line *next;
+    int unclosed;
+
+    while ( ptr ) {
+	if ( !(f->flags & MKD_NOHTML) && (tag = isopentag(ptr, f->engine)) ) {
+	    memset(&p, 0, sizeof p);
+	    p.text = ptr;
+	    ptr = htmlblock(&p, tag, &unclosed);
+	    ___mkd_freeLines(p.text);
+	}
+	else if ( isfootnote(ptr) )
+	    ptr = addfootnote(ptr, f);
+	else {
+	    next = ptr->next;
+	    ___mkd_freeLine(ptr);
+	    ptr = next;
+	}
+    }
+}
+
+
+/*
+ * the second pass of the streaming compiler; compile a piece of the
+ * document.  The footnotes were all collected in the first pass, so
+ * the ones in here are compiled into a scratch context and discarded.
+ */
+Paragraph *
+___mkd_compile_chunk(Line *ptr, MMIOT *f)
+{
+    MMIOT scratch;
+    Paragraph *ret;
+
+    ___mkd_initmmiot(&scratch, 0);
+    scratch.flags = f->flags;
+    scratch.engine = f->engine;
+    ret = compile_document(ptr, &scratch);
+    ___mkd_freemmiot(&scratch, 0);
+    return ret;
+}
+
+
+/*
+ * compile a piece of a document that's being edited, keeping the
+ * footnotes it defines in f.
+ */
+Paragraph *
+___mkd_compile_piece(Line *ptr, MMIOT *f)
+{
+    return compile_document(ptr, f);
+}
+
+
 static int
 first_nonblank_before(Line *j, int dle)
 {
@@ -1307,6 +1764,197 @@ compile(Line *ptr, int toplevel, MMIOT *f)
  * debugging.
  */
 
+#if WITH_THREADS
+/*
+ * compiling a big document on more than one thread:  the input is
+ * cut up wherever the streaming compiler could cut it, and each piece
+ * is compiled (into its own context, so it gets its own footnotes)
+ * by whichever thread gets to it first.   Then the pieces and their
+ * footnotes are put back together in order.
+ */
+#define PIECE_SIZE	262144
+
+struct piece {
+    Line *text;
+    Paragraph *code;
+    int html;			/* starts with a html block */
+    MMIOT ctx;
+} ;
+
+struct pieces {
+    struct piece *p;
+    int count;
+    int next;
+    pthread_mutex_t lock;
+} ;
+
+
+static void *
+compile_pieces(void *arg)
+{
+    struct pieces *w = arg;
+    int i;
+
+    while ( 1 ) {
+	pthread_mutex_lock(&w->lock);
+	i = (w->next < w->count) ? w->next++ : EOF;
+	pthread_mutex_unlock(&w->lock);
+
+	if ( i == EOF )
+	    return 0;
+	w->p[i].code = compile_document(w->p[i].text, &w->p[i].ctx);
+    }
+}
+
+
+/*
+ * hang a piece of the document off the end of the ones before it, with
+ * the source at the seam joined back into one SOURCE block (unless
+ * the piece starts with a html block that wasn't closed, which
+ * compile_document() would have made into a SOURCE block of its own.)
+ * `tail` is the last paragraph inside the SOURCE block at the end, so
+ * the pieces don't have to be walked over again every time.
+ */
+static void
+stitch(ParagraphRoot *d, Paragraph **tail, Paragraph *p, int html)
+{
+    if ( !p )
+	return;
+
+    if ( E(*d) && (E(*d)->typ == SOURCE) && (p->typ == SOURCE) && !html ) {
+	if ( *tail )
+	    (*tail)->next = p->down;
+	else
+	    E(*d)->down = p->down;
+	E(*d)->next = p->next;
+	p->down = p->next = 0;
+	___mkd_freeParagraph(p);
+    }
+    else {
+	if ( E(*d) )
+	    E(*d)->next = p;
+	else
+	    T(*d) = p;
+	E(*d) = p;
+	*tail = 0;
+    }
+
+    while ( E(*d)->next ) {
+	E(*d) = E(*d)->next;
+	*tail = 0;
+    }
+
+    if ( E(*d)->typ == SOURCE ) {
+	if ( !*tail )
+	    *tail = E(*d)->down;
+	if ( *tail )
+	    while ( (*tail)->next )
+		*tail = (*tail)->next;
+    }
+}
+
+
+static Paragraph *
+compile_parallel(Line *ptr, MMIOT *f)
+{
+    STRING(struct piece) pieces;
+    struct pieces w;
+    ParagraphRoot d = { 0, 0 };
+    Paragraph *tail = 0;
+    Breakpoint bp;
+    Line *t, *next, *prev = 0;
+    pthread_t *tid = 0;
+    long size = 0;
+    int i, j, cut, nthreads = 0, started = 0;
+
+    /* a document that can't be more than one piece is just compiled
+     * (only counting as far as it takes to find out)
+     */
+    for ( t = ptr; t && (size <= PIECE_SIZE); t = t->next )
+	size += S(t->text) + 1;
+    if ( size <= PIECE_SIZE )
+	return compile_document(ptr, f);
+    size = 0;
+
+    if ( (nthreads = ___mkd_nthreads()) < 2 )
+	return compile_document(ptr, f);
+
+    CREATE(pieces);
+    memset(&EXPAND(pieces), 0, sizeof T(pieces)[0]);
+    T(pieces)[0].text = ptr;
+
+    memset(&bp, 0, sizeof bp);
+    bp.flags = f->flags;
+    bp.engine = f->engine;
+
+    for ( t = ptr; t; prev = t, t = next ) {
+	/* the breakpoint tracker is written to see one line at a time,
+	 * so don't let it look any further ahead than this one.
+	 */
+	next = t->next;
+	t->next = 0;
+	cut = ___mkd_breakpoint(&bp, t);
+	t->next = next;
+
+	if ( cut && prev && (size >= PIECE_SIZE) ) {
+	    prev->next = 0;
+	    memset(&EXPAND(pieces), 0, sizeof T(pieces)[0]);
+	    T(pieces)[S(pieces)-1].text = t;
+	    T(pieces)[S(pieces)-1].html = !(f->flags & MKD_NOHTML)
+				       && isopentag(t, f->engine);
+	    size = 0;
+	}
+	size += S(t->text) + 1;
+    }
+
+    if ( S(pieces) == 1 ) {
+	DELETE(pieces);
+	return compile_document(ptr, f);
+    }
+
+    for ( i=0; i < S(pieces); i++ ) {
+	___mkd_initmmiot(&T(pieces)[i].ctx, 0);
+	T(pieces)[i].ctx.flags = f->flags;
+	T(pieces)[i].ctx.engine = f->engine;
+    }
+
+    w.p = T(pieces);
+    w.count = S(pieces);
+    w.next = 0;
+    pthread_mutex_init(&w.lock, 0);
+
+    if ( nthreads > w.count )
+	nthreads = w.count;
+    if ( (tid = malloc((nthreads-1) * sizeof tid[0])) )
+	while ( started < nthreads-1 ) {
+	    if ( pthread_create(&tid[started], 0, compile_pieces, &w) != 0 )
+		break;
+	    started++;
+	}
+    compile_pieces(&w);
+    for ( i=0; i < started; i++ )
+	pthread_join(tid[i], 0);
+    if ( tid ) free(tid);
+    pthread_mutex_destroy(&w.lock);
+
+    /* put the pieces back together, with the footnotes in the same
+     * order compile_document() would have found them in
+     */
+    for ( i=0; i < S(pieces); i++ ) {
+	MMIOT *ctx = &T(pieces)[i].ctx;
+
+	stitch(&d, &tail, T(pieces)[i].code, T(pieces)[i].html);
+	for ( j=0; j < S(*ctx->footnotes); j++ )
+	    EXPAND(*f->footnotes) = T(*ctx->footnotes)[j];
+	S(*ctx->footnotes) = 0;
+	___mkd_freemmiot(ctx, 0);
+    }
+    DELETE(pieces);
+    return T(d);
+}
+#endif
+
+
 /*
  * prepare and compile `text`, returning a Paragraph tree.
  */
@@ -1319,21 +1967,18 @@ mkd_compile(Document *doc, DWORD flags)
     if ( doc->compiled )
 	return 1;
 
-    doc->compiled = 1;
-    memset(doc->ctx, 0, sizeof(MMIOT) );
-    doc->ctx->ref_prefix= doc->ref_prefix;
-    doc->ctx->cb        = &(doc->cb);
-    doc->ctx->flags     = flags & USER_FLAGS;
-    CREATE(doc->ctx->in);
-    doc->ctx->footnotes = malloc(sizeof doc->ctx->footnotes[0]);
-    CREATE(*doc->ctx->footnotes);
+    ___mkd_prepare(doc, flags);
 
-    mkd_initialize();
+    if ( doc->editable )
+	return ___mkd_compile_edit(doc);
 
+#if WITH_THREADS
+    doc->code = compile_parallel(T(doc->content), doc->ctx);
+#else
     doc->code = compile_document(T(doc->content), doc->ctx);
-    qsort(T(*doc->ctx->footnotes), S(*doc->ctx->footnotes),
-		        sizeof T(*doc->ctx->footnotes)[0],
-			           (stfu)__mkd_footsort);
+#endif
+    ___mkd_sortfootnotes(doc->ctx);
+    ___mkd_index(doc, 1);
     memset(&doc->content, 0, sizeof doc->content);
     return 1;
 }
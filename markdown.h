@@ -13,6 +13,7 @@ typedef struct footnote {
     int height, width;		/* dimensions (for image link) */
     int dealloc;		/* deallocation needed? */
     int refnumber;
+    int lineno;			/* the line it was defined on */
     int flags;
 #define EXTRA_BOOKMARK	0x01
 #define REFERENCED	0x02
@@ -37,6 +38,7 @@ typedef struct line {
 
     line_type kind;
     int count;
+    int lineno;			/* which line of the input it is */
 } Line;
 
 
@@ -55,6 +57,7 @@ typedef struct paragraph {
 	   HDR, HR, TABLE, SOURCE } typ;
     enum { IMPLICIT=0, PARA, CENTER} align;
     int hnumber;		/* <Hn> for typ == HDR */
+    char *anchor;		/* and the anchor it gets in the html */
 } Paragraph;
 
 enum { ETX, SETEXT };	/* header types */
@@ -88,6 +91,60 @@ struct escaped {
 } ;
 
 
+/* user-defined delimiters for text that's passed through without
+ * being interpreted (see rawarg())
+ */
+#define RAW_MAX 128
+
+struct rawdef {
+    /*const*/ char *begin, *end;	/* Delimiting input mark-up */
+    /*const*/ char *otag, *etag;	/* Delimiting output mark-up */
+} ;
+
+
+/* an engine holds the configuration that used to be global -- extra
+ * html block tags, raw delimiters, the seed for mangling email
+ * addresses, and default flags.   Once it's frozen it's only read
+ * from, so documents on different threads can share it.
+ */
+typedef struct engine {
+    int magic;			/* "I AM VALID" magic number */
+#define VALID_ENGINE		0x19671025
+    int frozen;			/* no more changes allowed */
+    STRING(struct kw) extratags;/* html block tags beyond the standard ones */
+    struct rawdef raw[RAW_MAX];	/* raw delimiters, sorted descending */
+    char rawchr0[RAW_MAX+1];	/* initial char of each raw[].begin */
+    size_t rawnum;
+    unsigned long seed;		/* for mangling email addresses */
+    DWORD flags;		/* added to every document's flags */
+    struct cache *cache;	/* rendered blocks, for all its documents */
+} Engine;
+
+extern Engine ___mkd_default_engine;
+
+
+/* what a block looked at while it was being rendered, so the block
+ * cache can tell if it would come out the same in another document
+ */
+typedef struct reflog {
+    Cstring refs;		/* the references it looked up, and what they were */
+    int uncacheable;		/* it numbered a footnote or mangled an address */
+} Reflog;
+
+
+/* a header, and the anchor it was given when the document was
+ * compiled
+ */
+typedef struct mkd_header {
+    int hnumber;
+    int top;			/* it's a top-level header (which go in the toc) */
+    char *text;			/* what it says, without the markup */
+    int textsize;
+    char *anchor;
+    int anchorsize;
+} Header;
+
+
 /* a magic markdown io thing holds all the data structures needed to
  * do the backend processing of a markdown document
  */
@@ -95,7 +152,7 @@ typedef struct mmiot {
     Cstring out;
     Cstring in;
     Qblock Q;
-    int isp;
+    ptrdiff_t isp;
     int reference;
     struct escaped *esc;
     char *ref_prefix;
@@ -152,10 +209,74 @@ typedef struct mmiot {
 
 #define INPUT_MASK		(MKD_NOHEADER|MKD_TABSTOP)
 
+/* the flags that change how a document is compiled, which mkd_render()
+ * can't change
+ */
+#define COMPILE_MASK		(INPUT_MASK|MKD_NOHTML|MKD_STRICT|MKD_NOTABLES\
+				|MKD_NODIVQUOTE|MKD_NOALPHALIST|MKD_NODLIST\
+				|MKD_EXTRA_FOOTNOTE|MKD_NOSTYLE|MKD_1_COMPAT)
+
     Callback_data *cb;
+    Engine *engine;
+    unsigned long rng;		/* for mangling email addresses */
+    int block;			/* the top-level block being rendered */
+    Reflog *log;		/* (while it's being put in the block cache) */
 } MMIOT;
 
 
+/*
+ * where mkd_render_next() left off in the document
+ */
+typedef struct cursor {
+    Paragraph *top;		/* the next top-level paragraph */
+    Paragraph *down;		/* the next paragraph inside a SOURCE block */
+    ptrdiff_t pos;		/* how much of ctx->out has been handed out */
+    int started;
+    int done;
+} Cursor;
+
+
+/*
+ * a top-level block of the html that mkd_patch() rendered
+ */
+typedef struct mark {
+    unsigned long id;		/* hash of its html */
+    ptrdiff_t start;		/* where it is in ctx->out */
+    ptrdiff_t size;
+} Mark;
+
+
+/*
+ * a piece of a document that's being edited with mkd_update().  The
+ * source is cut where ___mkd_breakpoint() says it's safe to cut it,
+ * so each piece can be compiled again by itself after an edit.
+ */
+typedef struct chunk {
+    ptrdiff_t start;		/* where it is in the source */
+    ptrdiff_t size;
+    int line;			/* the line it starts on */
+    int numbered;		/* and the one its lines are numbered from */
+    Paragraph *code;		/* what it compiled into */
+    Paragraph *last;
+    STRING(Footnote) footnotes;	/* the footnotes defined in it */
+    int styles;			/* how many entries it has in the index */
+    int headers;
+    int toc;
+} Chunk;
+
+
+/* the paragraphs a document's styles and table of contents come from,
+ * picked out when it's compiled
+ */
+typedef STRING(Paragraph*) Paragraphs;
+
+typedef struct index {
+    Paragraphs styles;		/* the STYLE blocks, in order */
+    Paragraphs headers;		/* the HDRs, in order */
+    Paragraphs toc;		/* and the ones that go in the toc */
+} Index;
+
+
 /*
  * the mkdio text input functions return a document structure,
  * which contains a header (retrieved from the document if
@@ -170,6 +291,7 @@ typedef struct document {
     Line *author;
     Line *date;
     ANCHOR(Line) content;	/* uncompiled text, not valid after compile() */
+    int nlines;			/* how many lines have been read into it */
     Paragraph *code;		/* intermediate code generated by compile() */
     int compiled;		/* set after mkd_compile() */
     int html;			/* set after (internal) htmlify() */
@@ -177,28 +299,234 @@ typedef struct document {
     char *ref_prefix;
     MMIOT *ctx;			/* backend buffers, flags, and structures */
     Callback_data cb;		/* callback functions & private data */
+    STRING(Cstring) segments;	/* html that's been rendered so far */
+#define SEGMENT_SIZE	65536
+    Cursor cursor;		/* for mkd_render_next() */
+    FILE *stream;		/* unread input for mkd_stream() */
+    DWORD inflags;		/* input flags for mkd_stream() */
+    Engine *engine;		/* tags, raw delimiters, and so forth */
+    int editable;		/* made by mkd_edit_string() */
+    Cstring source;		/* the markdown, for mkd_update() */
+    ptrdiff_t base;		/* where it starts after the pandoc header */
+    STRING(Chunk) chunks;	/* and how it's been cut up */
+    STRING(Mark) marks;		/* the blocks of the last mkd_patch() */
+    int marked;			/* set while they point into the html */
+    void *image;		/* what mkd_load_compiled() loaded it into */
+    struct ast *ast;		/* what mkd_ast() made out of it */
+    Index index;		/* its styles and headers (see index.c) */
 } Document;
 
 
+/*
+ * state for the streaming compiler, which needs to know where it can
+ * safely cut the input into pieces that can be compiled separately.
+ */
+typedef struct breakpoint {
+    struct kw *tag;		/* the html block we're inside, if any */
+    Line *scan;			/* and where to resume looking for its end */
+    int scanpos;
+    int depth;
+    int fence;			/* size of the open code fence, if any */
+    int fencekind;
+    int inside;			/* lines since the fence was opened */
+    int maybe;			/* the last line might have opened one */
+    int maybekind;
+    int code;			/* inside an indented code block */
+    int list;			/* inside a list (with this indent) */
+    int lastlist;		/* (and before the last line) */
+    int quote;			/* inside a blockquote */
+    int blank;			/* the last line was blank */
+    int block;			/* the next line starts a new block */
+    int dl;			/* saw a markdown extra definition */
+    int footnote;		/* the last line was (part of) a footnote */
+    int content;		/* saw something besides blank lines */
+    DWORD flags;
+    Engine *engine;
+} Breakpoint;
+
+
+/*
+ * one document in a mkd_render_batch()
+ */
+typedef struct mkd_batch {
+    const char *text;		/* the markdown source */
+    int size;
+    char *html;			/* malloc()ed html */
+    int htmlsize;		/* (EOF if it couldn't be rendered) */
+} Batch;
+
+
+/*
+ * a document that mkd_submit() has finished with
+ */
+typedef struct mkd_result {
+    int id;			/* what mkd_submit() returned */
+    void *cookie;		/* and what was passed to it */
+    char *html;			/* malloc()ed html */
+    int htmlsize;		/* (EOF if it couldn't be rendered) */
+} Result;
+
+
+/*
+ * one change in a mkd_patch()
+ */
+typedef struct mkd_patch {
+    int op;
+#define MKD_PATCH_INSERT	1
+#define MKD_PATCH_REMOVE	2
+#define MKD_PATCH_REPLACE	3
+    int where;			/* which block it is (or was) */
+    unsigned long id;		/* the block */
+    unsigned long old;		/* and the one it replaces */
+    char *html;			/* malloc()ed html */
+    int htmlsize;
+} Patch;
+
+
+/*
+ * a node in the tree mkd_ast() makes out of a document
+ */
+typedef struct mkd_node {
+    int type;
+#define MKD_NODE_CODE		1	/* blocks */
+#define MKD_NODE_QUOTE		2
+#define MKD_NODE_PARAGRAPH	3
+#define MKD_NODE_HTML		4
+#define MKD_NODE_STYLE		5
+#define MKD_NODE_DL		6
+#define MKD_NODE_UL		7
+#define MKD_NODE_OL		8
+#define MKD_NODE_AL		9
+#define MKD_NODE_ITEM		10
+#define MKD_NODE_HEADER		11
+#define MKD_NODE_HR		12
+#define MKD_NODE_TABLE		13
+#define MKD_NODE_ROW		14
+#define MKD_NODE_HEADCELL	15
+#define MKD_NODE_CELL		16
+#define MKD_NODE_TERM		17
+#define MKD_NODE_NOTES		18	/* the footnotes, after everything else */
+#define MKD_NODE_NOTE		19
+#define MKD_NODE_TEXT		20	/* and what's inside them */
+#define MKD_NODE_EM		21
+#define MKD_NODE_STRONG		22
+#define MKD_NODE_CODESPAN	23
+#define MKD_NODE_LINK		24
+#define MKD_NODE_IMAGE		25
+#define MKD_NODE_SUPERSCRIPT	26
+#define MKD_NODE_DEL		27
+#define MKD_NODE_BREAK		28
+#define MKD_NODE_TAG		29
+#define MKD_NODE_NOTEREF	30
+    struct mkd_node *next;
+    struct mkd_node *child;
+    const char *text;		/* text, code, html, the url, or a footnote label */
+    int size;			/* (which isn't null-terminated) */
+    const char *title;		/* the title of a link or image, or what a footnote says */
+    int titlesize;
+    const char *ident;		/* %id% of a quote or list item */
+    const char *lang;		/* the language of a code block */
+    int hnumber;		/* header level */
+    int align;			/* paragraph or table cell alignment */
+#define MKD_ALIGN_NONE		0
+#define MKD_ALIGN_CENTER	1
+#define MKD_ALIGN_LEFT		2
+#define MKD_ALIGN_RIGHT		3
+    int height, width;		/* of an image */
+    int number;			/* of a footnote */
+    int line;			/* the line of the source it starts on */
+} Node;
+
+typedef int (*mkd_event_t)(const Node*, int, void*);
+
+
+/*
+ * the headers and link targets mkd_outline() finds in a document
+ */
+typedef struct mkd_outline {
+    int type;
+#define MKD_OUTLINE_HEADER	1
+#define MKD_OUTLINE_LINK	2
+#define MKD_OUTLINE_IMAGE	3
+#define MKD_OUTLINE_REF		4	/* a [label]: url definition */
+    int line;			/* the line of the source it's on */
+    int hnumber;		/* header level */
+    char *text;			/* what a header says, or the url */
+    int size;
+    char *anchor;		/* what a header is called in the html */
+    char *label;		/* the label a url is defined for */
+    int labelsize;
+} Outline;
+
+
+/*
+ * everything mkd_outputs() gets out of one pass over a document
+ */
+typedef struct mkd_outputs {
+    char *html;			/* (which belongs to the document) */
+    int htmlsize;
+    char *toc;
+    int tocsize;
+    char *css;
+    int csssize;
+    Header *headers;
+    int nheaders;
+    char *title, *author, *date;/* (which belong to the document) */
+} Outputs;
+
+
+/*
+ * a section of a document that mkd_split() rendered
+ */
+typedef struct mkd_split {
+    Header header;		/* (hnumber 0 for what's in front of the first header) */
+    int first, last;		/* the top-level blocks it's made of */
+    char *html;
+    int htmlsize;
+} Split;
+
+
 /*
  * economy FILE-type structure for pulling characters out of a
  * fixed-length string.
  */
 struct string_stream {
     const char *data;	/* the unread data */
-    int   size;		/* and how much is there? */
+    size_t size;	/* and how much is there? */
 } ;
 
 
 extern int  mkd_firstnonblank(Line *);
 extern int  mkd_compile(Document *, DWORD);
 extern int  mkd_document(Document *, char **);
+extern ptrdiff_t mkd_document64(Document *, char **);
+extern int  mkd_render_next(Document *, char *, int);
+extern int  mkd_render(Document *, DWORD, char **);
+extern int  mkd_render_range(Document *, int, int, DWORD, char **);
+extern int  mkd_section(Document *, char *, int *, int *);
+extern int  mkd_outputs(Document *, Outputs *);
+extern void mkd_free_outputs(Outputs *);
+extern int  mkd_split(Document *, int, DWORD, Split **);
+extern void mkd_free_split(Split *, int);
+extern char *mkd_doc_title(Document *);
+extern char *mkd_doc_author(Document *);
+extern char *mkd_doc_date(Document *);
+extern int  mkd_patch(Document *, Document *, Patch **);
+extern void mkd_free_patch(Patch *, int);
+extern int  mkd_save_compiled(Document *, FILE *);
+extern Document *mkd_load_compiled(const void *, size_t);
+extern int  mkd_ast(Document *, Node **);
+extern int  mkd_walk(Document *, mkd_event_t, void *);
+extern int  mkd_outline(Document *, Outline **);
 extern int  mkd_generatehtml(Document *, FILE *);
 extern int  mkd_css(Document *, char **);
 extern int  mkd_generatecss(Document *, FILE *);
+extern int  mkd_plaintext(Document *, char **);
+extern int  mkd_generateplaintext(Document *, FILE *);
 #define mkd_style mkd_generatecss
 extern int  mkd_xml(char *, int , char **);
 extern int  mkd_generatexml(char *, int, FILE *);
+extern int  mkd_generatexml64(char *, ptrdiff_t, FILE *);
 extern void mkd_cleanup(Document *);
 extern int  mkd_line(char *, int, char **, DWORD);
 extern int  mkd_generateline(char *, int, FILE*, DWORD);
@@ -210,6 +538,16 @@ extern void mkd_string_to_anchor(char*,int, mkd_sta_function_t, void*, int);
 
 extern Document *mkd_in(FILE *, DWORD);
 extern Document *mkd_string(const char*,int, DWORD);
+extern Document *mkd_string64(const char*,size_t, DWORD);
+extern Document *mkd_peek_header(FILE *, DWORD);
+
+extern void mkd_reset(Document *);
+extern Document *mkd_reuse_in(Document *, FILE *, DWORD);
+extern Document *mkd_reuse_string(Document *, const char*, int, DWORD);
+extern Document *mkd_pool_in(FILE *, DWORD);
+extern Document *mkd_pool_string(const char*, int, DWORD);
+extern void mkd_pool_release(Document *);
+extern void mkd_pool_drain();
 
 extern Document *gfm_in(FILE *, DWORD);
 extern Document *gfm_string(const char*,int, DWORD);
@@ -217,8 +555,35 @@ extern Document *gfm_string(const char*,int, DWORD);
 extern void mkd_initialize();
 extern void mkd_shlib_destructor();
 
+extern Engine *mkd_engine_new(DWORD);
+extern int  mkd_engine_define_tag(Engine *, char *, int);
+extern int  mkd_engine_html5_tags(Engine *);
+extern int  mkd_engine_raw(Engine *, char *);
+extern int  mkd_engine_seed(Engine *, unsigned long);
+extern int  mkd_engine_cache(Engine *, size_t);
+extern void mkd_engine_freeze(Engine *);
+extern void mkd_engine_free(Engine *);
+extern Document *mkd_engine_in(Engine *, FILE *, DWORD);
+extern Document *mkd_engine_string(Engine *, const char*, int, DWORD);
+
+extern int  mkd_threads(int);
+extern int  ___mkd_nthreads();
+extern int  mkd_render_batch(Batch *, int, DWORD, int);
+extern void mkd_free_batch(Batch *, int);
+
+extern int  mkd_async_start(int);
+extern int  mkd_async_fd();
+extern int  mkd_submit(Engine *, const char *, int, DWORD, void *);
+extern int  mkd_cancel(int);
+extern int  mkd_poll(Result *, int);
+extern void mkd_free_result(Result *);
+extern void mkd_async_shutdown();
+
 extern void mkd_ref_prefix(Document*, char*);
 
+extern Document *mkd_stream_in(FILE *, DWORD);
+extern int  mkd_stream(Document *, FILE *, DWORD);
+
 /* internal resource handling functions.
  */
 extern void ___mkd_freeLine(Line *);
@@ -233,6 +598,69 @@ extern void ___mkd_xml(char *, int, FILE *);
 extern void ___mkd_reparse(char *, int, int, MMIOT*, char*);
 extern void ___mkd_emblock(MMIOT*);
 extern void ___mkd_tidy(Cstring *);
+#define FNV_BASIS	2166136261UL
+extern unsigned long ___mkd_hash(unsigned long, const void *, ptrdiff_t);
+
+/* internal pieces of the streaming compiler.
+ */
+extern void ___mkd_prepare(Document *, DWORD);
+extern void ___mkd_sortfootnotes(MMIOT *);
+extern int  ___mkd_breakpoint(Breakpoint *, Line *);
+extern void ___mkd_footnotes(Line *, MMIOT *);
+extern Paragraph *___mkd_compile_chunk(Line *, MMIOT *);
+extern Paragraph *___mkd_compile_piece(Line *, MMIOT *);
+extern void ___mkd_display(Paragraph *, int, MMIOT *);
+extern void ___mkd_extra_footnotes(MMIOT *);
+
+extern int  ___mkd_render(Document *);
+
+/* headers and the table of contents
+ */
+typedef struct anchors {
+    struct anchor {
+	char *name;		/* an anchor a header has been given */
+	int last;		/* and the last -N that's been put on it */
+    } *slot;
+    int nslots;
+    int count;
+} Anchors;
+
+/* what the headers in some chunks of an editable document were called,
+ * and the anchors they had
+ */
+typedef STRING(struct slug { char *slug; char *anchor; }) Slugs;
+
+extern void ___mkd_string_slug(char *, int, Cstring *);
+extern void ___mkd_slug(Paragraph *, Cstring *);
+extern void ___mkd_anchor(Paragraph *, Anchors *, Cstring *);
+extern void ___mkd_anchors(Paragraph *, Anchors *);
+extern void ___mkd_free_anchors(Anchors *);
+extern void ___mkd_index(Document *, int);
+extern void ___mkd_unindex(Document *, int, int, Slugs *);
+extern void ___mkd_reindex(Document *, int, int, Slugs *);
+extern void ___mkd_freeindex(Document *);
+extern void ___mkd_label_anchor(char *, int, mkd_sta_function_t, void *);
+extern void ___mkd_header(Paragraph *, int, Header *);
+extern int  ___mkd_headers(Document *, int, Header **);
+extern void ___mkd_freeheaders(Header *, int);
+extern void ___mkd_tocwrite(Cstring *, Header *, int);
+
+/* documents being edited with mkd_update()
+ */
+extern int  ___mkd_compile_edit(Document *);
+extern void ___mkd_renumber(Document *);
+extern void ___mkd_freechunks(Document *);
+
+/* the block cache
+ */
+extern int  ___mkd_cache_fetch(MMIOT *, Paragraph *, Cstring *);
+extern void ___mkd_cache_store(MMIOT *, Cstring *, Reflog *, ptrdiff_t);
+extern void ___mkd_cache_looked(Reflog *, Footnote *, Footnote *);
+extern void ___mkd_free_cache(Engine *);
+extern void ___mkd_free_ast(Document *);
+
+extern struct kw *___mkd_search_tags(Engine *, char *, int);
+extern void ___mkd_free_tags(Engine *);
 
 extern Document *__mkd_new_Document();
 extern void __mkd_enqueue(Document*, Cstring *);
@@ -26,6 +26,7 @@ __mkd_new_Document()
     if ( ret ) {
 	if ( ret->ctx = calloc(sizeof(MMIOT), 1) ) {
 	    ret->magic = VALID_DOCUMENT;
+	    ret->engine = &___mkd_default_engine;
 	    return ret;
 	}
 	free(ret);
@@ -48,6 +49,7 @@ __mkd_enqueue(Document* a, Cstring *line)
 
     CREATE(p->text);
     ATTACH(a->content, p);
+    p->lineno = ++a->nlines;
 
     while ( size-- ) {
         if ( (c = *str++) == '\t' ) {
@@ -87,11 +89,10 @@ __mkd_header_dle(Line *p)
  */
 typedef int (*getc_func)(void*);
 
-Document *
-populate(getc_func getc, void* ctx, int flags)
+static Document *
+fill(Document *a, getc_func getc, void* ctx, int flags)
 {
     Cstring line;
-    Document *a = __mkd_new_Document();
     int c;
     int pandoc = 0;
 
@@ -139,6 +140,13 @@ populate(getc_func getc, void* ctx, int flags)
 }
 
 
+Document *
+populate(getc_func getc, void* ctx, int flags)
+{
+    return fill(__mkd_new_Document(), getc, ctx, flags);
+}
+
+
 /* convert a file into a linked list
  */
 Document *
@@ -148,6 +156,83 @@ mkd_in(FILE *f, DWORD flags)
 }
 
 
+/* read the pandoc header at the start of a file, and nothing else
+ * (fill() only knows there's a header after it's read the whole
+ * file.)   The document that comes back has the title, author, and
+ * date that mkd_doc_title() and friends return, but no text.   The
+ * file is left just past the header if there was one, and somewhere
+ * in its first three lines if there wasn't.
+ */
+static Document *
+peek(Document *a, getc_func getc, void *ctx, int flags)
+{
+    Cstring line;
+    Line *headers;
+    int c, lines = 0;
+
+    if ( !a ) return 0;
+
+    a->tabstop = (flags & MKD_TABSTOP) ? 4 : TABSTOP;
+
+    if ( flags & (MKD_NOHEADER|MKD_STRICT) )
+	return a;
+
+    CREATE(line);
+
+    while ( (lines < 3) && (c = (*getc)(ctx)) != EOF ) {
+	if ( c == '\n' ) {
+	    if ( S(line) == 0 )
+		break;
+	    __mkd_enqueue(a, &line);
+	    S(line) = 0;
+	    lines++;
+	}
+	else if ( isprint(c) || isspace(c) || (c & 0x80) ) {
+	    /* as soon as a line doesn't start with %, there's no header */
+	    if ( (S(line) == 0) && (c != '%') )
+		break;
+	    EXPAND(line) = c;
+	}
+    }
+
+    DELETE(line);
+
+    if ( lines == 3 ) {
+	headers = T(a->content);
+
+	a->title = headers;             __mkd_header_dle(a->title);
+	a->author= headers->next;       __mkd_header_dle(a->author);
+	a->date  = headers->next->next; __mkd_header_dle(a->date);
+    }
+    else
+	___mkd_freeLines(T(a->content));
+
+    T(a->content) = E(a->content) = 0;
+    return a;
+}
+
+
+/* get the pandoc header of a file without reading the rest of it
+ */
+Document *
+mkd_peek_header(FILE *f, DWORD flags)
+{
+    return peek(__mkd_new_Document(), (getc_func)fgetc, f, flags & INPUT_MASK);
+}
+
+
+/* mkd_in(), but reusing a document that's already been used
+ */
+Document *
+mkd_reuse_in(Document *doc, FILE *f, DWORD flags)
+{
+    if ( !(doc && (doc->magic == VALID_DOCUMENT)) )
+	return 0;
+    mkd_reset(doc);
+    return fill(doc, (getc_func)fgetc, f, flags & INPUT_MASK);
+}
+
+
 /* return a single character out of a buffer
  */
 int
@@ -165,6 +250,33 @@ __mkd_io_strget(struct string_stream *in)
  */
 Document *
 mkd_string(const char *buf, int len, DWORD flags)
+{
+    return mkd_string64(buf, (len > 0) ? len : 0, flags);
+}
+
+
+/* mkd_string(), but reusing a document that's already been used
+ */
+Document *
+mkd_reuse_string(Document *doc, const char *buf, int len, DWORD flags)
+{
+    struct string_stream about;
+
+    if ( !(doc && (doc->magic == VALID_DOCUMENT)) )
+	return 0;
+    mkd_reset(doc);
+
+    about.data = buf;
+    about.size = (len > 0) ? len : 0;
+
+    return fill(doc, (getc_func)__mkd_io_strget, &about, flags & INPUT_MASK);
+}
+
+
+/* mkd_string() for text that might be larger than an int can hold
+ */
+Document *
+mkd_string64(const char *buf, size_t len, DWORD flags)
 {
     struct string_stream about;
 
@@ -173,6 +285,41 @@ mkd_string(const char *buf, int len, DWORD flags)
 
     return populate((getc_func)__mkd_io_strget, &about, flags & INPUT_MASK);
 }
+
+
+/* attach a new document to an engine, freezing the engine
+ */
+static Document *
+attach(Engine *e, Document *doc)
+{
+    if ( doc ) {
+	mkd_engine_freeze(e);
+	doc->engine = e;
+    }
+    return doc;
+}
+
+
+/* mkd_in() for a document that uses an engine's configuration
+ */
+Document *
+mkd_engine_in(Engine *e, FILE *f, DWORD flags)
+{
+    if ( !(e && (e->magic == VALID_ENGINE)) )
+	return 0;
+    return attach(e, mkd_in(f, flags | e->flags));
+}
+
+
+/* mkd_string() for a document that uses an engine's configuration
+ */
+Document *
+mkd_engine_string(Engine *e, const char *buf, int len, DWORD flags)
+{
+    if ( !(e && (e->magic == VALID_ENGINE)) )
+	return 0;
+    return attach(e, mkd_string(buf, len, flags | e->flags));
+}
  
 /*
  * All encoding stuff gets done here, and is used in the "encoding"
@@ -243,7 +390,7 @@ fromutf8(const char *const str, long *pucs)
  */
 
 static void
-encode_la(char *doc, int szdoc, FILE *output, int ascii)
+encode_la(char *doc, ptrdiff_t szdoc, FILE *output, int ascii)
 {
     char *end;
     unsigned octet;
@@ -273,7 +420,7 @@ encode_la(char *doc, int szdoc, FILE *output, int ascii)
  * Convert ISO 8895-1 input to UTF-8 output.
  */
 static void
-encode_lu(char *doc, int szdoc, FILE *output)
+encode_lu(char *doc, ptrdiff_t szdoc, FILE *output)
 {
     char *end;
     unsigned octet;
@@ -299,7 +446,7 @@ encode_lu(char *doc, int szdoc, FILE *output)
  * Convert UTF-8 input to ASCII or ISO 8859-1 output.
  */
 static void
-encode_a(char *doc, int szdoc, FILE *output, int ascii)
+encode_a(char *doc, ptrdiff_t szdoc, FILE *output, int ascii)
 {
     char *end;
     size_t len;
@@ -359,7 +506,7 @@ encode_a(char *doc, int szdoc, FILE *output, int ascii)
  * Copy UTF-8 input to UTF-8 output.
  */
 static void
-encode_u(char *doc, int szdoc, FILE *output)
+encode_u(char *doc, ptrdiff_t szdoc, FILE *output)
 {
     char *end = doc + szdoc;
     char octet;
@@ -382,54 +529,66 @@ encode_u(char *doc, int szdoc, FILE *output)
 #if WITH_ENCODINGS
 #define OUT_MASK	(MKD_OUT_ASCII | MKD_OUT_LATIN1 | MKD_OUT_UTF8)
 #define IN_MASK		(MKD_IN_LATIN1 | MKD_IN_UTF8)
-int
-mkd_generatehtml(Document *p, FILE *output)
+static void
+writehtml(char *doc, ptrdiff_t szdoc, DWORD flags, FILE *output)
 {
-    char *doc;
-    int szdoc;
-    int ascii    = (p->ctx->flags & OUT_MASK) == MKD_OUT_ASCII;
-    int utf8     = (p->ctx->flags & OUT_MASK) == MKD_OUT_UTF8;
-    int inlatin1 = (p->ctx->flags & IN_MASK)  == MKD_IN_LATIN1;
-
-    if ( (szdoc = mkd_document(p, &doc)) != EOF ) {
-        if ( p->ctx->flags & MKD_CDATA )
-            mkd_generatexml(doc, szdoc, output);
-        else if (inlatin1) {	/* Input is Latin-1 ... */
-	    if (utf8)		/* ... convert to UTF-8 output. */
-                encode_lu(doc, szdoc, output);
-	    else		/* ... copy to Latin-1 output,
+    int ascii    = (flags & OUT_MASK) == MKD_OUT_ASCII;
+    int utf8     = (flags & OUT_MASK) == MKD_OUT_UTF8;
+    int inlatin1 = (flags & IN_MASK)  == MKD_IN_LATIN1;
+
+    if ( flags & MKD_CDATA )
+	mkd_generatexml64(doc, szdoc, output);
+    else if (inlatin1) {	/* Input is Latin-1 ... */
+	if (utf8)		/* ... convert to UTF-8 output. */
+	    encode_lu(doc, szdoc, output);
+	else			/* ... copy to Latin-1 output,
 				 *     or convert to ASCII output. */
-                encode_la(doc, szdoc, output, ascii);
-	} else {		/* Input is UTF-8 ... */
-	    if (utf8)		/* ... copy to UTF-8 output. */
-                encode_u(doc, szdoc, output);
-            else 		/* ... convert to Latin-1
+	    encode_la(doc, szdoc, output, ascii);
+    } else {			/* Input is UTF-8 ... */
+	if (utf8)		/* ... copy to UTF-8 output. */
+	    encode_u(doc, szdoc, output);
+	else 			/* ... convert to Latin-1
 				 *     or to ASCII output. */
-                encode_a(doc, szdoc, output, ascii);
-	}
-        putc('\n', output);
-        return 0;
+	    encode_a(doc, szdoc, output, ascii);
     }
-    return -1;
 }
 #else
+static void
+writehtml(char *doc, ptrdiff_t szdoc, DWORD flags, FILE *output)
+{
+    if ( flags & MKD_CDATA )
+	mkd_generatexml64(doc, szdoc, output);
+    else
+	fwrite(doc, szdoc, 1, output);
+}
+#endif /* WITH_ENCODINGS */
+
+
+/* write out a document a segment at a time, without gluing the
+ * segments together first.
+ */
 int
 mkd_generatehtml(Document *p, FILE *output)
 {
-    char *doc;
-    int szdoc;
+    Cstring *seg;
+    ptrdiff_t size;
+    int i;
 
-    if ( (szdoc = mkd_document(p, &doc)) != EOF ) {
-	if ( p->ctx->flags & MKD_CDATA )
-	    mkd_generatexml(doc, szdoc, output);
-	else
-	    fwrite(doc, szdoc, 1, output);
-	putc('\n', output);
-	return 0;
+    if ( ___mkd_render(p) == EOF )
+	return -1;
+
+    for ( i=0; i < S(p->segments); i++ ) {
+	seg = &T(p->segments)[i];
+	writehtml(T(*seg), S(*seg), p->ctx->flags, output);
     }
-    return -1;
+
+    /* mkd_document() may have put a null on the end */
+    if ( (size = S(p->ctx->out)) && (T(p->ctx->out)[size-1] == 0) )
+	--size;
+    writehtml(T(p->ctx->out), size, p->ctx->flags, output);
+    putc('\n', output);
+    return 0;
 }
-#endif /* WITH_ENCODINGS */
 
 
 /* convert some markdown text to html
@@ -446,45 +605,237 @@ markdown(Document *document, FILE *out, int flags)
 }
 
 
-/* write out a Cstring, mangled into a form suitable for `<a href=` or `<a id=`
+/* set up a file to be compiled and written out by mkd_stream()
+ */
+Document *
+mkd_stream_in(FILE *f, DWORD flags)
+{
+    Document *a = __mkd_new_Document();
+
+    if ( !a ) return 0;
+
+    a->tabstop = (flags & MKD_TABSTOP) ? 4 : TABSTOP;
+    a->inflags = flags & INPUT_MASK;
+    a->stream = f;
+    return a;
+}
+
+
+/* what mkd_stream() does with each piece of the input
+ */
+struct streamer {
+    Document *doc;
+    FILE *out;
+    int pass;
+    int first;		/* no paragraphs written yet */
+    Anchors anchors;	/* the ones the headers so far have */
+};
+
+
+/* hand off a piece of the input to the pass that's running now
+ */
+static void
+chunk(struct streamer *s, Line *text)
+{
+    MMIOT *f = s->doc->ctx;
+    Paragraph *code, *p;
+
+    if ( s->pass == 1 ) {
+	___mkd_footnotes(text, f);
+	return;
+    }
+
+    code = ___mkd_compile_chunk(text, f);
+    ___mkd_anchors(code, &s->anchors);
+    for ( p = code; p; p = p->next ) {
+	___mkd_display(p, s->first, f);
+	s->first = 0;
+    }
+    if ( code ) ___mkd_freeParagraph(code);
+
+    writehtml(T(f->out), S(f->out), f->flags, s->out);
+    S(f->out) = 0;
+}
+
+
+/* read the input, cut it up into pieces that can be compiled by
+ * themselves, and pass the pieces along as they come in.
+ */
+static void
+stream_pass(struct streamer *s, FILE *in)
+{
+    Document *doc = s->doc;
+    Breakpoint bp;
+    Cstring line;
+    Line *prev, *text;
+    int c, pandoc = 0;
+
+    memset(&bp, 0, sizeof bp);
+    bp.flags = doc->ctx->flags;
+    bp.engine = doc->engine;
+    CREATE(line);
+
+    do {
+	S(line) = 0;
+	while ( ((c = getc(in)) != EOF) && (c != '\n') )
+	    if ( isprint(c) || isspace(c) || (c & 0x80) )
+		EXPAND(line) = c;
+	if ( (c == EOF) && (S(line) == 0) )
+	    break;
+
+	if ( (c == '\n') && (pandoc != EOF) && (pandoc < 3) ) {
+	    if ( S(line) && (T(line)[0] == '%') )
+		pandoc++;
+	    else
+		pandoc = EOF;
+	}
+
+	prev = T(doc->content) ? E(doc->content) : 0;
+	__mkd_enqueue(doc, &line);
+
+	if ( (pandoc == 3) && !(doc->inflags & (MKD_NOHEADER|MKD_STRICT)) ) {
+	    /* the first three lines started with %, so we have a header
+	     */
+	    text = T(doc->content);
+	    if ( s->pass == 1 ) {
+		doc->title = text;             __mkd_header_dle(doc->title);
+		doc->author= text->next;       __mkd_header_dle(doc->author);
+		doc->date  = text->next->next; __mkd_header_dle(doc->date);
+	    }
+	    else
+		___mkd_freeLines(text);
+	    T(doc->content) = E(doc->content) = 0;
+	    memset(&bp, 0, sizeof bp);
+	    bp.flags = doc->ctx->flags;
+	    bp.engine = doc->engine;
+	    pandoc = EOF;
+	    continue;
+	}
+
+	if ( ___mkd_breakpoint(&bp, E(doc->content)) && prev ) {
+	    text = T(doc->content);
+	    prev->next = 0;
+	    T(doc->content) = E(doc->content);
+	    chunk(s, text);
+	}
+    } while ( c != EOF );
+
+    DELETE(line);
+
+    if ( (text = T(doc->content)) ) {
+	T(doc->content) = E(doc->content) = 0;
+	chunk(s, text);
+    }
+}
+
+
+/* compile and write out a document made by mkd_stream_in() without
+ * ever holding more than a piece of it in memory.  This takes two
+ * passes over the input; the first one collects the footnotes and
+ * the second one compiles and writes out the document a piece at a
+ * time, so the input has to be seekable.
+ */
+int
+mkd_stream(Document *doc, FILE *out, DWORD flags)
+{
+    struct streamer s;
+    long start;
+
+    if ( !(doc && doc->stream) || doc->compiled )
+	return -1;
+
+    if ( (start = ftell(doc->stream)) < 0 )
+	return -1;
+
+    ___mkd_prepare(doc, flags);
+
+    s.doc = doc;
+    s.out = out;
+    s.first = 1;
+
+    s.pass = 1;
+    stream_pass(&s, doc->stream);
+    ___mkd_sortfootnotes(doc->ctx);
+
+    if ( fseek(doc->stream, start, SEEK_SET) != 0 )
+	return -1;
+
+    s.pass = 2;
+    doc->nlines = 0;
+    memset(&s.anchors, 0, sizeof s.anchors);
+    stream_pass(&s, doc->stream);
+    ___mkd_free_anchors(&s.anchors);
+
+    if ( doc->ctx->flags & MKD_EXTRA_FOOTNOTE )
+	___mkd_extra_footnotes(doc->ctx);
+    writehtml(T(doc->ctx->out), S(doc->ctx->out), doc->ctx->flags, out);
+    S(doc->ctx->out) = 0;
+    putc('\n', out);
+
+    doc->stream = 0;
+    doc->html = 1;
+    return 0;
+}
+
+
+/* write out a header's label (what mkd_line() made out of it) as an
+ * anchor
  */
 void
-mkd_string_to_anchor(char *s, int len, mkd_sta_function_t outchar,
-                                       void *out, int labelformat)
+___mkd_label_anchor(char *line, int size, mkd_sta_function_t outchar, void *out)
 {
 #if WITH_URLENCODED_ANCHOR
     static const unsigned char hexchars[] = "0123456789abcdef";
 #endif
     unsigned char c;
+    int i;
 
-    int i, size;
-    char *line;
-
-    size = mkd_line(s, len, &line, IS_LABEL);
-    
 #if !WITH_URLENCODED_ANCHOR
-    if ( labelformat && (size>0) && !isalpha(line[0]) )
+    if ( (size>0) && !isalpha(line[0]) )
         (*outchar)('L',out);
 #endif
     for ( i=0; i < size ; i++ ) {
 	c = line[i];
-	if ( labelformat ) {
-	    if ( isalnum(c) || (c == '_') || (c == ':') || (c == '-') || (c == '.' ) )
-		(*outchar)(c, out);
-	    else
+	if ( isalnum(c) || (c == '_') || (c == ':') || (c == '-') || (c == '.' ) )
+	    (*outchar)(c, out);
+	else
 #if WITH_URLENCODED_ANCHOR
-	    {
-		(*outchar)('%', out);
-		(*outchar)(hexchars[c >> 4 & 0xf], out);
-		(*outchar)(hexchars[c      & 0xf], out);
-	    }
+	{
+	    (*outchar)('%', out);
+	    (*outchar)(hexchars[c >> 4 & 0xf], out);
+	    (*outchar)(hexchars[c      & 0xf], out);
+	}
 #else
-		(*outchar)('.', out);
+	    (*outchar)('.', out);
 #endif
-	}
-	else
-	    (*outchar)(c,out);
     }
+}
+
+
+/* write out a Cstring, mangled into a form suitable for `<a href=` or `<a id=`
+ * (the same anchor a header with that text gets in a document)
+ */
+void
+mkd_string_to_anchor(char *s, int len, mkd_sta_function_t outchar,
+                                       void *out, int labelformat)
+{
+    int i, size;
+    char *line;
+    Cstring anchor;
+
+    if ( labelformat ) {
+	CREATE(anchor);
+	___mkd_string_slug(s, len, &anchor);
+	for ( i=0; i < S(anchor); i++ )
+	    (*outchar)((unsigned char)T(anchor)[i], out);
+	DELETE(anchor);
+	return;
+    }
+
+    size = mkd_line(s, len, &line, IS_LABEL);
+    
+    for ( i=0; i < size ; i++ )
+	(*outchar)((unsigned char)line[i],out);
         
     if (line)
         free(line);
@@ -497,7 +848,7 @@ static void
 mkd_parse_line(char *bfr, int size, MMIOT *f, int flags)
 {
     ___mkd_initmmiot(f, 0);
-    f->flags = flags & USER_FLAGS;
+    f->flags = flags & (USER_FLAGS|IS_LABEL);
     ___mkd_reparse(bfr, size, 0, f, 0);
     ___mkd_emblock(f);
 }
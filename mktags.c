@@ -84,6 +84,6 @@ main()
     for (i=0; i < S(blocktags); i++)
 	printf("   { \"%s\", %d, %d },\n", T(blocktags)[i].id, T(blocktags)[i].size, T(blocktags)[i].selfclose );
     printf("};\n\n");
-    printf("#define NR_blocktags %d\n", S(blocktags));
+    printf("#define NR_blocktags %d\n", (int)S(blocktags));
     exit(0);
 }
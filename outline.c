@@ -0,0 +1,222 @@
+/* markdown: a C implementation of John Gruber's Markdown markup language.
+ *
+ * Copyright (C) 2007 David L Parsons.
+ * The redistribution terms are provided in the COPYRIGHT file that must
+ * be distributed with this source code.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "cstring.h"
+#include "markdown.h"
+#include "amalloc.h"
+
+/* the headers of a document and everything it links to, with the lines
+ * of the source they're on, for link checkers and site maps.   Like
+ * mkd_plaintext(), it's made out of what mkd_walk() sends, so nothing
+ * is ever rendered; the [label]: url definitions come straight out of
+ * the footnotes table.
+ */
+
+/* an item, with where its strings are in the pool (or -1)
+ */
+struct item {
+    Outline o;
+    int text, anchor, label;
+} ;
+
+struct outline {
+    Document *doc;
+    STRING(struct item) items;
+    Cstring pool;
+    int header;			/* which header we're in, or -1 */
+    Cstring title;		/* and what it says so far */
+    int nheaders;		/* how many headers there have been */
+} ;
+
+typedef int (*stfu)(const void*,const void*);
+
+
+/* put a string in the pool and say where it is
+ */
+static int
+pool(struct outline *o, const char *s, int size)
+{
+    int at = S(o->pool);
+
+    Cswrite(&o->pool, (char*)s, size);
+    EXPAND(o->pool) = 0;
+    return at;
+}
+
+
+static struct item *
+item(struct outline *o, int type, int line)
+{
+    struct item *it = &EXPAND(o->items);
+
+    memset(it, 0, sizeof *it);
+    it->o.type = type;
+    it->o.line = line;
+    it->text = it->anchor = it->label = -1;
+    return it;
+}
+
+
+static int
+visit(const Node *n, int leaving, void *ctx)
+{
+    struct outline *o = ctx;
+    struct item *it;
+    Paragraph *p;
+
+    switch ( n->type ) {
+    case MKD_NODE_HEADER:
+	if ( leaving ) {
+	    it = &T(o->items)[o->header];
+	    it->o.size = S(o->title);
+	    it->text = pool(o, T(o->title), S(o->title));
+	    o->header = -1;
+	    break;
+	}
+	o->header = S(o->items);
+	S(o->title) = 0;
+	it = item(o, MKD_OUTLINE_HEADER, n->line);
+	it->o.hnumber = n->hnumber;
+
+	/* the index has the headers in the same order mkd_walk() sends
+	 * them
+	 */
+	if ( o->nheaders < S(o->doc->index.headers) ) {
+	    p = T(o->doc->index.headers)[o->nheaders];
+	    if ( p->anchor )
+		it->anchor = pool(o, p->anchor, strlen(p->anchor));
+	}
+	o->nheaders++;
+	break;
+
+    case MKD_NODE_TEXT:
+    case MKD_NODE_CODESPAN:
+	if ( !leaving && (o->header >= 0) )
+	    Cswrite(&o->title, (char*)n->text, n->size);
+	break;
+
+    case MKD_NODE_LINK:
+    case MKD_NODE_IMAGE:
+	/* (the url might be in the arena, which is emptied after every
+	 * block, so it's copied now)
+	 */
+	if ( !leaving ) {
+	    it = item(o, (n->type == MKD_NODE_LINK) ? MKD_OUTLINE_LINK
+						    : MKD_OUTLINE_IMAGE, n->line);
+	    it->o.size = n->size;
+	    it->text = pool(o, n->text, n->size);
+	}
+	break;
+
+    default:
+	break;
+    }
+    return 0;
+}
+
+
+static int
+byline(struct item *a, struct item *b)
+{
+    return a->o.line - b->o.line;
+}
+
+
+/* the [label]: url definitions, whether anything uses them or not
+ * (but [^footnotes] aren't links)
+ */
+static void
+references(struct outline *o, Document *doc)
+{
+    MMIOT *f = doc->ctx;
+    Footnote *def;
+    struct item *it;
+    int i;
+
+    for ( i=0; i < S(*f->footnotes); i++ ) {
+	def = &T(*f->footnotes)[i];
+
+	if ( (f->flags & MKD_EXTRA_FOOTNOTE) && S(def->tag)
+					     && (T(def->tag)[0] == '^') )
+	    continue;
+	it = item(o, MKD_OUTLINE_REF, def->lineno);
+	it->o.size = S(def->link);
+	it->text = pool(o, T(def->link), S(def->link));
+	it->o.labelsize = S(def->tag);
+	it->label = pool(o, T(def->tag), S(def->tag));
+    }
+}
+
+
+/* the headers and link targets of a document, in the order they're in
+ * the source.   Returns how many there are (in *res, which is one
+ * block of memory to free() when you're done with it), or EOF if the
+ * document isn't compiled.
+ */
+int
+mkd_outline(Document *doc, Outline **res)
+{
+    struct outline o;
+    struct item *refs;
+    Outline *out;
+    char *strings;
+    int i, j, k, nitems, nrefs;
+
+    if ( !(res && doc && doc->compiled) )
+	return EOF;
+
+    *res = 0;
+    memset(&o, 0, sizeof o);
+    o.doc = doc;
+    o.header = -1;
+    CREATE(o.items);
+    CREATE(o.pool);
+    CREATE(o.title);
+
+    mkd_walk(doc, visit, &o);
+
+    /* the definitions go in with everything else, by line
+     */
+    nitems = S(o.items);
+    references(&o, doc);
+    nrefs = S(o.items) - nitems;
+    refs = T(o.items) + nitems;
+    qsort(refs, nrefs, sizeof refs[0], (stfu)byline);
+
+    if ( S(o.items) > 0 ) {
+	out = malloc(S(o.items) * sizeof *out + S(o.pool));
+	strings = (char*)(out + S(o.items));
+	memcpy(strings, T(o.pool), S(o.pool));
+
+	for ( i=j=k=0; k < S(o.items); k++ ) {
+	    struct item *it;
+
+	    if ( (j < nrefs) && ((i >= nitems)
+				 || (refs[j].o.line < T(o.items)[i].o.line)) )
+		it = &refs[j++];
+	    else
+		it = &T(o.items)[i++];
+
+	    out[k] = it->o;
+	    out[k].text = (it->text >= 0) ? strings + it->text : 0;
+	    out[k].anchor = (it->anchor >= 0) ? strings + it->anchor : 0;
+	    out[k].label = (it->label >= 0) ? strings + it->label : 0;
+	}
+	*res = out;
+    }
+
+    k = S(o.items);
+    DELETE(o.items);
+    DELETE(o.pool);
+    DELETE(o.title);
+    return k;
+}
@@ -0,0 +1,537 @@
+/* markdown: a C implementation of John Gruber's Markdown markup language.
+ *
+ * Copyright (C) 2007 David L Parsons.
+ * The redistribution terms are provided in the COPYRIGHT file that must
+ * be distributed with this source code.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "cstring.h"
+#include "markdown.h"
+#include "amalloc.h"
+
+/* write out the text a reader would see in a document, without any of
+ * the markup, for search indexers and the like.   It's made out of what
+ * mkd_walk() sends, so the text is never turned into html (and the
+ * emphasis is never put on the Qblock) in the first place.
+ */
+struct plain {
+    Cstring out;
+    int pants;			/* smartypants the text */
+    int quotes;			/* which smartypants quotes are open */
+    int cell;			/* which cell of a table row we're in */
+    int cellstart;		/* and where its text starts */
+} ;
+
+
+/* the smartypants patterns (from generate.c), written out as the
+ * characters the entities stand for
+ */
+static struct smarties {
+    char c0;
+    char *pat;
+    char *utf8;
+    int shift;
+} smarties[] = {
+    { '\'', "'s|",      "\xe2\x80\x99", 0 },	/* rsquo */
+    { '\'', "'t|",      "\xe2\x80\x99", 0 },
+    { '\'', "'re|",     "\xe2\x80\x99", 0 },
+    { '\'', "'ll|",     "\xe2\x80\x99", 0 },
+    { '\'', "'ve|",     "\xe2\x80\x99", 0 },
+    { '\'', "'m|",      "\xe2\x80\x99", 0 },
+    { '\'', "'d|",      "\xe2\x80\x99", 0 },
+    { '-',  "---",      "\xe2\x80\x94", 2 },	/* mdash */
+    { '-',  "--",       "\xe2\x80\x93", 1 },	/* ndash */
+    { '.',  "...",      "\xe2\x80\xa6", 2 },	/* hellip */
+    { '.',  ". . .",    "\xe2\x80\xa6", 4 },
+    { '(',  "(c)",      "\xc2\xa9",     2 },	/* copy */
+    { '(',  "(r)",      "\xc2\xae",     2 },	/* reg */
+    { '(',  "(tm)",     "\xe2\x84\xa2", 3 },	/* trade */
+    { '3',  "|3/4|",    "\xc2\xbe",     2 },	/* frac34 */
+    { '3',  "|3/4ths|", "\xc2\xbe",     2 },
+    { '1',  "|1/2|",    "\xc2\xbd",     2 },	/* frac12 */
+    { '1',  "|1/4|",    "\xc2\xbc",     2 },	/* frac14 */
+    { '1',  "|1/4th|",  "\xc2\xbc",     2 },
+} ;
+#define NRSMART ( sizeof smarties / sizeof smarties[0] )
+#define SPECIAL	"'\"-.(31`"	/* what they (and the quotes) start with */
+
+#define LSQUO	"\xe2\x80\x98"
+#define RSQUO	"\xe2\x80\x99"
+#define LDQUO	"\xe2\x80\x9c"
+#define RDQUO	"\xe2\x80\x9d"
+
+
+/* the entities people write in markdown source, and what they stand
+ * for (the numbered ones are worked out by entity())
+ */
+static struct entities {
+    char *name;
+    char *utf8;
+} entities[] = {
+    { "amp",    "&" },
+    { "lt",     "<" },
+    { "gt",     ">" },
+    { "quot",   "\"" },
+    { "apos",   "'" },
+    { "nbsp",   "\xc2\xa0" },
+    { "copy",   "\xc2\xa9" },
+    { "reg",    "\xc2\xae" },
+    { "trade",  "\xe2\x84\xa2" },
+    { "mdash",  "\xe2\x80\x94" },
+    { "ndash",  "\xe2\x80\x93" },
+    { "hellip", "\xe2\x80\xa6" },
+    { "lsquo",  "\xe2\x80\x98" },
+    { "rsquo",  "\xe2\x80\x99" },
+    { "ldquo",  "\xe2\x80\x9c" },
+    { "rdquo",  "\xe2\x80\x9d" },
+    { "laquo",  "\xc2\xab" },
+    { "raquo",  "\xc2\xbb" },
+    { "bull",   "\xe2\x80\xa2" },
+    { "middot", "\xc2\xb7" },
+    { "deg",    "\xc2\xb0" },
+    { "times",  "\xc3\x97" },
+    { "divide", "\xc3\xb7" },
+    { "plusmn", "\xc2\xb1" },
+    { "sect",   "\xc2\xa7" },
+    { "para",   "\xc2\xb6" },
+    { "cent",   "\xc2\xa2" },
+    { "pound",  "\xc2\xa3" },
+    { "yen",    "\xc2\xa5" },
+    { "euro",   "\xe2\x82\xac" },
+    { "frac14", "\xc2\xbc" },
+    { "frac12", "\xc2\xbd" },
+    { "frac34", "\xc2\xbe" },
+} ;
+#define NRENTITIES ( sizeof entities / sizeof entities[0] )
+
+
+/* if there's an entity at the start of s, put the utf-8 for it in
+ * utf8 and return how long the entity is
+ */
+static int
+entity(const char *s, int size, char *utf8)
+{
+    unsigned long c;
+    int i, len;
+    char *end;
+
+    for ( len = 1; (len < size) && (len < 12) && (s[len] != ';'); len++ )
+	if ( !isalnum(s[len]) && !(len == 1 && s[len] == '#') )
+	    return 0;
+    if ( (len >= size) || (s[len] != ';') || (len < 2) )
+	return 0;
+
+    if ( s[1] != '#' ) {
+	for ( i=0; i < NRENTITIES; i++ )
+	    if ( (strlen(entities[i].name) == len-1)
+			&& (strncmp(s+1, entities[i].name, len-1) == 0) ) {
+		strcpy(utf8, entities[i].utf8);
+		return len+1;
+	    }
+	return 0;
+    }
+
+    if ( tolower(s[2]) == 'x' )
+	c = strtoul(s+3, &end, 16);
+    else
+	c = strtoul(s+2, &end, 10);
+    if ( (end != s+len) || (c > 0x10ffff) )
+	return 0;
+
+    /* &#0; is how smartypants is told to keep its hands off something
+     */
+    if ( c == 0 )
+	utf8[0] = 0;
+    else if ( c < 0x80 ) {
+	utf8[0] = c;
+	utf8[1] = 0;
+    }
+    else if ( c < 0x800 ) {
+	utf8[0] = 0xc0 | (c >> 6);
+	utf8[1] = 0x80 | (c & 0x3f);
+	utf8[2] = 0;
+    }
+    else if ( c < 0x10000 ) {
+	utf8[0] = 0xe0 | (c >> 12);
+	utf8[1] = 0x80 | ((c >> 6) & 0x3f);
+	utf8[2] = 0x80 | (c & 0x3f);
+	utf8[3] = 0;
+    }
+    else {
+	utf8[0] = 0xf0 | (c >> 18);
+	utf8[1] = 0x80 | ((c >> 12) & 0x3f);
+	utf8[2] = 0x80 | ((c >> 6) & 0x3f);
+	utf8[3] = 0x80 | (c & 0x3f);
+	utf8[4] = 0;
+    }
+    return len+1;
+}
+
+
+/* a piece of text being smartypantsed; like peek() in generate.c,
+ * at(t,0) is the character we're looking at.   Looking back past the
+ * start of the text looks at what's already been written out.
+ */
+struct text {
+    struct plain *p;
+    const char *s;
+    int size;
+    int i;
+} ;
+
+static int
+at(struct text *t, int k)
+{
+    int pos = t->i + k;
+
+    if ( pos >= t->size )
+	return EOF;
+    if ( pos >= 0 )
+	return (unsigned char)t->s[pos];
+    if ( (S(t->p->out) + pos) >= 0 )
+	return (unsigned char)T(t->p->out)[S(t->p->out) + pos];
+    return EOF;
+}
+
+
+static int
+isthisnonword(struct text *t, int k)
+{
+    int c = at(t, k);
+
+    if ( c == EOF )
+	return 1;
+    if ( c & 0x80 )
+	return 0;
+    return isspace(c) || (c < ' ') || ispunct(c);
+}
+
+
+static int
+islike(struct text *t, char *s)
+{
+    int len;
+    int i;
+
+    if ( s[0] == '|' ) {
+	if ( !isthisnonword(t, -1) )
+	    return 0;
+	++s;
+    }
+
+    if ( !(len = strlen(s)) )
+	return 0;
+
+    if ( s[len-1] == '|' ) {
+	if ( !isthisnonword(t, len-1) )
+	    return 0;
+	len--;
+    }
+
+    for (i=1; i < len; i++)
+	if ( tolower(at(t,i)) != s[i] )
+	    return 0;
+    return 1;
+}
+
+
+static int
+smartyquote(struct text *t, int bit, char *left, char *right)
+{
+    if ( bit & t->p->quotes ) {
+	if ( isthisnonword(t, 1) ) {
+	    Cswrite(&t->p->out, right, strlen(right));
+	    t->p->quotes &= ~bit;
+	    return 1;
+	}
+    }
+    else if ( isthisnonword(t, -1) && at(t, 1) != EOF ) {
+	Cswrite(&t->p->out, left, strlen(left));
+	t->p->quotes |= bit;
+	return 1;
+    }
+    return 0;
+}
+
+
+static void
+smartypants(struct plain *p, const char *s, int size)
+{
+    struct text t;
+    int c, j, i, close = -1;
+
+    t.p = p;
+    t.s = s;
+    t.size = size;
+
+    for ( t.i = 0; t.i < size; t.i++ ) {
+	/* write out everything up to the next thing that might be
+	 * smartypantsed all at once
+	 */
+	for ( j = t.i; (j < size) && !strchr(SPECIAL, s[j]); j++ )
+	    ;
+	if ( j > t.i ) {
+	    Cswrite(&p->out, (char*)s + t.i, j - t.i);
+	    t.i = j-1;
+	    continue;
+	}
+
+	c = (unsigned char)s[t.i];
+
+	if ( t.i == close ) {
+	    Cswrite(&p->out, RDQUO, strlen(RDQUO));
+	    t.i++;
+	    continue;
+	}
+
+	for ( i=0; i < NRSMART; i++ )
+	    if ( (c == smarties[i].c0) && islike(&t, smarties[i].pat) )
+		break;
+	if ( i < NRSMART ) {
+	    Cswrite(&p->out, smarties[i].utf8, strlen(smarties[i].utf8));
+	    t.i += smarties[i].shift;
+	    continue;
+	}
+
+	switch (c) {
+	case '\'':  if ( smartyquote(&t, 0x01, LSQUO, RSQUO) )
+			continue;
+		    break;
+	case '"':   if ( smartyquote(&t, 0x02, LDQUO, RDQUO) )
+			continue;
+		    break;
+	case '`':   /* ``like this'' */
+		    if ( at(&t,1) == '`' ) {
+			for ( j = 2; (c = at(&t,j)) != EOF && c != '`'; j++ )
+			    if ( c == '\'' && at(&t,j+1) == '\'' ) {
+				Cswrite(&p->out, LDQUO, strlen(LDQUO));
+				close = t.i + j;
+				t.i++;
+				break;
+			    }
+			if ( close > t.i )
+			    continue;
+		    }
+		    break;
+	}
+	Csputc(c, &p->out);
+    }
+}
+
+
+/* write out some text, with its entities turned back into the
+ * characters they stand for
+ */
+static void
+text(struct plain *p, const char *s, int size)
+{
+    char utf8[5];
+    int i, j, len;
+
+    for ( i = j = 0; j < size; j++ ) {
+	if ( (s[j] != '&') || !(len = entity(s+j, size-j, utf8)) )
+	    continue;
+	if ( j > i ) {
+	    if ( p->pants )
+		smartypants(p, s+i, j-i);
+	    else
+		Cswrite(&p->out, (char*)s+i, j-i);
+	}
+	Cswrite(&p->out, utf8, strlen(utf8));
+	i = j + len;
+	j = i-1;
+    }
+    if ( j > i ) {
+	if ( p->pants )
+	    smartypants(p, s+i, j-i);
+	else
+	    Cswrite(&p->out, (char*)s+i, j-i);
+    }
+}
+
+
+/* take the padding off the cell that was just written out
+ */
+static void
+trimcell(struct plain *p)
+{
+    int start = p->cellstart, i;
+
+    while ( (S(p->out) > start) && isspace(T(p->out)[S(p->out)-1]) )
+	--S(p->out);
+    for ( i = start; (i < S(p->out)) && isspace(T(p->out)[i]); i++ )
+	;
+    if ( i > start ) {
+	memmove(T(p->out)+start, T(p->out)+i, S(p->out)-i);
+	S(p->out) -= i - start;
+    }
+}
+
+
+/* make sure the text that's been written out ends with <lines>
+ * newlines, so blocks don't run together
+ */
+static void
+separate(struct plain *p, int lines)
+{
+    int i;
+
+    if ( S(p->out) == 0 )
+	return;
+    for ( i = 0; (i < lines) && (i < S(p->out))
+			      && (T(p->out)[S(p->out)-1-i] == '\n'); i++ )
+	;
+    for ( ; i < lines; i++ )
+	Csputc('\n', &p->out);
+}
+
+
+static int
+visit(const Node *n, int leaving, void *ctx)
+{
+    struct plain *p = ctx;
+
+    switch ( n->type ) {
+    case MKD_NODE_PARAGRAPH:
+    case MKD_NODE_HEADER:
+    case MKD_NODE_TERM:
+	if ( leaving )
+	    separate(p, 1);
+	else {
+	    /* paragraphs in tight lists and definition terms are only
+	     * a line apart
+	     */
+	    separate(p, (n->type == MKD_NODE_TERM
+			 || (n->type == MKD_NODE_PARAGRAPH && !n->align)) ? 1 : 2);
+	    p->quotes = 0;
+	}
+	break;
+
+    case MKD_NODE_CODE:
+	if ( !leaving ) {
+	    separate(p, 2);
+	    Cswrite(&p->out, (char*)n->text, n->size);
+	}
+	break;
+
+    case MKD_NODE_ROW:
+	if ( leaving )
+	    separate(p, 1);
+	else {
+	    separate(p, 1);
+	    p->cell = 0;
+	}
+	break;
+
+    case MKD_NODE_HEADCELL:
+    case MKD_NODE_CELL:
+	if ( leaving )
+	    trimcell(p);
+	else {
+	    if ( p->cell++ )
+		Csputc('\t', &p->out);
+	    p->cellstart = S(p->out);
+	    p->quotes = 0;
+	}
+	break;
+
+    case MKD_NODE_NOTE:
+	/* each footnote is a line of its own, like an item in a tight
+	 * list
+	 */
+	separate(p, 1);
+	if ( !leaving )
+	    p->quotes = 0;
+	break;
+
+    case MKD_NODE_NOTEREF:
+	/* a reference to a footnote is its number, like the <sup> it
+	 * turns into
+	 */
+	if ( !leaving )
+	    Csprintf(&p->out, "%d", n->number);
+	break;
+
+    case MKD_NODE_NOTES:
+    case MKD_NODE_TABLE:
+    case MKD_NODE_QUOTE:
+    case MKD_NODE_UL:
+    case MKD_NODE_OL:
+    case MKD_NODE_AL:
+    case MKD_NODE_DL:
+	if ( !leaving )
+	    separate(p, 2);
+	break;
+
+    case MKD_NODE_CODESPAN:
+	if ( !leaving )
+	    Cswrite(&p->out, (char*)n->text, n->size);
+	break;
+
+    case MKD_NODE_TEXT:
+	if ( !leaving )
+	    text(p, n->text, n->size);
+	break;
+
+    /* html, styles, horizontal rules, and the markup around the text
+     * aren't visible (and a line break is already followed by the
+     * newline it was made out of)
+     */
+    default:
+	break;
+    }
+    return 0;
+}
+
+
+/* the visible text of a document
+ */
+int
+mkd_plaintext(Document *d, char **res)
+{
+    struct plain p;
+    int size;
+
+    if ( !(res && d && d->compiled) )
+	return EOF;
+
+    *res = 0;
+    memset(&p, 0, sizeof p);
+    p.pants = !(d->ctx->flags & (MKD_NOPANTS|MKD_TAGTEXT));
+    CREATE(p.out);
+    RESERVE(p.out, 100);
+
+    mkd_walk(d, visit, &p);
+    separate(&p, 1);
+
+    if ( (size = S(p.out)) > 0 ) {
+	EXPAND(p.out) = 0;
+	*res = T(p.out);	/* (see the HACK ALERT in mkd_css()) */
+    }
+    else
+	DELETE(p.out);
+    return size;
+}
+
+
+/* write the visible text of a document to a file
+ */
+int
+mkd_generateplaintext(Document *d, FILE *f)
+{
+    char *res = 0;
+    int size = mkd_plaintext(d, &res);
+    int written = size;
+
+    if ( size > 0 )
+	written = fwrite(res, 1, size, f);
+    if ( res )
+	free(res);
+    return (written == size) ? size : EOF;
+}
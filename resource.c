@@ -32,9 +32,12 @@ ___mkd_freeLine(Line *ptr)
 void
 ___mkd_freeLines(Line *p)
 {
-    if (p->next)
-	 ___mkd_freeLines(p->next);
-    ___mkd_freeLine(p);
+    Line *next;
+
+    for ( ; p; p = next ) {
+	next = p->next;
+	___mkd_freeLine(p);
+    }
 }
 
 
@@ -43,17 +46,25 @@ ___mkd_freeLines(Line *p)
 void
 ___mkd_freeParagraph(Paragraph *p)
 {
-    if (p->next)
-	___mkd_freeParagraph(p->next);
-    if (p->down)
-	___mkd_freeParagraph(p->down);
-    if (p->text)
-	___mkd_freeLines(p->text);
-    if (p->ident)
-	free(p->ident);
-    if (p->lang)
-	free(p->lang);
-    free(p);
+    Paragraph *next;
+
+    /* walk along the list instead of recursing down it, because a
+     * big document can have more paragraphs than there is stack.
+     */
+    for ( ; p; p = next ) {
+	next = p->next;
+	if (p->down)
+	    ___mkd_freeParagraph(p->down);
+	if (p->text)
+	    ___mkd_freeLines(p->text);
+	if (p->ident)
+	    free(p->ident);
+	if (p->lang)
+	    free(p->lang);
+	if (p->anchor)
+	    free(p->anchor);
+	free(p);
+    }
 }
 
 
@@ -91,6 +102,8 @@ ___mkd_initmmiot(MMIOT *f, void *footnotes)
 {
     if ( f ) {
 	memset(f, 0, sizeof *f);
+	f->engine = &___mkd_default_engine;
+	f->rng = f->engine->seed;
 	CREATE(f->in);
 	CREATE(f->out);
 	CREATE(f->Q);
@@ -142,18 +155,155 @@ ___mkd_freeLineRange(Line *anchor, Line *stop)
 void
 mkd_cleanup(Document *doc)
 {
+    int i;
+
     if ( doc && (doc->magic == VALID_DOCUMENT) ) {
+	___mkd_freechunks(doc);
+	DELETE(doc->source);
+
 	if ( doc->ctx ) {
 	    ___mkd_freemmiot(doc->ctx, 0);
 	    free(doc->ctx);
 	}
 
+	for ( i=0; i < S(doc->segments); i++ )
+	    DELETE(T(doc->segments)[i]);
+	DELETE(doc->segments);
+	DELETE(doc->marks);
+	___mkd_free_ast(doc);
+	___mkd_freeindex(doc);
+
+	if ( doc->image )
+	    free(doc->image);	/* (the code and the header are in it) */
+	else {
+	    if ( doc->code) ___mkd_freeParagraph(doc->code);
+	    if ( doc->title) ___mkd_freeLine(doc->title);
+	    if ( doc->author) ___mkd_freeLine(doc->author);
+	    if ( doc->date) ___mkd_freeLine(doc->date);
+	}
+	if ( T(doc->content) ) ___mkd_freeLines(T(doc->content));
+	memset(doc, 0, sizeof doc[0]);
+	free(doc);
+    }
+}
+
+
+/* empty out a document so it can be used again, keeping the buffers
+ * it's already allocated (see mkd_reuse_in() and mkd_reuse_string())
+ */
+void
+mkd_reset(Document *doc)
+{
+    MMIOT *f;
+    int i;
+
+    if ( !(doc && (doc->magic == VALID_DOCUMENT)) )
+	return;
+
+    ___mkd_freechunks(doc);
+    DELETE(doc->source);
+    doc->editable = 0;
+    doc->base = 0;
+
+    if ( (f = doc->ctx) ) {
+	if ( f->footnotes ) {
+	    for (i=0; i < S(*f->footnotes); i++)
+		___mkd_freefootnote( &T(*f->footnotes)[i] );
+	    S(*f->footnotes) = 0;
+	}
+	S(f->in) = S(f->out) = S(f->Q) = 0;
+    }
+
+    for ( i=0; i < S(doc->segments); i++ )
+	DELETE(T(doc->segments)[i]);
+    S(doc->segments) = 0;
+    ___mkd_free_ast(doc);
+    S(doc->index.styles) = S(doc->index.headers) = S(doc->index.toc) = 0;
+
+    if ( doc->image ) {
+	free(doc->image);
+	doc->image = 0;
+    }
+    else {
 	if ( doc->code) ___mkd_freeParagraph(doc->code);
 	if ( doc->title) ___mkd_freeLine(doc->title);
 	if ( doc->author) ___mkd_freeLine(doc->author);
 	if ( doc->date) ___mkd_freeLine(doc->date);
-	if ( T(doc->content) ) ___mkd_freeLines(T(doc->content));
-	memset(doc, 0, sizeof doc[0]);
-	free(doc);
     }
+    if ( T(doc->content) ) ___mkd_freeLines(T(doc->content));
+
+    doc->code = 0;
+    doc->title = doc->author = doc->date = 0;
+    T(doc->content) = E(doc->content) = 0;
+    doc->nlines = 0;
+    doc->compiled = doc->html = 0;
+    doc->marked = 0;		/* (but keep the marks for mkd_patch()) */
+    doc->ref_prefix = 0;
+    memset(&doc->cb, 0, sizeof doc->cb);
+    memset(&doc->cursor, 0, sizeof doc->cursor);
+    doc->stream = 0;
+}
+
+
+/* a few documents per thread, kept around after mkd_pool_release()
+ * for the next mkd_pool_in() or mkd_pool_string() to reuse
+ */
+#define POOLSIZE 8
+
+/* (if the compiler can't give each thread its own pool, a threaded
+ * build would have every thread sharing one without a lock, so
+ * nothing is ever pooled)
+ */
+#if WITH_THREADS && NO_THREAD_LOCAL
+#define POOLING 0
+#else
+#define POOLING 1
+#endif
+
+static THREAD_LOCAL Document *pool[POOLSIZE];
+static THREAD_LOCAL int pooled = 0;
+
+Document *
+mkd_pool_in(FILE *f, DWORD flags)
+{
+    if ( POOLING && (pooled > 0) )
+	return mkd_reuse_in(pool[--pooled], f, flags);
+    return mkd_in(f, flags);
+}
+
+
+Document *
+mkd_pool_string(const char *buf, int len, DWORD flags)
+{
+    if ( POOLING && (pooled > 0) )
+	return mkd_reuse_string(pool[--pooled], buf, len, flags);
+    return mkd_string(buf, len, flags);
+}
+
+
+/* done with a document from the pool; put it back if there's room
+ */
+void
+mkd_pool_release(Document *doc)
+{
+    if ( !(doc && (doc->magic == VALID_DOCUMENT)) )
+	return;
+
+    if ( POOLING && (pooled < POOLSIZE) ) {
+	mkd_reset(doc);
+	doc->engine = &___mkd_default_engine;
+	pool[pooled++] = doc;
+    }
+    else
+	mkd_cleanup(doc);
+}
+
+
+/* free the documents in this thread's pool
+ */
+void
+mkd_pool_drain()
+{
+    while ( pooled > 0 )
+	mkd_cleanup(pool[--pooled]);
 }
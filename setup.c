@@ -13,12 +13,23 @@
 #include <time.h>
 #include <ctype.h>
 
+#if WITH_THREADS
+#include <unistd.h>
+#endif
+
 #include "cstring.h"
 #include "markdown.h"
 #include "amalloc.h"
 #include "tags.h"
     
+/* the engine that documents made with mkd_in(), mkd_string(), and
+ * so forth use.   It's never frozen, so mkd_define_tag() and rawarg()
+ * can change it at any time.
+ */
+Engine ___mkd_default_engine = { VALID_ENGINE };
+
 static int need_to_initrng = 1;
+static int nthreads = 0;
 
 void
 mkd_initialize()
@@ -26,7 +37,7 @@ mkd_initialize()
 
     if ( need_to_initrng ) {
 	need_to_initrng = 0;
-	INITRNG(time(0));
+	___mkd_default_engine.seed = (unsigned long)time(0);
     }
 }
 
@@ -34,6 +45,95 @@ mkd_initialize()
 void
 mkd_shlib_destructor()
 {
+    mkd_async_shutdown();
+    mkd_pool_drain();
     mkd_deallocate_tags();
 }
 
+
+/* make a new engine, which can be configured until the first
+ * document is made with it (or until mkd_engine_freeze() is called.)
+ */
+Engine *
+mkd_engine_new(DWORD flags)
+{
+    Engine *e = calloc(sizeof(Engine), 1);
+
+    if ( e ) {
+	e->magic = VALID_ENGINE;
+	e->seed = (unsigned long)time(0);
+	e->flags = flags & USER_FLAGS;
+    }
+    return e;
+}
+
+
+/* set the seed for the email address mangler, so an engine can
+ * produce the same output every time.
+ */
+int
+mkd_engine_seed(Engine *e, unsigned long seed)
+{
+    if ( !(e && (e->magic == VALID_ENGINE)) || e->frozen )
+	return -1;
+    e->seed = seed;
+    return 0;
+}
+
+
+/* after an engine is frozen it can't be changed, and it's safe for
+ * documents on different threads to use it at the same time.  (The
+ * first document made with an engine freezes it, but if that might
+ * happen on more than one thread at once, freeze it beforehand.)
+ */
+void
+mkd_engine_freeze(Engine *e)
+{
+    if ( e && (e->magic == VALID_ENGINE) && !e->frozen )
+	e->frozen = 1;
+}
+
+
+/* destroy an engine; any documents made with it have to be
+ * cleaned up first.
+ */
+void
+mkd_engine_free(Engine *e)
+{
+    if ( e && (e->magic == VALID_ENGINE) && (e != &___mkd_default_engine) ) {
+	___mkd_free_tags(e);
+	___mkd_free_cache(e);
+	e->magic = 0;
+	free(e);
+    }
+}
+
+
+/* set how many threads compiling or rendering a big document, or a
+ * batch of documents, can use (0 is one for each processor.)  Returns
+ * what it was set to before.
+ */
+int
+mkd_threads(int count)
+{
+    int was = nthreads;
+
+    if ( count >= 0 )
+	nthreads = count;
+    return was;
+}
+
+
+/* how many threads there are to use
+ */
+int
+___mkd_nthreads()
+{
+    int count = nthreads;
+
+#ifdef _SC_NPROCESSORS_ONLN
+    if ( count <= 0 )
+	count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return (count > 0) ? count : 1;
+}
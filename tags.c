@@ -1,11 +1,16 @@
 /* block-level tags for passing html blocks through the blender
  */
 #define __WITHOUT_AMALLOC 1
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "cstring.h"
+#include "markdown.h"
 #include "tags.h"
 
-STRING(struct kw) extratags;
-
 /* the standard collection of tags are built and sorted when
  * discount is configured, so all we need to do is pull them
  * in and use them.
@@ -15,51 +20,98 @@ STRING(struct kw) extratags;
 #include "blocktags"
 
 
-/* define an additional html block tag
+/* case insensitive string sort (for qsort() and bsearch() of block tags)
  */
-void
-mkd_define_tag(char *id, int selfclose)
+static int
+casort(struct kw *a, struct kw *b)
+{
+    if ( a->size != b->size )
+	return a->size - b->size;
+    return strncasecmp(a->id, b->id, b->size);
+}
+
+
+/* stupid cast to make gcc shut up about the function types being
+ * passed into qsort() and bsearch()
+ */
+typedef int (*stfu)(const void*,const void*);
+
+
+/* look for a token in the standard tags and an engine's extra tags
+ */
+struct kw*
+___mkd_search_tags(Engine *e, char *pat, int len)
+{
+    struct kw key;
+    struct kw *ret;
+    
+    key.id = pat;
+    key.size = len;
+    
+    if ( (ret=bsearch(&key,blocktags,NR_blocktags,sizeof key,(stfu)casort)) )
+	return ret;
+
+    if ( S(e->extratags) )
+	return bsearch(&key,T(e->extratags),S(e->extratags),sizeof key,(stfu)casort);
+    
+    return 0;
+}
+
+
+/* define an additional html block tag for an engine that's not
+ * been frozen yet.  The tag name is not copied.
+ */
+int
+mkd_engine_define_tag(Engine *e, char *id, int selfclose)
 {
     struct kw *p;
 
+    if ( !(e && (e->magic == VALID_ENGINE)) || e->frozen )
+	return -1;
+
     /* only add the new tag if it doesn't exist in
      * either the standard or extra tag tables.
      */
-    if ( !(p = mkd_search_tags(id, strlen(id))) ) {
+    if ( !(p = ___mkd_search_tags(e, id, strlen(id))) ) {
 	/* extratags could be deallocated */
-	if ( S(extratags) == 0 )
-	    CREATE(extratags);
-	p = &EXPAND(extratags);
+	if ( S(e->extratags) == 0 )
+	    CREATE(e->extratags);
+	p = &EXPAND(e->extratags);
 	p->id = id;
 	p->size = strlen(id);
 	p->selfclose = selfclose;
+	qsort(T(e->extratags), S(e->extratags), sizeof(struct kw), (stfu)casort);
     }
+    return 0;
 }
 
 
-/* case insensitive string sort (for qsort() and bsearch() of block tags)
+/* destroy an engine's extra tags
  */
-static int
-casort(struct kw *a, struct kw *b)
+void
+___mkd_free_tags(Engine *e)
 {
-    if ( a->size != b->size )
-	return a->size - b->size;
-    return strncasecmp(a->id, b->id, b->size);
+    if ( S(e->extratags) > 0 )
+	DELETE(e->extratags);
 }
 
 
-/* stupid cast to make gcc shut up about the function types being
- * passed into qsort() and bsearch()
+/* define an additional html block tag
  */
-typedef int (*stfu)(const void*,const void*);
+void
+mkd_define_tag(char *id, int selfclose)
+{
+    mkd_engine_define_tag(&___mkd_default_engine, id, selfclose);
+}
 
 
 /* sort the list of extra html block tags for later searching
+ * (mkd_define_tag() keeps them sorted now, so this is a no-op
+ *  kept for old callers.)
  */
 void
 mkd_sort_tags()
 {
-    qsort(T(extratags), S(extratags), sizeof(struct kw), (stfu)casort);
 }
 
 
@@ -68,19 +120,7 @@ mkd_sort_tags()
 struct kw*
 mkd_search_tags(char *pat, int len)
 {
-    struct kw key;
-    struct kw *ret;
-    
-    key.id = pat;
-    key.size = len;
-    
-    if ( (ret=bsearch(&key,blocktags,NR_blocktags,sizeof key,(stfu)casort)) )
-	return ret;
-
-    if ( S(extratags) )
-	return bsearch(&key,T(extratags),S(extratags),sizeof key,(stfu)casort);
-    
-    return 0;
+    return ___mkd_search_tags(&___mkd_default_engine, pat, len);
 }
 
 
@@ -89,6 +129,5 @@ mkd_search_tags(char *pat, int len)
 void
 mkd_deallocate_tags()
 {
-    if ( S(extratags) > 0 )
-	DELETE(extratags);
+    ___mkd_free_tags(&___mkd_default_engine);
 } /* mkd_deallocate_tags */
@@ -0,0 +1,81 @@
+. tests/functions.sh
+
+title "converting documents in the background"
+
+rc=0
+MARKDOWN_FLAGS=
+
+# submit some documents (separated by @@ lines), cancel some of them,
+# pick up the rest with mkd_poll(), shut the workers down and do it
+# again, and make sure every document comes back (once) the same as it
+# does with mkd_document().
+#
+async() {
+    unset FLAGS
+    while [ "$1" ]; do
+	case "$1" in
+	-*) FLAGS="$FLAGS $1"
+	    shift ;;
+	*) break ;;
+	esac
+    done
+
+    __tests=`expr $__tests + 1`
+    test "$VERBOSE" && ./echo -n `./echo -n "  $1" '........................................................' | ./cols 50`
+
+    ./echo "$2" > $$.md
+    ./reasync $FLAGS < $$.md > $$.g 2>&1
+
+    if [ "`cat $$.g`" = "ok" ]; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z  "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$1"
+	fi
+	./echo "source:"
+	./echo "$2" | sed -e 's/^/	/'
+	./echo "diff:"
+	sed -e 's/^/	/' $$.g
+	rc=1
+    fi
+    rm -f $$.md $$.g
+}
+
+DOCS='# a header
+
+a *paragraph* with a [link][] and a note[^1]
+
+[link]: /url "title"
+[^1]: the note
+@@
+* a
+* list
+
+<div>
+some html
+</div>
+@@
+[link]
+
+no definition for that link
+@@
+
+@@
+| a | b |
+|---|---|
+| 1 | 2 |
+
+    code "here"'
+
+async 'one document' 'just *one*'
+async 'a few documents' "$DOCS"
+async -n20 'a lot of documents' "$DOCS"
+async -n10 -r4 -t1 'one worker' "$DOCS"
+async -n10 -r4 -t5 'more workers' "$DOCS"
+async -ffootnote -n5 'footnotes' "$DOCS"
+
+summary $0
+exit $rc
@@ -0,0 +1,80 @@
+. tests/functions.sh
+
+title "rendering batches of documents"
+
+rc=0
+MARKDOWN_FLAGS=
+
+# render some documents (separated by @@ lines) with mkd_render_batch()
+# on different numbers of threads, and make sure they come out the same
+# as they do with mkd_document().
+#
+batch() {
+    unset FLAGS
+    while [ "$1" ]; do
+	case "$1" in
+	-*) FLAGS="$FLAGS $1"
+	    shift ;;
+	*) break ;;
+	esac
+    done
+
+    __tests=`expr $__tests + 1`
+    test "$VERBOSE" && ./echo -n `./echo -n "  $1" '........................................................' | ./cols 50`
+
+    ./echo "$2" > $$.md
+    ./rebatch $FLAGS < $$.md > $$.g 2>&1
+
+    if [ "`cat $$.g`" = "ok" ]; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z  "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$1"
+	fi
+	./echo "source:"
+	./echo "$2" | sed -e 's/^/	/'
+	./echo "diff:"
+	sed -e 's/^/	/' $$.g
+	rc=1
+    fi
+    rm -f $$.md $$.g
+}
+
+DOCS='# a header
+
+a *paragraph* with a [link][] and a note[^1]
+
+[link]: /url "title"
+[^1]: the note
+@@
+* a
+* list
+
+<div>
+some html
+</div>
+@@
+[link]
+
+no definition for that link, and [^1] no note
+@@
+
+@@
+| a | b |
+|---|---|
+| 1 | 2 |
+
+    code "here"'
+
+batch 'one document' 'just *one*'
+batch 'a few documents' "$DOCS"
+batch -n20 'more documents than threads' "$DOCS"
+batch -n20 -t3 -t16 'odd numbers of threads' "$DOCS"
+batch -ffootnote 'footnotes' "$DOCS"
+batch -ftoc,nopants -n5 'other flags' "$DOCS"
+
+summary $0
+exit $rc
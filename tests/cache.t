@@ -0,0 +1,117 @@
+. tests/functions.sh
+
+title "cached blocks"
+
+rc=0
+MARKDOWN_FLAGS=
+
+# render some documents (separated by @@ lines) with an engine that
+# caches blocks and with one that doesn't, and make sure they come out
+# the same.
+#
+recache() {
+    unset FLAGS
+    while [ "$1" ]; do
+	case "$1" in
+	-*) FLAGS="$FLAGS $1"
+	    shift ;;
+	*) break ;;
+	esac
+    done
+
+    __tests=`expr $__tests + 1`
+    test "$VERBOSE" && ./echo -n `./echo -n "  $1" '........................................................' | ./cols 50`
+
+    ./echo "$2" > $$.md
+    ./recache $FLAGS < $$.md > $$.g 2>&1
+
+    if [ "`cat $$.g`" = "ok" ]; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z  "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$1"
+	fi
+	./echo "source:"
+	./echo "$2" | sed -e 's/^/	/'
+	./echo "diff:"
+	sed -e 's/^/	/' $$.g
+	rc=1
+    fi
+    rm -f $$.md $$.g
+}
+
+BOILERPLATE='# boilerplate
+
+a *paragraph* that turns up in every document
+
+* a
+* list
+
+    code'
+
+recache -n3 'the same blocks in every document' "$BOILERPLATE
+@@
+$BOILERPLATE
+
+something else
+@@
+something else
+
+$BOILERPLATE"
+
+recache -n2 'references redefined' 'see [the docs][docs] and ![a picture][pic]
+
+[docs]: /one "one"
+[pic]: /one.png
+@@
+see [the docs][docs] and ![a picture][pic]
+
+[docs]: /two "two"
+[pic]: /two.png =10x20
+@@
+see [the docs][docs] and ![a picture][pic]
+
+[docs]: /two "two"
+@@
+see [the docs][docs] and ![a picture][pic]'
+
+recache -c200 -n4 'a tiny cache' "$BOILERPLATE
+@@
+a different paragraph
+
+$BOILERPLATE
+@@
+# another header
+
+and more text, which is long enough to push something else out"
+
+recache -ffootnote -n2 'footnotes' 'a footnote[^1]
+
+a paragraph
+
+[^1]: one
+@@
+a paragraph
+
+another footnote[^1] and [^2]
+
+[^1]: two
+[^2]: three
+@@
+a paragraph'
+
+recache -ftoc -n2 'headers' '# one
+
+# one
+
+text
+@@
+# one
+
+text'
+
+summary $0
+exit $rc
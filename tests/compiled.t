@@ -0,0 +1,96 @@
+. tests/functions.sh
+
+title "saved compiled documents"
+
+rc=0
+MARKDOWN_FLAGS=
+
+# compile a document, save it, load it back, and make sure it comes
+# out the same as it does when it's just compiled.
+#
+reload() {
+    unset FLAGS
+    while [ "$1" ]; do
+	case "$1" in
+	-*) FLAGS="$FLAGS $1"
+	    shift ;;
+	*) break ;;
+	esac
+    done
+
+    __tests=`expr $__tests + 1`
+    test "$VERBOSE" && ./echo -n `./echo -n "  $1" '........................................................' | ./cols 50`
+
+    ./echo "$2" > $$.md
+    ./markdown $FLAGS $$.md > $$.w
+    ./reload $FLAGS < $$.md > $$.g 2>&1
+
+    if cmp -s $$.w $$.g; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z  "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$1"
+	fi
+	./echo "source:"
+	./echo "$2" | sed -e 's/^/	/'
+	./echo "diff:"
+	diff $$.w $$.g | sed -e 's/^/	/'
+	rc=1
+    fi
+    rm -f $$.md $$.w $$.g
+}
+
+reload 'paragraphs and lists' 'one
+
+* two
+* three
+
+1. four'
+
+reload '%div% ident' '>%this%
+text
+
+>%id:that%
+more'
+
+reload 'references' '[a][] and ![b][]
+
+[a]: /a "title"
+[b]: /b =10x20'
+
+reload -ffootnote 'footnotes' 'a footnote[^1] and another[^2]
+
+[^1]: one
+[^2]: two'
+
+reload -ftoc 'header anchors' '# one
+
+text
+
+# one
+
+## two *em*'
+
+reload 'pandoc header' '% title
+% author
+% date
+
+text'
+
+if ./markdown -V | grep FENCED-CODE >/dev/null; then
+
+reload 'fenced code with a language' '```c
+int x;
+```
+
+~~~
+plain
+~~~'
+
+fi
+
+summary $0
+exit $rc
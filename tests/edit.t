@@ -0,0 +1,155 @@
+. tests/functions.sh
+
+title "edited documents"
+
+rc=0
+MARKDOWN_FLAGS=
+
+# make some edits to a document with mkd_update(), and make sure that
+# after each one it comes out the same as the edited source does when
+# it's compiled from scratch.
+#
+edit() {
+    unset FLAGS
+    while [ "$1" ]; do
+	case "$1" in
+	-*) FLAGS="$FLAGS $1"
+	    shift ;;
+	*) break ;;
+	esac
+    done
+
+    __tests=`expr $__tests + 1`
+    test "$VERBOSE" && ./echo -n `./echo -n "  $1" '........................................................' | ./cols 50`
+
+    name="$1"
+    ./echo "$2" > $$.md
+    shift 2
+    Q=`./reedit $FLAGS "$@" < $$.md 2>&1`
+
+    if [ "$Q" = "ok" ]; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z  "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$name"
+	fi
+	./echo "$Q" | sed -e 's/^/	/'
+	rc=1
+    fi
+    rm -f $$.md
+}
+
+edit 'add a paragraph' 'one
+
+two' '5,0,three
+
+'
+
+edit 'join two paragraphs' 'one
+
+two' '3,2, '
+
+edit 'start a list' 'a
+
+b' '0,0,* ' '3,0,* '
+
+edit 'code fence at the start' '```
+a
+
+b
+```
+
+text' '0,0,x' '0,1,'
+
+edit 'open a code fence' 'a
+
+b
+
+c' '0,0,```
+' '0,4,'
+
+edit 'a code fence that never closes' '
+```
+
+```' '0,0,~~~
+'
+
+edit 'a code fence over a setext underline' '/
+```-
+
+```' '5,0,
+'
+
+edit 'a code fence after indented code' '    <
+
+```' '6,0,```
+'
+
+edit 'a code fence after a html block' '<div></div>
+```' '11,0,```
+'
+
+edit 'html block' 'a
+
+<div>
+b
+
+c
+</div>
+
+d' '3,0,<div>
+
+'
+
+edit 'footnotes' 'a[^1] and b[^2]
+
+[^1]: one
+[^2]: two' '0,0,[^2] '
+
+edit -n200 -s1 'random edits' '# header
+
+a paragraph
+with two lines
+
+* a list
+* of things
+
+1. and
+2. more
+
+> a quote
+
+    code
+
+text [a][]
+
+[a]: /a'
+
+edit -n200 -s2 -ffootnote 'random edits with footnotes' 'text[^1]
+
+* a [^2]
+
+[^1]: one
+[^2]: two
+
+more'
+
+edit -n200 -s3 -ftoc 'random edits with a table of contents' '# a
+
+text
+
+# a
+
+## text
+
+* # a
+
+more text
+
+# b'
+
+summary $0
+exit $rc
@@ -0,0 +1,121 @@
+. tests/functions.sh
+
+title "engines"
+
+rc=0
+MARKDOWN_FLAGS=
+
+# convert a document with two engines that have different extra tags
+# and raw delimiters, and with the default engine, and make sure that
+# each one only uses its own.
+#
+engines() {
+    unset FLAGS
+    while [ "$1" ]; do
+	case "$1" in
+	-*) FLAGS="$FLAGS $1"
+	    shift ;;
+	*) break ;;
+	esac
+    done
+
+    __tests=`expr $__tests + 1`
+    test "$VERBOSE" && ./echo -n `./echo -n "  $1" '........................................................' | ./cols 50`
+
+    ./echo "$2" > $$.md
+    ./echo "$3" > $$.w
+    ./engines $FLAGS < $$.md > $$.g 2>&1
+
+    if diff -b $$.w $$.g > /dev/null; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z  "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$1"
+	fi
+	./echo "source:"
+	./echo "$2" | sed -e 's/^/	/'
+	./echo "diff:"
+	diff -b $$.w $$.g | sed -e 's/^/	/'
+	rc=1
+    fi
+    rm -f $$.md $$.w $$.g
+}
+
+engines -z 'frozen engines can'"'"'t be changed' '' 'ok'
+
+engines 'extra tags' '<ATAG>
+*a*
+</ATAG>
+
+<BTAG>
+*b*
+</BTAG>' 'a:
+<ATAG>
+*a*
+</ATAG>
+
+
+<p><BTAG>
+<em>b</em>
+</BTAG></p>
+b:
+<p><ATAG>
+<em>a</em>
+</ATAG></p>
+
+<BTAG>
+*b*
+</BTAG>
+
+default:
+<p><ATAG>
+<em>a</em>
+</ATAG></p>
+
+<p><BTAG>
+<em>b</em>
+</BTAG></p>'
+
+engines 'html5 tags' '<aside>
+*c*
+</aside>' 'a:
+<aside>
+*c*
+</aside>
+
+b:
+<p><aside>
+<em>c</em>
+</aside></p>
+default:
+<p><aside>
+<em>c</em>
+</aside></p>'
+
+engines 'raw delimiters' 'math $$*x*$$ and @@*y*@@' 'a:
+<p>math <math>*x*</math> and @@<em>y</em>@@</p>
+b:
+<p>math <tt>*x*</tt> and <code>*y*</code></p>
+default:
+<p>math $$<em>x</em>$$ and @@<em>y</em>@@</p>'
+
+engines -fnohtml 'extra tags without html' '<ATAG>
+*a*
+</ATAG>' 'a:
+<p>&lt;ATAG>
+<em>a</em>
+&lt;/ATAG></p>
+b:
+<p>&lt;ATAG>
+<em>a</em>
+&lt;/ATAG></p>
+default:
+<p>&lt;ATAG>
+<em>a</em>
+&lt;/ATAG></p>'
+
+summary $0
+exit $rc
@@ -0,0 +1,101 @@
+. tests/functions.sh
+
+title "rendering a piece at a time"
+
+rc=0
+MARKDOWN_FLAGS=
+
+# render a document with mkd_render_next() into buffers of 1, 7, and
+# 65536 bytes (or whatever -c sizes are given), and make sure the pieces
+# add up to what mkd_document() writes.   If there's a third argument,
+# the document is doubled that many times first.
+#
+next() {
+    unset FLAGS
+    while [ "$1" ]; do
+	case "$1" in
+	-*) FLAGS="$FLAGS $1"
+	    shift ;;
+	*) break ;;
+	esac
+    done
+
+    __tests=`expr $__tests + 1`
+    test "$VERBOSE" && ./echo -n `./echo -n "  $1" '........................................................' | ./cols 50`
+
+    ./echo "$2" > $$.md
+    count=${3:-0}
+    while [ $count -gt 0 ]; do
+	cat $$.md $$.md > $$.w
+	mv $$.w $$.md
+	count=`expr $count - 1`
+    done
+    Q=`./renext $FLAGS < $$.md 2>&1`
+
+    if [ "$Q" = "ok" ]; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z  "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$1"
+	fi
+	./echo "$Q" | sed -e 's/^/	/'
+	rc=1
+    fi
+    rm -f $$.md $$.w
+}
+
+next 'empty document' ''
+
+next 'one paragraph' 'hello'
+
+next 'paragraphs and lists' 'a *paragraph*
+
+* one
+* two
+
+    code & <stuff>
+
+> quoted'
+
+next 'html and tables' '<div>
+raw *html*
+</div>
+
+| a | b |
+|---|---|
+| 1 | 2 |
+
+---'
+
+next -ffootnote 'footnotes' 'one[^1] and two[^2]
+
+[^1]: the first
+[^2]: the second'
+
+next -ftoc 'headers' '# one
+
+text
+
+## two'
+
+next -c3 -c4096 -c1000000 'other sizes' 'a *paragraph*
+
+* one
+* two'
+
+next 'a big document' 'a *paragraph* with [a link](/url)
+
+* one
+* two
+
+    code & <stuff>' 10
+
+next -ffootnote 'a big document with footnotes' 'note[^1] here
+
+[^1]: the note' 10
+
+summary $0
+exit $rc
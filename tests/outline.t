@@ -0,0 +1,114 @@
+. tests/functions.sh
+
+title "outlines"
+
+rc=0
+MARKDOWN_FLAGS=
+
+# get the outline of a document from mkd_outline(), and make sure the
+# headers, links, images, and definitions in it are the right ones, on
+# the right lines.
+#
+outline() {
+    unset FLAGS
+    while [ "$1" ]; do
+	case "$1" in
+	-*) FLAGS="$FLAGS $1"
+	    shift ;;
+	*) break ;;
+	esac
+    done
+
+    __tests=`expr $__tests + 1`
+    test "$VERBOSE" && ./echo -n `./echo -n "  $1" '........................................................' | ./cols 50`
+
+    ./echo "$2" > $$.md
+    test "$3" && ./echo "$3" > $$.w || : > $$.w
+    ./outlines $FLAGS < $$.md > $$.g 2>&1
+
+    if diff $$.w $$.g > /dev/null; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z  "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$1"
+	fi
+	./echo "source:"
+	./echo "$2" | sed -e 's/^/	/'
+	./echo "diff:"
+	diff $$.w $$.g | sed -e 's/^/	/'
+	rc=1
+    fi
+    rm -f $$.md $$.w $$.g
+}
+
+outline 'headers' '# One *two*
+
+text
+
+Setext `code`
+-------------
+
+### three ###' '1 h1 One.two One two
+5 h2 Setext.code Setext code
+8 h3 three three'
+
+outline 'links and images' 'text with [a link](http://a.com/)
+and ![an image](img.png "title") on two lines
+
+<http://auto.link/>' '1 link http://a.com/
+2 image img.png
+4 link http://auto.link/'
+
+outline 'definitions' 'a [link][r] to a definition
+
+[r]: http://r.com/
+[unused]: http://unused.com/' '1 link http://r.com/
+3 ref [r] http://r.com/
+4 ref [unused] http://unused.com/'
+
+outline 'code is skipped' 'a `[code](span.html)` and
+`# not a header`
+
+    [code](block.html)
+    # not a header
+
+[not code](text.html)' '7 link text.html'
+
+outline 'headers in other blocks' '* an [item](list.html)
+
+  ## in a list
+
+> ### in a [quote](quote.html)' '1 link list.html
+3 h2 in.a.list in a list
+5 h3 in.a.quote in a quote
+5 link quote.html'
+
+outline 'headers with the same name' '# same
+
+# same' '1 h1 same same
+3 h1 same-1 same'
+
+outline 'after a pandoc header' '% title
+% author
+% date
+
+# header
+
+[link](x.html)' '5 h1 header header
+7 link x.html'
+
+outline -ffootnotes 'footnotes aren'"'"'t links' 'a[^1] [b](b.html)
+
+[^1]: a note
+[c]: c.html' '1 link b.html
+4 ref [c] c.html'
+
+outline -fnolinks 'without links' '[link](x.html) ![image](y.png)' '1 image y.png'
+outline -fnoimage 'without images' '[link](x.html) ![image](y.png)' '1 link x.html'
+outline 'empty document' '' ''
+
+summary $0
+exit $rc
@@ -0,0 +1,84 @@
+. tests/functions.sh
+
+title "everything about a document at once"
+
+rc=0
+MARKDOWN_FLAGS=
+
+# get the html, table of contents, css, and headers of a document from
+# mkd_outputs(), and make sure they're the same as what mkd_document(),
+# mkd_toc(), and mkd_css() write, and what's in the html.
+#
+outputs() {
+    unset FLAGS
+    while [ "$1" ]; do
+	case "$1" in
+	-*) FLAGS="$FLAGS $1"
+	    shift ;;
+	*) break ;;
+	esac
+    done
+
+    __tests=`expr $__tests + 1`
+    test "$VERBOSE" && ./echo -n `./echo -n "  $1" '........................................................' | ./cols 50`
+
+    ./echo "$2" > $$.md
+    Q=`./outputs $FLAGS < $$.md 2>&1`
+
+    if [ "$Q" = "ok" ]; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z  "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$1"
+	fi
+	./echo "$Q" | sed -e 's/^/	/'
+	rc=1
+    fi
+    rm -f $$.md
+}
+
+DOC='% the title
+% the author
+% the date
+
+# One *two*
+
+<style>
+p { color: red; }
+</style>
+
+text
+
+* a list
+
+    ## in a list
+
+> ### in a quote
+
+two
+---
+
+<div>
+<style>
+h1 { color: blue; }
+</style>
+</div>
+
+### `code` in a header'
+
+outputs 'no flags' "$DOC"
+outputs -ftoc 'a table of contents' "$DOC"
+outputs -ftoc,nostyle 'no styles' "$DOC"
+outputs -ftoc 'no headers' 'just text'
+outputs -ftoc 'the same header twice' '# same
+
+## same
+
+# same'
+outputs 'empty document' ''
+
+summary $0
+exit $rc
@@ -0,0 +1,174 @@
+. tests/functions.sh
+
+title "patched documents"
+
+rc=0
+MARKDOWN_FLAGS=
+
+# render a document with mkd_patch(), make some edits to it, and make
+# sure that after each one the patch, applied to the blocks the last
+# render left, comes out the same as mkd_document() does.
+#
+patch() {
+    unset FLAGS
+    while [ "$1" ]; do
+	case "$1" in
+	-*) FLAGS="$FLAGS $1"
+	    shift ;;
+	*) break ;;
+	esac
+    done
+
+    __tests=`expr $__tests + 1`
+    test "$VERBOSE" && ./echo -n `./echo -n "  $1" '........................................................' | ./cols 50`
+
+    name="$1"
+    ./echo "$2" > $$.md
+    shift 2
+    Q=`./repatch $FLAGS "$@" < $$.md 2>&1`
+
+    if [ "$Q" = "ok" ]; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z  "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$name"
+	fi
+	./echo "$Q" | sed -e 's/^/	/'
+	rc=1
+    fi
+    rm -f $$.md
+}
+
+patch 'nothing changed' 'one
+
+two' '0,0,'
+
+patch 'insert a block' 'one
+
+two' '5,0,three
+
+'
+
+patch 'remove a block' 'one
+
+two
+
+three' '5,5,'
+
+patch 'replace a block' 'one
+
+two
+
+three' '5,3,TWO'
+
+patch 'insert at the start' 'one' '0,0,zero
+
+'
+
+patch 'remove the last block' 'one
+
+two' '3,5,'
+
+patch 'join two paragraphs' 'one
+
+two' '3,2, '
+
+patch 'split a paragraph' 'one two' '3,1,
+
+'
+
+patch 'several edits' 'one
+
+two
+
+three' '0,0,# ' '9,0,* ' '0,0,> '
+
+patch 'duplicate blocks' 'same
+
+other
+
+same
+
+same' '13,4,changed'
+
+patch 'insert a duplicate' 'same
+
+other' '6,0,same
+
+'
+
+patch 'remove a duplicate' 'same
+
+same
+
+same' '0,6,'
+
+patch 'duplicate lists' '* a
+* b
+
+text
+
+* a
+* b' '22,1,c'
+
+patch -ffootnote 'add a footnote' 'one
+
+two' '3,0,[^1]' '10,0,
+
+[^1]: the note'
+
+patch -ffootnote 'change a footnote' 'one[^1]
+
+two
+
+[^1]: the note' '25,4,other note'
+
+patch -ffootnote 'remove the footnotes' 'one[^1]
+
+two
+
+[^1]: the note' '3,4,'
+
+patch -ffootnote 'a second footnote' 'one[^1]
+
+two
+
+[^1]: the note
+[^2]: another' '9,0,[^2]'
+
+patch -ffootnote 'footnote and duplicates' 'same[^1]
+
+same
+
+same
+
+[^1]: the note' '6,0,
+
+same'
+
+patch 'random edits' 'one
+
+two
+
+* a
+* b
+
+> quoted
+
+    code' -n200 -s1
+
+patch -ffootnote 'random edits with footnotes' 'one[^1]
+
+[a]: /b
+
+same
+
+same
+
+[^1]: the note' -n200 -s7
+
+summary $0
+exit $rc
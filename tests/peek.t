@@ -0,0 +1,90 @@
+. tests/functions.sh
+
+title "reading just the header"
+
+rc=0
+MARKDOWN_FLAGS=
+
+# read the pandoc header of a document with mkd_peek_header(), and
+# make sure it's the header mkd_in() finds, and that the file's left
+# just after it.
+#
+peek() {
+    unset FLAGS
+    while [ "$1" ]; do
+	case "$1" in
+	-*) FLAGS="$FLAGS $1"
+	    shift ;;
+	*) break ;;
+	esac
+    done
+
+    __tests=`expr $__tests + 1`
+    test "$VERBOSE" && ./echo -n `./echo -n "  $1" '........................................................' | ./cols 50`
+
+    name="$1"
+    ./echo "$2" > $$.md
+    shift 2
+    Q=`./peek $FLAGS "$@" < $$.md 2>&1`
+
+    if [ "$Q" = "ok" ]; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z  "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$name"
+	fi
+	./echo "$Q" | sed -e 's/^/	/'
+	rc=1
+    fi
+    rm -f $$.md
+}
+
+HEADER='% the title
+% the author
+% the date'
+
+DOC="$HEADER
+
+# a header
+
+% not part of the header
+
+text"
+
+CR=`printf '\r'`
+
+peek 'a header' "$DOC" 'the title' 'the author' 'the date'
+peek 'just a header' "$HEADER" 'the title' 'the author' 'the date'
+peek 'four % lines' "$HEADER
+% more
+text" 'the title' 'the author' 'the date'
+peek 'empty fields' '%
+% the author
+%' '' 'the author' ''
+peek 'two % lines' '% the title
+% the author
+
+text' '' '' ''
+peek 'two % lines at the end' '% the title
+% the author'
+peek 'a blank line first' "
+$DOC"
+peek 'no header' 'just text' '' '' ''
+peek 'crlf line endings' "% the title$CR
+% the author$CR
+% the date$CR
+$CR
+text$CR" 'the title' 'the author' 'the date'
+peek -fnoheader 'with MKD_NOHEADER' "$DOC"
+peek 'a longer document' "$DOC
+
+$DOC
+
+$DOC" 'the title' 'the author' 'the date'
+peek 'empty document' ''
+
+summary $0
+exit $rc
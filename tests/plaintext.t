@@ -0,0 +1,90 @@
+. tests/functions.sh
+
+title "plain text"
+
+rc=0
+MARKDOWN_FLAGS=
+
+# the text mkd_plaintext() finds in a document
+#
+plain() {
+    unset FLAGS
+    while [ "$1" ]; do
+	case "$1" in
+	-*) FLAGS="$FLAGS $1"
+	    shift ;;
+	*) break ;;
+	esac
+    done
+
+    __tests=`expr $__tests + 1`
+    test "$VERBOSE" && ./echo -n `./echo -n "  $1" '........................................................' | ./cols 50`
+
+    Q=`./echo "$2" | ./plain $FLAGS`
+
+    if [ "$3" = "$Q" ]; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z  "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$1"
+	fi
+	./echo "source:"
+	./echo "$2" | sed -e 's/^/	/'
+	./echo "diff:"
+	(./echo "$3"  >> $$.w
+	./echo "$Q"  >> $$.g
+	diff  $$.w $$.g ) | sed -e 's/^/	/'
+	rm -f $$.w $$.g
+	rc=1
+    fi
+}
+
+plain 'paragraphs and emphasis' 'one *two*
+
+__three__ `four`' 'one two
+
+three four'
+
+plain 'links and images' '[a link](/url "title") and ![an image](/img)
+
+[ref][] <http://example.com>
+
+[ref]: /ref' 'a link and an image
+
+ref http://example.com'
+
+plain 'html is left out' '<div>
+hidden
+</div>
+
+text <b>bold</b>' 'text bold'
+
+plain -fnopants 'entities' 'AT&amp;T &lt;tag&gt; caf&#233; &#x263A; &nosuch;' 'AT&T <tag> café ☺ &nosuch;'
+
+plain 'smartypants' '"quoted" -- isn'"'"'t it...' '“quoted” – isn’t it…'
+
+plain 'table cells' '| a   |  b  |
+|-----|:---:|
+|  1  | 2   |
+|3|  four |' 'a	b
+1	2
+3	four'
+
+plain -ffootnote 'footnotes' 'text fn[^1] here[^x], again[^1].
+
+[^1]: the *note* x
+[^x]: &amp; another
+[^y]: not used' 'text fn1 here2, again[^1].
+
+the note x
+& another'
+
+plain 'footnotes without -ffootnote' 'text fn[^1] here.
+
+[^1]: /the-note' 'text fn^1 here.'
+
+summary $0
+exit $rc
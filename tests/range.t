@@ -0,0 +1,122 @@
+. tests/functions.sh
+
+title "rendering part of a document"
+
+rc=0
+MARKDOWN_FLAGS=
+
+# render every range of top-level blocks of a document, and make sure
+# each one is that part of the whole document, with the same footnote
+# numbers, and that every header's section is the right range.
+#
+range() {
+    unset FLAGS
+    while [ "$1" ]; do
+	case "$1" in
+	-*) FLAGS="$FLAGS $1"
+	    shift ;;
+	*) break ;;
+	esac
+    done
+
+    __tests=`expr $__tests + 1`
+    test "$VERBOSE" && ./echo -n `./echo -n "  $1" '........................................................' | ./cols 50`
+
+    ./echo "$2" > $$.md
+    Q=`./ranges $FLAGS < $$.md 2>&1`
+
+    if [ "$Q" = "ok" ]; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z  "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$1"
+	fi
+	./echo "$Q" | sed -e 's/^/	/'
+	rc=1
+    fi
+    rm -f $$.md
+}
+
+SECTIONS='# one
+
+text
+
+## one.one
+
+* a
+* list
+
+### one.one.one
+
+    code
+
+## one.two
+
+> # not a section
+
+* item
+
+  ## not one either
+
+# two
+
+text
+
+# three'
+
+NOTES='a[^1] and b[^2]
+
+# one
+
+c[^1], d[^3]
+
+## two
+
+e[^4]
+
+# three
+
+f[^2] and g[^5]
+
+[^1]: the first
+[^2]: the second
+[^3]: the third
+[^4]: the fourth
+[^5]: the fifth'
+
+range 'sections' "$SECTIONS"
+range -ftoc 'sections with a table of contents' "$SECTIONS"
+range -ffootnotes 'footnotes' "$NOTES"
+range -ffootnotes,toc 'footnotes with a table of contents' "$NOTES"
+range 'footnotes turned off' "$NOTES"
+range 'a pandoc header' "% title
+% author
+% date
+
+$SECTIONS"
+range 'styles and definitions' '<style>
+p { }
+</style>
+
+[a link][l]
+
+[l]: http://l.com/
+
+# header
+
+<div>html</div>'
+range 'headers with the same name' '# same
+
+text
+
+# same
+
+## same'
+range 'just a header' '# header'
+range 'empty document' ''
+
+summary $0
+exit $rc
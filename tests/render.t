@@ -0,0 +1,88 @@
+. tests/functions.sh
+
+title "rendering a document more than one way"
+
+rc=0
+MARKDOWN_FLAGS=
+
+# compile a document once, render it with mkd_render() with different
+# flags, and make sure each comes out the same as the document compiled
+# with those flags, and that mkd_document() isn't changed by it.
+#
+render() {
+    unset FLAGS
+    while [ "$1" ]; do
+	case "$1" in
+	-*) FLAGS="$FLAGS $1"
+	    shift ;;
+	*) break ;;
+	esac
+    done
+
+    __tests=`expr $__tests + 1`
+    test "$VERBOSE" && ./echo -n `./echo -n "  $1" '........................................................' | ./cols 50`
+
+    name="$1"
+    ./echo "$2" > $$.md
+    shift 2
+    Q=`./rerender $FLAGS "$@" < $$.md 2>&1`
+
+    if [ "$Q" = "ok" ]; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z  "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$name"
+	fi
+	./echo "$Q" | sed -e 's/^/	/'
+	rc=1
+    fi
+    rm -f $$.md
+}
+
+DOC='# A "header"
+
+Some *text*, with a [link](http://example.com "title"),
+an ![image](/a.png), and a <b>tag</b> -- and ~~deleted~~ text.
+
+## Another header
+
+* a list
+* with "quotes" in it...
+
+    code & <stuff>'
+
+render 'no flags' "$DOC" -r
+render 'smartypants' "$DOC" -rnopants -rpants
+render 'table of contents' "$DOC" -rtoc
+render 'cdata' "$DOC" -rcdata
+render 'no links or images' "$DOC" -rnolinks -rnoimage
+render 'strikethrough' "$DOC" -rnostrikethrough
+render 'safe links' "[a](javascript:x) and [b](http://x)" -rsafelink -r
+render 'several at once' "$DOC" -rtoc,nopants,cdata -rtoc -r -rnopants
+
+render 'compiled without html' "$DOC" -fnohtml -r -rtoc -rnopants
+render 'compiled without tables' 'a | b
+--|--
+c | d' -fnotables -r -rnopants
+
+render 'footnotes' 'one[^1] and two[^2], one[^1] again
+
+[^1]: the first note
+[^2]: the *second* note' -ffootnote -r -rnopants -rtoc
+
+render 'footnotes rendered twice' 'a[^2] b[^1]
+
+[^1]: one
+[^2]: two' -ffootnote -r -r
+
+render 'engine defaults' "$DOC" -etoc,nopants -r
+render 'engine defaults overridden' "$DOC" -etoc,nopants -rcdata -r -rtoc
+render 'engine defaults with footnotes' 'a[^1]
+
+[^1]: note' -ffootnote -etoc -r -rnopants
+
+summary $0
+exit $rc
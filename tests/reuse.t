@@ -0,0 +1,102 @@
+. tests/functions.sh
+
+title "reusing documents"
+
+rc=0
+MARKDOWN_FLAGS=
+
+# convert some documents (separated by @@ lines) in documents that are
+# reused, and in documents from the pool, and make sure they come out
+# the same as they do in new documents.
+#
+reuse() {
+    unset FLAGS
+    while [ "$1" ]; do
+	case "$1" in
+	-*) FLAGS="$FLAGS $1"
+	    shift ;;
+	*) break ;;
+	esac
+    done
+
+    __tests=`expr $__tests + 1`
+    test "$VERBOSE" && ./echo -n `./echo -n "  $1" '........................................................' | ./cols 50`
+
+    name="$1"
+    src="$2"
+    ./echo "$2" > $$.md
+    shift 2
+    ./reuse $FLAGS "$@" < $$.md > $$.g 2>&1
+
+    if [ "`cat $$.g`" = "ok" ]; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z  "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$name"
+	fi
+	./echo "source:"
+	./echo "$src" | sed -e 's/^/	/'
+	./echo "diff:"
+	sed -e 's/^/	/' $$.g
+	rc=1
+    fi
+    rm -f $$.md $$.g
+}
+
+DOCS='% a title
+% an author
+% a date
+
+# a header
+
+a *paragraph* with a [link][] and a note[^1]
+
+[link]: /url "title"
+[^1]: the note
+@@
+## a different header
+
+* a
+* list
+
+<tag>not a block</tag>
+@@
+[link]
+
+no definition for that link, and [^1] no note
+@@
+<style>
+p { color: red; }
+</style>
+
+a paragraph after some style
+@@
+
+@@
+| a | b |
+|---|---|
+| 1 | 2 |
+
+    code "here"'
+
+reuse 'no flags' "$DOCS"
+reuse 'footnotes' "$DOCS" -ffootnote
+reuse 'different flags for each document' "$DOCS" -ffootnote -ftoc -f -fnopants,nostyle,notables -fnoheader,footnote
+reuse 'more rounds' "$DOCS" -n5 -ftoc,footnote -fnohtml
+
+reuse 'footnotes in every document' 'one[^1]
+
+[^1]: the first note
+@@
+two[^1] and three[^2]
+
+[^1]: a second note
+[^2]: a third note
+@@
+none' -ffootnote -f -n4
+
+summary $0
+exit $rc
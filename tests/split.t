@@ -0,0 +1,139 @@
+. tests/functions.sh
+
+title "splitting a document into sections"
+
+rc=0
+MARKDOWN_FLAGS=
+
+# split a document into sections at each header level, and make sure
+# each one is what rendering just its blocks makes, and that what the
+# manifest says about its header is what's in the html.
+#
+sections() {
+    unset FLAGS
+    while [ "$1" ]; do
+	case "$1" in
+	-*) FLAGS="$FLAGS $1"
+	    shift ;;
+	*) break ;;
+	esac
+    done
+
+    __tests=`expr $__tests + 1`
+    test "$VERBOSE" && ./echo -n `./echo -n "  $1" '........................................................' | ./cols 50`
+
+    ./echo "$2" > $$.md
+    Q=`./splits $FLAGS < $$.md 2>&1`
+
+    if [ "$Q" = "ok" ]; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z  "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$1"
+	fi
+	./echo "$Q" | sed -e 's/^/	/'
+	rc=1
+    fi
+    rm -f $$.md
+}
+
+SECTIONS='# one
+
+text
+
+## one.one
+
+* a
+* list
+
+### one.one.one
+
+    code
+
+## one.two
+
+> # not a section
+
+* item
+
+  ## not one either
+
+# two
+
+text
+
+# three'
+
+NOTES='a[^1] and b[^2]
+
+# one
+
+c[^1], d[^3]
+
+## two
+
+e[^4]
+
+# three
+
+f[^2] and g[^5]
+
+[^1]: the first
+[^2]: the second
+[^3]: the third
+[^4]: the fourth
+[^5]: the fifth'
+
+sections 'sections' "$SECTIONS"
+sections -ftoc 'sections with a table of contents' "$SECTIONS"
+sections -ffootnotes 'footnotes' "$NOTES"
+sections -ffootnotes,toc 'footnotes with a table of contents' "$NOTES"
+sections 'footnotes turned off' "$NOTES"
+sections 'a pandoc header' "% title
+% author
+% date
+
+$SECTIONS"
+sections 'styles and definitions' '<style>
+p { }
+</style>
+
+[a link][l]
+
+[l]: http://l.com/
+
+# header
+
+<div>html</div>'
+sections 'headers with the same name' '# same
+
+text
+
+# same
+
+## same'
+sections 'text before the first header' 'text
+
+## two
+
+# one'
+sections 'headers with markup' '# *one* `two`
+
+text
+
+## "three" & <four>
+
+# [five](5.html)'
+sections -fsmarty 'headers with smartypants' '# "one" -- two...
+
+text
+
+# three'
+sections 'just a header' '# header'
+sections 'empty document' ''
+
+summary $0
+exit $rc
@@ -0,0 +1,134 @@
+. tests/functions.sh
+
+title "streaming"
+
+rc=0
+MARKDOWN_FLAGS=
+
+# stream a document with -B and make sure it comes out the same as it
+# does when it's compiled all at once.
+#
+stream() {
+    unset FLAGS
+    while [ "$1" ]; do
+	case "$1" in
+	-*) FLAGS="$FLAGS $1"
+	    shift ;;
+	*) break ;;
+	esac
+    done
+
+    __tests=`expr $__tests + 1`
+    test "$VERBOSE" && ./echo -n `./echo -n "  $1" '........................................................' | ./cols 50`
+
+    ./echo "$2" > $$.md
+    ./markdown $FLAGS $$.md > $$.w
+    ./markdown -B $FLAGS $$.md > $$.g
+
+    if cmp -s $$.w $$.g; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z  "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$1"
+	fi
+	./echo "source:"
+	./echo "$2" | sed -e 's/^/	/'
+	./echo "diff:"
+	diff $$.w $$.g | sed -e 's/^/	/'
+	rc=1
+    fi
+    rm -f $$.md $$.w $$.g
+}
+
+stream 'paragraphs' 'one
+
+two
+three
+
+
+four'
+
+stream 'references after use' '[a][] and [b][]
+
+more
+
+[a]: /a
+[b]: /b "title"'
+
+stream -ffootnote 'extra footnotes' 'a[^1] and b[^2]
+
+[^2]: second
+
+text
+
+[^1]: first'
+
+stream 'lists and quotes' '* a
+
+* b
+
+text
+
+> quote
+
+> more quote
+
+1. one
+
+2. two'
+
+stream 'code fences' '```
+code
+
+not a paragraph
+```
+
+text'
+
+stream 'code fence after a pandoc header' '% title
+% author
+% date
+```
+code
+
+not a paragraph
+```'
+
+stream 'html blocks' '<div>
+text
+
+more
+</div>
+
+<!-- a
+
+comment -->
+
+<div>a</div><div>
+b
+
+</div>
+after'
+
+stream 'pandoc header' '% title
+% author
+% date
+
+text'
+
+# a pipe can't be read twice
+__tests=`expr $__tests + 1`
+if ./echo text | ./markdown -B >/dev/null 2>&1; then
+    __failed=`expr $__failed + 1`
+    ./echo
+    ./echo "streaming from a pipe didn't fail"
+    rc=1
+else
+    __passed=`expr $__passed + 1`
+fi
+
+summary $0
+exit $rc
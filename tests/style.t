@@ -32,5 +32,21 @@ try -fnohtml 'unclosed with -fnohtml' '<style>foo' '<p>&lt;style>foo</p>'
 
 try -fnostyle 'disabling style blocks' "$ASK" "$ASK"
 
+NESTED='<div>
+<style>
+p { }
+</style>
+</div>'
+
+try 'nested in a div' "$NESTED" "$NESTED"
+
+try 'inside a blockquote' '> <style> ul {display:none;} </style>' \
+'<blockquote><p><style> ul {display:none;} </style></p></blockquote>'
+
+try 'inside a list' '* <style> ul {display:none;} </style>' \
+'<ul>
+<li><style> ul {display:none;} </style></li>
+</ul>'
+
 summary $0
 exit $rc
@@ -0,0 +1,89 @@
+. tests/functions.sh
+
+title "documents converted on more than one thread"
+
+rc=0
+MARKDOWN_FLAGS=
+
+# make a big document out of copies of a piece of markdown, with some
+# more markdown on the end, and make sure it comes out the same when
+# it's done on more than one thread as it does on one.
+#
+threaded() {
+    unset FLAGS
+    while [ "$1" ]; do
+	case "$1" in
+	-*) FLAGS="$FLAGS $1"
+	    shift ;;
+	*) break ;;
+	esac
+    done
+
+    __tests=`expr $__tests + 1`
+    test "$VERBOSE" && ./echo -n `./echo -n "  $1" '........................................................' | ./cols 50`
+
+    ./echo "$2" > $$.md
+    for x in 1 2 3 4 5 6 7 8 9 10; do
+	cat $$.md $$.md > $$.w
+	mv $$.w $$.md
+    done
+    ./echo "$3" >> $$.md
+    ./threads $FLAGS < $$.md > $$.g 2>&1
+
+    if [ "`cat $$.g`" = "ok" ]; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z  "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$1"
+	fi
+	./echo "source:"
+	./echo "$2" | sed -e 's/^/	/'
+	./echo "$3" | sed -e 's/^/	/'
+	./echo "diff:"
+	sed -e 's/^/	/' $$.g
+	rc=1
+    fi
+    rm -f $$.md $$.w $$.g
+}
+
+threaded -t4 'paragraphs and lists' '# a header
+
+some *text* with a [link][a] and `code`,
+over two lines
+
+* one
+* two
+
+    code
+
+> a quote
+
+1. three' ''
+
+threaded -t4 -ffootnote -ftoc 'footnotes and references at the end' '## section
+
+a paragraph[^1] with a [reference][r] and another[^2]
+
+* an item[^3]
+
+| a | b |
+|---|---|
+| [r][] | [^1] |
+
+<div>
+html
+</div>
+' '[r]: /r "title"
+[^1]: the first footnote
+[^2]: the *second*
+[^3]: the third'
+
+threaded -t3 -ffootnote 'more threads than pieces' 'text[^1]
+
+' '[^1]: note'
+
+summary $0
+exit $rc
@@ -38,6 +38,91 @@ hi' \
 </ul>
 <h1 id="L1.header">1 header</h1>'
 
+    try '-T -ftoc' 'toc items with the same name' \
+    '#A
+#A' \
+'<ul>
+ <li><a href="#A">A</a></li>
+ <li><a href="#A-1">A</a></li>
+</ul>
+<h1 id="A">A</h1>
+
+<h1 id="A-1">A</h1>'
+
+    try '-T -ftoc' 'toc items with code spans' \
+    '#`nil` or `NilClass`' \
+'<ul>
+ <li><a href="#nil.or.NilClass"><code>nil</code> or <code>NilClass</code></a></li>
+</ul>
+<h1 id="nil.or.NilClass"><code>nil</code> or <code>NilClass</code></h1>'
+
+    try '-T -ftoc' 'toc items with emphasis' \
+    '#some *emphasis* __here__' \
+'<ul>
+ <li><a href="#some.emphasis.here">some <em>emphasis</em> <strong>here</strong></a></li>
+</ul>
+<h1 id="some.emphasis.here">some <em>emphasis</em> <strong>here</strong></h1>'
+
+    try '-T -ftoc' 'toc items with ampersands' \
+    '#DAP & CDP
+#AT&amp;T' \
+'<ul>
+ <li><a href="#DAP...CDP">DAP &amp; CDP</a></li>
+ <li><a href="#AT.amp.T">AT&amp;T</a></li>
+</ul>
+<h1 id="DAP...CDP">DAP &amp; CDP</h1>
+
+<h1 id="AT.amp.T">AT&amp;T</h1>'
+
+    try '-T -ftoc' 'toc skips headers in blockquotes' \
+    '#A
+
+> ##Q' \
+'<ul>
+ <li><a href="#A">A</a></li>
+</ul>
+<h1 id="A">A</h1>
+
+<blockquote><h2 id="Q">Q</h2></blockquote>'
+
+    try '-T -ftoc' 'toc skips headers in lists' \
+    '#A
+
+* x
+
+  ##L' \
+'<ul>
+ <li><a href="#A">A</a></li>
+</ul>
+<h1 id="A">A</h1>
+
+<ul>
+<li><p>x</p>
+
+<h2 id="L">L</h2></li>
+</ul>'
+
+    try '-T -ftoc' 'nested headers with the same name' \
+    '#A
+
+> #A
+
+* x
+
+  #A' \
+'<ul>
+ <li><a href="#A">A</a></li>
+</ul>
+<h1 id="A">A</h1>
+
+<blockquote><h1 id="A-1">A</h1></blockquote>
+
+<ul>
+<li><p>x</p>
+
+<h1 id="A-2">A</h1></li>
+</ul>'
+
 else
     # new-style; uses a (depreciated) name=
     # inside a null <a> tag
@@ -74,6 +159,104 @@ hi' \
 </ul>
 <a name="L1.header"></a>
 <h1>1 header</h1>'
+
+    try '-T -ftoc' 'toc items with the same name' \
+    '#A
+#A' \
+'<ul>
+ <li><a href="#A">A</a></li>
+ <li><a href="#A-1">A</a></li>
+</ul>
+<a name="A"></a>
+<h1>A</h1>
+
+<a name="A-1"></a>
+<h1>A</h1>'
+
+    try '-T -ftoc' 'toc items with code spans' \
+    '#`nil` or `NilClass`' \
+'<ul>
+ <li><a href="#nil.or.NilClass"><code>nil</code> or <code>NilClass</code></a></li>
+</ul>
+<a name="nil.or.NilClass"></a>
+<h1><code>nil</code> or <code>NilClass</code></h1>'
+
+    try '-T -ftoc' 'toc items with emphasis' \
+    '#some *emphasis* __here__' \
+'<ul>
+ <li><a href="#some.emphasis.here">some <em>emphasis</em> <strong>here</strong></a></li>
+</ul>
+<a name="some.emphasis.here"></a>
+<h1>some <em>emphasis</em> <strong>here</strong></h1>'
+
+    try '-T -ftoc' 'toc items with ampersands' \
+    '#DAP & CDP
+#AT&amp;T' \
+'<ul>
+ <li><a href="#DAP...CDP">DAP &amp; CDP</a></li>
+ <li><a href="#AT.amp.T">AT&amp;T</a></li>
+</ul>
+<a name="DAP...CDP"></a>
+<h1>DAP &amp; CDP</h1>
+
+<a name="AT.amp.T"></a>
+<h1>AT&amp;T</h1>'
+
+    try '-T -ftoc' 'toc skips headers in blockquotes' \
+    '#A
+
+> ##Q' \
+'<ul>
+ <li><a href="#A">A</a></li>
+</ul>
+<a name="A"></a>
+<h1>A</h1>
+
+<blockquote><a name="Q"></a>
+<h2>Q</h2></blockquote>'
+
+    try '-T -ftoc' 'toc skips headers in lists' \
+    '#A
+
+* x
+
+  ##L' \
+'<ul>
+ <li><a href="#A">A</a></li>
+</ul>
+<a name="A"></a>
+<h1>A</h1>
+
+<ul>
+<li><p>x</p>
+
+<a name="L"></a>
+<h2>L</h2></li>
+</ul>'
+
+    try '-T -ftoc' 'nested headers with the same name' \
+    '#A
+
+> #A
+
+* x
+
+  #A' \
+'<ul>
+ <li><a href="#A">A</a></li>
+</ul>
+<a name="A"></a>
+<h1>A</h1>
+
+<blockquote><a name="A-1"></a>
+<h1>A</h1></blockquote>
+
+<ul>
+<li><p>x</p>
+
+<a name="A-2"></a>
+<h1>A</h1></li>
+</ul>'
 fi
 
 summary $0
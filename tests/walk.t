@@ -0,0 +1,115 @@
+. tests/functions.sh
+
+title "walking a document"
+
+rc=0
+MARKDOWN_FLAGS=
+
+# make sure mkd_walk() sends the nodes of a document in the order a
+# walk of the tree from mkd_ast() finds them, and stops when it's told
+# to.
+#
+walk() {
+    unset FLAGS
+    while [ "$1" ]; do
+	case "$1" in
+	-*) FLAGS="$FLAGS $1"
+	    shift ;;
+	*) break ;;
+	esac
+    done
+
+    __tests=`expr $__tests + 1`
+    test "$VERBOSE" && ./echo -n `./echo -n "  $1" '........................................................' | ./cols 50`
+
+    ./echo "$2" > $$.md
+    Q=`./rewalk $FLAGS < $$.md 2>&1`
+
+    if [ "$Q" = "ok" ]; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z  "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$1"
+	fi
+	./echo "$Q" | sed -e 's/^/	/'
+	rc=1
+    fi
+    rm -f $$.md
+}
+
+walk 'empty document' ''
+
+walk 'paragraphs and emphasis' 'one *two* __three__
+
+***four*** `five`  
+six ~~seven~~ a^b'
+
+walk 'headers' '# one #
+
+two
+===
+
+### three'
+
+walk 'nested lists and quotes' '* a
+    * b
+        1. c
+        2. d
+* e
+
+> quoted
+>
+> > twice
+> > * with a list
+
+a. alpha
+b. list'
+
+walk 'code and html' '    code
+    more code
+
+<div>
+html
+</div>
+
+<style>
+p { color: red; }
+</style>
+
+text <b>tag</b> <!-- comment -->
+
+---'
+
+walk 'links and images' '[a](/url "title") ![b](/img =10x20 "pic")
+[ref][] and [ref], <http://example.com>, [esc\\aped](/a\\_b)
+
+[ref]: /ref "ref title"'
+
+walk 'tables' '| a | b  | c |
+|:--|:--:|--:|
+| 1 | *2* | 3 |
+| 4 | 5 | `6` |'
+
+walk 'definition lists' '=term=
+    the definition
+
+another
+: with a definition'
+
+walk -ffootnote 'footnotes' 'one[^1] two[^2] again[^1]
+
+* in a list[^3]
+
+[^1]: the *first*
+[^2]: the second
+[^3]: the third
+[^4]: not used'
+
+walk 'divquote' '> %class%
+> in a div'
+
+summary $0
+exit $rc
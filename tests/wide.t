@@ -0,0 +1,92 @@
+. tests/functions.sh
+
+title "64-bit sizes"
+
+rc=0
+MARKDOWN_FLAGS=
+
+# convert a document with mkd_string64() and mkd_document64(), and with
+# mkd_generatehtml(), and make sure it comes out the same as it does
+# with mkd_string() and mkd_document().   If there's a third argument,
+# the document is doubled that many times first.
+#
+wide() {
+    unset FLAGS
+    while [ "$1" ]; do
+	case "$1" in
+	-*) FLAGS="$FLAGS $1"
+	    shift ;;
+	*) break ;;
+	esac
+    done
+
+    __tests=`expr $__tests + 1`
+    test "$VERBOSE" && ./echo -n `./echo -n "  $1" '........................................................' | ./cols 50`
+
+    ./echo "$2" > $$.md
+    count=${3:-0}
+    while [ $count -gt 0 ]; do
+	cat $$.md $$.md > $$.w
+	mv $$.w $$.md
+	count=`expr $count - 1`
+    done
+    ./wide $FLAGS < $$.md > $$.g 2>&1
+
+    if [ "`cat $$.g`" = "ok" ]; then
+	__passed=`expr $__passed + 1`
+	test $VERBOSE && ./echo " ok"
+    else
+	__failed=`expr $__failed + 1`
+	if [ -z  "$VERBOSE" ]; then
+	    ./echo
+	    ./echo "$1"
+	fi
+	./echo "source:"
+	./echo "$2" | sed -e 's/^/	/'
+	./echo "diff:"
+	sed -e 's/^/	/' $$.g
+	rc=1
+    fi
+    rm -f $$.md $$.w $$.g
+}
+
+wide 'empty document' ''
+
+wide 'paragraphs and lists' 'a *paragraph*
+
+* one
+* two
+
+    code'
+
+wide -ffootnote 'footnotes' 'text[^1] and [a link][a]
+
+[a]: /a
+[^1]: a note'
+
+wide -fcdata 'cdata' 'a <b>tag</b> & "quotes"'
+
+# big enough that the html is written in more than one segment
+#
+wide 'more than one segment' '# a header
+
+a *paragraph* with a [link](/url) in it, and `code`
+
+* one
+* two
+
+> a quote' 10
+
+wide -ffootnote 'footnotes in more than one segment' 'text[^1] and [a link][a],
+and text[^2]
+
+[a]: /a
+[^1]: a note
+[^2]: another' 10
+
+wide -fcdata 'cdata in more than one segment' 'a <b>tag</b> & "quotes"
+
+    <code> & more' 11
+
+summary $0
+exit $rc
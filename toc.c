@@ -9,22 +9,136 @@
 #include "config.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 
 #include "cstring.h"
 #include "markdown.h"
 #include "amalloc.h"
 
+/* get the label of a header, and the anchor it was given when the
+ * document was compiled
+ */
+void
+___mkd_header(Paragraph *p, int top, Header *h)
+{
+    char *anchor = p->anchor ? p->anchor : "";
+    int size = EOF;
+    char *text = 0;
+
+    if ( p->text )
+	size = mkd_line(T(p->text->text), S(p->text->text), &text, IS_LABEL);
+    if ( size < 0 ) {
+	size = 0;
+	text = calloc(1, 1);
+    }
+
+    h->hnumber = p->hnumber;
+    h->top = top;
+    h->text = text;
+    h->textsize = size;
+    h->anchor = strdup(anchor);
+    h->anchorsize = strlen(anchor);
+}
+
+
+void
+___mkd_freeheaders(Header *h, int count)
+{
+    int i;
+
+    for ( i=0; i < count; i++ ) {
+	free(h[i].text);
+	free(h[i].anchor);
+    }
+}
+
+
+/* get the headers of a document out of its index (or, with `toconly`
+ * set, just the ones that go in the table of contents) into a list
+ * allocated with malloc().   Returns how many there are.
+ */
+int
+___mkd_headers(Document *d, int toconly, Header **res)
+{
+    Paragraphs *list = toconly ? &d->index.toc : &d->index.headers;
+    STRING(Header) headers;
+    Paragraph *p;
+    int i, j, top;
+
+    CREATE(headers);
+    for ( i = j = 0; i < S(*list); i++ ) {
+	p = T(*list)[i];
+
+	/* the toc is in the same order as the headers */
+	if ( (top = (j < S(d->index.toc)) && (T(d->index.toc)[j] == p)) )
+	    j++;
+
+	if ( p->text )
+	    ___mkd_header(p, top, &EXPAND(headers));
+    }
+    *res = T(headers);
+    return S(headers);
+}
+
+
+/* write an header index out of the top-level headers in a list
+ */
+void
+___mkd_tocwrite(Cstring *res, Header *h, int count)
+{
+    int last_hnumber = 0;
+    int first = 1;
+    int i;
+
+    for ( i=0; i < count; i++ ) {
+	if ( !h[i].top )
+	    continue;
+
+	while ( last_hnumber > h[i].hnumber ) {
+	    if ( (last_hnumber - h[i].hnumber) > 1 )
+		    Csprintf(res, "\n");
+	    Csprintf(res, "</li>\n%*s</ul>\n%*s",
+		     last_hnumber-1, "", last_hnumber-1, "");
+	    --last_hnumber;
+	}
+
+	if ( last_hnumber == h[i].hnumber )
+	    Csprintf(res, "</li>\n");
+	else if ( (h[i].hnumber > last_hnumber) && !first )
+	    Csprintf(res, "\n");
+
+	while ( h[i].hnumber > last_hnumber ) {
+	    Csprintf(res, "%*s<ul>\n", last_hnumber, "");
+	    if ( (h[i].hnumber - last_hnumber) > 1 )
+		Csprintf(res, "%*s<li>\n", last_hnumber+1, "");
+	    ++last_hnumber;
+	}
+	Csprintf(res, "%*s<li><a href=\"#", h[i].hnumber, "");
+	Cswrite(res, h[i].anchor, h[i].anchorsize);
+	Csprintf(res, "\">");
+	Cswrite(res, h[i].text, h[i].textsize);
+	Csprintf(res, "</a>");
+
+	first = 0;
+    }
+
+    while ( last_hnumber > 0 ) {
+	--last_hnumber;
+	Csprintf(res, "</li>\n%*s</ul>\n%*s",
+		 last_hnumber, "", last_hnumber, "");
+    }
+}
+
+
 /* write an header index
  */
 int
 mkd_toc(Document *p, char **doc)
 {
-    Paragraph *tp, *srcp;
-    int last_hnumber = 0;
+    Header *headers;
     Cstring res;
-    int size;
-    int first = 1;
+    int size, count;
     
     if ( !(doc && p && p->ctx) ) return -1;
 
@@ -32,54 +146,14 @@ mkd_toc(Document *p, char **doc)
     
     if ( ! (p->ctx->flags & MKD_TOC) ) return 0;
 
+    count = ___mkd_headers(p, 1, &headers);
+
     CREATE(res);
     RESERVE(res, 100);
-
-    for ( tp = p->code; tp ; tp = tp->next ) {
-	if ( tp->typ == SOURCE ) {
-	    for ( srcp = tp->down; srcp; srcp = srcp->next ) {
-		if ( srcp->typ == HDR && srcp->text ) {
-	    
-		    while ( last_hnumber > srcp->hnumber ) {
-			if ( (last_hnumber - srcp->hnumber) > 1 )
-				Csprintf(&res, "\n");
-			Csprintf(&res, "</li>\n%*s</ul>\n%*s",
-				 last_hnumber-1, "", last_hnumber-1, "");
-			--last_hnumber;
-		    }
-
-		    if ( last_hnumber == srcp->hnumber )
-			Csprintf(&res, "</li>\n");
-		    else if ( (srcp->hnumber > last_hnumber) && !first )
-			Csprintf(&res, "\n");
-
-		    while ( srcp->hnumber > last_hnumber ) {
-			Csprintf(&res, "%*s<ul>\n", last_hnumber, "");
-			if ( (srcp->hnumber - last_hnumber) > 1 )
-			    Csprintf(&res, "%*s<li>\n", last_hnumber+1, "");
-			++last_hnumber;
-		    }
-		    Csprintf(&res, "%*s<li><a href=\"#", srcp->hnumber, "");
-		    mkd_string_to_anchor(T(srcp->text->text),
-					 S(srcp->text->text),
-					 (mkd_sta_function_t)Csputc, &res,1);
-		    Csprintf(&res, "\">");
-		    mkd_string_to_anchor(T(srcp->text->text),
-					 S(srcp->text->text),
-					 (mkd_sta_function_t)Csputc, &res,0);
-		    Csprintf(&res, "</a>");
-
-		    first = 0;
-		}
-	    }
-        }
-    }
-
-    while ( last_hnumber > 0 ) {
-	--last_hnumber;
-	Csprintf(&res, "</li>\n%*s</ul>\n%*s",
-		 last_hnumber, "", last_hnumber, "");
-    }
+    ___mkd_tocwrite(&res, headers, count);
+    ___mkd_freeheaders(headers, count);
+    if ( headers )
+	free(headers);
 
     if ( (size = S(res)) > 0 ) {
 	EXPAND(res) = 0;
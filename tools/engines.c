@@ -0,0 +1,197 @@
+/*
+ * engines: convert a document with two engines that have different
+ * extra tags and raw delimiters, and with the default engine, all at
+ * the same time, and write out what each made of it (for
+ * tests/engine.t.)   Engine a knows <ATAG> and the html5 tags, and
+ * wraps $$ in <math>;  engine b knows <BTAG>, wraps $$ in <tt>, and
+ * wraps @@ in <code>.   With -z, check that engines refuse to be
+ * changed once they're frozen instead, and print "ok" if they do.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mkdio.h"
+#include "pgm_options.h"
+
+static mkd_flag_t flags = 0;
+static int failed = 0;
+
+static void
+expect(char *what, int ok)
+{
+    if ( !ok ) {
+	printf("%s\n", what);
+	failed = 1;
+    }
+}
+
+
+static char *
+html(mkd_engine *e, char *src, int *len)
+{
+    MMIOT *doc;
+    char *res, *copy;
+
+    if ( e )
+	doc = mkd_engine_string(e, src, strlen(src), flags);
+    else
+	doc = mkd_string(src, strlen(src), flags);
+
+    if ( !doc || !mkd_compile(doc, flags) || ((*len = mkd_document(doc, &res)) < 0) ) {
+	fprintf(stderr, "can't compile the document\n");
+	exit(1);
+    }
+    copy = malloc(*len + 1);
+    memcpy(copy, res, *len);
+    copy[*len] = 0;
+    mkd_cleanup(doc);
+    return copy;
+}
+
+
+/* try to change an engine that's frozen
+ */
+static void
+refuses(char *why, mkd_engine *e)
+{
+    static char raw[] = "|~~|~~|<s>|</s>";
+    char what[80];
+
+    sprintf(what, "%s: mkd_engine_define_tag worked", why);
+    expect(what, mkd_engine_define_tag(e, "YTAG", 0) < 0);
+    sprintf(what, "%s: mkd_engine_html5_tags worked", why);
+    expect(what, mkd_engine_html5_tags(e) < 0);
+    sprintf(what, "%s: mkd_engine_raw worked", why);
+    expect(what, mkd_engine_raw(e, raw) < 0);
+    sprintf(what, "%s: mkd_engine_seed worked", why);
+    expect(what, mkd_engine_seed(e, 2) < 0);
+    sprintf(what, "%s: mkd_engine_cache worked", why);
+    expect(what, mkd_engine_cache(e, 1000) < 0);
+}
+
+
+static void
+frozen()
+{
+    static char raw[] = "|$$|$$|<math>|</math>";
+    char *src = "<ZTAG>\n*z*\n</ZTAG>\n\n<YTAG>\n*y*\n</YTAG>\n\n<aside>\n*x*\n</aside>\n\n$$*m*$$ ~~*s*~~\n";
+    char *before, *after;
+    int blen, alen;
+    mkd_engine *e;
+    MMIOT *doc;
+    FILE *f;
+
+    /* an engine that hasn't been used yet can be changed
+     */
+    e = mkd_engine_new(0);
+    expect("mkd_engine_define_tag didn't work", mkd_engine_define_tag(e, "ZTAG", 0) == 0);
+    expect("mkd_engine_raw didn't work", mkd_engine_raw(e, raw) > 0);
+    expect("mkd_engine_seed didn't work", mkd_engine_seed(e, 1) == 0);
+
+    /* but not after it's made a document
+     */
+    before = html(e, src, &blen);
+    refuses("after mkd_engine_string", e);
+    after = html(e, src, &alen);
+    if ( (alen != blen) || (memcmp(before, after, alen) != 0) ) {
+	printf("a frozen engine was changed\nbefore:\n%s\nafter:\n%s\n", before, after);
+	failed = 1;
+    }
+    free(before);
+    free(after);
+    mkd_engine_free(e);
+
+    e = mkd_engine_new(0);
+    mkd_engine_freeze(e);
+    mkd_engine_freeze(e);
+    refuses("after mkd_engine_freeze", e);
+    mkd_engine_free(e);
+
+    e = mkd_engine_new(0);
+    if ( !(f = tmpfile()) ) {
+	perror("tmpfile");
+	exit(1);
+    }
+    fputs(src, f);
+    rewind(f);
+    doc = mkd_engine_in(e, f, flags);
+    fclose(f);
+    refuses("after mkd_engine_in", e);
+    mkd_cleanup(doc);
+    mkd_engine_free(e);
+}
+
+
+main(argc, argv)
+char **argv;
+{
+    static char rawa[] = "|$$|$$|<math>|</math>";
+    static char rawb[] = "|$$|$$|<tt>|</tt>";
+    static char rawc[] = "|@@|@@|<code>|</code>";
+    mkd_engine *a, *b;
+    MMIOT *doc[3];
+    char *src = 0, *res;
+    int i, c, size = 0, cap = 0, len, z = 0;
+
+    for ( i=1; i < argc; i++ ) {
+	if ( (strncmp(argv[i], "-f", 2) == 0) && set_flag(&flags, argv[i]+2) )
+	    continue;
+	if ( strcmp(argv[i], "-z") == 0 )
+	    z = 1;
+	else {
+	    fprintf(stderr, "usage: %s [-fflags] [-z] < markdown\n", argv[0]);
+	    exit(1);
+	}
+    }
+
+    if ( z ) {
+	frozen();
+	if ( failed )
+	    exit(1);
+	puts("ok");
+	exit(0);
+    }
+
+    while ( (c = getchar()) != EOF ) {
+	if ( size >= cap )
+	    src = realloc(src, cap = 2*cap + 100);
+	src[size++] = c;
+    }
+    if ( !src )
+	src = "";
+
+    a = mkd_engine_new(0);
+    b = mkd_engine_new(0);
+    if ( (mkd_engine_define_tag(a, "ATAG", 0) < 0) || (mkd_engine_html5_tags(a) < 0)
+		|| (mkd_engine_raw(a, rawa) < 0) || (mkd_engine_define_tag(b, "BTAG", 0) < 0)
+		|| (mkd_engine_raw(b, rawb) < 0) || (mkd_engine_raw(b, rawc) < 0) ) {
+	fprintf(stderr, "%s: can't set up the engines\n", argv[0]);
+	exit(1);
+    }
+
+    /* make all the documents before any of them are compiled, and
+     * compile them all before any of them are rendered
+     */
+    doc[0] = mkd_engine_string(a, src, size, flags);
+    doc[1] = mkd_engine_string(b, src, size, flags);
+    doc[2] = mkd_string(src, size, flags);
+    for ( i=0; i < 3; i++ )
+	if ( !doc[i] || !mkd_compile(doc[i], flags) ) {
+	    fprintf(stderr, "%s: can't compile the document\n", argv[0]);
+	    exit(1);
+	}
+    for ( i=0; i < 3; i++ ) {
+	printf("%s:\n", (i == 0) ? "a" : (i == 1) ? "b" : "default");
+	if ( (len = mkd_document(doc[i], &res)) > 0 )
+	    fwrite(res, 1, len, stdout);
+	putchar('\n');
+    }
+
+    for ( i=0; i < 3; i++ )
+	mkd_cleanup(doc[i]);
+    mkd_engine_free(a);
+    mkd_engine_free(b);
+    exit(0);
+}
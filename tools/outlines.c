@@ -0,0 +1,90 @@
+/*
+ * outlines: write out the outline mkd_outline() makes of a document,
+ * one entry a line, as the line it's on, what it is, and what it says
+ * (for tests/outline.t.)   Headers are written as hN, their anchor (or
+ * - if they don't have one,) and their text;  links and images as link
+ * or image and the url;  and definitions as ref, the label, and the
+ * url.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mkdio.h"
+#include "pgm_options.h"
+
+static mkd_flag_t flags = 0;
+
+
+main(argc, argv)
+char **argv;
+{
+    MMIOT *doc;
+    mkd_outline_t *out, *o;
+    char *src = 0;
+    int i, c, n, size = 0, cap = 0;
+
+    for ( i=1; i < argc; i++ ) {
+	if ( (strncmp(argv[i], "-f", 2) == 0) && set_flag(&flags, argv[i]+2) )
+	    continue;
+	fprintf(stderr, "usage: %s [-fflags] < document\n", argv[0]);
+	exit(1);
+    }
+
+    while ( (c = getchar()) != EOF ) {
+	if ( size >= cap )
+	    src = realloc(src, cap = 2*cap + 100);
+	src[size++] = c;
+    }
+
+    if ( !(doc = mkd_string(src, size, flags)) ) {
+	fprintf(stderr, "can't read the document\n");
+	exit(1);
+    }
+    if ( mkd_outline(doc, &out) != EOF ) {
+	printf("an outline of a document that isn't compiled\n");
+	exit(1);
+    }
+    if ( !mkd_compile(doc, flags) ) {
+	fprintf(stderr, "can't compile the document\n");
+	exit(1);
+    }
+    if ( (n = mkd_outline(doc, &out)) < 0 ) {
+	printf("no outline\n");
+	exit(1);
+    }
+
+    for ( i=0; i < n; i++ ) {
+	o = &out[i];
+
+	if ( (o->text == 0) || (strlen(o->text) != o->size) ) {
+	    printf("%d: the text isn't %d bytes long\n", o->line, o->size);
+	    exit(1);
+	}
+
+	switch ( o->type ) {
+	case MKD_OUTLINE_HEADER:
+	    printf("%d h%d %s %s\n", o->line, o->hnumber,
+				     o->anchor ? o->anchor : "-", o->text);
+	    break;
+	case MKD_OUTLINE_LINK:
+	    printf("%d link %s\n", o->line, o->text);
+	    break;
+	case MKD_OUTLINE_IMAGE:
+	    printf("%d image %s\n", o->line, o->text);
+	    break;
+	case MKD_OUTLINE_REF:
+	    printf("%d ref [%.*s] %s\n", o->line, o->labelsize, o->label, o->text);
+	    break;
+	default:
+	    printf("%d what is %d?\n", o->line, o->type);
+	    break;
+	}
+    }
+
+    free(out);
+    mkd_cleanup(doc);
+    free(src);
+    exit(0);
+}
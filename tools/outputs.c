@@ -0,0 +1,193 @@
+/*
+ * outputs: get everything about a document from mkd_outputs(), and
+ * check that the html, the table of contents, and the css are what
+ * mkd_document(), mkd_toc(), and mkd_css() say they are, and that the
+ * headers are the ones in the html, with the anchors the html gives
+ * them (for tests/outputs.t.)   Prints "ok", or what was different.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mkdio.h"
+#include "pgm_options.h"
+
+static mkd_flag_t flags = 0;
+static char *src = 0;
+static int size = 0;
+
+static MMIOT *
+compile()
+{
+    MMIOT *doc;
+
+    if ( !(doc = mkd_string(src, size, flags)) || !mkd_compile(doc, flags) ) {
+	fprintf(stderr, "can't compile the document\n");
+	exit(1);
+    }
+    return doc;
+}
+
+
+static void
+differs(char *what, char *a, int ha, char *b, int hb)
+{
+    if ( (ha == hb) && ((ha == 0) || (memcmp(a, b, ha) == 0)) )
+	return;
+    printf("%s differs\nsource:\n%.*s\n%s:\n%.*s\nmkd_outputs:\n%.*s\n",
+	    what, size, src, what, ha, a ? a : "", hb, b ? b : "");
+    exit(1);
+}
+
+
+static void
+samestring(char *what, char *a, char *b)
+{
+    if ( (a == 0) != (b == 0) || (a && strcmp(a, b) != 0) ) {
+	printf("%s differs: <%s> vs <%s>\n", what, a ? a : "(null)", b ? b : "(null)");
+	exit(1);
+    }
+}
+
+
+/* find the next header in the html, and what it's called and says
+ */
+static char *
+header(char *html, char *end, int *level, char **anchor, int *anchorsize, char **text, int *textsize)
+{
+    char *p, *q, *name;
+
+    for ( p = html; p+3 < end; p++ )
+	if ( (p[0] == '<') && (p[1] == 'h') && (p[2] >= '1') && (p[2] <= '6')
+				&& ((p[3] == '>') || (p[3] == ' ')) )
+	    break;
+    if ( p+3 >= end )
+	return 0;
+    *level = p[2] - '0';
+
+    /* either <hN id="anchor"> or <a name="anchor"></a> in front of it */
+    *anchor = 0;
+    *anchorsize = 0;
+    if ( strncmp(p+3, " id=\"", 5) == 0 )
+	name = p+8;
+    else {
+	for ( name = p; (name > html) && (name[-1] == '\n'); --name )
+	    ;
+	name -= 4;
+	if ( (name >= html) && (strncmp(name, "</a>", 4) == 0) ) {
+	    while ( (name > html) && (strncmp(name, "<a name=\"", 9) != 0) )
+		--name;
+	    name += 9;
+	}
+	else
+	    name = 0;
+    }
+    if ( name && (q = strchr(name, '"')) ) {
+	*anchor = name;
+	*anchorsize = q - name;
+    }
+
+    /* and what's in it */
+    *text = strchr(p, '>')+1;
+    for ( p = *text; (p < end) && (strncmp(p, "</h", 3) != 0); p++ )
+	;
+    *textsize = p - *text;
+    return p;
+}
+
+
+main(argc, argv)
+char **argv;
+{
+    MMIOT *doc, *other;
+    mkd_outputs_t out;
+    char *html, *toc, *css, *p, *end, *anchor, *text, ref[200];
+    int i, c, cap = 0, len, tlen, clen, level, asize, tsize, intoc;
+
+    for ( i=1; i < argc; i++ )
+	if ( (strncmp(argv[i], "-f", 2) != 0) || !set_flag(&flags, argv[i]+2) ) {
+	    fprintf(stderr, "usage: %s [-fflags] < markdown\n", argv[0]);
+	    exit(1);
+	}
+
+    while ( (c = getchar()) != EOF ) {
+	if ( size >= cap )
+	    src = realloc(src, cap = 2*cap + 100);
+	src[size++] = c;
+    }
+    if ( !src )
+	src = "";
+
+    doc = compile();
+    if ( mkd_outputs(doc, &out) < 0 ) {
+	printf("mkd_outputs failed\n");
+	exit(1);
+    }
+
+    other = compile();
+    if ( (len = mkd_document(other, &html)) < 0 )
+	len = 0;
+    differs("mkd_document", html, len, out.html, out.htmlsize);
+    samestring("the title", mkd_doc_title(other), out.title);
+    samestring("the author", mkd_doc_author(other), out.author);
+    samestring("the date", mkd_doc_date(other), out.date);
+    mkd_cleanup(other);
+
+    other = compile();
+    if ( (tlen = mkd_toc(other, &toc)) < 0 )
+	tlen = 0;
+    differs("mkd_toc", toc, tlen, out.toc, out.tocsize);
+    if ( (clen = mkd_css(other, &css)) < 0 )
+	clen = 0;
+    differs("mkd_css", css, clen, out.css, out.csssize);
+
+    /* each header is the next one in the html */
+    end = out.html + out.htmlsize;
+    for ( p = out.html, i=0; (p = header(p, end, &level, &anchor, &asize, &text, &tsize)); i++ ) {
+	if ( i >= out.nheaders ) {
+	    printf("header %d (%.*s) is missing\n", i, tsize, text);
+	    exit(1);
+	}
+	if ( (level != out.headers[i].hnumber)
+		|| (tsize != out.headers[i].textsize)
+		|| memcmp(text, out.headers[i].text, tsize) != 0 ) {
+	    printf("header %d is <h%d>%.*s, not <h%d>%.*s\n", i,
+		    level, tsize, text, out.headers[i].hnumber,
+		    out.headers[i].textsize, out.headers[i].text);
+	    exit(1);
+	}
+	if ( (flags & MKD_TOC) && ((asize != out.headers[i].anchorsize)
+			|| memcmp(anchor, out.headers[i].anchor, asize) != 0) ) {
+	    printf("header %d (%.*s) is called <%.*s> in the html, not <%.*s>\n", i,
+		    tsize, text, asize, anchor ? anchor : "",
+		    out.headers[i].anchorsize, out.headers[i].anchor);
+	    exit(1);
+	}
+
+	/* and it's in the table of contents if it's at the top */
+	if ( flags & MKD_TOC ) {
+	    snprintf(ref, sizeof ref, "href=\"#%.*s\"", out.headers[i].anchorsize,
+							out.headers[i].anchor);
+	    intoc = toc && (strstr(toc, ref) != 0);
+	    if ( intoc != out.headers[i].top ) {
+		printf("header %d (%.*s) is %sin the table of contents\n", i, tsize, text,
+			intoc ? "" : "not ");
+		exit(1);
+	    }
+	}
+    }
+    if ( i != out.nheaders ) {
+	printf("mkd_outputs found %d headers, but the html has %d\n", out.nheaders, i);
+	exit(1);
+    }
+
+    mkd_free_outputs(&out);
+    if ( out.headers || out.toc || out.css || out.html ) {
+	printf("mkd_free_outputs didn't empty it\n");
+	exit(1);
+    }
+    mkd_cleanup(doc);
+    puts("ok");
+    exit(0);
+}
@@ -0,0 +1,143 @@
+/*
+ * peek: read the pandoc header of a document with mkd_peek_header(),
+ * and check that it finds the same title, author, and date that
+ * mkd_in() does, that it stops right after the header (and reads
+ * nothing if there isn't supposed to be one), and that what's left of
+ * the file is the rest of the document (for tests/peek.t.)   If a
+ * title, author, and date are given, they have to be the ones it finds
+ * (an empty one means there shouldn't be one.)
+ * Prints "ok", or what was different.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mkdio.h"
+#include "pgm_options.h"
+
+static mkd_flag_t flags = 0;
+
+
+static void
+same(char *what, char *a, char *b)
+{
+    if ( (a == 0) != (b == 0) || (a && strcmp(a, b) != 0) ) {
+	printf("%s differs: <%s> vs <%s>\n", what, a ? a : "(null)", b ? b : "(null)");
+	exit(1);
+    }
+}
+
+
+static int
+html(MMIOT *doc, char **text)
+{
+    int size;
+
+    if ( !(doc && mkd_compile(doc, flags)) ) {
+	fprintf(stderr, "can't compile the document\n");
+	exit(1);
+    }
+    if ( (size = mkd_document(doc, text)) < 0 )
+	size = 0;
+    return size;
+}
+
+
+main(argc, argv)
+char **argv;
+{
+    MMIOT *whole, *peeked, *rest;
+    FILE *f;
+    char *src = 0, *a, *b, *title = 0, *author = 0, *date = 0;
+    int i, c, expected = 0, size = 0, cap = 0, lines, past, ha, hb;
+    long pos;
+
+    for ( i=1; i < argc; i++ ) {
+	if ( (strncmp(argv[i], "-f", 2) == 0) && set_flag(&flags, argv[i]+2) )
+	    continue;
+	if ( (argv[i][0] == '-') || (argc - i != 3) ) {
+	    fprintf(stderr, "usage: %s [-fflags] [title author date] < document\n", argv[0]);
+	    exit(1);
+	}
+	title = argv[i][0] ? argv[i] : 0;
+	author = argv[i+1][0] ? argv[i+1] : 0;
+	date = argv[i+2][0] ? argv[i+2] : 0;
+	expected = 1;
+	break;
+    }
+
+    while ( (c = getchar()) != EOF ) {
+	if ( size >= cap )
+	    src = realloc(src, cap = 2*cap + 100);
+	src[size++] = c;
+    }
+
+    if ( !(f = tmpfile()) || (fwrite(src, 1, size, f) != size) ) {
+	perror("tmpfile");
+	exit(1);
+    }
+
+    /* where the third line ends */
+    for ( past = lines = 0; (past < size) && (lines < 3); past++ )
+	if ( src[past] == '\n' )
+	    lines++;
+
+    rewind(f);
+    whole = mkd_in(f, flags);
+    if ( !whole ) {
+	fprintf(stderr, "can't read the document\n");
+	exit(1);
+    }
+
+    rewind(f);
+    if ( !(peeked = mkd_peek_header(f, flags)) ) {
+	printf("mkd_peek_header failed\n");
+	exit(1);
+    }
+    pos = ftell(f);
+
+    same("title", mkd_doc_title(whole), mkd_doc_title(peeked));
+    same("author", mkd_doc_author(whole), mkd_doc_author(peeked));
+    same("date", mkd_doc_date(whole), mkd_doc_date(peeked));
+
+    if ( expected ) {
+	same("expected title", title, mkd_doc_title(peeked));
+	same("expected author", author, mkd_doc_author(peeked));
+	same("expected date", date, mkd_doc_date(peeked));
+    }
+
+    if ( flags & MKD_NOHEADER ) {
+	if ( pos != 0 ) {
+	    printf("read %ld bytes with MKD_NOHEADER set\n", pos);
+	    exit(1);
+	}
+    }
+    else if ( mkd_doc_title(peeked) || mkd_doc_author(peeked) || mkd_doc_date(peeked) ) {
+	if ( pos != past ) {
+	    printf("stopped at %ld, not at %d after the header\n", pos, past);
+	    exit(1);
+	}
+
+	/* the rest of the file is the rest of the document */
+	rest = mkd_in(f, flags|MKD_NOHEADER);
+	ha = html(whole, &a);
+	hb = html(rest, &b);
+	if ( (ha != hb) || memcmp(a, b, ha) != 0 ) {
+	    printf("the rest of the document differs\nwhole:\n%.*s\nrest:\n%.*s\n", ha, a, hb, b);
+	    exit(1);
+	}
+	mkd_cleanup(rest);
+    }
+    else if ( pos > past ) {
+	printf("read %ld bytes past the first three lines (%d)\n", pos - past, past);
+	exit(1);
+    }
+
+    mkd_cleanup(peeked);
+    mkd_cleanup(whole);
+    fclose(f);
+    free(src);
+    printf("ok\n");
+    exit(0);
+}
@@ -0,0 +1,42 @@
+/*
+ * plain: write out the text mkd_plaintext() finds in a document (so
+ * tests/plaintext.t can check it.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mkdio.h"
+#include "pgm_options.h"
+
+main(argc, argv)
+char **argv;
+{
+    mkd_flag_t flags = 0;
+    MMIOT *doc;
+    char *text;
+    int i, size;
+
+    for ( i=1; i < argc; i++ )
+	if ( (strncmp(argv[i], "-f", 2) != 0) || !set_flag(&flags, argv[i]+2) ) {
+	    fprintf(stderr, "usage: %s [-fflags] < markdown\n", argv[0]);
+	    exit(1);
+	}
+
+    if ( !(doc = mkd_in(stdin, flags)) || !mkd_compile(doc, flags) ) {
+	fprintf(stderr, "%s: can't compile the document\n", argv[0]);
+	exit(1);
+    }
+
+    if ( (size = mkd_plaintext(doc, &text)) == EOF ) {
+	fprintf(stderr, "%s: can't get the text of the document\n", argv[0]);
+	exit(1);
+    }
+    if ( size > 0 ) {
+	fwrite(text, 1, size, stdout);
+	free(text);
+    }
+    mkd_cleanup(doc);
+    exit(0);
+}
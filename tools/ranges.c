@@ -0,0 +1,283 @@
+/*
+ * ranges: render every range of top-level blocks of a document with
+ * mkd_render_range(), and check that each one is the same as that
+ * slice of what mkd_render() makes of the whole document, with the
+ * footnotes numbered the same way and a list of just the footnotes
+ * first used in it;  then find the section every header starts with
+ * mkd_section(), and check that it runs up to the next header at the
+ * same level or above (for tests/range.t.)
+ * Prints "ok", or the first range that came out differently.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mkdio.h"
+#include "pgm_options.h"
+
+static mkd_flag_t flags = 0;
+static char *src = 0;
+static int size = 0;
+
+#define FOOTNOTES "\n<div class=\"footnotes\">"
+
+/* the html of part of a document, split into its blocks and the list
+ * of footnotes at the end
+ */
+typedef struct {
+    char *html;
+    int body;			/* how much of it is blocks */
+    char *notes;		/* the list of footnotes, or 0 */
+} Html;
+
+
+static void
+split(Html *h, char *html, int size)
+{
+    char *p, *last = 0;
+
+    h->html = html;
+    for ( p = html; (p = strstr(p, FOOTNOTES)); p++ )
+	last = p;
+    h->notes = last;
+    h->body = last ? (last - html) : size;
+}
+
+
+static Html
+range(MMIOT *doc, int first, int last)
+{
+    Html h;
+    char *html;
+    int size;
+
+    if ( (size = mkd_render_range(doc, first, last, flags, &html)) < 0 ) {
+	printf("can't render blocks %d to %d\n", first, last);
+	exit(1);
+    }
+    split(&h, html, size);
+    return h;
+}
+
+
+/* the footnote numbered n, in a list of footnotes
+ */
+static char *
+footnote(char *notes, int n, int *len)
+{
+    char *p, *q;
+
+    for ( p = notes; p && (p = strstr(p, "<li id=\"")); p++ )
+	if ( (q = strchr(p, ':')) && (atoi(q+1) == n) ) {
+	    if ( !(q = strstr(p, "</li>\n")) )
+		break;
+	    *len = (q + 6) - p;
+	    return p;
+	}
+    return 0;
+}
+
+
+/* does a footnote numbered n get used in some html?
+ */
+static int
+uses(char *html, int size, int n)
+{
+    char ref[40];
+    int i, len;
+
+    len = sprintf(ref, "\" rel=\"footnote\">%d<", n);
+    for ( i=0; i+len <= size; i++ )
+	if ( memcmp(html+i, ref, len) == 0 )
+	    return 1;
+    return 0;
+}
+
+
+static void
+fail(int first, int last, char *what, char *expected, int ha, char *got, int hb)
+{
+    printf("blocks %d to %d: %s\nsource:\n%.*s\nexpected:\n%.*s\ngot:\n%.*s\n",
+	    first, last, what, size, src, ha, expected, hb, got);
+    exit(1);
+}
+
+
+/* the level of a header block, or 0 if it's not a header
+ */
+static int
+level(char *html)
+{
+    char *p = html;
+
+    if ( strncmp(p, "<a name=\"", 9) == 0 ) {
+	if ( !(p = strstr(p, "\"></a>\n")) )
+	    return 0;
+	p += 7;
+    }
+    if ( (p[0] == '<') && (p[1] == 'h') && (p[2] >= '1') && (p[2] <= '6')
+		       && ((p[3] == '>') || (p[3] == ' ')) )
+	return p[2] - '0';
+    return 0;
+}
+
+
+main(argc, argv)
+char **argv;
+{
+    MMIOT *doc;
+    mkd_outline_t *outline;
+    Html whole, *block, r;
+    char *html, *join = 0, *note;
+    int i, j, k, n, c, cap = 0, blocks, len, from, to, nheaders, found, prev;
+    int hwhole, notes, lo, hi;
+
+    for ( i=1; i < argc; i++ ) {
+	if ( (strncmp(argv[i], "-f", 2) == 0) && set_flag(&flags, argv[i]+2) )
+	    continue;
+	fprintf(stderr, "usage: %s [-fflags] < document\n", argv[0]);
+	exit(1);
+    }
+
+    while ( (c = getchar()) != EOF ) {
+	if ( size >= cap )
+	    src = realloc(src, cap = 2*cap + 100);
+	src[size++] = c;
+    }
+
+    if ( !(doc = mkd_string(src, size, flags)) ) {
+	fprintf(stderr, "can't read the document\n");
+	exit(1);
+    }
+    if ( (mkd_render_range(doc, 0, -1, flags, &html) != EOF)
+				|| (mkd_section(doc, "x", &i, &j) != EOF) ) {
+	printf("a range of a document that isn't compiled\n");
+	exit(1);
+    }
+    if ( !mkd_compile(doc, flags) ) {
+	fprintf(stderr, "can't compile the document\n");
+	exit(1);
+    }
+    if ( (hwhole = mkd_render(doc, flags, &html)) < 0 ) {
+	printf("can't render the document\n");
+	exit(1);
+    }
+    split(&whole, html, hwhole);
+
+    /* all of it */
+    r = range(doc, 0, -1);
+    if ( strcmp(r.html, whole.html) != 0 )
+	fail(0, -1, "differs", whole.html, hwhole, r.html, strlen(r.html));
+    free(r.html);
+
+    /* each block on its own; there are as many blocks as it takes to
+     * put the whole thing back together
+     */
+    block = malloc((size+2) * sizeof block[0]);
+    for ( blocks = -1, i=0; i <= size+1; i++ ) {
+	block[i] = range(doc, i, i+1);
+	if ( blocks >= 0 )
+	    continue;
+	for ( len = 0, j = 0; j < i; j++ ) {
+	    join = realloc(join, len + block[j].body + 3);
+	    if ( j ) {
+		memcpy(join+len, "\n\n", 2);
+		len += 2;
+	    }
+	    memcpy(join+len, block[j].html, block[j].body);
+	    len += block[j].body;
+	}
+	r = range(doc, i, -1);
+	if ( (r.body == 0) && (len == whole.body)
+			   && (memcmp(join, whole.html, len) == 0) )
+	    blocks = i;
+	free(r.html);
+    }
+    if ( blocks < 0 ) {
+	printf("the blocks don't add up to the document\n");
+	exit(1);
+    }
+
+    for ( from = 0; from <= blocks; from++ )
+	for ( to = from; to <= blocks+1; to++ ) {
+	    r = range(doc, from, to);
+
+	    /* the blocks are that slice of the document */
+	    for ( lo = 0, j = 0; j < from; j++ )
+		lo += block[j].body + 2;
+	    for ( hi = lo, j = from; (j < to) && (j < blocks); j++ )
+		hi += block[j].body + (j > from ? 2 : 0);
+	    if ( (from == to) || (from == blocks) )
+		hi = lo = (from < blocks) ? lo : whole.body;
+
+	    if ( (r.body != hi - lo) || memcmp(r.html, whole.html + lo, r.body) )
+		fail(from, to, "isn't that part of the document",
+			whole.html + lo, hi - lo, r.html, r.body);
+
+	    /* the footnotes first used in it, and nothing else */
+	    for ( notes = 0, k = 1; footnote(whole.notes, k, &len); k++ ) {
+		if ( !uses(whole.html + lo, hi - lo, k) || uses(whole.html, lo, k) )
+		    continue;
+		note = footnote(whole.notes, k, &len);
+		if ( !(r.notes && (html = footnote(r.notes, k, &n))
+			       && (n == len) && (memcmp(html, note, len) == 0)) )
+		    fail(from, to, "footnote is missing",
+			    note, len, r.notes ? r.notes : "", r.notes ? strlen(r.notes) : 0);
+		notes++;
+	    }
+	    for ( n = 0, html = r.notes; html && (html = strstr(html, "<li id=\"")); html++ )
+		n++;
+	    if ( n != notes )
+		fail(from, to, "has the wrong number of footnotes",
+			whole.notes ? whole.notes : "", whole.notes ? strlen(whole.notes) : 0,
+			r.notes ? r.notes : "", r.notes ? strlen(r.notes) : 0);
+	    free(r.html);
+	}
+
+    /* every top-level header starts a section, and the others don't */
+    if ( mkd_section(doc, "no such header", &i, &j) != EOF ) {
+	printf("found a section for a header that isn't there\n");
+	exit(1);
+    }
+    nheaders = mkd_outline(doc, &outline);
+    for ( found = 0, prev = -1, i=0; i < nheaders; i++ ) {
+	if ( (outline[i].type != MKD_OUTLINE_HEADER) || !outline[i].anchor )
+	    continue;
+	if ( mkd_section(doc, outline[i].anchor, &from, &to) != 0 )
+	    continue;
+	if ( (from <= prev) || (from >= blocks)
+			    || (level(block[from].html) != outline[i].hnumber) ) {
+	    printf("%s isn't the header of block %d\n", outline[i].anchor, from);
+	    exit(1);
+	}
+	for ( j = from+1; (j < blocks) && !(level(block[j].html)
+			  && (level(block[j].html) <= outline[i].hnumber)); j++ )
+	    ;
+	if ( to != j ) {
+	    printf("the section %s starts should end at %d, not %d\n",
+		    outline[i].anchor, j, to);
+	    exit(1);
+	}
+	prev = from;
+	found++;
+    }
+    for ( n = 0, j = 0; j < blocks; j++ )
+	if ( level(block[j].html) )
+	    n++;
+    if ( found != n ) {
+	printf("%d headers start sections, not %d\n", found, n);
+	exit(1);
+    }
+
+    for ( i=0; i <= size+1; i++ )
+	free(block[i].html);
+    free(block);
+    free(join);
+    free(outline);
+    free(whole.html);
+    mkd_cleanup(doc);
+    free(src);
+    printf("ok\n");
+    exit(0);
+}
@@ -0,0 +1,201 @@
+/*
+ * reasync: convert a list of documents (separated by lines that just
+ * say @@, and repeated -n times) with mkd_submit(), cancelling every
+ * third one, and pick them up with mkd_poll() until they've all come
+ * back, then shut the workers down and do it again (-r times, on -t
+ * threads); check that every document that wasn't cancelled comes
+ * back once, the same as it does with mkd_document(), and that the
+ * cancelled ones never do (for tests/async.t.)   Prints "ok", or what
+ * went wrong.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+
+#include "config.h"
+#include "mkdio.h"
+#include "pgm_options.h"
+
+static mkd_flag_t flags = 0;
+
+static char **text = 0, **want = 0;
+static int *textsize = 0, *wantsize = 0, count = 0;
+
+static char *
+html(char *src, int size, int *len)
+{
+    MMIOT *doc;
+    char *res, *copy;
+
+    if ( !(doc = mkd_string(src, size, flags)) || !mkd_compile(doc, flags) ) {
+	fprintf(stderr, "can't compile the document\n");
+	exit(1);
+    }
+    if ( (*len = mkd_document(doc, &res)) < 0 )
+	*len = 0;
+    copy = malloc(*len + 1);
+    memcpy(copy, res, *len);
+    mkd_cleanup(doc);
+    return copy;
+}
+
+
+/* wait (for a while) until mkd_poll() has something
+ */
+static int
+ready(int fd, int timeout)
+{
+    struct pollfd p;
+
+    if ( fd < 0 )
+	return 1;
+    p.fd = fd;
+    p.events = POLLIN;
+    return poll(&p, 1, timeout) > 0;
+}
+
+
+static void
+pass(int r, int threads)
+{
+    int *id = malloc(count * sizeof id[0]);
+    int *expected = malloc(count * sizeof expected[0]);
+    mkd_result_t res[4];
+    int i, n, k, fd, left, which;
+
+    /* start them up by hand every other time, and let mkd_submit() do
+     * it the rest of the time
+     */
+    if ( (r & 1) && (mkd_async_start(threads) == EOF) ) {
+	printf("round %d: mkd_async_start failed\n", r);
+	exit(1);
+    }
+
+    for ( left=i=0; i < count; i++ ) {
+	if ( (id[i] = mkd_submit(0, text[i], textsize[i], flags, &id[i])) == EOF ) {
+	    printf("round %d: mkd_submit %d failed\n", r, i);
+	    exit(1);
+	}
+	expected[i] = 1;
+	if ( (i % 3 == 2) && (mkd_cancel(id[i]) == 0) )
+	    expected[i] = 0;
+	left += expected[i];
+    }
+    if ( mkd_cancel(-1) != EOF ) {
+	printf("round %d: cancelled a document that doesn't exist\n", r);
+	exit(1);
+    }
+
+    fd = mkd_async_fd();
+    while ( left > 0 ) {
+	if ( !ready(fd, 10000) ) {
+	    printf("round %d: gave up waiting for %d documents\n", r, left);
+	    exit(1);
+	}
+	n = mkd_poll(res, 4);
+	for ( k=0; k < n; k++ ) {
+	    which = (int*)res[k].cookie - id;
+	    if ( (which < 0) || (which >= count) || (id[which] != res[k].id) ) {
+		printf("round %d: mkd_poll returned id %d with the wrong cookie\n", r, res[k].id);
+		exit(1);
+	    }
+	    if ( !expected[which] ) {
+		printf("round %d: document %d came back %s\n", r, which,
+			(which % 3 == 2) ? "after it was cancelled" : "twice");
+		exit(1);
+	    }
+	    if ( (res[k].htmlsize != wantsize[which])
+			|| (memcmp(res[k].html, want[which], wantsize[which]) != 0) ) {
+		printf("round %d: document %d differs\nsource:\n%.*s\n"
+		       "mkd_document:\n%.*s\nmkd_poll:\n%.*s\n", r, which,
+			textsize[which], text[which], wantsize[which], want[which],
+			(res[k].htmlsize > 0) ? res[k].htmlsize : 0,
+			res[k].html ? res[k].html : "");
+		exit(1);
+	    }
+	    expected[which] = 0;
+	    mkd_free_result(&res[k]);
+	    --left;
+	}
+    }
+
+    /* once everything's been picked up there's nothing more to pick up
+     */
+    if ( mkd_poll(res, 4) != 0 ) {
+	printf("round %d: mkd_poll found something after the last document\n", r);
+	exit(1);
+    }
+    if ( (fd >= 0) && ready(fd, 0) ) {
+	printf("round %d: mkd_async_fd is still readable\n", r);
+	exit(1);
+    }
+
+    /* and what's still queued when the workers are shut down is
+     * thrown away
+     */
+    for ( i=0; i < count; i++ )
+	mkd_submit(0, text[i], textsize[i], flags, 0);
+    mkd_async_shutdown();
+    if ( mkd_poll(res, 4) != 0 ) {
+	printf("round %d: mkd_poll found something after mkd_async_shutdown\n", r);
+	exit(1);
+    }
+    free(id);
+    free(expected);
+}
+
+
+main(argc, argv)
+char **argv;
+{
+    char *src = 0;
+    int i, j, c, size = 0, cap = 0, start, repeat = 1, rounds = 2, threads = 2;
+
+    for ( i=1; i < argc; i++ ) {
+	if ( (strncmp(argv[i], "-f", 2) == 0) && set_flag(&flags, argv[i]+2) )
+	    continue;
+	if ( strncmp(argv[i], "-n", 2) == 0 )
+	    repeat = atoi(argv[i]+2);
+	else if ( strncmp(argv[i], "-r", 2) == 0 )
+	    rounds = atoi(argv[i]+2);
+	else if ( strncmp(argv[i], "-t", 2) == 0 )
+	    threads = atoi(argv[i]+2);
+	else {
+	    fprintf(stderr, "usage: %s [-fflags] [-nrepeat] [-rrounds] [-tthreads] < documents\n", argv[0]);
+	    exit(1);
+	}
+    }
+
+    while ( (c = getchar()) != EOF ) {
+	if ( size >= cap )
+	    src = realloc(src, cap = 2*cap + 100);
+	src[size++] = c;
+    }
+    if ( !src )
+	src = "";
+
+    /* cut it up into documents, as many times as it's repeated */
+    for ( j=0; j < repeat; j++ )
+	for ( start = i = 0; i <= size; i++ ) {
+	    if ( (i < size) && !((size-i >= 4) && (strncmp(src+i, "\n@@\n", 4) == 0)) )
+		continue;
+	    text = realloc(text, (count+1) * sizeof text[0]);
+	    textsize = realloc(textsize, (count+1) * sizeof textsize[0]);
+	    text[count] = src + start;
+	    textsize[count++] = ((i < size) ? i+1 : size) - start;
+	    start = i + 4;
+	    i += 3;
+	}
+
+    want = malloc(count * sizeof want[0]);
+    wantsize = malloc(count * sizeof wantsize[0]);
+    for ( i=0; i < count; i++ )
+	want[i] = html(text[i], textsize[i], &wantsize[i]);
+
+    for ( i=0; i < rounds; i++ )
+	pass(i, threads);
+
+    puts("ok");
+    exit(0);
+}
@@ -0,0 +1,121 @@
+/*
+ * rebatch: render a list of documents (separated by lines that just
+ * say @@, and repeated -n times) with mkd_render_batch() on each of
+ * the -t numbers of threads (0, 1, 2, and 4 if none are given), and
+ * check that every document comes out the same as it does with
+ * mkd_document() (for tests/batch.t.)   Prints "ok", or the first
+ * document that came out differently.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mkdio.h"
+#include "pgm_options.h"
+
+static mkd_flag_t flags = 0;
+
+static char *
+html(char *src, int size, int *len)
+{
+    MMIOT *doc;
+    char *res, *copy;
+
+    if ( !(doc = mkd_string(src, size, flags)) || !mkd_compile(doc, flags) ) {
+	fprintf(stderr, "can't compile the document\n");
+	exit(1);
+    }
+    if ( (*len = mkd_document(doc, &res)) < 0 )
+	*len = 0;
+    copy = malloc(*len + 1);
+    memcpy(copy, res, *len);
+    mkd_cleanup(doc);
+    return copy;
+}
+
+
+main(argc, argv)
+char **argv;
+{
+    mkd_batch_t *batch = 0;
+    char *src = 0, **want = 0;
+    int *wantsize = 0, count = 0, threads[20], nthreads = 0;
+    int i, j, c, size = 0, cap = 0, start, rounds = 1, ret;
+
+    for ( i=1; i < argc; i++ ) {
+	if ( (strncmp(argv[i], "-f", 2) == 0) && set_flag(&flags, argv[i]+2) )
+	    continue;
+	if ( strncmp(argv[i], "-n", 2) == 0 )
+	    rounds = atoi(argv[i]+2);
+	else if ( (strncmp(argv[i], "-t", 2) == 0) && (nthreads < 20) )
+	    threads[nthreads++] = atoi(argv[i]+2);
+	else {
+	    fprintf(stderr, "usage: %s [-fflags] [-nrepeat] [-tthreads ...] < documents\n", argv[0]);
+	    exit(1);
+	}
+    }
+    if ( nthreads == 0 ) {
+	threads[nthreads++] = 0;
+	threads[nthreads++] = 1;
+	threads[nthreads++] = 2;
+	threads[nthreads++] = 4;
+    }
+
+    while ( (c = getchar()) != EOF ) {
+	if ( size >= cap )
+	    src = realloc(src, cap = 2*cap + 100);
+	src[size++] = c;
+    }
+
+    /* cut it up into documents, as many times as it's repeated */
+    for ( j=0; j < rounds; j++ )
+	for ( start = i = 0; i <= size; i++ ) {
+	    if ( (i < size) && !((size-i >= 4) && (strncmp(src+i, "\n@@\n", 4) == 0)) )
+		continue;
+	    batch = realloc(batch, (count+1) * sizeof batch[0]);
+	    batch[count].text = src + start;
+	    batch[count++].size = ((i < size) ? i+1 : size) - start;
+	    start = i + 4;
+	    i += 3;
+	}
+
+    want = malloc((count+1) * sizeof want[0]);
+    wantsize = malloc((count+1) * sizeof wantsize[0]);
+    for ( i=0; i < count; i++ )
+	want[i] = html((char*)batch[i].text, batch[i].size, &wantsize[i]);
+
+    for ( j=0; j < nthreads; j++ ) {
+	if ( (ret = mkd_render_batch(batch, count, flags, threads[j])) != count ) {
+	    printf("%d threads: mkd_render_batch rendered %d of %d documents\n",
+		    threads[j], ret, count);
+	    exit(1);
+	}
+	for ( i=0; i < count; i++ )
+	    if ( (batch[i].htmlsize != wantsize[i])
+			|| (memcmp(batch[i].html, want[i], wantsize[i]) != 0)
+			|| batch[i].html[wantsize[i]] ) {
+		printf("%d threads: document %d differs\nsource:\n%.*s\n"
+		       "mkd_document:\n%.*s\nmkd_render_batch:\n%.*s\n",
+			threads[j], i, batch[i].size, batch[i].text, wantsize[i], want[i],
+			(batch[i].htmlsize > 0) ? batch[i].htmlsize : 0,
+			batch[i].html ? batch[i].html : "");
+		exit(1);
+	    }
+	mkd_free_batch(batch, count);
+	for ( i=0; i < count; i++ )
+	    if ( batch[i].html || (batch[i].htmlsize != EOF) ) {
+		printf("%d threads: mkd_free_batch didn't empty document %d\n", threads[j], i);
+		exit(1);
+	    }
+    }
+
+    if ( (mkd_render_batch(batch, 0, flags, 0) != 0) || (mkd_render_batch(batch, -1, flags, 0) != EOF)
+					    || (mkd_render_batch(0, 1, flags, 0) != EOF) ) {
+	printf("mkd_render_batch didn't refuse a bad batch\n");
+	exit(1);
+    }
+
+    puts("ok");
+    exit(0);
+}
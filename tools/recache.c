@@ -0,0 +1,106 @@
+/*
+ * recache: render a list of documents, one after another, with an
+ * engine that caches rendered blocks and with one that doesn't, and
+ * check that every one comes out the same both ways (for
+ * tests/cache.t.)   The documents are separated by lines that just say
+ * @@, -ccachesize sets how big the cache can get, and -nrounds goes
+ * through the list that many times.
+ * Prints "ok", or the first document that came out differently.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mkdio.h"
+#include "pgm_options.h"
+
+static mkd_flag_t flags = 0;
+
+
+static char *
+html(mkd_engine *e, char *src, int size, int *len)
+{
+    MMIOT *doc;
+    char *res, *copy;
+
+    if ( !(doc = mkd_engine_string(e, src, size, flags)) || !mkd_compile(doc, flags) ) {
+	fprintf(stderr, "can't compile the document\n");
+	exit(1);
+    }
+    if ( (*len = mkd_document(doc, &res)) < 0 )
+	*len = 0;
+    copy = malloc(*len + 1);
+    memcpy(copy, res, *len);
+    mkd_cleanup(doc);
+    return copy;
+}
+
+
+main(argc, argv)
+char **argv;
+{
+    mkd_engine *cached, *plain;
+    char *src = 0, *a, *b, **doc = 0;
+    int *docsize = 0, ndocs = 0;
+    int i, c, size = 0, cap = 0, start, ha, hb, round, rounds = 1;
+    long cachesize = 1000000;
+
+    for ( i=1; i < argc; i++ ) {
+	if ( (strncmp(argv[i], "-f", 2) == 0) && set_flag(&flags, argv[i]+2) )
+	    continue;
+	if ( strncmp(argv[i], "-c", 2) == 0 )
+	    cachesize = atol(argv[i]+2);
+	else if ( strncmp(argv[i], "-n", 2) == 0 )
+	    rounds = atoi(argv[i]+2);
+	else {
+	    fprintf(stderr, "usage: %s [-fflags] [-ccachesize] [-nrounds] < documents\n", argv[0]);
+	    exit(1);
+	}
+    }
+
+    while ( (c = getchar()) != EOF ) {
+	if ( size >= cap )
+	    src = realloc(src, cap = 2*cap + 100);
+	src[size++] = c;
+    }
+
+    /* cut it up into documents */
+    for ( start = i = 0; i <= size; i++ ) {
+	if ( (i < size) && !((size-i >= 4) && (strncmp(src+i, "\n@@\n", 4) == 0)) )
+	    continue;
+	doc = realloc(doc, (ndocs+1) * sizeof doc[0]);
+	docsize = realloc(docsize, (ndocs+1) * sizeof docsize[0]);
+	doc[ndocs] = src + start;
+	docsize[ndocs++] = ((i < size) ? i+1 : size) - start;
+	start = i + 4;
+	i += 3;
+    }
+
+    if ( !(cached = mkd_engine_new(flags)) || (mkd_engine_cache(cached, cachesize) != 0)
+					    || !(plain = mkd_engine_new(flags)) ) {
+	fprintf(stderr, "%s: can't make the engines\n", argv[0]);
+	exit(1);
+    }
+    mkd_engine_seed(cached, 1);
+    mkd_engine_seed(plain, 1);
+
+    for ( round = 0; round < rounds; round++ )
+	for ( i=0; i < ndocs; i++ ) {
+	    a = html(plain, doc[i], docsize[i], &ha);
+	    b = html(cached, doc[i], docsize[i], &hb);
+	    if ( (ha != hb) || (memcmp(a, b, ha) != 0) ) {
+		printf("document %d (round %d) differs\nsource:\n%.*s\n"
+		       "uncached:\n%.*s\ncached:\n%.*s\n",
+			i, round, docsize[i], doc[i], ha, a, hb, b);
+		exit(1);
+	    }
+	    free(a);
+	    free(b);
+	}
+
+    mkd_engine_free(cached);
+    mkd_engine_free(plain);
+    puts("ok");
+    exit(0);
+}
@@ -0,0 +1,177 @@
+/*
+ * reedit: compile a document with mkd_edit_string(), make some edits
+ * to it with mkd_update(), and check that after every edit it renders
+ * to the same html (and table of contents) as a fresh compile of the
+ * edited source (for tests/edit.t.)   The edits are given as offset,removed,text (and
+ * -ncount makes that many more, picked at random from -sseed.)
+ * Prints "ok", or the first edit that came out differently.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mkdio.h"
+#include "pgm_options.h"
+
+/* bits of markdown that change where the blocks are */
+static char *bits[] = {
+    "\n", "\n\n", "a", "text ", "# ", "* ", "1. ", "-1. ", "> ",
+    "    ", "```\n", "~~~\n", "---\n", "<div>\n", "</div>\n",
+    "[a]: /b\n", "[^1]: note\n", "[^1]", "%\n", "=\n",
+};
+#define NRBITS	(sizeof bits / sizeof bits[0])
+
+static mkd_flag_t flags = 0;
+static char *src = 0;
+static int size = 0;
+static unsigned long seed = 1;
+
+static unsigned long
+rng()
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) & 0x7fff;
+}
+
+
+static char *
+html(MMIOT *doc, int *len)
+{
+    char *res = 0;
+
+    if ( (*len = mkd_document(doc, &res)) < 0 )
+	*len = 0;
+    return res;
+}
+
+
+static char *
+toc(MMIOT *doc, int *len)
+{
+    char *res = 0;
+
+    if ( (*len = mkd_toc(doc, &res)) < 0 )
+	*len = 0;
+    return res;
+}
+
+
+/* what the edit being checked was */
+static char edited[80];
+
+static int
+differs(char *what, char *a, int ha, char *b, int hb)
+{
+    if ( (ha == hb) && (memcmp(a, b, ha) == 0) )
+	return 0;
+    printf("%s: the %s differs\nsource:\n%.*s\n"
+	   "updated:\n%.*s\nfresh:\n%.*s\n",
+	    edited, what, size, src, ha, a, hb, b);
+    return 1;
+}
+
+
+/* make an edit to the document and to our copy of its source, and see
+ * if the document still matches a fresh compile
+ */
+static int
+edit(MMIOT *doc, int n, int offset, int removed, char *text)
+{
+    int len = strlen(text), ha, hb, ok = 1;
+    MMIOT *fresh;
+    char *a, *b;
+
+    if ( offset > size ) offset = size;
+    if ( removed > size - offset ) removed = size - offset;
+
+    snprintf(edited, sizeof edited, "edit %d (%d,%d,\"%.40s\")", n, offset, removed, text);
+    if ( mkd_update(doc, offset, removed, text, len) == EOF ) {
+	printf("%s: mkd_update failed\n", edited);
+	return 0;
+    }
+
+    src = realloc(src, size + len + 1);
+    memmove(src+offset+len, src+offset+removed, size-offset-removed);
+    memcpy(src+offset, text, len);
+    size += len - removed;
+
+    fresh = mkd_string(src, size, flags);
+    mkd_compile(fresh, flags);
+
+    a = html(doc, &ha);
+    b = html(fresh, &hb);
+    if ( differs("html", a, ha, b, hb) ) {
+	mkd_cleanup(fresh);
+	return 0;
+    }
+    if ( flags & MKD_TOC ) {
+	a = toc(doc, &ha);
+	b = toc(fresh, &hb);
+	ok = !differs("toc", a, ha, b, hb);
+	if ( a ) free(a);
+	if ( b ) free(b);
+    }
+    mkd_cleanup(fresh);
+    return ok;
+}
+
+
+main(argc, argv)
+char **argv;
+{
+    MMIOT *doc;
+    char *text;
+    int i, c, offset, removed, n = 0, count = 0, cap = 0;
+
+    for ( i=1; (i < argc) && (argv[i][0] == '-'); i++ ) {
+	if ( (strncmp(argv[i], "-f", 2) == 0) && set_flag(&flags, argv[i]+2) )
+	    continue;
+	if ( strncmp(argv[i], "-n", 2) == 0 )
+	    count = atoi(argv[i]+2);
+	else if ( strncmp(argv[i], "-s", 2) == 0 )
+	    seed = strtoul(argv[i]+2, 0, 10);
+	else {
+	    fprintf(stderr, "usage: %s [-fflags] [-ncount] [-sseed] "
+			    "[offset,removed,text ...] < markdown\n", argv[0]);
+	    exit(1);
+	}
+    }
+
+    while ( (c = getchar()) != EOF ) {
+	if ( size >= cap )
+	    src = realloc(src, cap = 2*cap + 100);
+	src[size++] = c;
+    }
+
+    if ( !(doc = mkd_edit_string(src ? src : "", size, flags)) ) {
+	fprintf(stderr, "%s: can't read the document\n", argv[0]);
+	exit(1);
+    }
+    mkd_compile(doc, flags);
+
+    /* the document should match before it's edited, too */
+    if ( !edit(doc, n++, 0, 0, "") )
+	exit(1);
+
+    for ( ; i < argc; i++ ) {
+	if ( (sscanf(argv[i], "%d,%d,", &offset, &removed) != 2)
+			  || !(text = strchr(strchr(argv[i], ',')+1, ',')) ) {
+	    fprintf(stderr, "%s: bad edit <%s>\n", argv[0], argv[i]);
+	    exit(1);
+	}
+	if ( !edit(doc, n++, offset, removed, text+1) )
+	    exit(1);
+    }
+
+    while ( count-- > 0 ) {
+	offset = size ? rng() % (size+1) : 0;
+	removed = (rng() % 3 == 0) ? rng() % 8 : 0;
+	if ( !edit(doc, n++, offset, removed, bits[rng() % NRBITS]) )
+	    exit(1);
+    }
+
+    mkd_cleanup(doc);
+    puts("ok");
+    exit(0);
+}
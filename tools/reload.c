@@ -0,0 +1,58 @@
+/*
+ * reload: compile a document, save it with mkd_save_compiled(), load
+ * it back with mkd_load_compiled(), and write out the html the loaded
+ * copy renders to (so tests/compiled.t can check that it's the same
+ * html that markdown writes.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mkdio.h"
+#include "pgm_options.h"
+
+main(argc, argv)
+char **argv;
+{
+    mkd_flag_t flags = 0;
+    MMIOT *doc, *copy;
+    FILE *tmp;
+    char *image;
+    long size;
+    int i;
+
+    for ( i=1; i < argc; i++ )
+	if ( (strncmp(argv[i], "-f", 2) != 0) || !set_flag(&flags, argv[i]+2) ) {
+	    fprintf(stderr, "usage: %s [-fflags] < markdown\n", argv[0]);
+	    exit(1);
+	}
+
+    if ( !(doc = mkd_in(stdin, flags)) || !mkd_compile(doc, flags) ) {
+	fprintf(stderr, "%s: can't compile the document\n", argv[0]);
+	exit(1);
+    }
+
+    if ( !(tmp = tmpfile()) || (mkd_save_compiled(doc, tmp) != 0) ) {
+	fprintf(stderr, "%s: can't save the document\n", argv[0]);
+	exit(1);
+    }
+    mkd_cleanup(doc);
+
+    size = ftell(tmp);
+    rewind(tmp);
+    if ( !(image = malloc(size ? size : 1)) || (fread(image, 1, size, tmp) != size) ) {
+	fprintf(stderr, "%s: can't read the document back\n", argv[0]);
+	exit(1);
+    }
+    fclose(tmp);
+
+    if ( !(copy = mkd_load_compiled(image, size)) ) {
+	fprintf(stderr, "%s: can't load the document\n", argv[0]);
+	exit(1);
+    }
+    mkd_generatehtml(copy, stdout);
+    mkd_cleanup(copy);
+    free(image);
+    exit(0);
+}
@@ -0,0 +1,127 @@
+/*
+ * renext: render a document a piece at a time with mkd_render_next(),
+ * into buffers of each of the -c sizes (1, 7, and 65536 if none are
+ * given), and check that the pieces add up to what mkd_document() says
+ * the html is (for tests/next.t.)   Prints "ok", or the first size
+ * that didn't.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mkdio.h"
+#include "pgm_options.h"
+
+static mkd_flag_t flags = 0;
+static char *src = 0;
+static int size = 0;
+
+static MMIOT *
+compile()
+{
+    MMIOT *doc;
+
+    if ( !(doc = mkd_string(src, size, flags)) || !mkd_compile(doc, flags) ) {
+	fprintf(stderr, "can't compile the document\n");
+	exit(1);
+    }
+    return doc;
+}
+
+
+/* drain a document into `cap`-sized pieces, and compare them with
+ * the whole thing
+ */
+static int
+drain(int cap, char *html, int len)
+{
+    MMIOT *doc = compile();
+    char *buf = malloc(cap), *all = 0;
+    int got, at = 0, calls = 0, i;
+
+    while ( (got = mkd_render_next(doc, buf, cap)) > 0 ) {
+	++calls;
+	if ( got > cap ) {
+	    printf("cap %d: mkd_render_next returned %d\n", cap, got);
+	    return 0;
+	}
+	if ( (at % cap) != 0 ) {
+	    printf("cap %d: a short piece (call %d) wasn't the last one\n", cap, calls-1);
+	    return 0;
+	}
+	all = realloc(all, at + got);
+	memcpy(all+at, buf, got);
+	at += got;
+    }
+    if ( got < 0 ) {
+	printf("cap %d: mkd_render_next failed\n", cap);
+	return 0;
+    }
+    if ( mkd_render_next(doc, buf, cap) != 0 ) {
+	printf("cap %d: mkd_render_next didn't stay at the end\n", cap);
+	return 0;
+    }
+
+    if ( (at != len) || (at && memcmp(all, html, len) != 0) ) {
+	for ( i=0; (i < at) && (i < len) && (all[i] == html[i]); i++ )
+	    ;
+	i = (i > 40) ? i-40 : 0;
+	printf("cap %d: the pieces differ at %d (%d bytes vs %d)\n"
+	       "mkd_document:\n%.80s\nmkd_render_next:\n%.*s\n",
+		cap, i, len, at, html+i, (at-i > 80) ? 80 : at-i, all ? all+i : "");
+	return 0;
+    }
+    if ( all )
+	free(all);
+    free(buf);
+    mkd_cleanup(doc);
+    return 1;
+}
+
+
+main(argc, argv)
+char **argv;
+{
+    MMIOT *doc;
+    char *html;
+    int i, c, cap = 0, len, caps[20], ncaps = 0;
+
+    for ( i=1; i < argc; i++ ) {
+	if ( (strncmp(argv[i], "-f", 2) == 0) && set_flag(&flags, argv[i]+2) )
+	    continue;
+	if ( (strncmp(argv[i], "-c", 2) == 0) && (ncaps < 20) && (atoi(argv[i]+2) > 0) ) {
+	    caps[ncaps++] = atoi(argv[i]+2);
+	    continue;
+	}
+	fprintf(stderr, "usage: %s [-fflags] [-csize ...] < markdown\n", argv[0]);
+	exit(1);
+    }
+    if ( ncaps == 0 ) {
+	caps[ncaps++] = 1;
+	caps[ncaps++] = 7;
+	caps[ncaps++] = 65536;
+    }
+
+    while ( (c = getchar()) != EOF ) {
+	if ( size >= cap )
+	    src = realloc(src, cap = 2*cap + 100);
+	src[size++] = c;
+    }
+    if ( !src )
+	src = "";
+
+    doc = compile();
+    if ( (len = mkd_document(doc, &html)) < 0 ) {
+	fprintf(stderr, "%s: can't render the document\n", argv[0]);
+	exit(1);
+    }
+
+    for ( i=0; i < ncaps; i++ )
+	if ( !drain(caps[i], html, len) )
+	    exit(1);
+
+    mkd_cleanup(doc);
+    puts("ok");
+    exit(0);
+}
@@ -0,0 +1,237 @@
+/*
+ * repatch: render a document with mkd_patch(), make some edits to it
+ * with mkd_update(), and after every edit apply the patch mkd_patch()
+ * returns to the list of blocks it had before, and check that the
+ * blocks add up to what mkd_document() says the html is (for
+ * tests/patch.t.)   The edits are given as offset,removed,text (and
+ * -ncount makes that many more, picked at random from -sseed.)
+ * Prints "ok", or the first edit whose patch didn't work.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mkdio.h"
+#include "pgm_options.h"
+
+/* bits of markdown that change the blocks */
+static char *bits[] = {
+    "\n", "\n\n", "a", "text ", "# ", "* ", "> ", "    ", "---\n",
+    "[a]: /b\n", "[^1]: note\n", "[^1]", "[a]", "same\n\nsame\n\n",
+};
+#define NRBITS	(sizeof bits / sizeof bits[0])
+
+typedef struct {
+    unsigned long id;
+    char *html;
+    int size;
+} Block;
+
+static Block *blocks = 0;
+static int nblocks = 0;
+
+static mkd_flag_t flags = 0;
+static char *src = 0;
+static int size = 0;
+static unsigned long seed = 1;
+
+static unsigned long
+rng()
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) & 0x7fff;
+}
+
+
+/* what the edit being checked was */
+static char edited[80];
+
+static int
+fail(char *why, int i)
+{
+    printf("%s: %s (block %d)\nsource:\n%.*s\n", edited, why, i, size, src);
+    return 0;
+}
+
+
+/* apply a patch to the list of blocks
+ */
+static int
+apply(mkd_patch_t *patch, int count)
+{
+    int i, w;
+
+    /* the removals come first, in the order the blocks were in, so
+     * take them out from the end
+     */
+    for ( i=count-1; i >= 0; --i ) {
+	if ( patch[i].op != MKD_PATCH_REMOVE )
+	    continue;
+	w = patch[i].where;
+	if ( (w < 0) || (w >= nblocks) || (blocks[w].id != patch[i].id) )
+	    return fail("removed the wrong block", w);
+	free(blocks[w].html);
+	memmove(&blocks[w], &blocks[w+1], (nblocks-w-1) * sizeof blocks[0]);
+	--nblocks;
+    }
+
+    for ( i=0; i < count; i++ ) {
+	w = patch[i].where;
+	switch ( patch[i].op ) {
+	case MKD_PATCH_REMOVE:
+	    if ( i && (patch[i-1].op != MKD_PATCH_REMOVE) )
+		return fail("a removal came after a change", w);
+	    continue;
+	case MKD_PATCH_REPLACE:
+	    if ( (w < 0) || (w >= nblocks) || (blocks[w].id != patch[i].old) )
+		return fail("replaced the wrong block", w);
+	    free(blocks[w].html);
+	    break;
+	case MKD_PATCH_INSERT:
+	    if ( (w < 0) || (w > nblocks) )
+		return fail("inserted a block in the wrong place", w);
+	    blocks = realloc(blocks, (nblocks+1) * sizeof blocks[0]);
+	    memmove(&blocks[w+1], &blocks[w], (nblocks-w) * sizeof blocks[0]);
+	    ++nblocks;
+	    break;
+	default:
+	    return fail("unknown patch", w);
+	}
+	blocks[w].id = patch[i].id;
+	blocks[w].size = patch[i].htmlsize;
+	blocks[w].html = malloc(patch[i].htmlsize+1);
+	memcpy(blocks[w].html, patch[i].html, patch[i].htmlsize);
+    }
+    return 1;
+}
+
+
+/* patch the blocks, and see if they add up to the document
+ */
+static int
+check(MMIOT *doc, MMIOT *prev)
+{
+    mkd_patch_t *patch;
+    char *html, *all;
+    int count, len, i, at;
+
+    if ( (count = mkd_patch(doc, prev, &patch)) == EOF )
+	return fail("mkd_patch failed", 0);
+    if ( !apply(patch, count) )
+	return 0;
+    mkd_free_patch(patch, count);
+
+    if ( (len = mkd_document(doc, &html)) < 0 )
+	return fail("mkd_document failed", 0);
+
+    /* the blocks are separated by blank lines, and the footnotes by
+     * just a newline
+     */
+    for ( at = i = 0; i < nblocks; i++ )
+	at += blocks[i].size + 2;
+    all = malloc(at+1);
+    for ( at = i = 0; i < nblocks; i++ ) {
+	if ( i ) {
+	    all[at++] = '\n';
+	    if ( strncmp(blocks[i].html, "<div class=\"footnotes\">", 23) != 0 )
+		all[at++] = '\n';
+	}
+	memcpy(all+at, blocks[i].html, blocks[i].size);
+	at += blocks[i].size;
+    }
+
+    if ( (at != len) || (memcmp(all, html, len) != 0) ) {
+	printf("%s: the patched blocks differ\nsource:\n%.*s\n"
+	       "patched:\n%.*s\nmkd_document:\n%.*s\n",
+		edited, size, src, at, all, len, html);
+	free(all);
+	return 0;
+    }
+    free(all);
+    return 1;
+}
+
+
+static int
+edit(MMIOT *doc, int n, int offset, int removed, char *text)
+{
+    int len = strlen(text);
+
+    if ( offset > size ) offset = size;
+    if ( removed > size - offset ) removed = size - offset;
+
+    snprintf(edited, sizeof edited, "edit %d (%d,%d,\"%.40s\")", n, offset, removed, text);
+    if ( mkd_update(doc, offset, removed, text, len) == EOF ) {
+	printf("%s: mkd_update failed\n", edited);
+	return 0;
+    }
+
+    src = realloc(src, size + len + 1);
+    memmove(src+offset+len, src+offset+removed, size-offset-removed);
+    memcpy(src+offset, text, len);
+    size += len - removed;
+
+    return check(doc, doc);
+}
+
+
+main(argc, argv)
+char **argv;
+{
+    MMIOT *doc;
+    char *text;
+    int i, c, offset, removed, n = 1, count = 0, cap = 0;
+
+    for ( i=1; (i < argc) && (argv[i][0] == '-'); i++ ) {
+	if ( (strncmp(argv[i], "-f", 2) == 0) && set_flag(&flags, argv[i]+2) )
+	    continue;
+	if ( strncmp(argv[i], "-n", 2) == 0 )
+	    count = atoi(argv[i]+2);
+	else if ( strncmp(argv[i], "-s", 2) == 0 )
+	    seed = strtoul(argv[i]+2, 0, 10);
+	else {
+	    fprintf(stderr, "usage: %s [-fflags] [-ncount] [-sseed] "
+			    "[offset,removed,text ...] < markdown\n", argv[0]);
+	    exit(1);
+	}
+    }
+
+    while ( (c = getchar()) != EOF ) {
+	if ( size >= cap )
+	    src = realloc(src, cap = 2*cap + 100);
+	src[size++] = c;
+    }
+
+    if ( !(doc = mkd_edit_string(src ? src : "", size, flags)) ) {
+	fprintf(stderr, "%s: can't read the document\n", argv[0]);
+	exit(1);
+    }
+    mkd_compile(doc, flags);
+
+    /* the first patch is all of the blocks */
+    strcpy(edited, "the first render");
+    if ( !check(doc, 0) )
+	exit(1);
+
+    for ( ; i < argc; i++ ) {
+	if ( (sscanf(argv[i], "%d,%d,", &offset, &removed) != 2)
+			  || !(text = strchr(strchr(argv[i], ',')+1, ',')) ) {
+	    fprintf(stderr, "%s: bad edit <%s>\n", argv[0], argv[i]);
+	    exit(1);
+	}
+	if ( !edit(doc, n++, offset, removed, text+1) )
+	    exit(1);
+    }
+
+    while ( count-- > 0 ) {
+	offset = size ? rng() % (size+1) : 0;
+	removed = (rng() % 3 == 0) ? rng() % 8 : 0;
+	if ( !edit(doc, n++, offset, removed, bits[rng() % NRBITS]) )
+	    exit(1);
+    }
+
+    mkd_cleanup(doc);
+    puts("ok");
+    exit(0);
+}
@@ -0,0 +1,140 @@
+/*
+ * rerender: compile a document once and render it with mkd_render()
+ * with each set of -r flags (-r on its own means 0, the engine's
+ * defaults), and check that each comes out the same as the document
+ * compiled from scratch with those flags, and that mkd_document()
+ * hasn't changed after it (for tests/render.t.)   -f gives the flags
+ * it's compiled with, and -e the default flags of the engine it's
+ * compiled with;  both are expected to be flags that don't overlap
+ * with the -r ones.   Prints "ok", or which one came out differently.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mkdio.h"
+#include "pgm_options.h"
+
+static char *src = 0;
+static int size = 0;
+
+
+static int
+differs(char *what, char *a, int ha, char *b, int hb)
+{
+    if ( (ha == hb) && (memcmp(a, b, ha) == 0) )
+	return 0;
+    printf("%s differs\nsource:\n%.*s\nexpected:\n%.*s\ngot:\n%.*s\n",
+	    what, size, src, ha, a, hb, b);
+    return 1;
+}
+
+
+/* compile the document from scratch and render it the usual way
+ */
+static int
+fresh(mkd_engine *engine, mkd_flag_t flags, char **res)
+{
+    MMIOT *doc;
+    char *html;
+    int len;
+
+    if ( engine )
+	doc = mkd_engine_string(engine, src, size, flags);
+    else
+	doc = mkd_string(src, size, flags);
+
+    if ( !doc || !mkd_compile(doc, flags) || (len = mkd_document(doc, &html)) < 0 ) {
+	fprintf(stderr, "can't compile the document\n");
+	exit(1);
+    }
+    *res = malloc(len+1);
+    memcpy(*res, html, len);
+    mkd_cleanup(doc);
+    return len;
+}
+
+
+main(argc, argv)
+char **argv;
+{
+    MMIOT *doc;
+    mkd_engine *engine = 0;
+    mkd_flag_t flags = 0, defaults = 0, with[20];
+    char *html, *before, *expect, what[40];
+    int i, c, cap = 0, len, blen, elen, pass, count = 0;
+
+    for ( i=1; i < argc; i++ ) {
+	if ( (strncmp(argv[i], "-f", 2) == 0) && set_flag(&flags, argv[i]+2) )
+	    continue;
+	if ( (strncmp(argv[i], "-e", 2) == 0) && set_flag(&defaults, argv[i]+2) ) {
+	    engine = mkd_engine_new(defaults);
+	    continue;
+	}
+	if ( (strncmp(argv[i], "-r", 2) == 0) && (count < 20) ) {
+	    with[count] = 0;
+	    if ( !argv[i][2] || set_flag(&with[count], argv[i]+2) ) {
+		++count;
+		continue;
+	    }
+	}
+	fprintf(stderr, "usage: %s [-fflags] [-eflags] [-rflags ...] < markdown\n", argv[0]);
+	exit(1);
+    }
+
+    while ( (c = getchar()) != EOF ) {
+	if ( size >= cap )
+	    src = realloc(src, cap = 2*cap + 100);
+	src[size++] = c;
+    }
+    if ( !src )
+	src = "";
+
+    if ( engine )
+	doc = mkd_engine_string(engine, src, size, flags);
+    else
+	doc = mkd_string(src, size, flags);
+    if ( !doc || !mkd_compile(doc, flags) ) {
+	fprintf(stderr, "%s: can't compile the document\n", argv[0]);
+	exit(1);
+    }
+
+    /* render it all twice, once before and once after mkd_document()
+     */
+    for ( pass=0; pass < 2; pass++ ) {
+	for ( i=0; i < count; i++ ) {
+	    if ( (len = mkd_render(doc, with[i], &html)) < 0 ) {
+		printf("mkd_render %d failed\n", i+1);
+		exit(1);
+	    }
+	    elen = fresh(with[i] ? 0 : engine, flags|with[i], &expect);
+	    sprintf(what, "mkd_render %d (pass %d)", i+1, pass+1);
+	    if ( differs(what, expect, elen, html, len) )
+		exit(1);
+	    free(expect);
+	    free(html);
+	}
+
+	if ( (len = mkd_document(doc, &html)) < 0 ) {
+	    printf("mkd_document failed\n");
+	    exit(1);
+	}
+	if ( pass == 0 ) {
+	    blen = fresh(engine, flags, &before);
+	    if ( differs("mkd_document", before, blen, html, len) )
+		exit(1);
+	}
+	/* (mkd_document() counts the null it put on the end of the html
+	 * the second time it's called)
+	 */
+	else if ( differs("mkd_document after mkd_render", before, blen, html, strlen(html)) )
+	    exit(1);
+    }
+
+    mkd_cleanup(doc);
+    if ( engine )
+	mkd_engine_free(engine);
+    puts("ok");
+    exit(0);
+}
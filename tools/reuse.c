@@ -0,0 +1,208 @@
+/*
+ * reuse: convert a list of documents (separated by lines that just say
+ * @@) with one document that's used over and over with
+ * mkd_reuse_string() and mkd_reuse_in(), and with documents from the
+ * pool, and check that each one comes out the same as it does in a
+ * new document (for tests/reuse.t.)   Each -f gives a set of flags;
+ * the documents take turns using them.   Prints "ok", or the first
+ * document that came out differently.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mkdio.h"
+#include "pgm_options.h"
+
+static char *
+append(char *s, int *len, char *what, char *text, int size)
+{
+    int wl = strlen(what);
+
+    if ( size < 0 )
+	size = text ? strlen(text) : 0;
+    s = realloc(s, *len + wl + size + 2);
+    memcpy(s + *len, what, wl);
+    *len += wl;
+    if ( size )
+	memcpy(s + *len, text, size);
+    *len += size;
+    s[(*len)++] = '\n';
+    s[*len] = 0;
+    return s;
+}
+
+
+/* everything that can be gotten out of a compiled document
+ */
+static char *
+everything(MMIOT *doc, mkd_flag_t flags, int *len)
+{
+    char *res = 0, *text;
+    int size;
+
+    *len = 0;
+    if ( !doc || !mkd_compile(doc, flags) ) {
+	fprintf(stderr, "can't compile the document\n");
+	exit(1);
+    }
+    res = append(res, len, "title: ", mkd_doc_title(doc), -1);
+    res = append(res, len, "author: ", mkd_doc_author(doc), -1);
+    res = append(res, len, "date: ", mkd_doc_date(doc), -1);
+
+    if ( (size = mkd_css(doc, &text)) > 0 ) {
+	res = append(res, len, "css:\n", text, size);
+	free(text);
+    }
+    if ( (size = mkd_toc(doc, &text)) > 0 ) {
+	res = append(res, len, "toc:\n", text, size);
+	free(text);
+    }
+    size = mkd_document(doc, &text);
+    res = append(res, len, "html:\n", text, (size > 0) ? size : 0);
+    return res;
+}
+
+
+static void
+check(char *how, int i, char *src, int size, char *want, int wlen, char *got, int glen)
+{
+    if ( (wlen != glen) || (memcmp(want, got, wlen) != 0) ) {
+	printf("document %d (%s) differs\nsource:\n%.*s\n"
+	       "new document:\n%.*s\n%s:\n%.*s\n", i, how, size, src, wlen, want, how, glen, got);
+	exit(1);
+    }
+    free(got);
+}
+
+
+static FILE *
+tmpdoc(char *src, int size)
+{
+    FILE *f = tmpfile();
+
+    if ( !f ) {
+	perror("tmpfile");
+	exit(1);
+    }
+    fwrite(src, 1, size, f);
+    rewind(f);
+    return f;
+}
+
+
+main(argc, argv)
+char **argv;
+{
+    MMIOT *fresh, *reused = 0, *fromfile = 0, *pooled;
+    mkd_engine *engine;
+    mkd_flag_t sets[20], flags;
+    char *src = 0, **doc = 0, *want, *got;
+    int *docsize = 0, ndocs = 0, nsets = 0;
+    int i, c, size = 0, cap = 0, start, wlen, glen, round, rounds = 2;
+    FILE *f;
+
+    for ( i=1; i < argc; i++ ) {
+	if ( (strncmp(argv[i], "-f", 2) == 0) && (nsets < 20) ) {
+	    sets[nsets] = 0;
+	    if ( set_flag(&sets[nsets], argv[i]+2) ) {
+		++nsets;
+		continue;
+	    }
+	}
+	if ( strncmp(argv[i], "-n", 2) == 0 ) {
+	    rounds = atoi(argv[i]+2);
+	    continue;
+	}
+	fprintf(stderr, "usage: %s [-fflags ...] [-nrounds] < documents\n", argv[0]);
+	exit(1);
+    }
+    if ( nsets == 0 )
+	sets[nsets++] = 0;
+
+    if ( !(engine = mkd_engine_new(MKD_TOC|MKD_NOPANTS))
+		|| (mkd_engine_define_tag(engine, "tag", 0) != 0) ) {
+	fprintf(stderr, "%s: can't make the engine\n", argv[0]);
+	exit(1);
+    }
+
+    while ( (c = getchar()) != EOF ) {
+	if ( size >= cap )
+	    src = realloc(src, cap = 2*cap + 100);
+	src[size++] = c;
+    }
+
+    /* cut it up into documents */
+    for ( start = i = 0; i <= size; i++ ) {
+	if ( (i < size) && !((size-i >= 4) && (strncmp(src+i, "\n@@\n", 4) == 0)) )
+	    continue;
+	doc = realloc(doc, (ndocs+1) * sizeof doc[0]);
+	docsize = realloc(docsize, (ndocs+1) * sizeof docsize[0]);
+	doc[ndocs] = src + start;
+	docsize[ndocs++] = ((i < size) ? i+1 : size) - start;
+	start = i + 4;
+	i += 3;
+    }
+
+    for ( round = 0; round < rounds; round++ ) {
+	for ( i=0; i < ndocs; i++ ) {
+	    flags = sets[(round*ndocs + i) % nsets];
+
+	    fresh = mkd_string(doc[i], docsize[i], flags);
+	    want = everything(fresh, flags, &wlen);
+	    mkd_cleanup(fresh);
+
+	    if ( reused ) {
+		if ( i & 1 )
+		    mkd_reset(reused);
+		reused = mkd_reuse_string(reused, doc[i], docsize[i], flags);
+	    }
+	    else
+		reused = mkd_string(doc[i], docsize[i], flags);
+	    got = everything(reused, flags, &glen);
+	    check("mkd_reuse_string", i, doc[i], docsize[i], want, wlen, got, glen);
+
+	    f = tmpdoc(doc[i], docsize[i]);
+	    if ( fromfile )
+		fromfile = mkd_reuse_in(fromfile, f, flags);
+	    else
+		fromfile = mkd_in(f, flags);
+	    fclose(f);
+	    got = everything(fromfile, flags, &glen);
+	    check("mkd_reuse_in", i, doc[i], docsize[i], want, wlen, got, glen);
+
+	    /* a document from an engine that's put in the pool has to
+	     * forget about the engine
+	     */
+	    if ( i & 1 ) {
+		pooled = mkd_engine_string(engine, doc[i], docsize[i], flags);
+		mkd_compile(pooled, flags);
+		mkd_pool_release(pooled);
+	    }
+
+	    pooled = mkd_pool_string(doc[i], docsize[i], flags);
+	    got = everything(pooled, flags, &glen);
+	    mkd_pool_release(pooled);
+	    check("mkd_pool_string", i, doc[i], docsize[i], want, wlen, got, glen);
+
+	    f = tmpdoc(doc[i], docsize[i]);
+	    pooled = mkd_pool_in(f, flags);
+	    fclose(f);
+	    got = everything(pooled, flags, &glen);
+	    mkd_pool_release(pooled);
+	    check("mkd_pool_in", i, doc[i], docsize[i], want, wlen, got, glen);
+
+	    free(want);
+	}
+	if ( round & 1 )
+	    mkd_pool_drain();
+    }
+
+    mkd_cleanup(reused);
+    mkd_cleanup(fromfile);
+    mkd_pool_drain();
+    mkd_engine_free(engine);
+    puts("ok");
+    exit(0);
+}
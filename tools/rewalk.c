@@ -0,0 +1,164 @@
+/*
+ * rewalk: check that mkd_walk() sends the nodes of a document in the
+ * same order they come in a pre-order walk of the tree mkd_ast() makes
+ * of it, with the same contents, and that it stops as soon as the
+ * function it calls returns anything except 0 (for tests/walk.t.)
+ * Prints "ok", or the first node that was different.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mkdio.h"
+#include "pgm_options.h"
+
+typedef struct {
+    const mkd_node_t *node;
+    int leaving;
+} Event;
+
+static Event *events = 0;
+static int nevents = 0;
+
+static void
+event(const mkd_node_t *n, int leaving)
+{
+    events = realloc(events, (nevents+1) * sizeof events[0]);
+    events[nevents].node = n;
+    events[nevents++].leaving = leaving;
+}
+
+
+/* walk the tree the way mkd_walk() should
+ */
+static void
+preorder(const mkd_node_t *n)
+{
+    for ( ; n; n = n->next ) {
+	event(n, 0);
+	preorder(n->child);
+	event(n, 1);
+    }
+}
+
+
+static int
+same(const char *a, int sa, const char *b, int sb)
+{
+    if ( !a || !b )
+	return (a == b) && (sa == sb);
+    return (sa == sb) && (memcmp(a, b, sa) == 0);
+}
+
+
+static int
+samestring(const char *a, const char *b)
+{
+    if ( !a || !b )
+	return a == b;
+    return strcmp(a, b) == 0;
+}
+
+
+/* mkd_walk() calls this; it checks each node as it comes in, and
+ * stops the walk after `stop` of them
+ */
+struct walking {
+    int seen;
+    int stop;
+    int bad;
+} ;
+
+static int
+check(const mkd_node_t *n, int leaving, void *ctx)
+{
+    struct walking *w = ctx;
+    const mkd_node_t *x;
+
+    if ( w->seen >= nevents ) {
+	printf("node %d (type %d): past the end of the tree\n", w->seen, n->type);
+	w->bad = 1;
+	return -1;
+    }
+    x = events[w->seen].node;
+
+    if ( (leaving != events[w->seen].leaving) || (n->type != x->type)
+		|| !same(n->text, n->size, x->text, x->size)
+		|| !same(n->title, n->titlesize, x->title, x->titlesize)
+		|| !samestring(n->ident, x->ident) || !samestring(n->lang, x->lang)
+		|| (n->hnumber != x->hnumber) || (n->align != x->align)
+		|| (n->height != x->height) || (n->width != x->width)
+		|| (n->number != x->number) || (n->line != x->line) ) {
+	printf("node %d: walked %s type %d line %d [%.*s]\n"
+	       "   but the tree has %s type %d line %d [%.*s]\n",
+		w->seen, leaving ? "out of" : "into", n->type, n->line,
+		n->text ? n->size : 0, n->text ? n->text : "",
+		events[w->seen].leaving ? "out of" : "into", x->type, x->line,
+		x->text ? x->size : 0, x->text ? x->text : "");
+	w->bad = 1;
+	return -1;
+    }
+
+    ++w->seen;
+    return (w->seen == w->stop) ? w->stop : 0;
+}
+
+
+main(argc, argv)
+char **argv;
+{
+    mkd_flag_t flags = 0;
+    MMIOT *doc;
+    mkd_node_t *root;
+    struct walking w;
+    int i, ret;
+
+    for ( i=1; i < argc; i++ )
+	if ( (strncmp(argv[i], "-f", 2) != 0) || !set_flag(&flags, argv[i]+2) ) {
+	    fprintf(stderr, "usage: %s [-fflags] < markdown\n", argv[0]);
+	    exit(1);
+	}
+
+    if ( !(doc = mkd_in(stdin, flags)) || !mkd_compile(doc, flags) ) {
+	fprintf(stderr, "%s: can't compile the document\n", argv[0]);
+	exit(1);
+    }
+    if ( mkd_ast(doc, &root) == EOF ) {
+	printf("mkd_ast failed\n");
+	exit(1);
+    }
+    preorder(root);
+
+    /* all the way through
+     */
+    memset(&w, 0, sizeof w);
+    if ( (ret = mkd_walk(doc, check, &w)) != 0 ) {
+	if ( !w.bad )
+	    printf("mkd_walk returned %d\n", ret);
+	exit(1);
+    }
+    if ( w.seen != nevents ) {
+	printf("mkd_walk sent %d nodes, but the tree has %d\n", w.seen, nevents);
+	exit(1);
+    }
+
+    /* and stopping after each node
+     */
+    for ( i=1; i <= nevents; i++ ) {
+	memset(&w, 0, sizeof w);
+	w.stop = i;
+	ret = mkd_walk(doc, check, &w);
+	if ( w.bad )
+	    exit(1);
+	if ( (ret != i) || (w.seen != i) ) {
+	    printf("told to stop after node %d, mkd_walk sent %d and returned %d\n",
+		    i, w.seen, ret);
+	    exit(1);
+	}
+    }
+
+    mkd_cleanup(doc);
+    puts("ok");
+    exit(0);
+}
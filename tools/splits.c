@@ -0,0 +1,207 @@
+/*
+ * splits: split a document into sections with mkd_split() at every
+ * header level, and check that the sections cover the document, that
+ * each one is what mkd_render_range() makes of its blocks, that each
+ * one starts at a header at that level or above and has no other such
+ * header in it, and that the header in its manifest is what the html,
+ * the table of contents, and mkd_section() say it is (for
+ * tests/split.t.)
+ * Prints "ok", or what was different.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mkdio.h"
+#include "pgm_options.h"
+
+static mkd_flag_t flags = 0;
+static char *src = 0;
+static int size = 0;
+
+
+/* the html of some blocks
+ */
+static char *
+range(MMIOT *doc, int first, int last, int *len)
+{
+    char *html;
+
+    if ( (*len = mkd_render_range(doc, first, last, flags, &html)) < 0 ) {
+	printf("can't render blocks %d to %d\n", first, last);
+	exit(1);
+    }
+    return html;
+}
+
+
+/* the level of the header a block starts with, or 0 if it doesn't
+ */
+static int
+header(char *html)
+{
+    char *p = html;
+
+    if ( strncmp(p, "<a name=\"", 9) == 0 ) {
+	if ( !(p = strstr(p, "\"></a>\n")) )
+	    return 0;
+	p += 7;
+    }
+    if ( (p[0] == '<') && (p[1] == 'h') && (p[2] >= '1') && (p[2] <= '6')
+		       && ((p[3] == '>') || (p[3] == ' ')) )
+	return p[2] - '0';
+    return 0;
+}
+
+
+/* what the table of contents says the header with an anchor says
+ */
+static char *
+label(char *toc, char *anchor, int *len)
+{
+    char *p, *q;
+    int size = strlen(anchor);
+
+    for ( p = toc; p && (p = strstr(p, "<a href=\"#")); p++ )
+	if ( (strncmp(p+10, anchor, size) == 0)
+			&& (strncmp(p+10+size, "\">", 2) == 0)
+			&& (q = strstr(p, "</a>")) ) {
+	    *len = q - (p+12+size);
+	    return p+12+size;
+	}
+    return 0;
+}
+
+
+static void
+fail(int level, int i, char *what)
+{
+    printf("level %d, section %d: %s\nsource:\n%.*s\n", level, i, what, size, src);
+    exit(1);
+}
+
+
+main(argc, argv)
+char **argv;
+{
+    MMIOT *doc, *contents;
+    mkd_split_t *s;
+    char *html, *block, *text, *toc = 0;
+    int i, j, c, n, cap = 0, level, len, blen, hlevel, textsize, first, last;
+
+    for ( i=1; i < argc; i++ ) {
+	if ( (strncmp(argv[i], "-f", 2) == 0) && set_flag(&flags, argv[i]+2) )
+	    continue;
+	fprintf(stderr, "usage: %s [-fflags] < document\n", argv[0]);
+	exit(1);
+    }
+
+    while ( (c = getchar()) != EOF ) {
+	if ( size >= cap )
+	    src = realloc(src, cap = 2*cap + 100);
+	src[size++] = c;
+    }
+
+    if ( !(doc = mkd_string(src, size, flags)) ) {
+	fprintf(stderr, "can't read the document\n");
+	exit(1);
+    }
+    if ( mkd_split(doc, 1, flags, &s) != EOF ) {
+	printf("split a document that isn't compiled\n");
+	exit(1);
+    }
+    if ( !mkd_compile(doc, flags) ) {
+	fprintf(stderr, "can't compile the document\n");
+	exit(1);
+    }
+    if ( mkd_split(doc, 0, flags, &s) != EOF ) {
+	printf("split a document at level 0\n");
+	exit(1);
+    }
+
+    /* the same document, with a table of contents */
+    if ( !(contents = mkd_string(src, size, flags|MKD_TOC))
+			|| !mkd_compile(contents, flags|MKD_TOC)
+			|| (mkd_toc(contents, &toc) < 0) ) {
+	fprintf(stderr, "can't get the table of contents\n");
+	exit(1);
+    }
+
+    for ( level = 1; level <= 6; level++ ) {
+	if ( (n = mkd_split(doc, level, flags, &s)) < 0 )
+	    fail(level, 0, "can't split the document");
+
+	for ( i=0; i < n; i++ ) {
+	    /* the sections are one after another, all the way through */
+	    if ( s[i].first != (i ? s[i-1].last : 0) )
+		fail(level, i, "doesn't start where the last one ended");
+	    if ( s[i].last <= s[i].first )
+		fail(level, i, "is empty");
+
+	    /* each one is those blocks of the document */
+	    html = range(doc, s[i].first, s[i].last, &len);
+	    if ( (s[i].htmlsize != len) || (strlen(s[i].html) != len)
+					|| (memcmp(s[i].html, html, len) != 0) ) {
+		printf("level %d, section %d (blocks %d to %d) differs\n"
+		       "mkd_render_range:\n%.*s\nmkd_split:\n%.*s\n",
+			level, i, s[i].first, s[i].last, len, html,
+			s[i].htmlsize, s[i].html);
+		exit(1);
+	    }
+	    free(html);
+
+	    /* it starts with the header in the manifest */
+	    block = range(doc, s[i].first, s[i].first+1, &blen);
+	    hlevel = header(block);
+	    if ( (hlevel == 0) || (hlevel > level) ) {
+		if ( i > 0 )
+		    fail(level, i, "doesn't start with a header");
+		if ( s[i].header.hnumber || s[i].header.text || s[i].header.anchor )
+		    fail(level, i, "has a header it doesn't start with");
+	    }
+	    else {
+		if ( s[i].header.hnumber != hlevel )
+		    fail(level, i, "has the wrong header level");
+		if ( !s[i].header.anchor
+			|| (strlen(s[i].header.anchor) != s[i].header.anchorsize)
+			|| (mkd_section(doc, s[i].header.anchor, &first, &last) != 0)
+			|| (first != s[i].first) )
+		    fail(level, i, "has the wrong anchor");
+		if ( !(text = label(toc, s[i].header.anchor, &textsize))
+			|| !s[i].header.text
+			|| (s[i].header.textsize != textsize)
+			|| (strlen(s[i].header.text) != textsize)
+			|| memcmp(s[i].header.text, text, textsize) )
+		    fail(level, i, "has the wrong header text");
+		if ( (flags & MKD_TOC) && !strstr(block, s[i].header.anchor) )
+		    fail(level, i, "has an anchor that isn't in the html");
+	    }
+	    free(block);
+
+	    /* and there are no other headers to split at in it */
+	    for ( j = s[i].first+1; j < s[i].last; j++ ) {
+		block = range(doc, j, j+1, &blen);
+		hlevel = header(block);
+		free(block);
+		if ( hlevel && (hlevel <= level) )
+		    fail(level, i, "has a header it should have been split at");
+	    }
+	}
+
+	/* and there's nothing after them */
+	html = range(doc, n ? s[n-1].last : 0, -1, &len);
+	if ( len != 0 )
+	    fail(level, n, "the document goes on after the last section");
+	free(html);
+
+	mkd_free_split(s, n);
+    }
+
+    free(toc);
+    mkd_cleanup(contents);
+    mkd_cleanup(doc);
+    free(src);
+    printf("ok\n");
+    exit(0);
+}
@@ -0,0 +1,116 @@
+/*
+ * threads: compile and render a document with mkd_threads() set to
+ * more than one thread, and check that it comes out as the same html
+ * (and table of contents) as it does on one thread (for
+ * tests/threads.t.)   -tcount says how many threads to use.
+ * Prints "ok", or where the html first came out differently.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mkdio.h"
+#include "pgm_options.h"
+
+static mkd_flag_t flags = 0;
+static char *src = 0;
+static int size = 0;
+
+
+/* compile the document on <compile> threads and render it on <render>
+ * threads
+ */
+static char *
+html(int compile, int render, int *len, char **toc, int *toclen)
+{
+    MMIOT *doc;
+    char *res = 0, *copy;
+
+    mkd_threads(compile);
+    if ( !(doc = mkd_string(src ? src : "", size, flags)) || !mkd_compile(doc, flags) ) {
+	fprintf(stderr, "can't compile the document\n");
+	exit(1);
+    }
+    mkd_threads(render);
+    if ( (*len = mkd_document(doc, &res)) < 0 )
+	*len = 0;
+    copy = malloc(*len + 1);
+    memcpy(copy, res, *len);
+
+    *toc = 0;
+    if ( (*toclen = mkd_toc(doc, toc)) < 0 )
+	*toclen = 0;
+    mkd_cleanup(doc);
+    return copy;
+}
+
+
+static int
+differs(char *what, char *a, int ha, char *b, int hb)
+{
+    int i;
+
+    if ( (ha == hb) && (memcmp(a, b, ha) == 0) )
+	return 0;
+    for ( i=0; (i < ha) && (i < hb) && (a[i] == b[i]); i++ )
+	;
+    i = (i > 40) ? i-40 : 0;
+    printf("the %s differs at %d (%d bytes vs %d)\n"
+	   "one thread:\n%.80s\nthreaded:\n%.80s\n",
+	    what, i, ha, hb, a + (i < ha ? i : ha), b + (i < hb ? i : hb));
+    return 1;
+}
+
+
+/* do it the same way on one thread and on <count> threads
+ */
+static int
+check(char *how, int compile, int render)
+{
+    char *a, *b, *ta, *tb;
+    int ha, hb, tha, thb, ok;
+
+    a = html(1, 1, &ha, &ta, &tha);
+    b = html(compile, render, &hb, &tb, &thb);
+    ok = !(differs("html", a, ha, b, hb) || differs("toc", ta, tha, tb, thb));
+    if ( !ok )
+	printf("(%s)\n", how);
+    free(a);
+    free(b);
+    if ( ta ) free(ta);
+    if ( tb ) free(tb);
+    return ok;
+}
+
+
+main(argc, argv)
+char **argv;
+{
+    int i, c, count = 4, cap = 0;
+
+    for ( i=1; i < argc; i++ ) {
+	if ( (strncmp(argv[i], "-f", 2) == 0) && set_flag(&flags, argv[i]+2) )
+	    continue;
+	if ( strncmp(argv[i], "-t", 2) == 0 )
+	    count = atoi(argv[i]+2);
+	else {
+	    fprintf(stderr, "usage: %s [-fflags] [-tcount] < markdown\n", argv[0]);
+	    exit(1);
+	}
+    }
+
+    while ( (c = getchar()) != EOF ) {
+	if ( size >= cap )
+	    src = realloc(src, cap = 2*cap + 100);
+	src[size++] = c;
+    }
+
+    if ( !check("compiled on more than one thread", count, 1)
+	    || !check("rendered on more than one thread", 1, count)
+	    || !check("compiled and rendered on more than one thread", count, count) )
+	exit(1);
+
+    puts("ok");
+    exit(0);
+}
@@ -0,0 +1,105 @@
+/*
+ * wide: convert a document with mkd_string64() and mkd_document64(),
+ * and with mkd_generatehtml(), and check that they come out the same
+ * as mkd_string() and mkd_document() (for tests/wide.t.)
+ * Prints "ok", or which one came out differently.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "mkdio.h"
+#include "pgm_options.h"
+
+static mkd_flag_t flags = 0;
+
+
+static int
+differs(char *what, char *a, long ha, char *b, long hb)
+{
+    long i;
+
+    if ( (ha == hb) && (memcmp(a, b, ha) == 0) )
+	return 0;
+    for ( i=0; (i < ha) && (i < hb) && (a[i] == b[i]); i++ )
+	;
+    i = (i > 40) ? i-40 : 0;
+    printf("%s differs at %ld (%ld bytes vs %ld)\n"
+	   "mkd_document:\n%.80s\n%s:\n%.80s\n",
+	    what, i, ha, hb, a + (i < ha ? i : ha), what, b + (i < hb ? i : hb));
+    return 1;
+}
+
+
+main(argc, argv)
+char **argv;
+{
+    MMIOT *doc, *doc64, *gen;
+    char *src = 0, *html, *html64, *xml, *written;
+    ptrdiff_t size64;
+    int i, c, size = 0, cap = 0, len, xmlsize;
+    long wsize;
+    FILE *tmp;
+
+    for ( i=1; i < argc; i++ )
+	if ( (strncmp(argv[i], "-f", 2) != 0) || !set_flag(&flags, argv[i]+2) ) {
+	    fprintf(stderr, "usage: %s [-fflags] < markdown\n", argv[0]);
+	    exit(1);
+	}
+
+    while ( (c = getchar()) != EOF ) {
+	if ( size >= cap )
+	    src = realloc(src, cap = 2*cap + 100);
+	src[size++] = c;
+    }
+    if ( !src )
+	src = "";
+
+    if ( !(doc = mkd_string(src, size, flags)) || !mkd_compile(doc, flags)
+		|| !(doc64 = mkd_string64(src, size, flags)) || !mkd_compile(doc64, flags)
+		|| !(gen = mkd_string(src, size, flags)) || !mkd_compile(gen, flags) ) {
+	fprintf(stderr, "%s: can't compile the document\n", argv[0]);
+	exit(1);
+    }
+
+    if ( (len = mkd_document(doc, &html)) < 0 || (size64 = mkd_document64(doc64, &html64)) < 0 ) {
+	fprintf(stderr, "%s: can't render the document\n", argv[0]);
+	exit(1);
+    }
+    if ( differs("mkd_document64", html, len, html64, size64) )
+	exit(1);
+
+    /* mkd_generatehtml() writes it with a newline on the end, and
+     * xmlified if it's MKD_CDATA
+     */
+    if ( flags & MKD_CDATA )
+	xmlsize = mkd_xml(html, len, &xml);
+    else {
+	xml = html;
+	xmlsize = len;
+    }
+    if ( !(tmp = tmpfile()) || (mkd_generatehtml(gen, tmp) != 0) ) {
+	fprintf(stderr, "%s: can't write the document\n", argv[0]);
+	exit(1);
+    }
+    wsize = ftell(tmp);
+    rewind(tmp);
+    if ( !(written = malloc(wsize+1)) || (fread(written, 1, wsize, tmp) != wsize) ) {
+	fprintf(stderr, "%s: can't read the document back\n", argv[0]);
+	exit(1);
+    }
+    fclose(tmp);
+    if ( (wsize < 1) || (written[wsize-1] != '\n') ) {
+	printf("mkd_generatehtml didn't write a newline on the end\n");
+	exit(1);
+    }
+    if ( differs("mkd_generatehtml", xml, xmlsize, written, wsize-1) )
+	exit(1);
+
+    mkd_cleanup(doc);
+    mkd_cleanup(doc64);
+    mkd_cleanup(gen);
+    puts("ok");
+    exit(0);
+}
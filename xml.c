@@ -38,7 +38,7 @@ mkd_xmlchar(unsigned char c)
 /* write output in XML format
  */
 int
-mkd_generatexml(char *p, int size, FILE *out)
+mkd_generatexml64(char *p, ptrdiff_t size, FILE *out)
 {
     unsigned char c;
     char *entity;
@@ -55,6 +55,13 @@ mkd_generatexml(char *p, int size, FILE *out)
 }
 
 
+int
+mkd_generatexml(char *p, int size, FILE *out)
+{
+    return mkd_generatexml64(p, size, out);
+}
+
+
 /* build a xml'ed version of a string
  */
 int